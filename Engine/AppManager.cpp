@@ -25,6 +25,7 @@
 #include "AppManager.h"
 #include "AppManagerPrivate.h"
 
+#include <algorithm> // min, max
 #include <clocale>
 #include <cstddef>
 #include <stdexcept>
@@ -54,6 +55,7 @@
 #include "Engine/Dot.h"
 #include "Engine/GroupInput.h"
 #include "Engine/GroupOutput.h"
+#include "Engine/ImageBufferPool.h"
 #include "Engine/LibraryBinary.h"
 #include "Engine/Log.h"
 #include "Engine/Node.h"
@@ -62,6 +64,7 @@
 #include "Engine/OfxHost.h"
 #include "Engine/ProcessHandler.h" // ProcessInputChannel
 #include "Engine/Project.h"
+#include "Engine/RenderScheduler.h"
 #include "Engine/RotoPaint.h"
 #include "Engine/RotoSmear.h"
 #include "Engine/ViewerInstance.h" // RenderStatsMap
@@ -217,6 +220,7 @@ AppManager::~AppManager()
 
     ///Caches may have launched some threads to delete images, wait for them to be done
     QThreadPool::globalInstance()->waitForDone();
+    Natron::quitRenderScheduler();
     
     ///Kill caches now because decreaseNCacheFilesOpened can be called
     _imp->_nodeCache->waitForDeleterThread();
@@ -371,9 +375,18 @@ AppManager::loadInternalAfterInitGui(const CLArgs& cl)
         
         U64 maxDiskCacheNode = _imp->_settings->getMaximumDiskCacheNodeSize();
         
-        _imp->_nodeCache.reset( new Cache<Image>("NodeCache",NATRON_CACHE_VERSION, maxCacheRAM - playbackSize,1.) );
-        _imp->_diskCache.reset( new Cache<Image>("DiskCache",NATRON_CACHE_VERSION, maxDiskCacheNode,0.) );
-        _imp->_viewerCache.reset( new Cache<FrameEntry>("ViewerCache",NATRON_CACHE_VERSION,viewerCacheSize,(double)playbackSize / (double)viewerCacheSize) );
+        int nShards = _imp->_settings->getCacheShardsCount();
+        if (nShards <= 0) {
+            nShards = _imp->idealThreadCount;
+        }
+        nShards = std::max(1, nShards);
+        
+        _imp->_nodeCache.reset( new Cache<Image>("NodeCache",NATRON_CACHE_VERSION, maxCacheRAM - playbackSize,1., nShards) );
+        _imp->_diskCache.reset( new Cache<Image>("DiskCache",NATRON_CACHE_VERSION, maxDiskCacheNode,0., nShards) );
+        _imp->_viewerCache.reset( new Cache<FrameEntry>("ViewerCache",NATRON_CACHE_VERSION,viewerCacheSize,(double)playbackSize / (double)viewerCacheSize, nShards) );
+        setApplicationsCachesEvictionPolicy( _imp->_settings->getCacheEvictionPolicy() );
+        setApplicationsCachesCompressionEnabled( _imp->_settings->isCacheCompressionEnabled() );
+        Natron::setImageBufferPoolMaximumSize(maxCacheRAM * NATRON_IMAGE_BUFFER_POOL_PORTION);
     } catch (std::logic_error) {
         // ignore
     }
@@ -587,6 +600,9 @@ AppManager::clearAllCaches()
         it->second.app->renderAllViewers(true);
     }
     
+    ///Give back the buffers of the cleared images to the system
+    Natron::trimImageBufferPool();
+
     Project::clearAutoSavesDir();
 }
 
@@ -601,8 +617,10 @@ AppManager::wipeAndCreateDiskCacheStructure()
     clearAllCaches();
     
     assert(_imp->_diskCache);
+    _imp->_diskCache->resetPackAllocator();
     _imp->cleanUpCacheDiskStructure(_imp->_diskCache->getCachePath());
     assert(_imp->_viewerCache);
+    _imp->_viewerCache->resetPackAllocator();
     _imp->cleanUpCacheDiskStructure(_imp->_viewerCache->getCachePath());
 }
 
@@ -670,6 +688,7 @@ AppManager::setApplicationsCachesMaximumMemoryPercent(double p)
 
     _imp->_nodeCache->setMaximumCacheSize(maxCacheRAM - playbackSize);
     _imp->_nodeCache->setMaximumInMemorySize(1);
+    Natron::setImageBufferPoolMaximumSize(maxCacheRAM * NATRON_IMAGE_BUFFER_POOL_PORTION);
     U64 maxDiskCacheSize = _imp->_settings->getMaximumViewerDiskCacheSize();
     _imp->_viewerCache->setMaximumInMemorySize( (double)playbackSize / (double)maxDiskCacheSize );
 }
@@ -702,6 +721,22 @@ AppManager::setPlaybackCacheMaximumSize(double p)
     _imp->_viewerCache->setMaximumInMemorySize( (double)playbackSize / (double)maxDiskCacheSize );
 }
 
+void
+AppManager::setApplicationsCachesEvictionPolicy(Natron::CacheEvictionPolicyEnum policy)
+{
+    _imp->_nodeCache->setEvictionPolicy(policy);
+    _imp->_diskCache->setEvictionPolicy(policy);
+    _imp->_viewerCache->setEvictionPolicy(policy);
+}
+
+void
+AppManager::setApplicationsCachesCompressionEnabled(bool enabled)
+{
+    _imp->_nodeCache->setCompressionEnabled(enabled);
+    _imp->_diskCache->setCompressionEnabled(enabled);
+    _imp->_viewerCache->setCompressionEnabled(enabled);
+}
+
 void
 AppManager::loadAllPlugins()
 {
@@ -1651,6 +1686,53 @@ AppManager::getCachesTotalMemorySize() const
     return _imp->_viewerCache->getMemoryCacheSize() + _imp->_nodeCache->getMemoryCacheSize();
 }
 
+double
+AppManager::getViewerCacheOccupancy() const
+{
+    std::size_t maxSize = _imp->_viewerCache->getMaximumSize();
+    if (maxSize == 0) {
+        return 1.;
+    }
+    return (double)(_imp->_viewerCache->getMemoryCacheSize() + _imp->_viewerCache->getDiskCacheSize()) / (double)maxSize;
+}
+
+double
+AppManager::getDiskCacheOccupancy() const
+{
+    std::size_t maxSize = _imp->_diskCache->getMaximumSize();
+    if (maxSize == 0) {
+        return 1.;
+    }
+    return (double)(_imp->_diskCache->getMemoryCacheSize() + _imp->_diskCache->getDiskCacheSize()) / (double)maxSize;
+}
+
+U64
+AppManager::getImageBuffersUsedMemorySize() const
+{
+    Natron::ImageBufferPoolStats stats;
+
+    Natron::getImageBufferPoolStats(&stats);
+
+    return stats.usedSize;
+}
+
+U64
+AppManager::getImageBuffersPooledMemorySize() const
+{
+    Natron::ImageBufferPoolStats stats;
+
+    Natron::getImageBufferPoolStats(&stats);
+
+    return stats.pooledSize;
+}
+
+int
+AppManager::getCachesLockContentionCount() const
+{
+    return _imp->_viewerCache->getLockContentionCount() + _imp->_nodeCache->getLockContentionCount() +
+    _imp->_diskCache->getLockContentionCount();
+}
+
 Natron::CacheSignalEmitter*
 AppManager::getOrActivateViewerCacheSignalEmitter() const
 {
@@ -1908,6 +1990,11 @@ AppManager::checkCacheFreeMemoryIsGoodEnough()
     size_t systemRAMToKeepFree = getSystemTotalRAM() * appPTR->getCurrentSettings()->getUnreachableRamPercent();
     size_t totalFreeRAM = getAmountFreePhysicalRAM();
     
+    ///The free buffers of the image buffer pool are released before any cache entry
+    if (totalFreeRAM <= systemRAMToKeepFree) {
+        Natron::trimImageBufferPool();
+        totalFreeRAM = getAmountFreePhysicalRAM();
+    }
 
     double playbackRAMPercent = appPTR->getCurrentSettings()->getRamPlaybackMaximumPercent();
     while (totalFreeRAM <= systemRAMToKeepFree) {
@@ -1962,8 +2049,12 @@ AppManager::getOCIOConfigPath() const
 void
 AppManager::setNThreadsToRender(int nThreads)
 {
-    QMutexLocker l(&_imp->nThreadsMutex);
-    _imp->nThreadsToRender = nThreads;
+    {
+        QMutexLocker l(&_imp->nThreadsMutex);
+        _imp->nThreadsToRender = nThreads;
+    }
+    ///-1 disables multi-threading: the render scheduler tasks then run in the threads waiting for them
+    Natron::setRenderSchedulerThreadsCount( nThreads == -1 ? 0 : (nThreads == 0 ? _imp->idealThreadCount : nThreads) );
 }
 
 void
@@ -2005,7 +2096,7 @@ AppManager::fetchAndAddNRunningThreads(int nThreads)
 int
 AppManager::getNRunningThreads() const
 {
-    return (int)_imp->runningThreadsCount;
+    return (int)_imp->runningThreadsCount + Natron::getRenderSchedulerBusyThreadsCount();
 }
 
 void
@@ -2410,6 +2501,18 @@ AppManager::toggleAutoHideGraphInputs()
 }
 
 
+void
+AppManager::recomputeNodesHash()
+{
+    for (std::map<int,AppInstanceRef>::iterator it = _imp->_appInstances.begin(); it != _imp->_appInstances.end(); ++it) {
+        NodeList nodes;
+        it->second.app->getProject()->getNodes_recursive(nodes);
+        for (NodeList::iterator it2 = nodes.begin(); it2 != nodes.end(); ++it2) {
+            (*it2)->doComputeHashOnMainThread();
+        }
+    }
+}
+
 void
 AppManager::launchPythonInterpreter()
 {
@@ -218,6 +218,28 @@ public:
 
     U64 getCachesTotalMemorySize() const;
 
+    /**
+     * @brief Returns the size of the viewer cache (resp. the cache of the DiskCache nodes), in RAM and on disk,
+     * relative to its maximum size as set in the settings. 1 means the cache is full and starts evicting entries.
+     **/
+    double getViewerCacheOccupancy() const;
+    double getDiskCacheOccupancy() const;
+
+    /**
+     * @brief Returns the memory held by the image buffers in use, whether they are in the caches or not.
+     **/
+    U64 getImageBuffersUsedMemorySize() const;
+
+    /**
+     * @brief Returns the memory held by free image buffers which are kept to be recycled, see ImageBufferPool.h
+     **/
+    U64 getImageBuffersPooledMemorySize() const;
+
+    /**
+     * @brief Returns how many times a thread had to wait on a lock of one of the caches held by another thread.
+     **/
+    int getCachesLockContentionCount() const;
+
     Natron::CacheSignalEmitter* getOrActivateViewerCacheSignalEmitter() const;
 
     void setApplicationsCachesMaximumMemoryPercent(double p);
@@ -228,6 +250,10 @@ public:
 
     void setPlaybackCacheMaximumSize(double p);
 
+    void setApplicationsCachesEvictionPolicy(Natron::CacheEvictionPolicyEnum policy);
+
+    void setApplicationsCachesCompressionEnabled(bool enabled);
+
     void removeFromNodeCache(const boost::shared_ptr<Natron::Image> & image);
     void removeFromViewerCache(const boost::shared_ptr<Natron::FrameEntry> & texture);
     
@@ -357,8 +383,8 @@ public:
     
     /**
      * @brief Returns the number of threads that were launched by Natron for rendering.
-     * This sums up threads launched by the multi-thread suite and threads launched for 
-     * parallel rendering.
+     * This sums up threads launched by the multi-thread suite, threads launched for 
+     * parallel rendering and the threads of the render scheduler running a task.
      **/
     int getNRunningThreads() const;
     
@@ -431,6 +457,9 @@ public Q_SLOTS:
     void onCrashReporterOutputWritten();
 
     void toggleAutoHideGraphInputs();
+    
+    ///Recomputes the hash of all the nodes of all the projects, called when the way the hash is computed changes
+    void recomputeNodesHash();
 
     ///Closes the application not saving any projects.
     virtual void exitApp();
@@ -377,38 +377,8 @@ AppManagerPrivate::checkForCacheDiskStructure(const QString & cachePath)
 
         return false;
     }
-    QDir directory(cachePath);
-    QStringList files = directory.entryList(QDir::AllDirs);
-
-
-    /*Now counting actual data files in the cache*/
-    /*check if there's 256 subfolders, otherwise reset cache.*/
-    int count = 0; // -1 because of the restoreFile
-    int subFolderCount = 0;
-    for (int i = 0; i < files.size(); ++i) {
-        QString subFolder(cachePath);
-        subFolder.append( QDir::separator() );
-        subFolder.append(files[i]);
-        if ( ( subFolder.right(1) == QString(".") ) || ( subFolder.right(2) == QString("..") ) ) {
-            continue;
-        }
-        QDir d(subFolder);
-        if ( d.exists() ) {
-            ++subFolderCount;
-            QStringList items = d.entryList();
-            for (int j = 0; j < items.size(); ++j) {
-                if ( ( items[j] != QString(".") ) && ( items[j] != QString("..") ) ) {
-                    ++count;
-                }
-            }
-        }
-    }
-    if (subFolderCount < 256) {
-        qDebug() << cachePath << "doesn't contain sub-folders indexed from 00 to FF. Reseting.";
-        cleanUpCacheDiskStructure(cachePath);
-
-        return false;
-    }
+    /*The data files of the cache are the pack files next to the restore file, they are
+      checked one by one when the entries of the table of contents are restored.*/
 
     return true;
 }
@@ -428,23 +398,6 @@ AppManagerPrivate::cleanUpCacheDiskStructure(const QString & cachePath)
     }
 #endif
     cacheFolder.mkpath(".");
-
-    QStringList etr = cacheFolder.entryList(QDir::NoDotAndDotDot);
-    // if not 256 subdirs, we re-create the cache
-    if (etr.size() < 256) {
-        Q_FOREACH (QString e, etr) {
-            cacheFolder.rmdir(e);
-        }
-    }
-    for (U32 i = 0x00; i <= 0xF; ++i) {
-        for (U32 j = 0x00; j <= 0xF; ++j) {
-            std::ostringstream oss;
-            oss << std::hex <<  i;
-            oss << std::hex << j;
-            std::string str = oss.str();
-            cacheFolder.mkdir( str.c_str() );
-        }
-    }
 }
 
 void
@@ -86,7 +86,7 @@ struct AppManagerPrivate
     
     int nThreadsToRender; // the value held by the corresponding Knob in the Settings, stored here for faster access (3 RW lock vs 1 mutex here)
     int nThreadsPerEffect;  // the value held by the corresponding Knob in the Settings, stored here for faster access (3 RW lock vs 1 mutex here)
-    bool useThreadPool; // whether the multi-thread suite should use the global thread pool (of QtConcurrent) or not
+    bool useThreadPool; // whether the multi-thread suite should use the threads of the render scheduler or not
     mutable QMutex nThreadsMutex; // protects nThreadsToRender & nThreadsPerEffect & useThreadPool
     
     //The idea here is to keep track of the number of threads launched by Natron (except the ones of the global thread pool of QtConcurrent)
@@ -45,6 +45,8 @@ GCC_DIAG_OFF(deprecated)
 #include <QtCore/QBuffer>
 #include <QtCore/QThreadPool>
 #include <QtCore/QRunnable>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QThread>
 GCC_DIAG_ON(deprecated)
 #if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
 #include <boost/shared_ptr.hpp>
@@ -61,6 +63,9 @@ GCC_DIAG_ON(deprecated)
 //Beyond that percentage of occupation, the cache will start evicting LRU entries
 #define NATRON_CACHE_LIMIT_PERCENT 0.9
 
+//Number of least recently used entries considered by cost-aware eviction policies when picking the entry to evict
+#define NATRON_CACHE_EVICTION_CANDIDATES 32
+
 ///When defined, number of opened files, memory size and disk size of the cache are printed whenever there's activity.
 //#define NATRON_DEBUG_CACHE
 
@@ -309,6 +314,183 @@ private:
 };
 
 
+template <typename EntryType>
+class Cache;
+
+/**
+ * @brief The point of this thread is to run the codec on the entries leaving the in-memory portion of the cache so that
+ * whole images are never compressed or decompressed while holding the lock of a shard.
+ * An entry queued for compression is no longer in any container of the cache: get() takes it back with takeBack()
+ * if the thread did not start working on it yet.
+ **/
+template <typename T>
+class CacheCompressorThread
+    : public QThread
+{
+public:
+
+    struct Job
+    {
+        boost::shared_ptr<T> entry;
+        bool compress; //< if false, the entry is compressed and must be decompressed then moved to the disk portion
+    };
+
+private:
+
+    mutable QMutex _jobsQueueMutex;
+    std::list<Job> _jobsQueue;
+    std::size_t _pendingSize; //< the memory the queued jobs will free, protected by _jobsQueueMutex
+    bool _working; //< protected by _jobsQueueMutex
+    QWaitCondition _jobsQueueNotEmptyCond;
+    bool mustQuit;
+    QMutex mustQuitMutex;
+    QWaitCondition mustQuitCond;
+    const Cache<T>* cache;
+
+public:
+
+    CacheCompressorThread(const Cache<T>* cache)
+        : QThread()
+        , _jobsQueueMutex()
+        , _jobsQueue()
+        , _pendingSize(0)
+        , _working(false)
+        , _jobsQueueNotEmptyCond()
+        , mustQuit(false)
+        , mustQuitMutex()
+        , mustQuitCond()
+        , cache(cache)
+    {
+        setObjectName("CacheCompressor");
+    }
+
+    virtual ~CacheCompressorThread()
+    {
+    }
+
+    void appendToQueue(const boost::shared_ptr<T> & entry,
+                       bool compress)
+    {
+        {
+            QMutexLocker k(&_jobsQueueMutex);
+            Job j;
+            j.entry = entry;
+            j.compress = compress;
+            _jobsQueue.push_back(j);
+            _pendingSize += entry->size();
+        }
+        if ( !isRunning() ) {
+            start();
+        } else {
+            QMutexLocker k(&_jobsQueueMutex);
+            _jobsQueueNotEmptyCond.wakeOne();
+        }
+    }
+
+    /**
+     * @brief Removes from the queue the job of the entry matching the key, if the thread did not start working on it yet.
+     **/
+    bool takeBack(const typename T::key_type & key,
+                  Job* job)
+    {
+        QMutexLocker k(&_jobsQueueMutex);
+
+        for (typename std::list<Job>::iterator it = _jobsQueue.begin(); it != _jobsQueue.end(); ++it) {
+            if ( it->entry && (it->entry->getKey() == key) ) {
+                *job = *it;
+                std::size_t sz = it->entry->size();
+                _pendingSize = sz > _pendingSize ? 0 : _pendingSize - sz;
+                _jobsQueue.erase(it);
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::size_t getPendingSize() const
+    {
+        QMutexLocker k(&_jobsQueueMutex);
+
+        return _pendingSize;
+    }
+
+    void quitThread()
+    {
+        if ( !isRunning() ) {
+            return;
+        }
+        QMutexLocker k(&mustQuitMutex);
+        mustQuit = true;
+
+        {
+            ///The entries left in the queue are dropped
+            QMutexLocker k2(&_jobsQueueMutex);
+            _jobsQueue.clear();
+            _pendingSize = 0;
+            _jobsQueue.push_back( Job() );
+            _jobsQueueNotEmptyCond.wakeOne();
+        }
+        while (mustQuit) {
+            mustQuitCond.wait(&mustQuitMutex);
+        }
+    }
+
+    bool isWorking() const
+    {
+        QMutexLocker k(&_jobsQueueMutex);
+
+        return !_jobsQueue.empty() || _working;
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL
+    {
+        for (;; ) {
+            bool quit;
+            {
+                QMutexLocker k(&mustQuitMutex);
+                quit = mustQuit;
+            }
+
+            {
+                Job front;
+                {
+                    QMutexLocker k(&_jobsQueueMutex);
+                    _working = false;
+                    if ( quit && _jobsQueue.empty() ) {
+                        k.unlock();
+                        QMutexLocker k(&mustQuitMutex);
+                        mustQuit = false;
+                        mustQuitCond.wakeAll();
+
+                        return;
+                    }
+                    while ( _jobsQueue.empty() ) {
+                        _jobsQueueNotEmptyCond.wait(&_jobsQueueMutex);
+                    }
+
+                    assert( !_jobsQueue.empty() );
+                    front = _jobsQueue.front();
+                    _jobsQueue.pop_front();
+                    if (front.entry) {
+                        std::size_t sz = front.entry->size();
+                        _pendingSize = sz > _pendingSize ? 0 : _pendingSize - sz;
+                        _working = true;
+                    }
+                }
+                if (front.entry) {
+                    cache->processCompressorJob(front);
+                }
+            } // front
+            cache->notifyMemoryDeallocated();
+        }
+    }
+};
+
+
 class CacheSignalEmitter
     : public QObject
 {
@@ -363,6 +545,32 @@ Q_SIGNALS:
 };
 
 
+/**
+ * @brief Same as QMutexLocker except that it increments the given counter whenever the mutex
+ * was already taken by another thread and the caller had to wait for it.
+ **/
+class CacheMutexLocker
+{
+    QMutex* _mutex;
+
+public:
+
+    CacheMutexLocker(QMutex* mutex,
+                     QAtomicInt* contentionCounter)
+        : _mutex(mutex)
+    {
+        if ( !_mutex->tryLock() ) {
+            contentionCounter->fetchAndAddRelaxed(1);
+            _mutex->lock();
+        }
+    }
+
+    ~CacheMutexLocker()
+    {
+        _mutex->unlock();
+    }
+};
+
 /*
  * ValueType must be derived of CacheEntryHelper
  */
@@ -371,6 +579,7 @@ class Cache
     : public CacheAPI
 {
     friend class CacheCleanerThread;
+    friend class CacheCompressorThread<EntryType>;
 
 public:
 
@@ -450,6 +659,46 @@ public:
 
 private:
 
+    /**
+     * @brief A shard owns all the entries whose hash falls into its partition. Each shard has its own LRU
+     * containers and locks so that threads looking-up entries living in different shards never wait on each other.
+     * The memory budget is still global to the cache: when it is exceeded, entries are evicted from the fullest shards first.
+     *
+     * Entries evicted from memoryCache go first to compressedCache where their data is kept compressed in RAM. They
+     * are decompressed when looked-up again. The compressed entries are part of the in-memory portion: their (compressed)
+     * size is accounted in memoryCacheSize.
+     **/
+    struct CacheShard
+    {
+        mutable QMutex lock; //protects memoryCache & compressedCache & diskCache
+        mutable QMutex getLock; //prevents get() and getOrCreate() to be called simultaneously on this shard
+        mutable CacheContainer memoryCache;
+        mutable CacheContainer compressedCache;
+        mutable CacheContainer diskCache;
+        std::size_t memoryCacheSize; // protected by the _sizeLock of the cache
+        std::size_t compressedCacheSize; // protected by the _sizeLock of the cache
+        std::size_t diskCacheSize; // protected by the _sizeLock of the cache
+        double memoryInflation; // GreedyDual-Size inflation of memoryCache, protected by lock
+        double compressedInflation; // GreedyDual-Size inflation of compressedCache, protected by lock
+        double diskInflation; // GreedyDual-Size inflation of diskCache, protected by lock
+
+        CacheShard()
+            : lock()
+            , getLock()
+            , memoryCache()
+            , compressedCache()
+            , diskCache()
+            , memoryCacheSize(0)
+            , compressedCacheSize(0)
+            , diskCacheSize(0)
+            , memoryInflation(0.)
+            , compressedInflation(0.)
+            , diskInflation(0.)
+        {
+        }
+    };
+
+    typedef boost::shared_ptr<CacheShard> CacheShardPtr;
 
     std::size_t _maximumInMemorySize;     // the maximum size of the in-memory portion of the cache.(in % of the maximum cache size)
     std::size_t _maximumCacheSize;     // maximum size allowed for the cache
@@ -459,14 +708,25 @@ private:
      */
     mutable std::size_t _memoryCacheSize;     // current size of the cache in bytes
     mutable std::size_t _diskCacheSize;
-    mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _maximumInMemorySize & _maximumCacheSize
-    mutable QMutex _lock; //protects _memoryCache & _diskCache
-    mutable QMutex _getLock;  //prevents get() and getOrCreate() to be called simultaneously
-
-    /*These 2 are mutable because we need to modify the LRU list even
-         when we call get() and we want this function to be const.*/
-    mutable CacheContainer _memoryCache;
-    mutable CacheContainer _diskCache;
+    mutable std::size_t _compressedCacheSize; // the part of _memoryCacheSize used by compressed entries
+    mutable QMutex _sizeLock; // protects _memoryCacheSize & _diskCacheSize & _compressedCacheSize & _maximumInMemorySize & _maximumCacheSize and the sizes of the shards
+
+    ///The hash-partitions of the cache. With a single shard the cache behaves as one LRU protected by a single lock.
+    ///The vector itself is never modified after the constructor.
+    std::vector<CacheShardPtr> _shards;
+
+    ///Number of times a thread had to wait for a lock of a shard held by another thread
+    mutable QAtomicInt _lockContention;
+
+    ///A value of Natron::CacheEvictionPolicyEnum, can be changed at any time
+    QAtomicInt _evictionPolicy;
+
+    ///Whether entries evicted from the in-memory portion are kept compressed in RAM, can be changed at any time
+    QAtomicInt _compressionEnabled;
+
+    ///The pack files holding the entries stored on disk, created lazily by getPackAllocator()
+    mutable boost::shared_ptr<Natron::CachePackAllocator> _packs;
+    mutable QMutex _packsLock;
     const std::string _cacheName;
     const unsigned int _version;
 
@@ -478,6 +738,7 @@ private:
     std::size_t _maxPhysicalRAM;
     bool _tearingDown;
     mutable Natron::DeleterThread<EntryType> _deleterThread;
+    mutable Natron::CacheCompressorThread<EntryType> _compressorThread;
     mutable QWaitCondition _memoryFullCondition; //< protected by _sizeLock
     mutable Natron::CacheCleanerThread _cleanerThread;
 
@@ -490,40 +751,53 @@ public:
           ,
           U64 maximumCacheSize      // total size
           ,
-          double maximumInMemoryPercentage)      //how much should live in RAM
+          double maximumInMemoryPercentage      //how much should live in RAM
+          ,
+          unsigned int nShards = 0)      //how many independent partitions the cache is made of, 0 = one per core
         : CacheAPI()
         , _maximumInMemorySize(maximumCacheSize * maximumInMemoryPercentage)
         , _maximumCacheSize(maximumCacheSize)
         , _memoryCacheSize(0)
         , _diskCacheSize(0)
+        , _compressedCacheSize(0)
         , _sizeLock()
-        , _lock()
-        , _getLock()
-        , _memoryCache()
-        , _diskCache()
+        , _shards()
+        , _lockContention()
+        , _evictionPolicy( (int)Natron::eCacheEvictionPolicyLRU )
+        , _compressionEnabled(1)
         , _cacheName(cacheName)
         , _version(version)
         , _signalEmitter(new CacheSignalEmitter)
         , _maxPhysicalRAM( getSystemTotalRAM() )
         , _tearingDown(false)
         , _deleterThread(this)
+        , _compressorThread(this)
         , _memoryFullCondition()
         , _cleanerThread(this)
     {
+        if (nShards == 0) {
+            nShards = (unsigned int)std::max(1, QThread::idealThreadCount());
+        }
+        for (unsigned int i = 0; i < nShards; ++i) {
+            _shards.push_back( CacheShardPtr(new CacheShard) );
+        }
     }
 
     virtual ~Cache()
     {
-        QMutexLocker locker(&_lock);
-
         _tearingDown = true;
-        _memoryCache.clear();
-        _diskCache.clear();
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            QMutexLocker locker(&_shards[i]->lock);
+            _shards[i]->memoryCache.clear();
+            _shards[i]->compressedCache.clear();
+            _shards[i]->diskCache.clear();
+        }
         delete _signalEmitter;
     }
 
     void waitForDeleterThread()
     {
+        _compressorThread.quitThread();
         _deleterThread.quitThread();
         _cleanerThread.quitThread();
     }
@@ -542,67 +816,40 @@ public:
     bool get(const typename EntryType::key_type & key,
              std::list<EntryTypePtr>* returnValue) const
     {
+        CacheShard & shard = getShard( key.getHash() );
+
         ///Be atomic, so it cannot be created by another thread in the meantime
-        QMutexLocker getlocker(&_getLock);
+        CacheMutexLocker getlocker(&shard.getLock, &_lockContention);
+        EntryTypePtr compressed;
+        {
+            ///lock the shard before reading it.
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
 
-        ///lock the cache before reading it.
-        QMutexLocker locker(&_lock);
+            if ( getInternal(shard, key, returnValue, &compressed) ) {
+                return true;
+            }
+        }
 
-        return getInternal(key, returnValue);
+        return compressed && decompressFoundEntry(shard, compressed, returnValue);
     } // get
 
 private:
 
-    void createInternal(const typename EntryType::key_type & key,
+    void createInternal(CacheShard & shard,
+                        const typename EntryType::key_type & key,
                         const ParamsTypePtr & params,
                         EntryTypePtr* returnValue) const
     {
-        //_lock must not be taken here
+        //The lock of the shard must not be taken here
 
         ///Before allocating the memory check that there's enough space to fit in memory
         appPTR->checkCacheFreeMemoryIsGoodEnough();
 
-
-        ///Just in case, we don't allow more than X files to be removed at once.
-        int safeCounter = 0;
-        ///If too many files are opened, fall-back on RAM storage.
-        while (appPTR->isNCacheFilesOpenedCapped() && safeCounter < 1000) {
-#ifdef NATRON_DEBUG_CACHE
-            qDebug() << "Reached maximum cache files opened limit,clearing last recently used one...";
-#endif
-            if ( !evictLRUDiskEntry() ) {
-                break;
-            }
-            ++safeCounter;
-        }
-
-        U64 memoryCacheSize, maximumInMemorySize;
-        {
-            QMutexLocker k(&_sizeLock);
-            memoryCacheSize = _memoryCacheSize;
-            maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
-        }
         {
-            QMutexLocker locker(&_lock);
             std::list<EntryTypePtr> entriesToBeDeleted;
-            double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
             ///While the current cache size can't fit the new entry, erase the last recently used entries.
             ///Also if the total free RAM is under the limit of the system free RAM to keep free, erase LRU entries.
-            while (occupationPercentage > NATRON_CACHE_LIMIT_PERCENT) {
-                std::list<EntryTypePtr> deleted;
-                if ( !tryEvictEntry(deleted) ) {
-                    break;
-                }
-
-                for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
-                    if ( !(*it)->isStoredOnDisk() ) {
-                        memoryCacheSize -= (*it)->size();
-                    }
-                    entriesToBeDeleted.push_back(*it);
-                }
-
-                occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
-            }
+            evictInMemoryEntries(NULL, NATRON_CACHE_LIMIT_PERCENT, entriesToBeDeleted);
 
             if ( !entriesToBeDeleted.empty() ) {
                 ///Launch a separate thread whose function will be to delete all the entries to be deleted
@@ -618,15 +865,15 @@ private:
             QMutexLocker k(&_sizeLock);
             double occupationPercentage =  _maximumCacheSize == 0 ? 0.99 : (double)_memoryCacheSize / _maximumCacheSize;
 
-            //_memoryCacheSize member will get updated while images are being destroyed by the parallel thread.
+            //_memoryCacheSize member will get updated while images are being destroyed or compressed by the parallel threads.
             //we wait for cache memory occupation to be < 100% to be sure we don't hit swap here
-            while ( occupationPercentage >= 1. && _deleterThread.isWorking() ) {
+            while ( occupationPercentage >= 1. && ( _deleterThread.isWorking() || _compressorThread.isWorking() ) ) {
                 _memoryFullCondition.wait(&_sizeLock);
                 occupationPercentage =  _maximumCacheSize == 0 ? 0.99 : (double)_memoryCacheSize / _maximumCacheSize;
             }
         }
         {
-            QMutexLocker locker(&_lock);
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
             Natron::StorageModeEnum storage;
             if (params->getCost() == 0) {
                 storage = Natron::eStorageModeRAM;
@@ -638,12 +885,7 @@ private:
 
 
             try {
-                std::string filePath;
-                if (storage == Natron::eStorageModeDisk) {
-                    filePath = getCachePath().toStdString();
-                    filePath += '/';
-                }
-                returnValue->reset( new EntryType(key, params, this, storage, filePath) );
+                returnValue->reset( new EntryType(key, params, this, storage) );
 
                 ///Don't call allocateMemory() here because we're still under the lock and we might force tons of threads to wait unnecesserarily
             } catch (const std::bad_alloc & e) {
@@ -651,7 +893,7 @@ private:
             }
 
             if (*returnValue) {
-                sealEntry(*returnValue, true);
+                sealEntry(shard, *returnValue, true);
             }
         }
     } // createInternal
@@ -661,13 +903,15 @@ public:
     void swapOrInsert(const EntryTypePtr& entryToBeEvicted,
                       const EntryTypePtr& newEntry)
     {
-        QMutexLocker locker(&_lock);
-        
         const typename EntryType::key_type& key = entryToBeEvicted->getKey();
         typename EntryType::hash_type hash = entryToBeEvicted->getHashKey();
+        CacheShard & shard = getShard(hash);
+
+        CacheMutexLocker locker(&shard.lock, &_lockContention);
+
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache(hash);
-        if (memoryCached != _memoryCache.end()) {
+        CacheIterator memoryCached = shard.memoryCache(hash);
+        if (memoryCached != shard.memoryCache.end()) {
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
             for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                 if ( (*it)->getKey() == key && (*it)->getParams() == entryToBeEvicted->getParams()) {
@@ -677,10 +921,11 @@ public:
             }
             ///Append it
             ret.push_back(newEntry);
+            touchEntry(shard, newEntry, true);
         } else {
             ///Look in disk cache
-            CacheIterator diskCached = _diskCache(hash);
-            if (diskCached != _diskCache.end()) {
+            CacheIterator diskCached = shard.diskCache(hash);
+            if (diskCached != shard.diskCache.end()) {
                 ///Remove the old entry
                 std::list<EntryTypePtr> & ret = getValueFromIterator(diskCached);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
@@ -692,7 +937,8 @@ public:
 
             }
             ///Insert in mem cache
-            _memoryCache.insert(hash, newEntry);
+            shard.memoryCache.insert(hash, newEntry);
+            touchEntry(shard, newEntry, true);
         }
     }
 
@@ -731,14 +977,19 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
 
+        CacheShard & shard = getShard( key.getHash() );
         {
             ///Be atomic, so it cannot be created by another thread in the meantime
-            QMutexLocker getlocker(&_getLock);
+            CacheMutexLocker getlocker(&shard.getLock, &_lockContention);
             std::list<EntryTypePtr> entries;
+            EntryTypePtr compressed;
             bool didGetSucceed;
             {
-                QMutexLocker locker(&_lock);
-                didGetSucceed = getInternal(key, &entries);
+                CacheMutexLocker locker(&shard.lock, &_lockContention);
+                didGetSucceed = getInternal(shard, key, &entries, &compressed);
+            }
+            if (!didGetSucceed && compressed) {
+                didGetSucceed = decompressFoundEntry(shard, compressed, &entries);
             }
             if (didGetSucceed) {
                 for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
@@ -750,7 +1001,7 @@ public:
                 }
             }
 
-            createInternal(key, params, returnValue);
+            createInternal(shard, key, params, returnValue);
 
             return false;
         } // getlocker
@@ -768,13 +1019,24 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            if ( evictedFromMemory.second->isStoredOnDisk() ) {
-                evictedFromMemory.second->removeAnyBackingFile();
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard & shard = *_shards[i];
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
+            std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+            while (evictedFromMemory.second) {
+                if ( evictedFromMemory.second->isStoredOnDisk() ) {
+                    evictedFromMemory.second->removeAnyBackingFile();
+                }
+                evictedFromMemory = shard.memoryCache.evict();
+            }
+            std::pair<hash_type, EntryTypePtr> evictedFromCompressed = shard.compressedCache.evict();
+            while (evictedFromCompressed.second) {
+                onRemovedFromCompressedPortion(shard, evictedFromCompressed.second);
+                if ( evictedFromCompressed.second->isStoredOnDisk() ) {
+                    evictedFromCompressed.second->removeAnyBackingFile();
+                }
+                evictedFromCompressed = shard.compressedCache.evict();
             }
-            evictedFromMemory = _memoryCache.evict();
         }
 
         if (_signalEmitter) {
@@ -793,17 +1055,20 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-
-        /// An entry which has a use_count greater than 1 is not removable:
-        /// The backing file must not be removed because it might be read/written to
-        /// at the same time. The best we can do is just let it here in the cache.
-        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-        //we'll let the user of these entries purge the extra entries left in the cache later on
-        while (evictedFromDisk.second) {
-            evictedFromDisk.second->removeAnyBackingFile();
-            evictedFromDisk = _diskCache.evict();
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard & shard = *_shards[i];
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
+
+            /// An entry which has a use_count greater than 1 is not removable:
+            /// The backing file must not be removed because it might be read/written to
+            /// at the same time. The best we can do is just let it here in the cache.
+            std::pair<hash_type, EntryTypePtr> evictedFromDisk = shard.diskCache.evict();
+            //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+            //we'll let the user of these entries purge the extra entries left in the cache later on
+            while (evictedFromDisk.second) {
+                evictedFromDisk.second->removeAnyBackingFile();
+                evictedFromDisk = shard.diskCache.evict();
+            }
         }
 
 
@@ -820,49 +1085,43 @@ public:
             ///block signals otherwise the we would be spammed of notifications
             _signalEmitter->blockSignals(true);
         }
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evictedFromMemory = _memoryCache.evict();
-        while (evictedFromMemory.second) {
-            ///move back the entry on disk if it can be store on disk
-            if ( evictedFromMemory.second->isStoredOnDisk() ) {
-                evictedFromMemory.second->deallocate();
-                /*insert it back into the disk portion */
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard & shard = *_shards[i];
+            ///Compressed entries stored on disk are decompressed one by one and written to the disk portion,
+            ///but not while holding the lock of the shard
+            std::list<EntryTypePtr> toDecompress;
+            {
+                CacheMutexLocker locker(&shard.lock, &_lockContention);
+                std::pair<hash_type, EntryTypePtr> evictedFromMemory = shard.memoryCache.evict();
+                while (evictedFromMemory.second) {
+                    ///move back the entry on disk if it can be store on disk
+                    if ( evictedFromMemory.second->isStoredOnDisk() ) {
+                        moveToDiskPortion(shard, evictedFromMemory.second);
+                    }
 
-                U64 diskCacheSize, maximumCacheSize;
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumCacheSize = _maximumCacheSize;
+                    evictedFromMemory = shard.memoryCache.evict();
                 }
 
-                /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-                while (diskCacheSize + evictedFromMemory.second->size() >= maximumCacheSize) {
-                    {
-                        std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-                        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-                        //we'll let the user of these entries purge the extra entries left in the cache later on
-                        if (!evictedFromDisk.second) {
-                            break;
-                        }
-                        ///Erase the file from the disk if we reach the limit.
-                        evictedFromDisk.second->removeAnyBackingFile();
-                    }
-                    {
-                        QMutexLocker k(&_sizeLock);
-                        diskCacheSize = _diskCacheSize;
-                        maximumCacheSize = _maximumCacheSize;
+                std::pair<hash_type, EntryTypePtr> evictedFromCompressed = shard.compressedCache.evict();
+                while (evictedFromCompressed.second) {
+                    onRemovedFromCompressedPortion(shard, evictedFromCompressed.second);
+                    if ( evictedFromCompressed.second->isStoredOnDisk() ) {
+                        toDecompress.push_back(evictedFromCompressed.second);
                     }
-                }
 
-                /*update the disk cache size*/
-                CacheIterator existingDiskCacheEntry = _diskCache( evictedFromMemory.second->getHashKey() );
-                /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-                if ( existingDiskCacheEntry == _diskCache.end() ) {
-                    _diskCache.insert(evictedFromMemory.second->getHashKey(), evictedFromMemory.second);
+                    evictedFromCompressed = shard.compressedCache.evict();
                 }
             }
-
-            evictedFromMemory = _memoryCache.evict();
+            for (typename std::list<EntryTypePtr>::iterator it = toDecompress.begin(); it != toDecompress.end(); ++it) {
+                try {
+                    (*it)->decompress();
+                } catch (const std::exception & e) {
+                    qDebug() << "Error while decompressing cache entry: " << e.what();
+                    continue;
+                }
+                CacheMutexLocker locker(&shard.lock, &_lockContention);
+                moveToDiskPortion(shard, *it);
+            }
         }
 
         _signalEmitter->blockSignals(false);
@@ -877,53 +1136,39 @@ public:
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
         std::list<EntryTypePtr> entriesToBeDeleted;
 
-        {
-            QMutexLocker locker(&_lock);
-            U64 memoryCacheSize, maximumInMemorySize;
-            {
-                QMutexLocker k(&_sizeLock);
-                memoryCacheSize = _memoryCacheSize;
-                maximumInMemorySize = std::max( (std::size_t)1, _maximumInMemorySize );
-            }
-            double occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
-            while (occupationPercentage >= NATRON_CACHE_LIMIT_PERCENT) {
-                std::list<EntryTypePtr> deleted;
-                if ( !tryEvictEntry(deleted) ) {
-                    break;
-                }
-
-                for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
-                    if ( !(*it)->isStoredOnDisk() ) {
-                        memoryCacheSize -= (*it)->size();
-                    }
-                    entriesToBeDeleted.push_back(*it);
-                }
-                occupationPercentage = (double)memoryCacheSize / maximumInMemorySize;
-            }
-        }
+        evictInMemoryEntries(NULL, NATRON_CACHE_LIMIT_PERCENT, entriesToBeDeleted);
     }
 
     /**
      * @brief Get a copy of the cache at the moment it gets the lock for reading.
      * Returning this function, the caller can assume the entries will not be removed
      * from the cache because their use_count is > 1
+     * Note that the data of compressed entries is not accessible, they must be looked-up with get() first.
      **/
     void getCopy(std::list<EntryTypePtr>* copy) const
     {
-        QMutexLocker locker(&_lock);
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            const CacheShard & shard = *_shards[i];
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
 
-        for (CacheIterator it = _memoryCache.begin(); it != _memoryCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
-        }
-        for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
-            const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
-            copy->insert( copy->end(), entries.begin(), entries.end() );
+            for (CacheIterator it = shard.memoryCache.begin(); it != shard.memoryCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
+            for (CacheIterator it = shard.compressedCache.begin(); it != shard.compressedCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
+            for (CacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(it);
+                copy->insert( copy->end(), entries.begin(), entries.end() );
+            }
         }
     }
 
     /**
-     * @brief Removes the last recently used entry from the in-memory cache.
+     * @brief Removes the entry designated by the eviction policy (the least recently used one by default)
+     * from the in-memory cache.
      * This is expensive since it takes the lock. Returns false
      * if there's nothing left to evict.
      **/
@@ -932,43 +1177,16 @@ public:
         ///Make sure the shared_ptrs live in this list and are destroyed not while under the lock
         ///so that the memory freeing (which might be expensive for large images) doesn't happen while under the lock
         std::list<EntryTypePtr> entriesToBeDeleted;
-        bool ret;
-        {
-            QMutexLocker locker(&_lock);
-            ret = tryEvictEntry(entriesToBeDeleted);
-        }
-
-        return ret;
-    }
-
-    /**
-     * @brief Removes the last recently used entry from the disk cache.
-     * This is expensive since it takes the lock. Returns false
-     * if there's nothing left to evict.
-     **/
-    bool evictLRUDiskEntry() const
-    {
-        QMutexLocker locker(&_lock);
-        std::pair<hash_type, EntryTypePtr> evicted = _diskCache.evict();
-
-        //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-        //we'll let the user of these entries purge the extra entries left in the cache later on
-        if (!evicted.second) {
-            return false;
-        }
-        /*if it is stored on disk, remove it from memory*/
 
-        assert( evicted.second.unique() );
-        evicted.second->removeAnyBackingFile();
-
-        return true;
+        return tryEvictEntry(NULL, entriesToBeDeleted);
     }
 
     /**
      * @brief To be called by a CacheEntry whenever it's size changes.
      * This way the cache can keep track of the real memory footprint.
      **/
-    virtual void notifyEntrySizeChanged(std::size_t oldSize,
+    virtual void notifyEntrySizeChanged(U64 hash,
+                                        std::size_t oldSize,
                                         std::size_t newSize) const OVERRIDE FINAL
     {
         ///The entry has notified it's memory layout has changed, it must have been due to an action from the cache
@@ -979,11 +1197,14 @@ public:
 
         ///Avoid overflows, _memoryCacheSize may not always fallback to 0
         qint64 diff = (qint64)newSize - (qint64)oldSize;
+        CacheShard & shard = getShard(hash);
 
         if (diff < 0) {
-            _memoryCacheSize = diff > (qint64)_memoryCacheSize ? 0 : _memoryCacheSize + diff;
+            subtractSize(-diff, &_memoryCacheSize);
+            subtractSize(-diff, &shard.memoryCacheSize);
         } else {
             _memoryCacheSize += diff;
+            shard.memoryCacheSize += diff;
         }
 #ifdef NATRON_DEBUG_CACHE
         qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
@@ -993,7 +1214,8 @@ public:
     /**
      * @brief To be called by a CacheEntry on allocation.
      **/
-    virtual void notifyEntryAllocated(int time,
+    virtual void notifyEntryAllocated(U64 hash,
+                                      int time,
                                       std::size_t size,
                                       Natron::StorageModeEnum storage) const OVERRIDE FINAL
     {
@@ -1002,11 +1224,8 @@ public:
         QMutexLocker k(&_sizeLock);
 
         _memoryCacheSize += size;
+        getShard(hash).memoryCacheSize += size;
         _signalEmitter->emitAddedEntry(time);
-
-        if (storage == Natron::eStorageModeDisk) {
-            appPTR->increaseNCacheFilesOpened();
-        }
 #ifdef NATRON_DEBUG_CACHE
         qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
 #endif
@@ -1015,19 +1234,23 @@ public:
     /**
      * @brief To be called by a CacheEntry on destruction.
      **/
-    virtual void notifyEntryDestroyed(int time,
+    virtual void notifyEntryDestroyed(U64 hash,
+                                      int time,
                                       std::size_t size,
                                       Natron::StorageModeEnum storage) const OVERRIDE FINAL
     {
         QMutexLocker k(&_sizeLock);
+        CacheShard & shard = getShard(hash);
 
         if (storage == Natron::eStorageModeRAM) {
-            _memoryCacheSize = size > _memoryCacheSize ? 0 : _memoryCacheSize - size;
+            subtractSize(size, &_memoryCacheSize);
+            subtractSize(size, &shard.memoryCacheSize);
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
 #endif
         } else if (storage == Natron::eStorageModeDisk) {
-            _diskCacheSize = size > _diskCacheSize ? 0 : _diskCacheSize - size;
+            subtractSize(size, &_diskCacheSize);
+            subtractSize(size, &shard.diskCacheSize);
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize);
 #endif
@@ -1048,7 +1271,8 @@ public:
      * @brief To be called whenever an entry is deallocated from memory and put back on disk or whenever
      * it is reallocated in the RAM.
      **/
-    virtual void notifyEntryStorageChanged(Natron::StorageModeEnum oldStorage,
+    virtual void notifyEntryStorageChanged(U64 hash,
+                                           Natron::StorageModeEnum oldStorage,
                                            Natron::StorageModeEnum newStorage,
                                            int time,
                                            std::size_t size) const OVERRIDE FINAL
@@ -1057,41 +1281,65 @@ public:
             return;
         }
         QMutexLocker k(&_sizeLock);
+        CacheShard & shard = getShard(hash);
 
         assert(oldStorage != newStorage);
         assert(newStorage != Natron::eStorageModeNone);
         if (oldStorage == Natron::eStorageModeRAM) {
-            _memoryCacheSize = size > _memoryCacheSize ? 0 : _memoryCacheSize - size;
+            subtractSize(size, &_memoryCacheSize);
+            subtractSize(size, &shard.memoryCacheSize);
             _diskCacheSize += size;
+            shard.diskCacheSize += size;
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
             qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize);
 #endif
-            ///We switched from RAM to DISK that means the MemoryFile object has been destroyed hence the file has been closed.
-            appPTR->decreaseNCacheFilesOpened();
         } else if (oldStorage == Natron::eStorageModeDisk) {
             _memoryCacheSize += size;
-            _diskCacheSize = size > _diskCacheSize ? 0 : _diskCacheSize - size;
+            shard.memoryCacheSize += size;
+            subtractSize(size, &_diskCacheSize);
+            subtractSize(size, &shard.diskCacheSize);
 #ifdef NATRON_DEBUG_CACHE
             qDebug() << cacheName().c_str() << " memory size: " << printAsRAM(_memoryCacheSize);
             qDebug() << cacheName().c_str() << " disk size: " << printAsRAM(_diskCacheSize);
 #endif
-            ///We switched from DISK to RAM that means the MemoryFile object has been created and the file opened
-            appPTR->increaseNCacheFilesOpened();
         } else {
             if (newStorage == Natron::eStorageModeRAM) {
                 _memoryCacheSize += size;
+                shard.memoryCacheSize += size;
             } else if (newStorage == Natron::eStorageModeDisk) {
                 _diskCacheSize += size;
+                shard.diskCacheSize += size;
             }
         }
 
         _signalEmitter->emitEntryStorageChanged(time, (int)oldStorage, (int)newStorage);
     }
 
-    virtual void backingFileClosed() const OVERRIDE FINAL
+    /**
+     * @brief Returns the allocator of the pack files holding the disk portion of this cache.
+     * It is created on first use in the directory returned by getCachePath().
+     **/
+    virtual boost::shared_ptr<Natron::CachePackAllocator> getPackAllocator() const OVERRIDE FINAL
+    {
+        QMutexLocker k(&_packsLock);
+
+        if (!_packs) {
+            _packs.reset( new Natron::CachePackAllocator(getCachePath().toStdString(), NATRON_CACHE_PACK_FILE_SIZE) );
+        }
+
+        return _packs;
+    }
+
+    /**
+     * @brief Drops the reference of the cache on its pack allocator, e.g: before the pack files are removed from disk.
+     * Entries still alive keep the old allocator until they are destroyed.
+     **/
+    void resetPackAllocator()
     {
-        appPTR->decreaseNCacheFilesOpened();
+        QMutexLocker k(&_packsLock);
+
+        _packs.reset();
     }
 
     // const data member: no need to take the lock
@@ -1166,6 +1414,57 @@ public:
         QMutexLocker k(&_sizeLock); return _diskCacheSize;
     }
 
+    std::size_t getShardsCount() const
+    {
+        return _shards.size();
+    }
+
+    /**
+     * @brief Selects how entries are picked when the cache needs to free some space.
+     * This can be changed while the cache is in use.
+     **/
+    void setEvictionPolicy(Natron::CacheEvictionPolicyEnum policy)
+    {
+        _evictionPolicy = (int)policy;
+    }
+
+    Natron::CacheEvictionPolicyEnum getEvictionPolicy() const
+    {
+        return (Natron::CacheEvictionPolicyEnum)(int)_evictionPolicy;
+    }
+
+    /**
+     * @brief When enabled, the entries evicted from the in-memory portion are first kept compressed in RAM
+     * (up to NATRON_CACHE_COMPRESSED_PORTION of the in-memory portion) before being written to disk or destroyed.
+     * Disabling it does not decompress the entries already compressed.
+     **/
+    void setCompressionEnabled(bool enabled)
+    {
+        _compressionEnabled = (int)enabled;
+    }
+
+    bool isCompressionEnabled() const
+    {
+        return (int)_compressionEnabled != 0;
+    }
+
+    /**
+     * @brief Returns the size in RAM of the compressed entries, this is included in getMemoryCacheSize()
+     **/
+    std::size_t getCompressedCacheSize() const
+    {
+        QMutexLocker k(&_sizeLock); return _compressedCacheSize;
+    }
+
+    /**
+     * @brief Returns how many times a thread had to wait on a lock held by another thread
+     * since the creation of the cache.
+     **/
+    int getLockContentionCount() const
+    {
+        return (int)_lockContention;
+    }
+
     CacheSignalEmitter* activateSignalEmitter() const
     {
         return _signalEmitter;
@@ -1183,9 +1482,10 @@ public:
         std::list<EntryTypePtr> toRemove;
 
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( entry->getHashKey() );
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard & shard = getShard( entry->getHashKey() );
+            CacheMutexLocker l(&shard.lock, &_lockContention);
+            CacheIterator existingEntry = shard.memoryCache( entry->getHashKey() );
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     if ( (*it)->getKey() == entry->getKey() ) {
@@ -1196,12 +1496,25 @@ public:
                     }
                 }
                 if ( ret.empty() ) {
-                    _memoryCache.erase(existingEntry);
+                    shard.memoryCache.erase(existingEntry);
                 }
-            } else {
-                existingEntry = _diskCache( entry->getHashKey() );
-                if ( existingEntry != _diskCache.end() ) {
-                    std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
+            } else if ( ( existingEntry = shard.compressedCache( entry->getHashKey() ) ) != shard.compressedCache.end() ) {
+                std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
+                for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                    if ( (*it)->getKey() == entry->getKey() ) {
+                        onRemovedFromCompressedPortion(shard, *it);
+                        toRemove.push_back(*it);
+                        ret.erase(it);
+                        break;
+                    }
+                }
+                if ( ret.empty() ) {
+                    shard.compressedCache.erase(existingEntry);
+                }
+            } else {
+                existingEntry = shard.diskCache( entry->getHashKey() );
+                if ( existingEntry != shard.diskCache.end() ) {
+                    std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         if ( (*it)->getKey() == entry->getKey() ) {
                             //(*it)->scheduleForDestruction();
@@ -1211,11 +1524,11 @@ public:
                         }
                     }
                     if ( ret.empty() ) {
-                        _diskCache.erase(existingEntry);
+                        shard.diskCache.erase(existingEntry);
                     }
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // CacheMutexLocker l(&shard.lock);
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
 
@@ -1229,27 +1542,35 @@ public:
     {
         std::list<EntryTypePtr> toRemove;
         {
-            QMutexLocker l(&_lock);
-            CacheIterator existingEntry = _memoryCache( hash);
-            if ( existingEntry != _memoryCache.end() ) {
+            CacheShard & shard = getShard(hash);
+            CacheMutexLocker l(&shard.lock, &_lockContention);
+            CacheIterator existingEntry = shard.memoryCache( hash);
+            if ( existingEntry != shard.memoryCache.end() ) {
                 std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                 for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                     //(*it)->scheduleForDestruction();
                     toRemove.push_back(*it);
                 }
-                _memoryCache.erase(existingEntry);
+                shard.memoryCache.erase(existingEntry);
+            } else if ( ( existingEntry = shard.compressedCache(hash) ) != shard.compressedCache.end() ) {
+                std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
+                for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                    onRemovedFromCompressedPortion(shard, *it);
+                    toRemove.push_back(*it);
+                }
+                shard.compressedCache.erase(existingEntry);
             } else {
-                existingEntry = _diskCache( hash );
-                if ( existingEntry != _diskCache.end() ) {
+                existingEntry = shard.diskCache( hash );
+                if ( existingEntry != shard.diskCache.end() ) {
                     std::list<EntryTypePtr> & ret = getValueFromIterator(existingEntry);
                     for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
                         //(*it)->scheduleForDestruction();
                         toRemove.push_back(*it);
                     }
-                    _diskCache.erase(existingEntry);
+                    shard.diskCache.erase(existingEntry);
                 }
             }
-        } // QMutexLocker l(&_lock);
+        } // CacheMutexLocker l(&shard.lock);
 
         if ( !toRemove.empty() ) {
             _deleterThread.appendToQueue(toRemove);
@@ -1288,31 +1609,43 @@ public:
         
         std::string holderID = holder->getCacheID();
         
-        QMutexLocker locker(&_lock);
-        
-        for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                
-                const EntryTypePtr & front = entries.front();
-                
-                if (front->getKey().getCacheHolderID() == holderID) {
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            const CacheShard & shard = *_shards[i];
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
+
+            for (CacheIterator memIt = shard.memoryCache.begin(); memIt != shard.memoryCache.end(); ++memIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+
+                    const EntryTypePtr & front = entries.front();
+
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *ramOccupied += (*it)->size();
+                        }
+                    }
+                }
+            }
+
+            for (CacheIterator compIt = shard.compressedCache.begin(); compIt != shard.compressedCache.end(); ++compIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(compIt);
+                if ( !entries.empty() && (entries.front()->getKey().getCacheHolderID() == holderID) ) {
                     for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
                         *ramOccupied += (*it)->size();
                     }
                 }
             }
-        }
-        
-        for (CacheIterator memIt = _diskCache.begin(); memIt != _diskCache.end(); ++memIt) {
-            std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
-            if ( !entries.empty() ) {
-                
-                const EntryTypePtr & front = entries.front();
-                
-                if (front->getKey().getCacheHolderID() == holderID) {
-                    for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
-                        *diskOccupied += (*it)->size();
+
+            for (CacheIterator memIt = shard.diskCache.begin(); memIt != shard.diskCache.end(); ++memIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
+                if ( !entries.empty() ) {
+
+                    const EntryTypePtr & front = entries.front();
+
+                    if (front->getKey().getCacheHolderID() == holderID) {
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            *diskOccupied += (*it)->size();
+                        }
                     }
                 }
             }
@@ -1321,16 +1654,110 @@ public:
 
 private:
 
+    static void subtractSize(std::size_t size,
+                             std::size_t* total)
+    {
+        *total = size > *total ? 0 : *total - size;
+    }
+
+    /**
+     * @brief The GreedyDual-Size priority of an entry: H = L + cost / size where L is the inflation of
+     * the container when the entry was last accessed. The cost is the render time in seconds per MiB.
+     * Entries that are not accessed anymore keep their H while L grows at each eviction, so they
+     * eventually get evicted even if they were expensive.
+     **/
+    struct GreedyDualSizeScore
+    {
+        double operator()(const EntryTypePtr & entry) const
+        {
+            ///Don't use size() which returns 0 for entries whose backing file is not mapped
+            double sz = std::max( (double)entry->getParams()->getElementsCount() * sizeof(data_t), 1. );
+
+            return entry->getEvictionInflation() + entry->getRenderCost() * (1 << 20) / sz;
+        }
+    };
+
+    /**
+     * @brief Removes from the memory (or disk) portion of the shard the entry designated by the eviction policy.
+     * Returns a NULL entry if all entries are referenced somewhere else.
+     **/
+    std::pair<hash_type, EntryTypePtr> evictFromShard(CacheShard & shard,
+                                                      bool inMemory) const
+    {
+        assert( !shard.lock.tryLock() );
+
+        return inMemory ? evictFromContainer(shard.memoryCache, shard.memoryInflation) : evictFromContainer(shard.diskCache, shard.diskInflation);
+    }
+
+    std::pair<hash_type, EntryTypePtr> evictFromContainer(CacheContainer & container,
+                                                          double & inflation) const
+    {
+        if (getEvictionPolicy() == Natron::eCacheEvictionPolicyLRU) {
+            return container.evict();
+        }
+
+        GreedyDualSizeScore score;
+        std::pair<hash_type, EntryTypePtr> evicted = container.evictLowestScore(score, NATRON_CACHE_EVICTION_CANDIDATES);
+        if (evicted.second) {
+            inflation = std::max( inflation, score(evicted.second) );
+        }
+
+        return evicted;
+    }
+
+    /**
+     * @brief Must be called whenever an entry is inserted or looked-up in a container so that cost-aware
+     * policies know it was recently accessed.
+     **/
+    static void touchEntry(const CacheShard & shard,
+                           const EntryTypePtr & entry,
+                           bool inMemory)
+    {
+        entry->setEvictionInflation(inMemory ? shard.memoryInflation : shard.diskInflation);
+    }
+
+    CacheShard & getShard(hash_type hash) const
+    {
+        if (_shards.size() == 1) {
+            return *_shards.front();
+        }
+        ///Fold the high bits so that all bits of the hash participate in the partitioning
+        return *_shards[(std::size_t)( (hash ^ (hash >> 32)) % _shards.size() )];
+    }
+
+    /**
+     * @brief Returns the indexes of the shards ordered by decreasing memory (or disk) occupation so that
+     * eviction frees the fullest shards first.
+     **/
+    void getShardsByDecreasingSize(bool inMemory,
+                                   std::vector<std::size_t>* indexes) const
+    {
+        std::vector<std::pair<std::size_t, std::size_t> > sizes( _shards.size() );
+        {
+            QMutexLocker k(&_sizeLock);
+            for (std::size_t i = 0; i < _shards.size(); ++i) {
+                sizes[i].first = inMemory ? _shards[i]->memoryCacheSize : _shards[i]->diskCacheSize;
+                sizes[i].second = i;
+            }
+        }
+        std::sort( sizes.begin(), sizes.end() );
+        indexes->resize( sizes.size() );
+        for (std::size_t i = 0; i < sizes.size(); ++i) {
+            (*indexes)[i] = sizes[sizes.size() - 1 - i].second;
+        }
+    }
+
     virtual void removeAllEntriesWithDifferentNodeHashForHolderPrivate(const std::string & holderID,
                                                                        U64 nodeHash,
                                                                        bool removeAll) OVERRIDE FINAL
     {
         std::list<EntryTypePtr> toDelete;
-        CacheContainer newMemCache, newDiskCache;
-        {
-            QMutexLocker locker(&_lock);
+        for (std::size_t i = 0; i < _shards.size(); ++i) {
+            CacheShard & shard = *_shards[i];
+            CacheContainer newMemCache, newCompressedCache, newDiskCache;
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
 
-            for (CacheIterator memIt = _memoryCache.begin(); memIt != _memoryCache.end(); ++memIt) {
+            for (CacheIterator memIt = shard.memoryCache.begin(); memIt != shard.memoryCache.end(); ++memIt) {
                 std::list<EntryTypePtr> & entries = getValueFromIterator(memIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1348,7 +1775,24 @@ private:
                 }
             }
 
-            for (CacheIterator dIt = _diskCache.begin(); dIt != _diskCache.end(); ++dIt) {
+            for (CacheIterator cIt = shard.compressedCache.begin(); cIt != shard.compressedCache.end(); ++cIt) {
+                std::list<EntryTypePtr> & entries = getValueFromIterator(cIt);
+                if ( !entries.empty() ) {
+                    const EntryTypePtr & front = entries.front();
+
+                    if ( (front->getKey().getCacheHolderID() == holderID) &&
+                         ( ( front->getKey().getTreeVersion() != nodeHash) || removeAll ) ) {
+                        for (typename std::list<EntryTypePtr>::iterator it = entries.begin(); it != entries.end(); ++it) {
+                            onRemovedFromCompressedPortion(shard, *it);
+                            toDelete.push_back(*it);
+                        }
+                    } else {
+                        newCompressedCache.insert(front->getHashKey(), entries);
+                    }
+                }
+            }
+
+            for (CacheIterator dIt = shard.diskCache.begin(); dIt != shard.diskCache.end(); ++dIt) {
                 std::list<EntryTypePtr> & entries = getValueFromIterator(dIt);
                 if ( !entries.empty() ) {
                     const EntryTypePtr & front = entries.front();
@@ -1366,9 +1810,10 @@ private:
                 }
             }
 
-            _memoryCache = newMemCache;
-            _diskCache = newDiskCache;
-        } // QMutexLocker locker(&_lock);
+            shard.memoryCache = newMemCache;
+            shard.compressedCache = newCompressedCache;
+            shard.diskCache = newDiskCache;
+        } // for all shards
 
         if ( !toDelete.empty() ) {
             _deleterThread.appendToQueue(toDelete);
@@ -1379,21 +1824,29 @@ private:
         }
     } // removeAllEntriesWithDifferentNodeHashForHolderPrivate
 
-    bool getInternal(const typename EntryType::key_type & key,
-                     std::list<EntryTypePtr>* returnValue) const
+    /**
+     * @brief Looks-up the containers of the shard for entries matching the key.
+     * @param compressedEntry If the entry was found compressed, it is removed from the compressed portion and returned
+     * in compressedEntry: the caller must then decompress it with decompressFoundEntry() after releasing the lock of the shard.
+     **/
+    bool getInternal(CacheShard & shard,
+                     const typename EntryType::key_type & key,
+                     std::list<EntryTypePtr>* returnValue,
+                     EntryTypePtr* compressedEntry) const
     {
         ///Private should be locked
-        assert( !_lock.tryLock() );
+        assert( !shard.lock.tryLock() );
 
         ///find a matching value in the internal memory container
-        CacheIterator memoryCached = _memoryCache( key.getHash() );
+        CacheIterator memoryCached = shard.memoryCache( key.getHash() );
 
-        if ( memoryCached != _memoryCache.end() ) {
+        if ( memoryCached != shard.memoryCache.end() ) {
             ///we found something with a matching hash key. There may be several entries linked to
             ///this key, we need to find one with matching params
             std::list<EntryTypePtr> & ret = getValueFromIterator(memoryCached);
             for (typename std::list<EntryTypePtr>::const_iterator it = ret.begin(); it != ret.end(); ++it) {
                 if ( (*it)->getKey() == key ) {
+                    touchEntry(shard, *it, true);
                     returnValue->push_back(*it);
 
                     ///Q_EMIT te added signal otherwise when first reading something that's already cached
@@ -1405,11 +1858,51 @@ private:
             }
 
             return returnValue->size() > 0;
-        } else {
+        }
+
+        ///fallback on the compressed entries
+        CacheIterator compressedCached = shard.compressedCache( key.getHash() );
+        if ( compressedCached != shard.compressedCache.end() ) {
+            std::list<EntryTypePtr> & ret = getValueFromIterator(compressedCached);
+            for (typename std::list<EntryTypePtr>::iterator it = ret.begin(); it != ret.end(); ++it) {
+                if ( (*it)->getKey() == key ) {
+                    onRemovedFromCompressedPortion(shard, *it);
+                    *compressedEntry = *it;
+                    ret.erase(it);
+                    if ( ret.empty() ) {
+                        shard.compressedCache.erase(compressedCached);
+                    }
+
+                    return false;
+                }
+            }
+        }
+
+        ///The entry may be in the queue of the compressor thread
+        {
+            typename CacheCompressorThread<EntryType>::Job job;
+            if ( _compressorThread.takeBack(key, &job) ) {
+                if ( job.entry->isCompressed() ) {
+                    *compressedEntry = job.entry;
+
+                    return false;
+                }
+                shard.memoryCache.insert(job.entry->getHashKey(), job.entry);
+                touchEntry(shard, job.entry, true);
+                returnValue->push_back(job.entry);
+                if (_signalEmitter) {
+                    _signalEmitter->emitAddedEntry( key.getTime() );
+                }
+
+                return true;
+            }
+        }
+
+        {
             ///fallback on the disk cache internal container
-            CacheIterator diskCached = _diskCache( key.getHash() );
+            CacheIterator diskCached = shard.diskCache( key.getHash() );
 
-            if ( diskCached == _diskCache.end() ) {
+            if ( diskCached == shard.diskCache.end() ) {
                 /*the entry was neither in memory or disk, just allocate a new one*/
                 return false;
             } else {
@@ -1439,29 +1932,14 @@ private:
                         }
 
                         //put it back into the RAM
-                        _memoryCache.insert( (*it)->getHashKey(), *it );
+                        shard.memoryCache.insert( (*it)->getHashKey(), *it );
+                        touchEntry(shard, *it, true);
                         
 
-                        U64 memoryCacheSize, maximumInMemorySize;
-                        {
-                            QMutexLocker k(&_sizeLock);
-                            memoryCacheSize = _memoryCacheSize;
-                            maximumInMemorySize = _maximumInMemorySize;
-                        }
                         std::list<EntryTypePtr> entriesToBeDeleted;
 
                         //now clear extra entries from the disk cache so it doesn't exceed the RAM limit.
-                        while (memoryCacheSize > maximumInMemorySize) {
-                            if ( !tryEvictEntry(entriesToBeDeleted) ) {
-                                break;
-                            }
-
-                            {
-                                QMutexLocker k(&_sizeLock);
-                                memoryCacheSize = _memoryCacheSize;
-                                maximumInMemorySize = _maximumInMemorySize;
-                            }
-                        }
+                        evictInMemoryEntries(&shard, 1., entriesToBeDeleted);
 
                         returnValue->push_back(*it);
                         ret.erase(it);
@@ -1472,7 +1950,7 @@ private:
                         }
                         
                         ///Remove it from the disk cache
-                        _diskCache.erase(diskCached);
+                        shard.diskCache.erase(diskCached);
                         
                         return true;
                     }
@@ -1485,28 +1963,120 @@ private:
         }
     } // getInternal
 
+    /**
+     * @brief Decompresses an entry found compressed by getInternal() and puts it back into the in-memory portion.
+     * The lock of the shard must not be taken.
+     **/
+    bool decompressFoundEntry(CacheShard & shard,
+                              const EntryTypePtr & entry,
+                              std::list<EntryTypePtr>* returnValue) const
+    {
+        try {
+            entry->decompress();
+        } catch (const std::exception & e) {
+            qDebug() << "Error while decompressing cache entry: " << e.what();
+
+            return false;
+        }
+
+        ///Destroyed after the lock is released
+        std::list<EntryTypePtr> entriesToBeDeleted;
+        {
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
+
+            //put it back into the RAM
+            shard.memoryCache.insert(entry->getHashKey(), entry);
+            touchEntry(shard, entry, true);
+
+            ///The entry is referenced by the caller so it cannot be evicted here
+            evictInMemoryEntries(&shard, 1., entriesToBeDeleted);
+        }
+        returnValue->push_back(entry);
+        if (_signalEmitter) {
+            _signalEmitter->emitAddedEntry( entry->getKey().getTime() );
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Called by the compressor thread: runs the codec on the entry without holding any lock, then
+     * inserts it in the compressed or disk portion of its shard.
+     **/
+    void processCompressorJob(const typename CacheCompressorThread<EntryType>::Job & job) const
+    {
+        const EntryTypePtr & entry = job.entry;
+        std::pair<hash_type, EntryTypePtr> evicted(entry->getHashKey(), entry);
+        CacheShard & shard = getShard(evicted.first);
+        bool ok;
+
+        if (job.compress) {
+            ok = entry->compress();
+        } else {
+            try {
+                entry->decompress();
+                ok = true;
+            } catch (const std::exception & e) {
+                qDebug() << "Error while decompressing cache entry: " << e.what();
+                ok = false;
+            }
+        }
+
+        ///Destroyed after the lock is released
+        std::list<EntryTypePtr> entriesToBeDeleted;
+        {
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
+
+            ///A get() may have created the entry again while it was not in the cache
+            bool recreated = false;
+            CacheIterator memoryCached = shard.memoryCache(evicted.first);
+            if ( memoryCached != shard.memoryCache.end() ) {
+                const std::list<EntryTypePtr> & entries = getValueFromIterator(memoryCached);
+                for (typename std::list<EntryTypePtr>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+                    if ( (*it)->getKey() == entry->getKey() ) {
+                        recreated = true;
+                        break;
+                    }
+                }
+            }
+
+            if (recreated) {
+                entriesToBeDeleted.push_back(entry);
+            } else if (job.compress && ok) {
+                insertInCompressedPortion(shard, evicted, entriesToBeDeleted);
+            } else if ( ok && entry->isStoredOnDisk() ) {
+                insertInDiskPortion(shard, evicted, entriesToBeDeleted);
+            } else {
+                entriesToBeDeleted.push_back(entry);
+            }
+        }
+    }
+
     /** @brief Inserts into the cache an entry that was previously allocated by the createInternal()
      * function. This is called directly by createInternal() if the allocation was successful
      **/
-    void sealEntry(const EntryTypePtr & entry,
+    void sealEntry(CacheShard & shard,
+                   const EntryTypePtr & entry,
                    bool inMemory) const
     {
-        assert( !_lock.tryLock() );   // must be locked
+        assert( !shard.lock.tryLock() );   // must be locked
         typename EntryType::hash_type hash = entry->getHashKey();
 
+        touchEntry(shard, entry, inMemory);
+
         if (inMemory) {
             /*if the entry doesn't exist on the memory cache,make a new list and insert it*/
-            CacheIterator existingEntry = _memoryCache(hash);
-            if ( existingEntry == _memoryCache.end() ) {
-                _memoryCache.insert(hash, entry);
+            CacheIterator existingEntry = shard.memoryCache(hash);
+            if ( existingEntry == shard.memoryCache.end() ) {
+                shard.memoryCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
             }
         } else {
-            CacheIterator existingEntry = _diskCache(hash);
-            if ( existingEntry == _diskCache.end() ) {
-                _diskCache.insert(hash, entry);
+            CacheIterator existingEntry = shard.diskCache(hash);
+            if ( existingEntry == shard.diskCache.end() ) {
+                shard.diskCache.insert(hash, entry);
             } else {
                 /*append to the existing list*/
                 getValueFromIterator(existingEntry).push_back(entry);
@@ -1514,70 +2084,342 @@ private:
         }
     }
 
-    bool tryEvictEntry(std::list<EntryTypePtr> & entriesToBeDeleted) const
+    /**
+     * @brief Evicts one entry from the in-memory portion, starting with the shard occupying the most memory.
+     * @param lockedShard If not NULL, the caller already holds the lock of this shard: the other shards are
+     * then only try-locked so that we never wait on a lock while holding another one.
+     **/
+    bool tryEvictEntry(const CacheShard* lockedShard,
+                       std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        std::vector<std::size_t> shardsOrder;
+
+        getShardsByDecreasingSize(true, &shardsOrder);
+        for (std::size_t i = 0; i < shardsOrder.size(); ++i) {
+            CacheShard & shard = *_shards[shardsOrder[i]];
+            if (&shard == lockedShard) {
+                if ( tryEvictEntryFromShard(shard, entriesToBeDeleted) ) {
+                    return true;
+                }
+            } else if (lockedShard) {
+                if ( !shard.lock.tryLock() ) {
+                    _lockContention.fetchAndAddRelaxed(1);
+                    continue;
+                }
+                bool evicted = tryEvictEntryFromShard(shard, entriesToBeDeleted);
+                shard.lock.unlock();
+                if (evicted) {
+                    return true;
+                }
+            } else {
+                CacheMutexLocker locker(&shard.lock, &_lockContention);
+                if ( tryEvictEntryFromShard(shard, entriesToBeDeleted) ) {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Removes from the disk portion the entry designated by the eviction policy, starting with the shard
+     * occupying the most disk space: the disk budget is global to the cache, like the memory budget.
+     * Returns NULL if all entries on disk are referenced somewhere else.
+     * @param lockedShard @see tryEvictEntry
+     **/
+    EntryTypePtr tryEvictDiskEntry(const CacheShard* lockedShard) const
+    {
+        std::vector<std::size_t> shardsOrder;
+
+        getShardsByDecreasingSize(false, &shardsOrder);
+        for (std::size_t i = 0; i < shardsOrder.size(); ++i) {
+            CacheShard & shard = *_shards[shardsOrder[i]];
+            std::pair<hash_type, EntryTypePtr> evicted;
+            if (&shard == lockedShard) {
+                evicted = evictFromShard(shard, false);
+            } else if (lockedShard) {
+                if ( !shard.lock.tryLock() ) {
+                    _lockContention.fetchAndAddRelaxed(1);
+                    continue;
+                }
+                evicted = evictFromShard(shard, false);
+                shard.lock.unlock();
+            } else {
+                CacheMutexLocker locker(&shard.lock, &_lockContention);
+                evicted = evictFromShard(shard, false);
+            }
+            if (evicted.second) {
+                return evicted.second;
+            }
+        }
+
+        return EntryTypePtr();
+    }
+
+    bool tryEvictEntryFromShard(CacheShard & shard,
+                                std::list<EntryTypePtr> & entriesToBeDeleted) const
     {
-        assert( !_lock.tryLock() );
-        std::pair<hash_type, EntryTypePtr> evicted = _memoryCache.evict();
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = evictFromShard(shard, true);
         //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
         //we'll let the user of these entries purge the extra entries left in the cache later on
         if (!evicted.second) {
-            return false;
+            ///The compressed entries are part of the in-memory portion too
+            return evictFromCompressedPortion(shard, entriesToBeDeleted);
         }
-        /*if it is stored on disk, remove it from memory*/
 
+        ///Rather than writing the entry to disk or destroying it, try to keep it compressed in RAM.
+        ///The compression happens in the compressor thread, not under the lock of the shard
+        if ( isWorthCompressing(evicted.second) ) {
+            _compressorThread.appendToQueue(evicted.second, true);
+
+            return true;
+        }
+
+        /*if it is stored on disk, remove it from memory*/
         if ( evicted.second->isStoredOnDisk() ) {
             assert( evicted.second.unique() );
+            insertInDiskPortion(shard, evicted, entriesToBeDeleted);
+        } else {
+            entriesToBeDeleted.push_back(evicted.second);
+        }
+
+        return true;
+    } // tryEvictEntryFromShard
+
+    /**
+     * @brief Writes an entry evicted from the in-memory portion of the shard to its disk portion, evicting
+     * entries from the disk portion if it is full.
+     **/
+    void insertInDiskPortion(CacheShard & shard,
+                             const std::pair<hash_type, EntryTypePtr> & evicted,
+                             std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        ///This is EXPENSIVE! it calls msync
+        evicted.second->deallocate();
+
+        /*insert it back into the disk portion */
+
+        U64 diskCacheSize, maximumCacheSize, maximumInMemorySize;
+        {
+            QMutexLocker k(&_sizeLock);
+            diskCacheSize = _diskCacheSize;
+            maximumInMemorySize = _maximumInMemorySize;
+            maximumCacheSize = _maximumCacheSize;
+        }
 
-            ///This is EXPENSIVE! it calls msync
-            evicted.second->deallocate();
+        /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
+        while ( ( diskCacheSize  + evicted.second->size() ) >= (maximumCacheSize - maximumInMemorySize) ) {
+            {
+                EntryTypePtr evictedFromDisk = tryEvictDiskEntry(&shard);
+                //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+                //we'll let the user of these entries purge the extra entries left in the cache later on
+                if (!evictedFromDisk) {
+                    break;
+                }
 
-            /*insert it back into the disk portion */
+                ///Erase the file from the disk if we reach the limit.
+                //evictedFromDisk->scheduleForDestruction();
 
-            U64 diskCacheSize, maximumCacheSize, maximumInMemorySize;
+
+                entriesToBeDeleted.push_back(evictedFromDisk);
+            }
             {
                 QMutexLocker k(&_sizeLock);
                 diskCacheSize = _diskCacheSize;
                 maximumInMemorySize = _maximumInMemorySize;
                 maximumCacheSize = _maximumCacheSize;
             }
+        }
 
-            /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
-            while ( ( diskCacheSize  + evicted.second->size() ) >= (maximumCacheSize - maximumInMemorySize) ) {
-                {
-                    std::pair<hash_type, EntryTypePtr> evictedFromDisk = _diskCache.evict();
-                    //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
-                    //we'll let the user of these entries purge the extra entries left in the cache later on
-                    if (!evictedFromDisk.second) {
-                        break;
-                    }
+        touchEntry(shard, evicted.second, false);
+        CacheIterator existingDiskCacheEntry = shard.diskCache(evicted.first);
+        /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
+        if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+            shard.diskCache.insert(evicted.first, evicted.second);
+        } else {   /*append to the existing list*/
+            getValueFromIterator(existingDiskCacheEntry).push_back(evicted.second);
+        }
+    }
 
-                    ///Erase the file from the disk if we reach the limit.
-                    //evictedFromDisk.second->scheduleForDestruction();
+    /**
+     * @brief Returns whether an entry evicted from the in-memory portion should be compressed rather than written to disk or destroyed.
+     **/
+    bool isWorthCompressing(const EntryTypePtr & entry) const
+    {
+        if ( !isCompressionEnabled() ) {
+            return false;
+        }
+        std::size_t maximumCompressedSize;
+        {
+            QMutexLocker k(&_sizeLock);
+            maximumCompressedSize = _maximumInMemorySize * NATRON_CACHE_COMPRESSED_PORTION;
+        }
 
+        ///Don't bother compressing an entry which could not fit in the compressed portion anyway
+        return entry->size() * NATRON_CACHE_COMPRESSION_MAX_RATIO < maximumCompressedSize;
+    }
 
-                    entriesToBeDeleted.push_back(evictedFromDisk.second);
-                }
-                {
-                    QMutexLocker k(&_sizeLock);
-                    diskCacheSize = _diskCacheSize;
-                    maximumInMemorySize = _maximumInMemorySize;
-                    maximumCacheSize = _maximumCacheSize;
-                }
-            }
+    /**
+     * @brief Inserts an entry compressed by the compressor thread in the compressed portion of the shard.
+     * If the compressed portion of the cache then exceeds its budget, the oldest compressed entries of the shard leave it.
+     **/
+    void insertInCompressedPortion(CacheShard & shard,
+                                   const std::pair<hash_type, EntryTypePtr> & evicted,
+                                   std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        assert( !shard.lock.tryLock() );
+        assert( evicted.second->isCompressed() );
+        std::size_t maximumCompressedSize;
+        {
+            QMutexLocker k(&_sizeLock);
+            maximumCompressedSize = _maximumInMemorySize * NATRON_CACHE_COMPRESSED_PORTION;
+        }
+
+        std::size_t compressedCacheSize;
+        {
+            QMutexLocker k(&_sizeLock);
+            std::size_t compressedSize = evicted.second->size();
+            _compressedCacheSize += compressedSize;
+            shard.compressedCacheSize += compressedSize;
+            compressedCacheSize = _compressedCacheSize;
+        }
 
-            CacheIterator existingDiskCacheEntry = _diskCache(evicted.first);
-            /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
-            if ( existingDiskCacheEntry == _diskCache.end() ) {
-                _diskCache.insert(evicted.first, evicted.second);
-            } else {   /*append to the existing list*/
-                getValueFromIterator(existingDiskCacheEntry).push_back(evicted.second);
+        evicted.second->setEvictionInflation(shard.compressedInflation);
+        CacheIterator existingCompressedEntry = shard.compressedCache(evicted.first);
+        if ( existingCompressedEntry == shard.compressedCache.end() ) {
+            shard.compressedCache.insert(evicted.first, evicted.second);
+        } else {
+            getValueFromIterator(existingCompressedEntry).push_back(evicted.second);
+        }
+
+        ///We can only evict from this shard since the others are not locked
+        while (compressedCacheSize > maximumCompressedSize) {
+            if ( !evictFromCompressedPortion(shard, entriesToBeDeleted) ) {
+                break;
             }
+            QMutexLocker k(&_sizeLock);
+            compressedCacheSize = _compressedCacheSize;
+        }
+    }
+
+    /**
+     * @brief Removes the entry designated by the eviction policy from the compressed portion of the shard.
+     * Entries stored on disk are decompressed by the compressor thread and written to the disk portion, the others are destroyed.
+     * Returns false if there's nothing left to evict.
+     **/
+    bool evictFromCompressedPortion(CacheShard & shard,
+                                    std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        assert( !shard.lock.tryLock() );
+        std::pair<hash_type, EntryTypePtr> evicted = evictFromContainer(shard.compressedCache, shard.compressedInflation);
+        if (!evicted.second) {
+            return false;
+        }
+        onRemovedFromCompressedPortion(shard, evicted.second);
+
+        if ( evicted.second->isStoredOnDisk() ) {
+            _compressorThread.appendToQueue(evicted.second, false);
         } else {
             entriesToBeDeleted.push_back(evicted.second);
         }
 
         return true;
-    } // tryEvictEntry
+    }
+
+    /**
+     * @brief Must be called when a compressed entry is taken out of the compressed portion, before it is decompressed.
+     **/
+    void onRemovedFromCompressedPortion(CacheShard & shard,
+                                        const EntryTypePtr & entry) const
+    {
+        std::size_t compressedSize = entry->size();
+        QMutexLocker k(&_sizeLock);
+
+        subtractSize(compressedSize, &_compressedCacheSize);
+        subtractSize(compressedSize, &shard.compressedCacheSize);
+    }
+
+    /**
+     * @brief Moves an entry stored on disk that was removed from the in-memory portion to the disk portion,
+     * this is used when clearing the in-memory portion.
+     **/
+    void moveToDiskPortion(CacheShard & shard,
+                           const EntryTypePtr & entry) const
+    {
+        entry->deallocate();
+        /*insert it back into the disk portion */
+
+        U64 diskCacheSize, maximumCacheSize;
+        {
+            QMutexLocker k(&_sizeLock);
+            diskCacheSize = _diskCacheSize;
+            maximumCacheSize = _maximumCacheSize;
+        }
+
+        /*before that we need to clear the disk cache if it exceeds the maximum size allowed*/
+        while (diskCacheSize + entry->size() >= maximumCacheSize) {
+            {
+                EntryTypePtr evictedFromDisk = tryEvictDiskEntry(&shard);
+                //if the cache couldn't evict that means all entries are used somewhere and we shall not remove them!
+                //we'll let the user of these entries purge the extra entries left in the cache later on
+                if (!evictedFromDisk) {
+                    break;
+                }
+                ///Erase the file from the disk if we reach the limit.
+                evictedFromDisk->removeAnyBackingFile();
+            }
+            {
+                QMutexLocker k(&_sizeLock);
+                diskCacheSize = _diskCacheSize;
+                maximumCacheSize = _maximumCacheSize;
+            }
+        }
+
+        /*update the disk cache size*/
+        CacheIterator existingDiskCacheEntry = shard.diskCache( entry->getHashKey() );
+        /*if the entry doesn't exist on the disk cache,make a new list and insert it*/
+        if ( existingDiskCacheEntry == shard.diskCache.end() ) {
+            shard.diskCache.insert(entry->getHashKey(), entry);
+        }
+    }
+
+    /**
+     * @brief Evicts entries from the in-memory portion until its occupation is at most maxOccupation (a fraction of
+     * the maximum in-memory size). The entries to destroy are appended to entriesToBeDeleted: their memory is not freed yet
+     * but it is considered as such.
+     * @param lockedShard @see tryEvictEntry
+     **/
+    void evictInMemoryEntries(const CacheShard* lockedShard,
+                              double maxOccupation,
+                              std::list<EntryTypePtr> & entriesToBeDeleted) const
+    {
+        std::size_t pendingDeletionSize = 0;
+
+        for (;;) {
+            {
+                ///The entries queued in the compressor thread will release most of their memory
+                std::size_t pendingSize = pendingDeletionSize + _compressorThread.getPendingSize();
+                QMutexLocker k(&_sizeLock);
+                std::size_t memoryCacheSize = _memoryCacheSize > pendingSize ? _memoryCacheSize - pendingSize : 0;
+                if ( (double)memoryCacheSize / std::max( (std::size_t)1, _maximumInMemorySize ) <= maxOccupation ) {
+                    return;
+                }
+            }
+            std::list<EntryTypePtr> deleted;
+            if ( !tryEvictEntry(lockedShard, deleted) ) {
+                return;
+            }
+            ///Entries moved to the disk or compressed portions already updated the memory size
+            for (typename std::list<EntryTypePtr>::iterator it = deleted.begin(); it != deleted.end(); ++it) {
+                if ( (*it)->isAllocated() && ( !(*it)->isStoredOnDisk() || (*it)->isCompressed() ) ) {
+                    pendingDeletionSize += (*it)->size();
+                }
+            }
+            entriesToBeDeleted.splice(entriesToBeDeleted.end(), deleted);
+        }
+    }
 };
 } // namespace Natron
 
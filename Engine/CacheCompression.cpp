@@ -0,0 +1,370 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CacheCompression.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <algorithm> // min
+
+#include "Global/GlobalDefines.h"
+
+/*
+ * The compressed stream starts with one byte holding the element size used by the shuffle (1 when the data
+ * was not shuffled), followed by
+ * a sequence of LZ77 tokens, the same layout as LZ4 blocks:
+ * - 1 byte: high nibble = number of literals, low nibble = match length - 4. A nibble of 15 means the
+ *   value continues in the following bytes, each byte being added until one is different from 255.
+ * - the literals
+ * - 2 bytes: little-endian offset of the match, going backward from the current position
+ * - the continuation bytes of the match length, if any
+ * The last token only has literals.
+ */
+
+#define CACHE_COMPRESSION_MIN_MATCH 4
+#define CACHE_COMPRESSION_HASH_LOG 14
+#define CACHE_COMPRESSION_MAX_OFFSET 65535
+///Number of bytes at the end of the input that are always emitted as literals
+#define CACHE_COMPRESSION_LAST_LITERALS 5
+#define CACHE_COMPRESSION_MAX_SKIP 16
+
+namespace {
+
+inline U32
+read32(const unsigned char* p)
+{
+    U32 ret;
+
+    memcpy( &ret, p, sizeof(U32) );
+
+    return ret;
+}
+
+inline U32
+hashSequence(U32 sequence)
+{
+    return (sequence * 2654435761U) >> (32 - CACHE_COMPRESSION_HASH_LOG);
+}
+
+///Number of bytes needed to encode a length with a 4 bits nibble plus continuation bytes
+inline std::size_t
+lengthBytes(std::size_t length)
+{
+    return length < 15 ? 0 : (length - 15) / 255 + 1;
+}
+
+inline unsigned char*
+writeLength(unsigned char* op,
+            std::size_t length)
+{
+    length -= 15;
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (unsigned char)length;
+
+    return op;
+}
+
+/**
+ * @brief Emits one token. Returns NULL if it does not fit before oend.
+ * A matchLength of 0 denotes the last token which only has literals.
+ **/
+unsigned char*
+writeSequence(unsigned char* op,
+              unsigned char* oend,
+              const unsigned char* literals,
+              std::size_t literalsCount,
+              std::size_t offset,
+              std::size_t matchLength)
+{
+    std::size_t needed = 1 + lengthBytes(literalsCount) + literalsCount;
+
+    if (matchLength > 0) {
+        needed += 2 + lengthBytes(matchLength - CACHE_COMPRESSION_MIN_MATCH);
+    }
+    if ( needed > (std::size_t)(oend - op) ) {
+        return 0;
+    }
+
+    unsigned char* token = op++;
+    *token = (unsigned char)( (literalsCount < 15 ? literalsCount : 15) << 4 );
+    if (literalsCount >= 15) {
+        op = writeLength(op, literalsCount);
+    }
+    memcpy(op, literals, literalsCount);
+    op += literalsCount;
+
+    if (matchLength > 0) {
+        *op++ = (unsigned char)(offset & 0xff);
+        *op++ = (unsigned char)(offset >> 8);
+        std::size_t len = matchLength - CACHE_COMPRESSION_MIN_MATCH;
+        *token |= (unsigned char)(len < 15 ? len : 15);
+        if (len >= 15) {
+            op = writeLength(op, len);
+        }
+    }
+
+    return op;
+}
+
+std::size_t
+lzCompress(const unsigned char* src,
+           std::size_t size,
+           unsigned char* dst,
+           std::size_t dstCapacity)
+{
+    unsigned char* op = dst;
+    unsigned char* oend = dst + dstCapacity;
+    std::size_t anchor = 0;
+
+    if (size > CACHE_COMPRESSION_LAST_LITERALS + CACHE_COMPRESSION_MIN_MATCH) {
+        ///Positions are stored + 1 so that 0 means empty
+        std::vector<U32> table(1 << CACHE_COMPRESSION_HASH_LOG, 0);
+        const std::size_t matchLimit = size - CACHE_COMPRESSION_LAST_LITERALS;
+        const std::size_t searchLimit = matchLimit - CACHE_COMPRESSION_MIN_MATCH;
+        std::size_t ip = 0;
+
+        while (ip < searchLimit) {
+            U32 sequence = read32(src + ip);
+            U32 h = hashSequence(sequence);
+            std::size_t candidate = table[h];
+            table[h] = (U32)(ip + 1);
+
+            if ( (candidate == 0) || (ip + 1 - candidate > CACHE_COMPRESSION_MAX_OFFSET) || (read32(src + candidate - 1) != sequence) ) {
+                ///Skip faster through data that does not compress, but not too fast to find the next compressible area
+                ip += 1 + std::min( (ip - anchor) >> 6, (std::size_t)CACHE_COMPRESSION_MAX_SKIP );
+                continue;
+            }
+            std::size_t ref = candidate - 1;
+            std::size_t matchLength = CACHE_COMPRESSION_MIN_MATCH;
+            while (ip + matchLength < matchLimit && src[ref + matchLength] == src[ip + matchLength]) {
+                ++matchLength;
+            }
+
+            op = writeSequence(op, oend, src + anchor, ip - anchor, ip - ref, matchLength);
+            if (!op) {
+                return 0;
+            }
+            ip += matchLength;
+            anchor = ip;
+            if (ip < searchLimit) {
+                table[hashSequence( read32(src + ip - 2) )] = (U32)(ip - 1);
+            }
+        }
+    }
+
+    op = writeSequence(op, oend, src + anchor, size - anchor, 0, 0);
+    if (!op) {
+        return 0;
+    }
+
+    return op - dst;
+}
+
+bool
+lzDecompress(const unsigned char* src,
+             std::size_t srcSize,
+             unsigned char* dst,
+             std::size_t dstSize)
+{
+    const unsigned char* ip = src;
+    const unsigned char* iend = src + srcSize;
+    unsigned char* op = dst;
+    unsigned char* oend = dst + dstSize;
+
+    while (ip < iend) {
+        unsigned int token = *ip++;
+        std::size_t literalsCount = token >> 4;
+        if (literalsCount == 15) {
+            unsigned char b;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                b = *ip++;
+                literalsCount += b;
+            } while (b == 255);
+        }
+        if ( ( literalsCount > (std::size_t)(iend - ip) ) || ( literalsCount > (std::size_t)(oend - op) ) ) {
+            return false;
+        }
+        memcpy(op, ip, literalsCount);
+        op += literalsCount;
+        ip += literalsCount;
+
+        if (ip == iend) {
+            ///This was the last token
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        std::size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if ( (offset == 0) || ( offset > (std::size_t)(op - dst) ) ) {
+            return false;
+        }
+        std::size_t matchLength = token & 15;
+        if (matchLength == 15) {
+            unsigned char b;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                b = *ip++;
+                matchLength += b;
+            } while (b == 255);
+        }
+        matchLength += CACHE_COMPRESSION_MIN_MATCH;
+        if ( matchLength > (std::size_t)(oend - op) ) {
+            return false;
+        }
+        const unsigned char* match = op - offset;
+        if (offset >= matchLength) {
+            memcpy(op, match, matchLength);
+            op += matchLength;
+        } else {
+            ///Overlapping copy: this repeats the last offset bytes
+            for (std::size_t i = 0; i < matchLength; ++i) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return op == oend;
+}
+
+void
+shuffle(const unsigned char* src,
+        std::size_t size,
+        std::size_t elementSize,
+        unsigned char* dst)
+{
+    std::size_t count = size / elementSize;
+
+    for (std::size_t b = 0; b < elementSize; ++b) {
+        const unsigned char* s = src + b;
+        unsigned char* d = dst + b * count;
+        for (std::size_t i = 0; i < count; ++i, s += elementSize) {
+            d[i] = *s;
+        }
+    }
+    ///The trailing bytes that do not form a whole element are left as is
+    memcpy(dst + count * elementSize, src + count * elementSize, size - count * elementSize);
+
+    ///Replace each byte by its difference with the previous one, smooth images then give runs of similar values
+    for (std::size_t i = size - 1; i > 0; --i) {
+        dst[i] = (unsigned char)(dst[i] - dst[i - 1]);
+    }
+}
+
+void
+unshuffle(unsigned char* src,
+          std::size_t size,
+          std::size_t elementSize,
+          unsigned char* dst)
+{
+    std::size_t count = size / elementSize;
+
+    for (std::size_t i = 1; i < size; ++i) {
+        src[i] = (unsigned char)(src[i] + src[i - 1]);
+    }
+
+    for (std::size_t b = 0; b < elementSize; ++b) {
+        const unsigned char* s = src + b * count;
+        unsigned char* d = dst + b;
+        for (std::size_t i = 0; i < count; ++i, d += elementSize) {
+            *d = s[i];
+        }
+    }
+    memcpy(dst + count * elementSize, src + count * elementSize, size - count * elementSize);
+}
+} // anon namespace
+
+namespace Natron {
+
+std::size_t
+compressCacheBuffer(const char* src,
+                    std::size_t size,
+                    std::size_t elementSize,
+                    char* dst,
+                    std::size_t dstCapacity)
+{
+    if ( (dstCapacity < 1) || (elementSize == 0) || (elementSize > 255) ) {
+        return 0;
+    }
+    dst[0] = (char)elementSize;
+
+    const unsigned char* input = (const unsigned char*)src;
+    unsigned char* shuffled = 0;
+    if ( (elementSize > 1) && (size >= elementSize) ) {
+        shuffled = (unsigned char*)malloc(size);
+        if (!shuffled) {
+            return 0;
+        }
+        shuffle(input, size, elementSize, shuffled);
+        input = shuffled;
+    }
+
+    std::size_t ret = lzCompress(input, size, (unsigned char*)dst + 1, dstCapacity - 1);
+    free(shuffled);
+
+    return ret == 0 ? 0 : ret + 1;
+}
+
+bool
+decompressCacheBuffer(const char* src,
+                      std::size_t srcSize,
+                      char* dst,
+                      std::size_t dstSize)
+{
+    if (srcSize < 1) {
+        return false;
+    }
+    std::size_t elementSize = (unsigned char)src[0];
+    if (elementSize == 0) {
+        return false;
+    }
+
+    if ( (elementSize == 1) || (dstSize < elementSize) ) {
+        return lzDecompress( (const unsigned char*)src + 1, srcSize - 1, (unsigned char*)dst, dstSize );
+    }
+
+    unsigned char* shuffled = (unsigned char*)malloc(dstSize);
+    if (!shuffled) {
+        return false;
+    }
+    bool ok = lzDecompress( (const unsigned char*)src + 1, srcSize - 1, shuffled, dstSize );
+    if (ok) {
+        unshuffle(shuffled, dstSize, elementSize, (unsigned char*)dst);
+    }
+    free(shuffled);
+
+    return ok;
+}
+} // namespace Natron
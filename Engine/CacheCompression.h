@@ -0,0 +1,49 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHECOMPRESSION_H
+#define NATRON_ENGINE_CACHECOMPRESSION_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstddef>
+
+namespace Natron {
+
+/**
+ * @brief Compresses size bytes from src into dst with a fast lossless codec suited to image data.
+ * The data is seen as elements of elementSize bytes, typically a pixel (e.g: 16 for RGBA float images).
+ * The bytes of the elements are first regrouped by position (byte-plane shuffle) and delta-encoded so that
+ * the slowly varying channels, exponents and high bytes form long runs, then the result goes through a LZ77 coder.
+ * @returns The number of bytes written to dst, or 0 if the compressed data does not fit in dstCapacity bytes.
+ **/
+std::size_t compressCacheBuffer(const char* src, std::size_t size, std::size_t elementSize, char* dst, std::size_t dstCapacity);
+
+/**
+ * @brief Decompresses data produced by compressCacheBuffer(). dstSize must be the size of the original data.
+ * @returns False if the compressed data is corrupted.
+ **/
+bool decompressCacheBuffer(const char* src, std::size_t srcSize, char* dst, std::size_t dstSize);
+
+} // namespace Natron
+
+#endif // NATRON_ENGINE_CACHECOMPRESSION_H
@@ -31,6 +31,8 @@
 #include <stdexcept>
 #include <vector>
 #include <fstream>
+#include <cstring> // memcpy
+#include <algorithm> // min
 
 #include <QtCore/QFile>
 #include <QtCore/QMutex>
@@ -44,14 +46,17 @@
 #endif
 #include "Engine/Hash64.h"
 #include "Engine/CacheEntryHolder.h"
-#include "Engine/MemoryFile.h"
+#include "Engine/CachePackAllocator.h"
+#include "Engine/CacheCompression.h"
+#include "Engine/ImageBufferPool.h"
 #include "Engine/NonKeyParams.h"
-#include <SequenceParsing.h> // for removePath
+#include <SequenceParsing.h>
 
 namespace Natron {
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////BUFFER////////////////////////////////////////////////////
 
+///A buffer in RAM whose memory is recycled by the image buffer pool, see ImageBufferPool.h
 template <typename T>
 class RamBuffer
 {
@@ -87,43 +92,43 @@ public:
     {
         return count;
     }
+
+    ///The bytes taken in RAM, which may be more than size() * sizeof(T) since the pool rounds up the allocations
+    U64 allocatedSize() const
+    {
+        return data ? getImageBufferAllocationSize(count * sizeof(T)) : 0;
+    }
     
     void resize(U64 size)
     {
         if (size == 0) {
             return;
         }
+        clear();
+        ///Throws std::bad_alloc
+        data = (T*)allocateImageBuffer(size * sizeof(T));
         count = size;
-        if (data) {
-            free(data);
-            data = 0;
-        }
-        data = (T*)malloc(size * sizeof(T));
-        if (!data) {
-            throw std::bad_alloc();
-        }
     }
     
     void clear()
     {
-        count = 0;
         if (data) {
-            free(data);
+            freeImageBuffer(data, count * sizeof(T));
             data = 0;
         }
+        count = 0;
     }
     
     ~RamBuffer()
     {
-        if (data) {
-            free(data);
-            data = 0;
-        }
+        clear();
     }
 };
 
 /** @brief Buffer represents  an internal buffer that can be allocated on different devices.
- * For now the class is simple and can only be either on disk using mmap or in RAM using malloc.
+ * For now the class is simple and can only be either on disk, in one of the memory-mapped pack files of the cache,
+ * or in RAM using malloc. In both cases the data can be compressed in RAM by the cache when it evicts the entry from
+ * its in-memory portion, the data is then not accessible until decompress() is called.
  * The cost parameter given to the allocate() function is a hint that the Buffer classes uses
  * to select a device to use. By default -1 means it should not allocate any memory,
  * 0 means RAM and >= 1 means the data will be stored on disk using mmap. We could see this
@@ -143,10 +148,14 @@ public:
 
 
     Buffer()
-    : _path()
-    , _buffer()
-    , _backingFile()
+    : _buffer()
+    , _packs()
+    , _location()
+    , _mapped(false)
     , _storageMode(eStorageModeRAM)
+    , _compressedData(0)
+    , _compressedSize(0)
+    , _uncompressedSize(0)
     {
     }
     
@@ -157,37 +166,27 @@ public:
 
     void allocate( U64 count,
                    Natron::StorageModeEnum storage,
-                   std::string path = std::string() )
+                   const boost::shared_ptr<CachePackAllocator> & packs = boost::shared_ptr<CachePackAllocator>() )
     {
         /*allocate should be called only once.*/
-        assert( _path.empty() );
-        assert( ( (_buffer.size() == 0) && !_backingFile ) || ( (_buffer.size() != 0) && !_backingFile ) || (!(_buffer.size() != 0) && _backingFile) );
-        if ( (_buffer.size() > 0) || _backingFile ) {
+        assert( !( (_buffer.size() != 0) && _location.isValid() ) );
+        if ( (_buffer.size() > 0) || _location.isValid() ) {
             return;
         }
 
 
-        if (storage == Natron::eStorageModeDisk) {
+        if ( (storage == Natron::eStorageModeDisk) && packs ) {
             _storageMode = eStorageModeDisk;
-            _path = path;
-            try {
-                _backingFile.reset( new MemoryFile(_path,MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate) );
-            } catch (const std::runtime_error & r) {
-                std::cout << r.what() << std::endl;
-
-                ///if opening the file mapping failed, just call allocate again, but this time on RA%!
-                _backingFile.reset();
-                _path.clear();
-                allocate(count,Natron::eStorageModeRAM, path);
+            if ( !packs->allocate(count * sizeof(DataType), &_location) ) {
+                ///if there's no room in the pack files, just call allocate again, but this time on RAM!
+                _location = CachePackLocation();
+                allocate(count,Natron::eStorageModeRAM);
 
                 return;
             }
-
-            if ( !path.empty() && (count != 0) ) {
-                //if the backing file has already the good size and we just wanted to re-open the mapping
-                _backingFile->resize(count);
-            }
-        } else if (storage == Natron::eStorageModeRAM) {
+            _packs = packs;
+            _mapped = true;
+        } else if (storage != Natron::eStorageModeNone) {
             _storageMode = eStorageModeRAM;
             _buffer.resize(count);
         }
@@ -201,12 +200,19 @@ public:
      **/
     void reallocate(U64 count)
     {
+        assert(!_compressedData);
         if (_storageMode == eStorageModeRAM) {
             assert(_buffer.size() > 0); // could be 0 if we allocate 0...
             _buffer.resize(count);
         } else if (_storageMode == eStorageModeDisk) {
-            assert(_backingFile);
-            _backingFile->resize( count * sizeof(DataType) );
+            assert( _packs && _location.isValid() );
+            CachePackLocation newLocation;
+            if ( !_packs->allocate(count * sizeof(DataType), &newLocation) ) {
+                throw std::bad_alloc();
+            }
+            memcpy( _packs->data(newLocation), _packs->data(_location), std::min(_location.length, newLocation.length) );
+            _packs->deallocate(_location);
+            _location = newLocation;
         }
     }
     
@@ -215,105 +221,222 @@ public:
      **/
     void swap(Buffer& other)
     {
+        assert(!_compressedData && !other._compressedData);
         if (_storageMode == eStorageModeRAM) {
             if (other._storageMode == eStorageModeRAM) {
                 _buffer.swap(other._buffer);
             } else {
-                _buffer.resize(other._backingFile->size() / sizeof(DataType));
-                const char* src = other._backingFile->data();
+                _buffer.resize(other._location.length / sizeof(DataType));
+                const char* src = other._packs->data(other._location);
                 char* dst = (char*)_buffer.getData();
-                memcpy(dst,src,other._backingFile->size());
+                memcpy(dst,src,other._location.length);
             }
         } else if (_storageMode == eStorageModeDisk) {
             if (other._storageMode == eStorageModeDisk) {
-                assert(_backingFile);
-                _backingFile.swap(other._backingFile);
-                _path = other._path;
+                assert(_location.isValid());
+                _packs.swap(other._packs);
+                std::swap(_location, other._location);
             } else {
-                _backingFile->resize(other._buffer.size() * sizeof(DataType));
-				assert(_backingFile->data());
+                reallocate( other._buffer.size() );
+                assert( _packs->data(_location) );
                 const char* src = (const char*)other._buffer.getData();
-                char* dst = (char*)_backingFile->data();
+                char* dst = _packs->data(_location);
                 memcpy(dst,src,other._buffer.size() * sizeof(DataType));
             }
         }
         
     }
     
-    const std::string& getFilePath() const {
-        return _path;
+    const CachePackLocation& getPackLocation() const {
+        return _location;
     }
 
+    /**
+     * @brief Makes the data of an entry living in the disk portion of the cache accessible again.
+     * The pack files are always mapped so this does not involve any system call, the pages of the
+     * pack file will be read back from the disk by the operating system when accessed.
+     **/
     void reOpenFileMapping() const
     {
-        assert(!_backingFile && _storageMode == eStorageModeDisk);
-        try{
-            _backingFile.reset( new MemoryFile(_path,MemoryFile::eFileOpenModeEnumIfExistsKeepElseCreate) );
-        } catch (const std::exception & e) {
-            _backingFile.reset();
+        assert(!_mapped && _storageMode == eStorageModeDisk);
+        if ( !_packs || !_packs->data(_location) ) {
             throw std::bad_alloc();
         }
+        _mapped = true;
     }
 
-    void restoreBufferFromFile(const std::string & path)
+    /**
+     * @brief Re-attach the buffer to data that was stored in the pack files by a previous session.
+     * @returns False if the location is not valid anymore.
+     **/
+    bool restoreBufferFromPack(const boost::shared_ptr<CachePackAllocator> & packs,
+                               const CachePackLocation & location)
     {
-        _path = path;
+        if ( !packs->reserve(location) ) {
+            return false;
+        }
+        _packs = packs;
+        _location = location;
+        _mapped = false;
         _storageMode = eStorageModeDisk;
+
+        return true;
+    }
+
+    /**
+     * @brief Replaces the data by a compressed copy held in RAM. If the data was in the pack files, its space there
+     * is released: the data will be written back to the pack files only if decompress() is called.
+     * @param elementSize The size of the elements the data is made of, @see compressCacheBuffer
+     * @returns False if the data does not compress well enough, in which case the buffer is left untouched.
+     **/
+    bool compress(std::size_t elementSize)
+    {
+        assert(!_compressedData);
+        ///Not size() which includes the rounding of the allocation
+        std::size_t sz = _storageMode == eStorageModeRAM ? _buffer.size() * sizeof(DataType) : size();
+        const char* src = (const char*)readable();
+        if ( !src || (sz == 0) ) {
+            return false;
+        }
+        std::size_t capacity = (std::size_t)(sz * NATRON_CACHE_COMPRESSION_MAX_RATIO);
+        char* dst = (char*)malloc(capacity);
+        if (!dst) {
+            return false;
+        }
+        std::size_t compressedSize = compressCacheBuffer(src, sz, elementSize, dst, capacity);
+        if (compressedSize == 0) {
+            free(dst);
+
+            return false;
+        }
+        ///Give back the unused part of the allocation
+        char* shrunk = (char*)realloc(dst, compressedSize);
+        _compressedData = shrunk ? shrunk : dst;
+        _compressedSize = compressedSize;
+        _uncompressedSize = sz;
+
+        if (_storageMode == eStorageModeRAM) {
+            _buffer.clear();
+        } else {
+            _packs->deallocate(_location);
+            _location = CachePackLocation();
+            _mapped = false;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Restores the data compressed by compress(). Data stored on disk gets a new location in the pack files.
+     * WARNING: This function throws a std::bad_alloc if the allocation fails or a std::runtime_error if the
+     * compressed data is corrupted, in which case the buffer is left deallocated.
+     **/
+    void decompress()
+    {
+        assert(_compressedData);
+        char* dst;
+        if (_storageMode == eStorageModeRAM) {
+            try {
+                _buffer.resize(_uncompressedSize / sizeof(DataType));
+            } catch (const std::bad_alloc &) {
+                freeCompressedData();
+                throw;
+            }
+            dst = (char*)_buffer.getData();
+        } else {
+            if ( !_packs->allocate(_uncompressedSize, &_location) ) {
+                _location = CachePackLocation();
+                freeCompressedData();
+                throw std::bad_alloc();
+            }
+            _mapped = true;
+            dst = _packs->data(_location);
+        }
+        bool ok = decompressCacheBuffer(_compressedData, _compressedSize, dst, _uncompressedSize);
+        freeCompressedData();
+        if (!ok) {
+            if (_storageMode == eStorageModeRAM) {
+                _buffer.clear();
+            } else {
+                _packs->deallocate(_location);
+                _location = CachePackLocation();
+                _mapped = false;
+            }
+            throw std::runtime_error("Corrupted compressed cache entry");
+        }
+    }
+
+    bool isCompressed() const
+    {
+        return _compressedData != 0;
     }
 
     void deallocate()
     {
+        if (_compressedData) {
+            freeCompressedData();
+
+            return;
+        }
         if (_storageMode == eStorageModeRAM) {
             _buffer.clear();
         } else {
-            if (_backingFile) {
-                bool flushOk = _backingFile->flush();
-                _backingFile.reset();
-                if (!flushOk) {
+            if (_mapped) {
+                _mapped = false;
+                if ( !_packs->flush(_location) ) {
                     throw std::runtime_error("Failed to flush RAM data to backing file.");
                 }
             }
         }
     }
 
+    /**
+     * @brief Gives back the space used in the pack files. Returns true if the data was accessible.
+     **/
     bool removeAnyBackingFile() const
     {
-        if (_storageMode == eStorageModeDisk) {
-            if (_backingFile) {
-                _backingFile->remove();
-                _backingFile.reset();
-                return true;
-            } else {
-                int ret_code = std::remove( _path.c_str() );
-                Q_UNUSED(ret_code);
-                return false;
-            }
+        if (_compressedData) {
+            freeCompressedData();
+
+            return true;
+        }
+        if ( (_storageMode == eStorageModeDisk) && _location.isValid() ) {
+            bool wasMapped = _mapped;
+            _packs->deallocate(_location);
+            _location = CachePackLocation();
+            _mapped = false;
+
+            return wasMapped;
         }
         return false;
     }
 
     /**
-     * @brief Returns the size of the buffer in bytes.
+     * @brief Returns the size of the buffer in bytes. For buffers in RAM this is the memory actually taken,
+     * including the rounding of the allocation by the image buffer pool.
      **/
     size_t size() const
     {
+        if (_compressedData) {
+            return _compressedSize;
+        }
         if (_storageMode == eStorageModeRAM) {
-            return _buffer.size() * sizeof(DataType);
+            return _buffer.allocatedSize();
         } else {
-            return _backingFile ? _backingFile->size() : 0;
+            return _mapped ? _location.length : 0;
         }
     }
 
     bool isAllocated() const
     {
-        return (_buffer.size() > 0) || ( _backingFile && _backingFile->data() );
+        return (_buffer.size() > 0) || _mapped || _compressedData;
     }
 
     DataType* writable()
     {
         if (_storageMode == eStorageModeDisk) {
-            if (_backingFile) {
-                return (DataType*)_backingFile->data();
+            if (_mapped) {
+                return (DataType*)_packs->data(_location);
             } else {
                 return NULL;
             }
@@ -325,7 +448,7 @@ public:
     const DataType* readable() const
     {
         if (_storageMode == eStorageModeDisk) {
-            return _backingFile ? (const DataType*)_backingFile->data() : 0;
+            return _mapped ? (const DataType*)_packs->data(_location) : 0;
         } else {
             return _buffer.getData();
         }
@@ -338,19 +461,39 @@ public:
 
 private:
 
-    std::string _path;
+    void freeCompressedData() const
+    {
+        free(_compressedData);
+        _compressedData = 0;
+        _compressedSize = 0;
+        _uncompressedSize = 0;
+    }
+
     RamBuffer<DataType> _buffer;
 
-    /*mutable so the reOpenFileMapping function can reopen the mmaped file. It doesn't
+    ///The pack files holding the data when stored on disk
+    boost::shared_ptr<CachePackAllocator> _packs;
+
+    /*mutable so removeAnyBackingFile can release the space held in the pack files. */
+    mutable CachePackLocation _location;
+
+    /*mutable so the reOpenFileMapping function can make the data accessible again. It doesn't
        change the underlying data*/
-    mutable boost::scoped_ptr<MemoryFile> _backingFile;
+    mutable bool _mapped;
     Natron::StorageModeEnum _storageMode;
+
+    /*mutable so removeAnyBackingFile can release the compressed copy of data stored on disk*/
+    mutable char* _compressedData; //< the output of compressCacheBuffer(), NULL when the data is not compressed
+    mutable std::size_t _compressedSize;
+    mutable std::size_t _uncompressedSize;
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////CACHE ENTRY////////////////////////////////////////////////////
 /**
- * @brief Defines the API of the Cache as seen by the cache entries
+ * @brief Defines the API of the Cache as seen by the cache entries.
+ * The hash passed to the notification functions is the hash key of the entry, it is used by the cache
+ * to find the shard the entry belongs to.
  **/
 class CacheAPI
 {
@@ -361,17 +504,17 @@ public:
      * @brief To be called by a CacheEntry whenever it's size is changed.
      * This way the cache can keep track of the real memory footprint.
      **/
-    virtual void notifyEntrySizeChanged(size_t oldSize,size_t newSize) const = 0;
+    virtual void notifyEntrySizeChanged(U64 hash,size_t oldSize,size_t newSize) const = 0;
 
     /**
      * @brief To be called by a CacheEntry on allocation.
      **/
-    virtual void notifyEntryAllocated(int time, size_t size, Natron::StorageModeEnum storage) const = 0;
+    virtual void notifyEntryAllocated(U64 hash,int time, size_t size, Natron::StorageModeEnum storage) const = 0;
 
     /**
      * @brief To be called by a CacheEntry on destruction.
      **/
-    virtual void notifyEntryDestroyed(int time, size_t size, Natron::StorageModeEnum storage) const = 0;
+    virtual void notifyEntryDestroyed(U64 hash,int time, size_t size, Natron::StorageModeEnum storage) const = 0;
     
     /**
      * @brief Called by the Cache deleter thread to wake up sleeping threads that were attempting to create a new iamge
@@ -379,15 +522,15 @@ public:
     virtual void notifyMemoryDeallocated() const = 0;
 
     /**
-     * @brief To be called when a backing file has been closed
+     * @brief Returns the pack files in which the entries stored on disk are allocated.
      **/
-    virtual void backingFileClosed() const = 0;
+    virtual boost::shared_ptr<CachePackAllocator> getPackAllocator() const = 0;
 
     /**
      * @brief To be called whenever an entry is deallocated from memory and put back on disk or whenever
      * it is reallocated in the RAM.
      **/
-    virtual void notifyEntryStorageChanged(Natron::StorageModeEnum oldStorage,Natron::StorageModeEnum newStorage,
+    virtual void notifyEntryStorageChanged(U64 hash,Natron::StorageModeEnum oldStorage,Natron::StorageModeEnum newStorage,
                                            int time,size_t size) const = 0;
     
     /**
@@ -397,57 +540,6 @@ public:
     virtual void removeAllEntriesWithDifferentNodeHashForHolderPrivate(const std::string& holderID, U64 nodeHash, bool removeAll) = 0;
     
     
-#ifdef DEBUG
-    static bool checkFileNameMatchesHash(const std::string &originalFileName,U64 hash)
-    {
-        
-        std::string filename = originalFileName;
-        std::string path = SequenceParsing::removePath(filename);
-        //remove extension from filename
-        {
-            size_t lastdot = filename.find_last_of('.');
-            if (lastdot != std::string::npos) {
-                filename.erase(lastdot, std::string::npos);
-            }
-        }
-        
-        //remove index if it has one
-        {
-            std::size_t foundSep = filename.find_last_of('_');
-            if (foundSep != std::string::npos) {
-                filename.erase(foundSep, std::string::npos);
-            }
-        }
-        
-        QString hashKeyStr(filename.c_str());
-        
-        //prepend the 2 digits of the containing directory
-        {
-            if (path.size() > 0) {
-                if (path[path.size() - 1] == '\\' || path[path.size() -1] == '/') {
-                    path.erase(path.size() - 1, 1);
-                }
-                
-                std::size_t foundSep = path.find_last_of('/');
-                if (foundSep == std::string::npos) {
-                    foundSep = path.find_last_of('\\');
-                }
-                assert(foundSep != std::string::npos);
-                std::string enclosingDirName = path.substr(foundSep + 1, std::string::npos);
-                hashKeyStr.prepend(enclosingDirName.c_str());
-            }
-        }
-        
-        
-        U64 hashKey = hashKeyStr.toULongLong(0,16); //< to hex (base 16)
-        if (hashKey == hash) {
-            return true;
-        } else {
-            return false;
-        }
-        
-    }
-#endif
     
 };
 
@@ -507,6 +599,8 @@ public:
     , _removeBackingFileBeforeDestruction(false)
     , _requestedStorage(eStorageModeNone)
     , _entryLock(QReadWriteLock::Recursive)
+    , _renderCost(0.)
+    , _evictionInflation(0.)
     {
     }
 
@@ -519,16 +613,16 @@ public:
     CacheEntryHelper(const KeyType & key,
                      const boost::shared_ptr<ParamsType> & params,
                      const CacheAPI* cache,
-                     Natron::StorageModeEnum storage,
-                     const std::string & path)
+                     Natron::StorageModeEnum storage)
     : _key(key)
     , _params(params)
     , _data()
     , _cache(cache)
     , _removeBackingFileBeforeDestruction(false)
-    , _requestedPath(path)
     , _requestedStorage(storage)
     , _entryLock(QReadWriteLock::Recursive)
+    , _renderCost(0.)
+    , _evictionInflation(0.)
     {
     }
 
@@ -548,14 +642,12 @@ public:
     void setCacheEntry(const KeyType & key,
                        const boost::shared_ptr<ParamsType> & params,
                        const CacheAPI* cache,
-                       Natron::StorageModeEnum storage,
-                       const std::string & path)
+                       Natron::StorageModeEnum storage)
     {
         assert(!_params && _cache == NULL);
         _key = key;
         _params = params;
         _cache = cache;
-        _requestedPath = path;
         _requestedStorage = storage;
     }
 
@@ -579,44 +671,44 @@ public:
                 }
             }
             QWriteLocker k(&_entryLock);
-            allocate(_params->getElementsCount(),_requestedStorage,_requestedPath);
+            allocate(_params->getElementsCount(),_requestedStorage);
             onMemoryAllocated(false);
         }
         
         if (_cache) {
-            _cache->notifyEntryAllocated( getTime(),size(),_data.getStorageMode() );
+            _cache->notifyEntryAllocated( getHashKey(),getTime(),size(),_data.getStorageMode() );
         }
     }
     
     /**
-     * @brief To be called for disk-cached entries when restoring them from a file.
-     * The file-path will be the one passed to the constructor
+     * @brief To be called for disk-cached entries when restoring them from the pack files of the cache.
+     * This function throws a std::runtime_error if the data of the entry is not in the pack files anymore.
      **/
-    void restoreMetaDataFromFile(std::size_t size)
+    void restoreMetaDataFromPack(const CachePackLocation & location)
     {
         if (!_cache || _requestedStorage != Natron::eStorageModeDisk) {
             return;
         }
         
-        assert(!_requestedPath.empty());
-        
         {
             QWriteLocker k(&_entryLock);
             
-            restoreBufferFromFile(_requestedPath);
+            if ( !_data.restoreBufferFromPack(_cache->getPackAllocator(), location) ) {
+                throw std::runtime_error("Cache restore, the entry is not in the pack files anymore");
+            }
             
             onMemoryAllocated(true);
 
         }
         
         if (_cache) {
-            _cache->notifyEntryStorageChanged(Natron::eStorageModeNone, Natron::eStorageModeDisk, getTime(),size);
+            _cache->notifyEntryStorageChanged(getHashKey(),Natron::eStorageModeNone, Natron::eStorageModeDisk, getTime(),location.length);
         }
     }
 
     /**
      * @brief Called right away once the buffer is allocated. Used in debug mode to initialize image with a default color.
-     * @param diskRestoration If true, this is called by restoreMetaDataFromFile() and the memory is in fact not allocated, this should
+     * @param diskRestoration If true, this is called by restoreMetaDataFromPack() and the memory is in fact not allocated, this should
      * just restore meta-data
      **/
     virtual void onMemoryAllocated(bool /*diskRestoration*/)
@@ -629,8 +721,8 @@ public:
         return _key;
     }
     
-    const std::string& getFilePath() const {
-        return _data.getFilePath();
+    const CachePackLocation& getPackLocation() const {
+        return _data.getPackLocation();
     }
 
     typename AbstractCacheEntry<KeyType>::hash_type getHashKey() const OVERRIDE FINAL
@@ -638,37 +730,6 @@ public:
         return _key.getHash();
     }
 
-    std::string generateStringFromHash(const std::string & path,U64 hashKey) const
-    {
-        std::string name(path);
-
-        if ( path.empty() ) {
-            QDir subfolder( path.c_str() );
-            if ( !subfolder.exists() ) {
-                std::cout << "(" << std::hex <<
-                    this << ") " <<   "Something is wrong in cache... couldn't find : " << path << std::endl;
-                throw std::invalid_argument(path);
-            }
-        }
-        QString hashKeyStr = QString::number(hashKey,16); //< hex is base 16
-        for (int i = 0; i < 2; ++i) {
-            if (i >= hashKeyStr.size()) {
-                break;
-            }
-            name.push_back(hashKeyStr[i].toLatin1());
-        }
-        name.append("/");
-        int i = 2;
-        while (i < hashKeyStr.size()) {
-            name.push_back(hashKeyStr[i].toLatin1());
-            ++i;
-        }
-        
-        name.append("." NATRON_CACHE_FILE_EXT);
-
-        return name;
-    }
-
     /** @brief This function is called by the get() function of the Cache when the entry is
      * living only in the disk portion of the cache. No locking is required here because the
      * caller is already preventing other threads to call this function.
@@ -680,7 +741,7 @@ public:
             _data.reOpenFileMapping();
         }
         if (_cache) {
-            _cache->notifyEntryStorageChanged( Natron::eStorageModeDisk, Natron::eStorageModeRAM,getTime(), size() );
+            _cache->notifyEntryStorageChanged( getHashKey(),Natron::eStorageModeDisk, Natron::eStorageModeRAM,getTime(), size() );
         }
     }
 
@@ -691,6 +752,8 @@ public:
     {
         std::size_t sz = size();
         bool dataAllocated = _data.isAllocated();
+        ///A compressed copy only lives in RAM, even for entries stored on disk
+        bool wasCompressed = _data.isCompressed();
         int time = getTime();
         {
             QWriteLocker k(&_entryLock);
@@ -698,13 +761,13 @@ public:
             _data.deallocate();
         }
         if (_cache) {
-            if ( isStoredOnDisk() ) {
+            if ( isStoredOnDisk() && !wasCompressed ) {
                 if (dataAllocated) {
-                    _cache->notifyEntryStorageChanged( Natron::eStorageModeRAM, Natron::eStorageModeDisk, time, sz );
+                    _cache->notifyEntryStorageChanged( getHashKey(),Natron::eStorageModeRAM, Natron::eStorageModeDisk, time, sz );
                 }
             } else {
                 if (dataAllocated) {
-                    _cache->notifyEntryDestroyed(time, sz, Natron::eStorageModeRAM);
+                    _cache->notifyEntryDestroyed(getHashKey(),time, sz, Natron::eStorageModeRAM);
                 }
             }
         }
@@ -747,7 +810,7 @@ public:
     }
 
     /**
-     * @brief An entry stored on disk is effectively destroyed when its backing file is removed.
+     * @brief An entry stored on disk is effectively destroyed when its space in the pack files is released.
      **/
     void removeAnyBackingFile() const
     {
@@ -756,23 +819,84 @@ public:
         }
         
         bool isAlloc = _data.isAllocated();
-        bool hasRemovedFile;
+        std::size_t compressedSize = _data.isCompressed() ? size() : 0;
         {
             QWriteLocker k(&_entryLock);
-            hasRemovedFile = _data.removeAnyBackingFile();
+            _data.removeAnyBackingFile();
         }
         
-        if (hasRemovedFile) {
-            _cache->backingFileClosed();
-        }
-        if ( isAlloc ) {
-            _cache->notifyEntryDestroyed(getTime(), _params->getElementsCount() * sizeof(DataType),Natron::eStorageModeRAM);
+        if (compressedSize > 0) {
+            _cache->notifyEntryDestroyed(getHashKey(),getTime(), compressedSize,Natron::eStorageModeRAM);
+        } else if ( isAlloc ) {
+            _cache->notifyEntryDestroyed(getHashKey(),getTime(), _params->getElementsCount() * sizeof(DataType),Natron::eStorageModeRAM);
         } else {
             ///size() will return 0 at this point, we have to recompute it
-            _cache->notifyEntryDestroyed(getTime(), _params->getElementsCount() * sizeof(DataType),Natron::eStorageModeDisk);
+            _cache->notifyEntryDestroyed(getHashKey(),getTime(), _params->getElementsCount() * sizeof(DataType),Natron::eStorageModeDisk);
         }
     }
     
+    /**
+     * @brief Compresses the data of the entry in RAM, @see Buffer::compress. The data is not accessible
+     * until decompress() is called. Only the cache should call this, on entries that are not used anywhere else.
+     * @returns False if the data does not compress well enough.
+     **/
+    bool compress()
+    {
+        std::size_t oldSize = size();
+        {
+            QWriteLocker k(&_entryLock);
+            if ( !_data.compress( getCompressionElementSize() ) ) {
+                return false;
+            }
+        }
+        if (_cache) {
+            _cache->notifyEntrySizeChanged( getHashKey(), oldSize, size() );
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Makes the data compressed by compress() accessible again.
+     * WARNING: This function throws if the data could not be restored, the entry is then deallocated.
+     **/
+    void decompress()
+    {
+        std::size_t oldSize = size();
+        std::string error;
+        {
+            QWriteLocker k(&_entryLock);
+            try {
+                _data.decompress();
+            } catch (const std::exception & e) {
+                error = e.what();
+            }
+        }
+        if (!error.empty()) {
+            if (_cache) {
+                _cache->notifyEntryDestroyed(getHashKey(), getTime(), oldSize, Natron::eStorageModeRAM);
+            }
+            throw std::runtime_error(error);
+        }
+        if (_cache) {
+            _cache->notifyEntrySizeChanged( getHashKey(), oldSize, size() );
+        }
+    }
+
+    bool isCompressed() const
+    {
+        QReadLocker k(&_entryLock);
+        return _data.isCompressed();
+    }
+
+    /**
+     * @brief The size in bytes of the elements compressCacheBuffer() should consider, ideally the size of a pixel.
+     **/
+    virtual std::size_t getCompressionElementSize() const
+    {
+        return sizeof(DataType);
+    }
+
     /**
      * @brief To be called when an entry is going to be removed from the cache entirely.
      **/
@@ -791,6 +915,38 @@ public:
         return _params;
     }
 
+    /**
+     * @brief Accumulates the time (in seconds) spent computing the content of this entry.
+     * Several threads may render distinct portions of the same entry hence the costs add up.
+     * Cost-aware eviction policies use it to keep entries that are expensive to recompute.
+     **/
+    void addRenderCost(double seconds)
+    {
+        QWriteLocker k(&_entryLock);
+        _renderCost += seconds;
+    }
+
+    double getRenderCost() const
+    {
+        QReadLocker k(&_entryLock);
+        return _renderCost;
+    }
+
+    /**
+     * @brief Book-keeping of the GreedyDual-Size eviction policy: the value of the cache
+     * inflation when this entry was last accessed. Only the cache should call these, under the lock
+     * of the shard owning the entry.
+     **/
+    void setEvictionInflation(double inflation)
+    {
+        _evictionInflation = inflation;
+    }
+
+    double getEvictionInflation() const
+    {
+        return _evictionInflation;
+    }
+
 protected:
 
 
@@ -800,7 +956,7 @@ protected:
         size_t oldSize = size();
         _data.reallocate(elemCount);
         if (_cache) {
-            _cache->notifyEntrySizeChanged( oldSize,size());
+            _cache->notifyEntrySizeChanged( getHashKey(),oldSize,size());
         }
     }
 
@@ -809,76 +965,25 @@ protected:
         size_t oldSize = size();
         _data.swap(other._data);
         if (_cache) {
-            _cache->notifyEntrySizeChanged( oldSize,size());
+            _cache->notifyEntrySizeChanged( getHashKey(),oldSize,size());
         }
     }
 
 private:
 
-    static bool fileExists(const std::string& filename)
-    {
-        std::ifstream f(filename.c_str());
-        bool ret = f.good();
-        f.close();
-        return ret;
-    }
-
     /** @brief This function is called in allocateMeory(...) and before the object is exposed
      * to other threads. Hence this function doesn't need locking mechanism at all.
      * We must ensure that this function is called ONLY by allocateMemory(), that's why
      * it is private.
      **/
-    void allocate( U64 count,
-                   Natron::StorageModeEnum storage,
-                   std::string path = std::string() )
-    {
-        std::string fileName;
-        
-        if (storage == Natron::eStorageModeDisk) {
-            
-            typename AbstractCacheEntry<KeyType>::hash_type hashKey = getHashKey();
-            try {
-                fileName = generateStringFromHash(path,hashKey);
-            } catch (const std::invalid_argument & e) {
-                std::cout << "Path is empty but required for disk caching: " << e.what() << std::endl;
-                return;
-            }
-            
-            assert(!fileName.empty());
-            //Check if the filename already exists, if so append a 0-based index after the hash (separated by a '_')
-            //and try again
-            int index = 0;
-            if (fileExists(fileName)) {
-                fileName.insert(fileName.size() - 4,"_0");
-            }
-            while (fileExists(fileName)) {
-                ++index;
-                std::stringstream ss;
-                ss << index;
-                fileName.replace(fileName.size() - 1,std::string::npos,ss.str());
-            }
-#ifdef DEBUG
-            if (!CacheAPI::checkFileNameMatchesHash(fileName, hashKey)) {
-                qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
-            }
-#endif
-        }
-        _data.allocate(count, storage, fileName);
-    }
-
-    /** @brief This function is called in allocateMeory() and before the object is exposed
-     * to other threads. Hence this function doesn't need locking mechanism at all.
-     * We must ensure that this function is called ONLY by allocateMemory(), that's why
-     * it is private.
-     **/
-    void restoreBufferFromFile(const std::string & path)
+    void allocate(U64 count,
+                  Natron::StorageModeEnum storage)
     {
-        
-        if (!fileExists(path)) {
-            throw std::runtime_error("Cache restore, no such file: " + path);
+        if ( (storage == Natron::eStorageModeDisk) && _cache ) {
+            _data.allocate( count, storage, _cache->getPackAllocator() );
+        } else {
+            _data.allocate(count, storage);
         }
-        _data.restoreBufferFromFile(path);
-       
     }
 
 protected:
@@ -888,9 +993,10 @@ protected:
     Buffer<DataType> _data;
     const CacheAPI* _cache;
     bool _removeBackingFileBeforeDestruction;
-    std::string _requestedPath;
     Natron::StorageModeEnum _requestedStorage;
     mutable QReadWriteLock _entryLock;
+    double _renderCost; //< protected by _entryLock
+    double _evictionInflation; //< protected by the lock of the cache shard holding the entry
 };
 }
 
@@ -0,0 +1,420 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "CachePackAllocator.h"
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <cassert>
+
+#include <QtCore/QMutex>
+#include <QtCore/QDir>
+#include <QtCore/QStringList>
+#include <QtCore/QDebug>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#endif
+
+#include "Engine/AppManager.h"
+#include "Engine/MemoryFile.h"
+
+using namespace Natron;
+
+namespace {
+struct CachePack
+{
+    boost::shared_ptr<MemoryFile> file;
+    std::map<U64, U64> freeExtents; //< offset -> length, two extents are never adjacent
+    U64 freeBytes;
+
+    CachePack()
+        : file()
+        , freeExtents()
+        , freeBytes(0)
+    {
+    }
+};
+
+typedef boost::shared_ptr<CachePack> CachePackPtr;
+
+U64
+alignedLength(U64 length)
+{
+    U64 ret = ( (length + NATRON_CACHE_PACK_ALIGNMENT - 1) / NATRON_CACHE_PACK_ALIGNMENT ) * NATRON_CACHE_PACK_ALIGNMENT;
+
+    return ret == 0 ? NATRON_CACHE_PACK_ALIGNMENT : ret;
+}
+}
+
+struct Natron::CachePackAllocatorPrivate
+{
+    std::string directory;
+    std::size_t packSize;
+    mutable QMutex lock; //< protects all members below
+    std::vector<CachePackPtr> packs; //< indexed by pack number, NULL for the numbers not in use
+    std::size_t allocatedSize;
+
+    CachePackAllocatorPrivate(const std::string & directory,
+                              std::size_t packSize)
+        : directory(directory)
+        , packSize(packSize)
+        , lock()
+        , packs()
+        , allocatedSize(0)
+    {
+    }
+
+    std::string getPackFilePath(int index) const
+    {
+        std::stringstream ss;
+
+        ss << directory << "/pack_" << index << "." NATRON_CACHE_FILE_EXT;
+
+        return ss.str();
+    }
+
+    void openExistingPacks();
+
+    int createPack(std::size_t size);
+
+    void removePack(int index);
+
+    void insertFreeExtent(CachePack & pack, U64 offset, U64 length);
+};
+
+void
+CachePackAllocatorPrivate::openExistingPacks()
+{
+    QDir dir( directory.c_str() );
+    QStringList filters;
+
+    filters << "pack_*." NATRON_CACHE_FILE_EXT;
+    QStringList files = dir.entryList(filters, QDir::Files);
+    for (int i = 0; i < files.size(); ++i) {
+        ///Extract <index> from pack_<index>.ntc
+        QString indexStr = files[i].mid( 5, files[i].size() - 5 - ( (int)sizeof("." NATRON_CACHE_FILE_EXT) - 1 ) );
+        bool ok;
+        int index = indexStr.toInt(&ok);
+        if ( !ok || (index < 0) ) {
+            continue;
+        }
+        CachePackPtr pack(new CachePack);
+        try {
+            pack->file.reset( new MemoryFile(getPackFilePath(index), MemoryFile::eFileOpenModeEnumIfExistsKeepElseFail) );
+        } catch (const std::exception & e) {
+            qDebug() << "Failed to open cache pack file:" << e.what();
+            continue;
+        }
+        if ( !pack->file->data() || (pack->file->size() == 0) ) {
+            pack->file->remove();
+            continue;
+        }
+        appPTR->increaseNCacheFilesOpened();
+        pack->freeBytes = pack->file->size();
+        pack->freeExtents.insert( std::make_pair(0, pack->freeBytes) );
+        if ( (int)packs.size() <= index ) {
+            packs.resize(index + 1);
+        }
+        packs[index] = pack;
+    }
+}
+
+int
+CachePackAllocatorPrivate::createPack(std::size_t size)
+{
+    ///Check that we are allowed to open one more file
+    if ( appPTR->isNCacheFilesOpenedCapped() ) {
+        return -1;
+    }
+
+    ///Re-use the first free index
+    int index = 0;
+    while ( index < (int)packs.size() && packs[index] ) {
+        ++index;
+    }
+
+    CachePackPtr pack(new CachePack);
+    try {
+        pack->file.reset( new MemoryFile(getPackFilePath(index), size, MemoryFile::eFileOpenModeEnumIfExistsTruncateElseCreate) );
+    } catch (const std::exception & e) {
+        qDebug() << "Failed to create cache pack file:" << e.what();
+
+        return -1;
+    }
+    appPTR->increaseNCacheFilesOpened();
+    pack->freeBytes = size;
+    pack->freeExtents.insert( std::make_pair(0, (U64)size) );
+    if ( index == (int)packs.size() ) {
+        packs.push_back(pack);
+    } else {
+        packs[index] = pack;
+    }
+
+    return index;
+}
+
+void
+CachePackAllocatorPrivate::removePack(int index)
+{
+    assert( index >= 0 && index < (int)packs.size() && packs[index] );
+    try {
+        packs[index]->file->remove();
+    } catch (const std::exception & e) {
+        qDebug() << "Failed to remove cache pack file:" << e.what();
+    }
+    packs[index].reset();
+    appPTR->decreaseNCacheFilesOpened();
+}
+
+void
+CachePackAllocatorPrivate::insertFreeExtent(CachePack & pack,
+                                            U64 offset,
+                                            U64 length)
+{
+    pack.freeBytes += length;
+
+    std::map<U64, U64>::iterator next = pack.freeExtents.lower_bound(offset);
+
+    ///Merge with the previous extent if it ends where this one starts
+    if ( next != pack.freeExtents.begin() ) {
+        std::map<U64, U64>::iterator prev = next;
+        --prev;
+        assert(prev->first + prev->second <= offset);
+        if (prev->first + prev->second == offset) {
+            offset = prev->first;
+            length += prev->second;
+            pack.freeExtents.erase(prev);
+        }
+    }
+
+    ///Merge with the next extent if it starts where this one ends
+    if ( ( next != pack.freeExtents.end() ) && (offset + length == next->first) ) {
+        length += next->second;
+        pack.freeExtents.erase(next);
+    }
+
+    pack.freeExtents.insert( std::make_pair(offset, length) );
+}
+
+CachePackAllocator::CachePackAllocator(const std::string & directory,
+                                       std::size_t packSize)
+    : _imp( new CachePackAllocatorPrivate(directory, packSize) )
+{
+    QMutexLocker k(&_imp->lock);
+
+    _imp->openExistingPacks();
+}
+
+CachePackAllocator::~CachePackAllocator()
+{
+    for (std::size_t i = 0; i < _imp->packs.size(); ++i) {
+        if (_imp->packs[i]) {
+            _imp->packs[i]->file->flush();
+            appPTR->decreaseNCacheFilesOpened();
+        }
+    }
+    delete _imp;
+}
+
+const std::string &
+CachePackAllocator::getDirectory() const
+{
+    return _imp->directory;
+}
+
+bool
+CachePackAllocator::allocate(std::size_t size,
+                             CachePackLocation* location)
+{
+    U64 length = alignedLength(size);
+    QMutexLocker k(&_imp->lock);
+
+    ///First-fit in the existing packs
+    for (std::size_t i = 0; i < _imp->packs.size(); ++i) {
+        CachePack* pack = _imp->packs[i].get();
+        if ( !pack || (pack->freeBytes < length) ) {
+            continue;
+        }
+        for (std::map<U64, U64>::iterator it = pack->freeExtents.begin(); it != pack->freeExtents.end(); ++it) {
+            if (it->second >= length) {
+                location->pack = (int)i;
+                location->offset = it->first;
+                location->length = size;
+                if (it->second > length) {
+                    pack->freeExtents.insert( std::make_pair(it->first + length, it->second - length) );
+                }
+                pack->freeExtents.erase(it);
+                pack->freeBytes -= length;
+                _imp->allocatedSize += length;
+
+                return true;
+            }
+        }
+    }
+
+    ///No room left: entries larger than a pack get a pack of their own
+    int index = _imp->createPack( std::max( (std::size_t)length, _imp->packSize ) );
+    if (index == -1) {
+        return false;
+    }
+    CachePack & pack = *_imp->packs[index];
+    location->pack = index;
+    location->offset = 0;
+    location->length = size;
+    pack.freeExtents.clear();
+    if (pack.file->size() > length) {
+        pack.freeExtents.insert( std::make_pair(length, pack.file->size() - length) );
+    }
+    pack.freeBytes -= length;
+    _imp->allocatedSize += length;
+
+    return true;
+}
+
+bool
+CachePackAllocator::reserve(const CachePackLocation & location)
+{
+    U64 length = alignedLength(location.length);
+    QMutexLocker k(&_imp->lock);
+
+    if ( !location.isValid() || ( location.pack >= (int)_imp->packs.size() ) || !_imp->packs[location.pack] ) {
+        return false;
+    }
+    CachePack & pack = *_imp->packs[location.pack];
+
+    ///Find the free extent containing the location
+    std::map<U64, U64>::iterator it = pack.freeExtents.upper_bound(location.offset);
+    if ( it == pack.freeExtents.begin() ) {
+        return false;
+    }
+    --it;
+    U64 extentStart = it->first;
+    U64 extentEnd = it->first + it->second;
+    if (location.offset + length > extentEnd) {
+        return false;
+    }
+    pack.freeExtents.erase(it);
+    if (extentStart < location.offset) {
+        pack.freeExtents.insert( std::make_pair(extentStart, location.offset - extentStart) );
+    }
+    if (location.offset + length < extentEnd) {
+        pack.freeExtents.insert( std::make_pair(location.offset + length, extentEnd - location.offset - length) );
+    }
+    pack.freeBytes -= length;
+    _imp->allocatedSize += length;
+
+    return true;
+}
+
+void
+CachePackAllocator::deallocate(const CachePackLocation & location)
+{
+    if ( !location.isValid() ) {
+        return;
+    }
+    U64 length = alignedLength(location.length);
+    QMutexLocker k(&_imp->lock);
+
+    assert( location.pack < (int)_imp->packs.size() && _imp->packs[location.pack] );
+    CachePack & pack = *_imp->packs[location.pack];
+    _imp->insertFreeExtent(pack, location.offset, length);
+    assert(_imp->allocatedSize >= length);
+    _imp->allocatedSize -= length;
+
+    ///Dedicated packs of large entries are not worth keeping around
+    if ( (pack.freeBytes == pack.file->size()) && (pack.file->size() > _imp->packSize) ) {
+        _imp->removePack(location.pack);
+    }
+}
+
+char*
+CachePackAllocator::data(const CachePackLocation & location) const
+{
+    QMutexLocker k(&_imp->lock);
+
+    if ( !location.isValid() || ( location.pack >= (int)_imp->packs.size() ) || !_imp->packs[location.pack] ) {
+        return 0;
+    }
+    char* base = _imp->packs[location.pack]->file->data();
+
+    return base ? base + location.offset : 0;
+}
+
+bool
+CachePackAllocator::flush(const CachePackLocation & location) const
+{
+    boost::shared_ptr<MemoryFile> file;
+    {
+        QMutexLocker k(&_imp->lock);
+        if ( !location.isValid() || ( location.pack >= (int)_imp->packs.size() ) || !_imp->packs[location.pack] ) {
+            return false;
+        }
+        file = _imp->packs[location.pack]->file;
+    }
+
+    ///Don't hold the lock while syncing, this is expensive
+    return file->flush(location.offset, location.length);
+}
+
+std::size_t
+CachePackAllocator::getPacksCount() const
+{
+    QMutexLocker k(&_imp->lock);
+    std::size_t ret = 0;
+
+    for (std::size_t i = 0; i < _imp->packs.size(); ++i) {
+        if (_imp->packs[i]) {
+            ++ret;
+        }
+    }
+
+    return ret;
+}
+
+std::size_t
+CachePackAllocator::getPacksSize() const
+{
+    QMutexLocker k(&_imp->lock);
+    std::size_t ret = 0;
+
+    for (std::size_t i = 0; i < _imp->packs.size(); ++i) {
+        if (_imp->packs[i]) {
+            ret += _imp->packs[i]->file->size();
+        }
+    }
+
+    return ret;
+}
+
+std::size_t
+CachePackAllocator::getAllocatedSize() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->allocatedSize;
+}
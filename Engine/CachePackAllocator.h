@@ -0,0 +1,144 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_CACHEPACKALLOCATOR_H
+#define NATRON_ENGINE_CACHEPACKALLOCATOR_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <string>
+#include <cstddef>
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/noncopyable.hpp>
+#endif
+
+#include "Global/GlobalDefines.h"
+
+namespace Natron {
+
+/**
+ * @brief The address of a chunk of memory living in one of the pack files of a CachePackAllocator.
+ **/
+struct CachePackLocation
+{
+    int pack; //< the index of the pack file, -1 if this location is invalid
+    U64 offset; //< the offset in bytes from the start of the pack file, always a multiple of NATRON_CACHE_PACK_ALIGNMENT
+    U64 length; //< the number of bytes requested, the space reserved in the pack is rounded up to NATRON_CACHE_PACK_ALIGNMENT
+
+    CachePackLocation()
+        : pack(-1)
+        , offset(0)
+        , length(0)
+    {
+    }
+
+    bool isValid() const
+    {
+        return pack >= 0;
+    }
+};
+
+struct CachePackAllocatorPrivate;
+
+/**
+ * @brief Stores the disk portion of a cache in a few large memory-mapped pack files instead of one file per entry.
+ * Each pack file is mapped once for its whole lifetime and its space is handed out by a first-fit free-list
+ * allocator which coalesces adjacent free extents. Entries are addressed by a CachePackLocation (pack, offset, length).
+ * Entries larger than a pack get a dedicated pack file which is removed as soon as the entry is deallocated.
+ *
+ * Pack files are named pack_<index>.ntc and live in the directory given to the constructor. All existing pack files
+ * in that directory are opened by the constructor and their space is considered free until reserve() is called
+ * for the entries that were restored from the cache table of contents.
+ *
+ * This class is thread-safe.
+ **/
+class CachePackAllocator
+    : boost::noncopyable
+{
+public:
+
+    /**
+     * @param directory The directory where the pack files are stored
+     * @param packSize The size in bytes of a pack file
+     **/
+    CachePackAllocator(const std::string & directory,
+                       std::size_t packSize);
+
+    /**
+     * @brief Closes the mapping of all pack files. The files themselves are not removed.
+     **/
+    ~CachePackAllocator();
+
+    const std::string & getDirectory() const;
+
+    /**
+     * @brief Reserves size bytes in one of the pack files, creating a new pack file if needed.
+     * @returns False if no space could be reserved, e.g: if the pack file could not be created.
+     **/
+    bool allocate(std::size_t size, CachePackLocation* location);
+
+    /**
+     * @brief Marks the given location as used. This is called when restoring the entries of a cache
+     * whose data is already in the pack files.
+     * @returns False if the location does not belong to a pack file or overlaps an area already in use.
+     **/
+    bool reserve(const CachePackLocation & location);
+
+    /**
+     * @brief Gives back the space held by location to the free-list.
+     **/
+    void deallocate(const CachePackLocation & location);
+
+    /**
+     * @brief Returns a pointer to the first byte of the given location in the mapped pack file.
+     * The pointer remains valid until deallocate() is called for this location.
+     **/
+    char* data(const CachePackLocation & location) const;
+
+    /**
+     * @brief Ensures that the content of the given location is in sync. with the pack file on disk.
+     **/
+    bool flush(const CachePackLocation & location) const;
+
+    /**
+     * @brief Returns the number of pack files currently opened.
+     **/
+    std::size_t getPacksCount() const;
+
+    /**
+     * @brief Returns the total size in bytes of the pack files.
+     **/
+    std::size_t getPacksSize() const;
+
+    /**
+     * @brief Returns the number of bytes currently reserved by entries in the pack files.
+     **/
+    std::size_t getAllocatedSize() const;
+
+private:
+
+    CachePackAllocatorPrivate* _imp;
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_CACHEPACKALLOCATOR_H
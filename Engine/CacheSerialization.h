@@ -65,24 +65,27 @@ template<typename EntryType>
 void Cache<EntryType>::save(CacheTOC* tableOfContents)
 {
     clearInMemoryPortion(false);
-    QMutexLocker l(&_lock);     // must be locked
-
-    for (CacheIterator it = _diskCache.begin(); it != _diskCache.end(); ++it) {
-        std::list<EntryTypePtr> & listOfValues  = getValueFromIterator(it);
-        for (typename std::list<EntryTypePtr>::const_iterator it2 = listOfValues.begin(); it2 != listOfValues.end(); ++it2) {
-            if ( (*it2)->isStoredOnDisk() ) {
-                SerializedEntry serialization;
-                serialization.hash = (*it2)->getHashKey();
-                serialization.params = (*it2)->getParams();
-                serialization.key = (*it2)->getKey();
-                serialization.size = (*it2)->dataSize();
-                serialization.filePath = (*it2)->getFilePath();
-                tableOfContents->push_back(serialization);
-#ifdef DEBUG
-                if (!CacheAPI::checkFileNameMatchesHash(serialization.filePath, serialization.hash)) {
-                    qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
+    for (std::size_t i = 0; i < _shards.size(); ++i) {
+        CacheShard & shard = *_shards[i];
+        CacheMutexLocker l(&shard.lock, &_lockContention);     // must be locked
+
+        for (CacheIterator it = shard.diskCache.begin(); it != shard.diskCache.end(); ++it) {
+            std::list<EntryTypePtr> & listOfValues  = getValueFromIterator(it);
+            for (typename std::list<EntryTypePtr>::const_iterator it2 = listOfValues.begin(); it2 != listOfValues.end(); ++it2) {
+                if ( (*it2)->isStoredOnDisk() ) {
+                    SerializedEntry serialization;
+                    serialization.hash = (*it2)->getHashKey();
+                    serialization.params = (*it2)->getParams();
+                    serialization.key = (*it2)->getKey();
+                    const CachePackLocation & location = (*it2)->getPackLocation();
+                    if ( !location.isValid() ) {
+                        continue;
+                    }
+                    serialization.size = location.length;
+                    serialization.pack = location.pack;
+                    serialization.packOffset = location.offset;
+                    tableOfContents->push_back(serialization);
                 }
-#endif
             }
         }
     }
@@ -113,29 +116,30 @@ void Cache<EntryType>::restore(const CacheTOC & tableOfContents)
             qDebug() << "WARNING: serialized hash key different than the restored one";
         }
 
-#ifdef DEBUG
-        if (!checkFileNameMatchesHash(it->filePath, it->hash)) {
-            qDebug() << "WARNING: Cache entry filename is not the same as the serialized hash key";
-        }
-#endif
-
         EntryType* value = NULL;
 
         Natron::StorageModeEnum storage = Natron::eStorageModeDisk;
 
         try {
-            value = new EntryType(it->key,it->params,this,storage,it->filePath);
+            value = new EntryType(it->key,it->params,this,storage);
+
+            CachePackLocation location;
+            location.pack = it->pack;
+            location.offset = it->packOffset;
+            location.length = it->size;
 
             ///This will not put the entry back into RAM, instead we just insert back the entry into the disk cache
-            value->restoreMetaDataFromFile(it->size);
+            value->restoreMetaDataFromPack(location);
         } catch (const std::exception & e) {
             qDebug() << e.what();
+            delete value;
             continue;
         }
 
         {
-            QMutexLocker locker(&_lock);
-            sealEntry(EntryTypePtr(value), false);
+            CacheShard & shard = getShard( value->getHashKey() );
+            CacheMutexLocker locker(&shard.lock, &_lockContention);
+            sealEntry(shard, EntryTypePtr(value), false);
         }
     }
 }
@@ -147,14 +151,16 @@ struct Cache<EntryType>::SerializedEntry
     typename EntryType::key_type key;
     ParamsTypePtr params;
     std::size_t size; //< the data size in bytes
-    std::string filePath; //< we need to serialize it as several entries can have the same hash, hence we index them
+    int pack; //< the index of the pack file holding the data
+    U64 packOffset; //< the offset in bytes of the data in the pack file
 
     SerializedEntry()
     : hash(0)
     , key()
     , params()
     , size(0)
-    , filePath()
+    , pack(-1)
+    , packOffset(0)
     {
 
     }
@@ -167,7 +173,8 @@ struct Cache<EntryType>::SerializedEntry
         ar & boost::serialization::make_nvp("Key",key);
         ar & boost::serialization::make_nvp("Params",params);
         ar & boost::serialization::make_nvp("Size",size);
-        ar & boost::serialization::make_nvp("Filename",filePath);
+        ar & boost::serialization::make_nvp("Pack",pack);
+        ar & boost::serialization::make_nvp("PackOffset",packOffset);
     }
 
     template<class Archive>
@@ -178,7 +185,8 @@ struct Cache<EntryType>::SerializedEntry
         ar & boost::serialization::make_nvp("Key",key);
         ar & boost::serialization::make_nvp("Params",params);
         ar & boost::serialization::make_nvp("Size",size);
-        ar & boost::serialization::make_nvp("Filename",filePath);
+        ar & boost::serialization::make_nvp("Pack",pack);
+        ar & boost::serialization::make_nvp("PackOffset",packOffset);
     }
 
     BOOST_SERIALIZATION_SPLIT_MEMBER()
@@ -26,6 +26,7 @@
 
 #include <algorithm>
 #include <stdexcept>
+#include <cfloat>
 
 #if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
@@ -35,6 +36,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/AppManager.h"
 
 #include "Engine/CurvePrivate.h"
+#include "Engine/Hash64.h"
 #include "Engine/Interpolation.h"
 #include "Engine/KnobTypes.h"
 #include "Engine/KnobFile.h"
@@ -301,6 +303,7 @@ Curve::clearKeyFrames()
     QMutexLocker l(&_imp->_lock);
 
     _imp->keyFrames.clear();
+    _imp->segmentsValid = false;
 }
 
 bool
@@ -414,6 +417,41 @@ Curve::addKeyFrame(KeyFrame key)
     return it.second;
 }
 
+int
+Curve::addKeyFrames(const std::list<KeyFrame>& keys)
+{
+    QMutexLocker l(&_imp->_lock);
+    int added = 0;
+
+    if ( keys.empty() ) {
+        return added;
+    }
+    bool constantInterp = (_imp->type == CurvePrivate::eCurveTypeBool) || (_imp->type == CurvePrivate::eCurveTypeString) ||
+                          ( _imp->type == CurvePrivate::eCurveTypeIntConstantInterp);
+    for (std::list<KeyFrame>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+        KeyFrame key(*it);
+        if (constantInterp) {
+            key.setInterpolation(Natron::eKeyframeTypeConstant);
+        }
+        if ( addKeyFrameNoUpdate(key).second ) {
+            ++added;
+        }
+    }
+
+    ///refresh the derivatives of all the keyframes in a single pass, in the order of time: each keyframe is
+    ///computed from its neighbours, which are all in the set by now. See evaluateCurveChanged()
+    for (KeyFrameSet::iterator it = _imp->keyFrames.begin(); it != _imp->keyFrames.end(); ++it) {
+        Natron::KeyframeTypeEnum interp = it->getInterpolation();
+        if ( (interp != Natron::eKeyframeTypeBroken) && (interp != Natron::eKeyframeTypeFree) &&
+             ( interp != Natron::eKeyframeTypeNone) ) {
+            it = refreshDerivatives(eCurveChangedReasonDerivativesChanged, it);
+        }
+    }
+    onCurveChanged();
+
+    return added;
+}
+
 std::pair<KeyFrameSet::iterator,bool> Curve::addKeyFrameNoUpdate(const KeyFrame & cp)
 {
     // PRIVATE - should not lock
@@ -432,12 +470,11 @@ std::pair<KeyFrameSet::iterator,bool> Curve::addKeyFrameNoUpdate(const KeyFrame
     } else {
         bool addedKey = true;
         double paramEps = NATRON_CURVE_X_SPACING_EPSILON * std::abs(_imp->xMax - _imp->xMin);
-        for (KeyFrameSet::iterator it = _imp->keyFrames.begin(); it != _imp->keyFrames.end(); ++it) {
-            if (std::abs( it->getTime() - cp.getTime() ) < paramEps) {
-                _imp->keyFrames.erase(it);
-                addedKey = false;
-                break;
-            }
+        // the first keyframe with time > cp.getTime() - paramEps is the only candidate closer than paramEps
+        KeyFrameSet::iterator it = _imp->keyFrames.upper_bound( KeyFrame(cp.getTime() - paramEps, 0.) );
+        if ( ( it != _imp->keyFrames.end() ) && (std::abs( it->getTime() - cp.getTime() ) < paramEps) ) {
+            _imp->keyFrames.erase(it);
+            addedKey = false;
         }
         std::pair<KeyFrameSet::iterator,bool> newKey = _imp->keyFrames.insert(cp);
         newKey.second = addedKey;
@@ -759,34 +796,54 @@ interParams(const KeyFrameSet &keyFrames,
     }
 }
 
-double
-Curve::getValueAt(double t,bool doClamp) const
+/// round an interpolated value to the type of the values of the curve
+static double
+roundToCurveType(CurvePrivate::CurveTypeEnum type,
+                 double v)
 {
-    QMutexLocker l(&_imp->_lock);
+    switch (type) {
+    case CurvePrivate::eCurveTypeString:
+    case CurvePrivate::eCurveTypeInt:
 
-    if ( _imp->keyFrames.empty() ) {
-        throw std::runtime_error("Curve has no control points!");
+        return std::floor(v + 0.5);
+    case CurvePrivate::eCurveTypeDouble:
+
+        return v;
+    case CurvePrivate::eCurveTypeBool:
+
+        return v >= 0.5 ? 1. : 0.;
+    default:
+
+        return v;
     }
-    
-    std::map<double,double>::const_iterator foundCached = _imp->resultCache.find(t);
-    double v;
-    if (foundCached != _imp->resultCache.end()) {
-        v = foundCached->second;
-    } else {
-        
-        // even when there is only one keyframe, there may be tangents!
-        //if (_imp->keyFrames.size() == 1) {
-        //    //if there's only 1 keyframe, don't bother interpolating
-        //    return (*_imp->keyFrames.begin()).getValue();
-        //}
-        double tcur,tnext;
-        double vcurDerivRight,vnextDerivLeft,vcur,vnext;
-        Natron::KeyframeTypeEnum interp,interpNext;
-        KeyFrame k(t,0.);
-        // find the first keyframe with time greater than t
-        KeyFrameSet::const_iterator itup;
-        itup = _imp->keyFrames.upper_bound(k);
-        interParams(_imp->keyFrames,
+}
+
+CurveSegments::CurveSegments()
+    : _times()
+    , _segments()
+{
+}
+
+void
+CurveSegments::build(const KeyFrameSet& keyFrames)
+{
+    _times.clear();
+    _segments.clear();
+    if ( keyFrames.empty() ) {
+        return;
+    }
+    _times.reserve( keyFrames.size() );
+    _segments.resize(keyFrames.size() + 1);
+
+    double tcur,tnext;
+    double vcurDerivRight,vnextDerivLeft,vcur,vnext;
+    Natron::KeyframeTypeEnum interp,interpNext;
+    int i = 0;
+    // segment i ends at the keyframe itup
+    for (KeyFrameSet::const_iterator itup = keyFrames.begin(); ; ++itup, ++i) {
+        // any time in the segment will do for the asserts
+        double t = _times.empty() ? itup->getTime() - 1. : _times.back();
+        interParams(keyFrames,
                     t,
                     itup,
                     &tcur,
@@ -797,37 +854,161 @@ Curve::getValueAt(double t,bool doClamp) const
                     &vnext,
                     &vnextDerivLeft,
                     &interpNext);
-        
-        v = Natron::interpolate(tcur,vcur,
-                                vcurDerivRight,
-                                vnextDerivLeft,
-                                tnext,vnext,
-                                t,
-                                interp,
-                                interpNext);
-        _imp->resultCache[t] = v;
+        Segment & seg = _segments[i];
+        Natron::cubicCoefficients(tcur,vcur,
+                                  vcurDerivRight,
+                                  vnextDerivLeft,
+                                  tnext,vnext,
+                                  interp,
+                                  interpNext,
+                                  &seg.tstart, &seg.tend,
+                                  &seg.c0, &seg.c1, &seg.c2, &seg.c3);
+        if ( itup == keyFrames.end() ) {
+            break;
+        }
+        _times.push_back( itup->getTime() );
+    }
+    assert( _segments.size() == _times.size() + 1 );
+}
+
+int
+CurveSegments::findSegment(double t) const
+{
+    // branchless upper_bound: the loop only depends on the number of keyframes, and the
+    // comparison compiles to a conditional move
+    const double* base = &_times[0];
+    int len = (int)_times.size();
+
+    while (len > 1) {
+        const int half = len / 2;
+        base = (base[half] <= t) ? base + half : base;
+        len -= half;
+    }
+
+    return (int)(base - &_times[0]) + (*base <= t);
+}
+
+double
+CurveSegments::evaluate(int segment,
+                        double t) const
+{
+    const Segment & seg = _segments[segment];
+
+    return Natron::cubicEval(seg.c0, seg.c1, seg.c2, seg.c3, (t - seg.tstart) / (seg.tend - seg.tstart));
+}
+
+double
+CurveSegments::getValueAt(double t) const
+{
+    assert( !isEmpty() );
+
+    return evaluate(findSegment(t), t);
+}
+
+void
+CurveSegments::getValuesAt(const double* times,
+                           double* values,
+                           int n) const
+{
+    assert( !isEmpty() );
+    for (int i = 0; i < n; ++i) {
+        values[i] = evaluate(findSegment(times[i]), times[i]);
+    }
+}
+
+double
+CurveSegments::integrate(double t1,
+                         double t2) const
+{
+    assert( !isEmpty() && t1 <= t2 );
+    const int nKeys = (int)_times.size();
+    double sum = 0.;
+    // same as Natron::integrate on each segment between t1 and t2
+    for (int i = findSegment(t1); ; ++i) {
+        const Segment & seg = _segments[i];
+        const bool last = (i == nKeys) || (t2 <= _times[i]);
+        const double time2 = last ? t2 : _times[i];
+        double ret = Natron::cubicIntegrate(seg.c0, seg.c1, seg.c2, seg.c3, (time2 - seg.tstart) / (seg.tend - seg.tstart));
+        if (t1 != seg.tstart) {
+            ret -= Natron::cubicIntegrate(seg.c0, seg.c1, seg.c2, seg.c3, (t1 - seg.tstart) / (seg.tend - seg.tstart));
+        }
+        sum += ret * (seg.tend - seg.tstart);
+        if (last) {
+            break;
+        }
+        t1 = time2;
+    }
+
+    return sum;
+}
+
+double
+Curve::getValueAt(double t,bool doClamp) const
+{
+    QMutexLocker l(&_imp->_lock);
+
+    if ( _imp->keyFrames.empty() ) {
+        throw std::runtime_error("Curve has no control points!");
     }
 
+    // even when there is only one keyframe, there may be tangents!
+    double v = _imp->getSegments().getValueAt(t);
+
     if ( doClamp && mustClamp() ) {
         v = clampValueToCurveYRange(v);
     }
 
-    switch (_imp->type) {
-    case CurvePrivate::eCurveTypeString:
-    case CurvePrivate::eCurveTypeInt:
+    return roundToCurveType(_imp->type, v);
+} // getValueAt
 
-        return std::floor(v + 0.5);
-    case CurvePrivate::eCurveTypeDouble:
+void
+Curve::getValuesAt(const double* times,
+                   double* values,
+                   int n,
+                   bool doClamp) const
+{
+    QMutexLocker l(&_imp->_lock);
 
-        return v;
-    case CurvePrivate::eCurveTypeBool:
+    if ( _imp->keyFrames.empty() ) {
+        throw std::runtime_error("Curve has no control points!");
+    }
 
-        return v >= 0.5 ? 1. : 0.;
-    default:
+    _imp->getSegments().getValuesAt(times, values, n);
 
-        return v;
+    if ( doClamp && mustClamp() ) {
+        std::pair<double,double> minmax = getCurveYRange();
+        for (int i = 0; i < n; ++i) {
+            values[i] = std::max( minmax.first, std::min(values[i], minmax.second) );
+        }
     }
-} // getValueAt
+    if (_imp->type != CurvePrivate::eCurveTypeDouble) {
+        for (int i = 0; i < n; ++i) {
+            values[i] = roundToCurveType(_imp->type, values[i]);
+        }
+    }
+}
+
+CurveSnapshot::CurveSnapshot()
+    : _segments()
+    , _type(CurvePrivate::eCurveTypeDouble)
+    , _clamp(false)
+    , _yMin(INT_MIN)
+    , _yMax(INT_MAX)
+{
+}
+
+double
+CurveSnapshot::getValueAt(double t,
+                          bool clamp) const
+{
+    double v = _segments.getValueAt(t);
+
+    if (clamp && _clamp) {
+        v = std::max( _yMin, std::min(v, _yMax) );
+    }
+
+    return roundToCurveType( (CurvePrivate::CurveTypeEnum)_type, v );
+}
 
 double
 Curve::getDerivativeAt(double t) const
@@ -906,6 +1087,19 @@ Curve::getIntegrateFromTo(double t1,
     }
     assert(_imp->type == CurvePrivate::eCurveTypeDouble); // only real-valued curves can be derived
 
+    // the Y range is fetched once: it locks the owner knob
+    const bool clamp = mustClamp();
+    std::pair<double,double> minmax;
+    if (clamp) {
+        minmax = getCurveYRange();
+    }
+    if ( !clamp || ( (minmax.first <= -DBL_MAX) && (DBL_MAX <= minmax.second) ) ) {
+        // the curve is never clamped: integrate the cached cubics
+        const double sum = _imp->getSegments().integrate(t1, t2);
+
+        return opposite ? -sum : sum;
+    }
+
     // even when there is only one keyframe, there may be tangents!
     //if (_imp->keyFrames.size() == 1) {
     //    //if there's only 1 keyframe, don't bother interpolating
@@ -935,25 +1129,14 @@ Curve::getIntegrateFromTo(double t1,
     // while there are still keyframes after the current time, add to the total sum and advance
     while (itup != _imp->keyFrames.end() && itup->getTime() < t2) {
         // add integral from t1 to itup->getTime() to sum
-        if ( mustClamp() ) {
-            std::pair<double,double> minmax = getCurveYRange();
-            sum += Natron::integrate_clamp(tcur,vcur,
-                                           vcurDerivRight,
-                                           vnextDerivLeft,
-                                           tnext,vnext,
-                                           t1, itup->getTime(),
-                                           minmax.first, minmax.second,
-                                           interp,
-                                           interpNext);
-        } else {
-            sum += Natron::integrate(tcur,vcur,
-                                     vcurDerivRight,
-                                     vnextDerivLeft,
-                                     tnext,vnext,
-                                     t1, itup->getTime(),
-                                     interp,
-                                     interpNext);
-        }
+        sum += Natron::integrate_clamp(tcur,vcur,
+                                       vcurDerivRight,
+                                       vnextDerivLeft,
+                                       tnext,vnext,
+                                       t1, itup->getTime(),
+                                       minmax.first, minmax.second,
+                                       interp,
+                                       interpNext);
         // advance
         t1 = itup->getTime();
         ++itup;
@@ -972,25 +1155,14 @@ Curve::getIntegrateFromTo(double t1,
 
     assert( itup == _imp->keyFrames.end() || t2 <= itup->getTime() );
     // add integral from t1 to t2 to sum
-    if ( mustClamp() ) {
-        std::pair<double,double> minmax = getCurveYRange();
-        sum += Natron::integrate_clamp(tcur,vcur,
-                                       vcurDerivRight,
-                                       vnextDerivLeft,
-                                       tnext,vnext,
-                                       t1, t2,
-                                       minmax.first, minmax.second,
-                                       interp,
-                                       interpNext);
-    } else {
-        sum += Natron::integrate(tcur,vcur,
-                                 vcurDerivRight,
-                                 vnextDerivLeft,
-                                 tnext,vnext,
-                                 t1, t2,
-                                 interp,
-                                 interpNext);
-    }
+    sum += Natron::integrate_clamp(tcur,vcur,
+                                   vcurDerivRight,
+                                   vnextDerivLeft,
+                                   tnext,vnext,
+                                   t1, t2,
+                                   minmax.first, minmax.second,
+                                   interp,
+                                   interpNext);
 
     return opposite ? -sum : sum;
 } // getIntegrateFromTo
@@ -1082,6 +1254,36 @@ Curve::getKeyFrames_mt_safe() const
     return _imp->keyFrames;
 }
 
+void
+Curve::appendToHash(Hash64* hash) const
+{
+    QMutexLocker l(&_imp->_lock);
+
+    hash->append((U64)_imp->keyFrames.size());
+    for (KeyFrameSet::const_iterator it = _imp->keyFrames.begin(); it != _imp->keyFrames.end(); ++it) {
+        hash->append(it->getTime());
+        hash->append(it->getValue());
+        hash->append(it->getLeftDerivative());
+        hash->append(it->getRightDerivative());
+        hash->append((int)it->getInterpolation());
+    }
+}
+
+void
+Curve::getSnapshot(CurveSnapshot* snapshot) const
+{
+    QMutexLocker l(&_imp->_lock);
+
+    snapshot->_segments = _imp->getSegments();
+    snapshot->_type = (int)_imp->type;
+    snapshot->_clamp = mustClamp();
+    if (snapshot->_clamp) {
+        std::pair<double,double> minmax = getCurveYRange();
+        snapshot->_yMin = minmax.first;
+        snapshot->_yMax = minmax.second;
+    }
+}
+
 KeyFrameSet::iterator
 Curve::setKeyFrameValueAndTimeNoUpdate(double value,
                                        double time,
@@ -1528,5 +1730,5 @@ Curve::onCurveChanged()
     if (_imp->owner) {
         _imp->owner->clearExpressionsResults(_imp->dimensionInOwner);
     }
-    _imp->resultCache.clear();
+    _imp->segmentsValid = false;
 }
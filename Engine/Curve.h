@@ -26,6 +26,7 @@
 // ***** END PYTHON BLOCK *****
 
 #include <vector>
+#include <list>
 #include <map>
 #include <set>
 
@@ -126,9 +127,89 @@ typedef std::set<KeyFrame, KeyFrame_compare_time> KeyFrameSet;
 
 
 class KnobI;
+class Hash64;
 struct CurvePrivate;
 class RectD;
 
+/**
+ * @brief The keyframes of a Curve flattened to a sorted array of times and the coefficients of the cubic
+ * of each segment between them, so that evaluating the curve is a binary search followed by a cubic.
+ * There are keys+1 segments: the extrapolation before the first keyframe, one per interval between
+ * keyframes and the extrapolation after the last keyframe.
+ * The values are not clamped nor rounded to the type of the curve.
+ **/
+class CurveSegments
+{
+public:
+
+    CurveSegments();
+
+    /// rebuild the segments from the keyframes
+    void build(const KeyFrameSet& keyFrames);
+
+    bool isEmpty() const
+    {
+        return _times.empty();
+    }
+
+    /// the curve must not be empty
+    double getValueAt(double t) const WARN_UNUSED_RETURN;
+
+    /// same as getValueAt for n times at once. The times do not have to be sorted.
+    void getValuesAt(const double* times, double* values, int n) const;
+
+    /// integrate the curve from t1 to t2, with t1 <= t2
+    double integrate(double t1, double t2) const WARN_UNUSED_RETURN;
+
+private:
+
+    struct Segment
+    {
+        double tstart, tend; //< the cubic is evaluated at (t - tstart) / (tend - tstart)
+        double c0, c1, c2, c3;
+    };
+
+    /// the index of the segment containing t, i.e. the number of keyframes with time <= t
+    int findSegment(double t) const WARN_UNUSED_RETURN;
+
+    double evaluate(int segment, double t) const WARN_UNUSED_RETURN;
+
+    std::vector<double> _times; //< the times of the keyframes
+    std::vector<Segment> _segments; //< _times.size() + 1 segments
+};
+
+/**
+ * @brief An immutable copy of the keyframes of a Curve, with the range its values are clamped to.
+ * It can be evaluated by several threads at once without locking nor allocating.
+ * See Curve::getSnapshot()
+ **/
+class CurveSnapshot
+{
+public:
+
+    CurveSnapshot();
+
+    bool isAnimated() const
+    {
+        return !_segments.isEmpty();
+    }
+
+    /**
+     * @brief Same as Curve::getValueAt.
+     * The curve must be animated.
+     **/
+    double getValueAt(double t,bool clamp = true) const WARN_UNUSED_RETURN;
+
+private:
+
+    friend class Curve;
+
+    CurveSegments _segments;
+    int _type; //< the CurvePrivate::CurveTypeEnum of the curve
+    bool _clamp;
+    double _yMin, _yMax;
+};
+
 class Curve
 {
     enum CurveChangedReasonEnum
@@ -192,6 +273,13 @@ public:
     ///existing key at this time.
     bool addKeyFrame(KeyFrame key);
 
+    /**
+     * @brief Adds all the keys at once, replacing the keyframes already existing at the same times.
+     * Unlike calling addKeyFrame for each key, the derivatives are computed once, after all the keys are inserted.
+     * Returns the number of keyframes added, the others replaced an existing keyframe.
+     **/
+    int addKeyFrames(const std::list<KeyFrame>& keys);
+
     void removeKeyFrameWithTime(double time);
 
     void removeKeyFrameWithIndex(int index);
@@ -224,12 +312,28 @@ public:
 
     double getValueAt(double t,bool clamp = true) const WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Same as getValueAt for n times at once, the curve is locked only once.
+     * Prefer it over getValueAt to sample a curve, e.g to draw it.
+     **/
+    void getValuesAt(const double* times, double* values, int n, bool clamp = true) const;
+
     double getDerivativeAt(double t) const WARN_UNUSED_RETURN;
 
     double getIntegrateFromTo(double t1, double t2) const WARN_UNUSED_RETURN;
 
     KeyFrameSet getKeyFrames_mt_safe() const WARN_UNUSED_RETURN;
 
+    /**
+     * @brief Appends the time, value, derivatives and interpolation of each keyframe to the hash.
+     **/
+    void appendToHash(Hash64* hash) const;
+
+    /**
+     * @brief Copies the keyframes and the Y range of the curve to snapshot.
+     **/
+    void getSnapshot(CurveSnapshot* snapshot) const;
+
     void clearKeyFrames();
 
     /**
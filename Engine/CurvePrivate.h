@@ -52,7 +52,8 @@ struct CurvePrivate
     };
 
     KeyFrameSet keyFrames;
-    std::map<double,double> resultCache; //< a cache for interpolations
+    mutable CurveSegments segments; //< the keyframes flattened for the interpolations, built on demand
+    mutable bool segmentsValid; //< false if segments must be rebuilt from keyFrames
     KnobI* owner;
     int dimensionInOwner;
     bool isParametric;
@@ -65,7 +66,8 @@ struct CurvePrivate
 
     CurvePrivate()
     : keyFrames()
-    , resultCache()
+    , segments()
+    , segmentsValid(false)
     , owner(NULL)
     , dimensionInOwner(-1)
     , isParametric(false)
@@ -88,6 +90,7 @@ struct CurvePrivate
     void operator=(const CurvePrivate & other)
     {
         keyFrames = other.keyFrames;
+        segmentsValid = false;
         owner = other.owner;
         dimensionInOwner = other.dimensionInOwner;
         isParametric = other.isParametric;
@@ -98,6 +101,17 @@ struct CurvePrivate
         yMax = other.yMax;
         hasYRange = other.hasYRange;
     }
+
+    /// must be called with _lock held
+    const CurveSegments& getSegments() const
+    {
+        if (!segmentsValid) {
+            segments.build(keyFrames);
+            segmentsValid = true;
+        }
+
+        return segments;
+    }
     
 };
 
@@ -207,6 +207,13 @@ EffectInstance::setParallelRenderArgsTLS(int time,
     args.tilesSupported = getNode()->getCurrentSupportTiles();
     args.viewerProgressReportEnabled = viewerProgressReportEnabled;
     args.stats = stats;
+    ///The main thread reads the knobs with the gui values, it never uses the copy.
+    ///The analysis (e.g: the tracker in the instance changed action) sets values and reads them back while it runs.
+    if ( !isAnalysis && ( QThread::currentThread() != qApp->thread() ) ) {
+        args.knobsSnapshot = getKnobsSnapshot();
+    } else {
+        args.knobsSnapshot.reset();
+    }
     ++args.validArgs;
 }
 
@@ -249,8 +256,9 @@ EffectInstance::invalidateParallelRenderArgsTLS()
     if ( _imp->frameRenderArgs.hasLocalData() ) {
         ParallelRenderArgs & args = _imp->frameRenderArgs.localData();
         --args.validArgs;
-        if (args.validArgs < 0) {
+        if (args.validArgs <= 0) {
             args.validArgs = 0;
+            args.knobsSnapshot.reset();
         }
 
         for (NodeList::iterator it = args.rotoPaintNodes.begin(); it != args.rotoPaintNodes.end(); ++it) {
@@ -272,6 +280,50 @@ EffectInstance::getParallelRenderArgsTLS() const
     }
 }
 
+boost::shared_ptr<const KnobsSnapshotMap>
+EffectInstance::getKnobsSnapshot()
+{
+    U64 age;
+    {
+        QMutexLocker k(&_imp->knobsSnapshotMutex);
+        if (_imp->knobsSnapshot) {
+            return _imp->knobsSnapshot;
+        }
+        age = _imp->knobsSnapshotAge;
+    }
+    
+    boost::shared_ptr<KnobsSnapshotMap> snapshot(new KnobsSnapshotMap);
+    const std::vector<boost::shared_ptr<KnobI> > & knobs = getKnobs();
+    for (std::vector<boost::shared_ptr<KnobI> >::const_iterator it = knobs.begin(); it != knobs.end(); ++it) {
+        boost::shared_ptr<KnobSnapshotI> knobSnapshot = (*it)->createSnapshot();
+        if (knobSnapshot) {
+            snapshot->insert( std::make_pair(it->get(), knobSnapshot) );
+        }
+    }
+    
+    QMutexLocker k(&_imp->knobsSnapshotMutex);
+    if (_imp->knobsSnapshotAge == age) {
+        _imp->knobsSnapshot = snapshot;
+    }
+    
+    return snapshot;
+}
+
+const KnobSnapshotI*
+EffectInstance::getKnobSnapshot(const KnobI* knob) const
+{
+    if ( !_imp->frameRenderArgs.hasLocalData() ) {
+        return 0;
+    }
+    const ParallelRenderArgs & args = _imp->frameRenderArgs.localData();
+    if (!args.validArgs || !args.knobsSnapshot) {
+        return 0;
+    }
+    KnobsSnapshotMap::const_iterator found = args.knobsSnapshot->find(knob);
+    
+    return found != args.knobsSnapshot->end() ? found->second.get() : 0;
+}
+
 bool
 EffectInstance::isCurrentRenderInAnalysis() const
 {
@@ -1272,15 +1324,17 @@ EffectInstance::getImageFromCacheAndConvertIfNeeded(bool useCache,
             }
 
             bool convertible = imgComps.isConvertibleTo(components);
+            ///Half float images are only cached in place of floating point images, see Project::isNodeCacheHalfFloatEnabled()
+            bool deepEnough = ( getSizeOfForBitDepth(imgDepth) >= getSizeOfForBitDepth(bitdepth) ) ||
+                              ( (imgDepth == eImageBitDepthHalf) && (bitdepth == eImageBitDepthFloat) );
             if ( (imgMMlevel == mipMapLevel) && convertible &&
-                 ( getSizeOfForBitDepth(imgDepth) >= getSizeOfForBitDepth(bitdepth) ) /* && imgComps == components && imgDepth == bitdepth*/ ) {
+                 deepEnough /* && imgComps == components && imgDepth == bitdepth*/ ) {
                 ///We found  a matching image
 
                 *image = *it;
                 break;
             } else {
-                if ( (imgMMlevel >= mipMapLevel) || !convertible ||
-                     ( getSizeOfForBitDepth(imgDepth) < getSizeOfForBitDepth(bitdepth) ) ) {
+                if ( (imgMMlevel >= mipMapLevel) || !convertible || !deepEnough ) {
                     ///Either smaller resolution or not enough components or bit-depth is not as deep, don't use the image
                     continue;
                 }
@@ -1345,11 +1399,43 @@ EffectInstance::getImageFromCacheAndConvertIfNeeded(bool useCache,
                     return;
                 }
 
-                if (imgToConvertBounds.area() > 1) {
+                bool copyBitMap = useCache && imageToConvert->usesBitMap();
+                unsigned int downscaleLevels = mipMapLevel - imageToConvert->getMipMapLevel();
+                if ( (imgToConvertBounds.area() > 1) && copyBitMap && (downscaleLevels > 1) ) {
+                    ///Cache the intermediate levels as well: they are computed anyway and switching to another
+                    ///proxy level will then not have to downscale the full image again
+                    std::vector<ImagePtr> levels;
+                    RectI levelBounds = imgToConvertBounds;
+                    for (unsigned int i = 1; i < downscaleLevels; ++i) {
+                        levelBounds = levelBounds.downscalePowerOfTwoSmallestEnclosing(1);
+                        boost::shared_ptr<ImageParams> levelParams = Image::makeParams( oldParams->getCost(),
+                                                                                        rod,
+                                                                                        levelBounds,
+                                                                                        oldParams->getPixelAspectRatio(),
+                                                                                        imageToConvert->getMipMapLevel() + i,
+                                                                                        oldParams->isRodProjectFormat(),
+                                                                                        oldParams->getComponents(),
+                                                                                        oldParams->getBitDepth(),
+                                                                                        oldParams->getFramesNeeded() );
+                        ImagePtr levelImg;
+                        getOrCreateFromCacheInternal(key, levelParams, useCache, useDiskCache, &levelImg);
+                        if (!levelImg) {
+                            return;
+                        }
+                        levels.push_back(levelImg);
+                    }
+                    levels.push_back(img);
+
+                    std::vector<Natron::Image*> levelsPtr;
+                    for (std::vector<ImagePtr>::iterator it = levels.begin(); it != levels.end(); ++it) {
+                        levelsPtr.push_back( it->get() );
+                    }
+                    imageToConvert->buildMipMapPyramid(rod, imgToConvertBounds, levelsPtr, copyBitMap);
+                } else if (imgToConvertBounds.area() > 1) {
                     imageToConvert->downscaleMipMap( rod,
                                                      imgToConvertBounds,
                                                      imageToConvert->getMipMapLevel(), img->getMipMapLevel(),
-                                                     useCache && imageToConvert->usesBitMap(),
+                                                     copyBitMap,
                                                      img.get() );
                 } else {
                     img->pasteFrom(*imageToConvert, imgToConvertBounds);
@@ -1984,11 +2070,8 @@ EffectInstance::renderHandler(RenderArgs & args,
                               Natron::ImagePremultiplicationEnum originalImagePremultiplication,
                               ImagePlanesToRender & planes)
 {
-    boost::shared_ptr<TimeLapse> timeRecorder;
-
-    if (frameArgs.stats) {
-        timeRecorder.reset( new TimeLapse() );
-    }
+    ///The render time is always measured: besides the stats it is the cost used by cost-aware cache eviction policies
+    boost::shared_ptr<TimeLapse> timeRecorder( new TimeLapse() );
 
     const PlaneToRender & firstPlane = planes.planes.begin()->second;
     const double time = args._time;
@@ -2351,8 +2434,14 @@ EffectInstance::renderHandler(RenderArgs & args,
             } // if (renderFullScaleThenDownscale) {
         } // if (it->second.isAllocatedOnTheFly) {
 
+        double renderTime = timeRecorder->getTimeSinceCreation();
+        it->second.renderMappedImage->addRenderCost(renderTime);
+        if ( !it->second.isAllocatedOnTheFly && (it->second.downscaleImage != it->second.renderMappedImage) ) {
+            it->second.downscaleImage->addRenderCost(renderTime);
+        }
+
         if ( frameArgs.stats && frameArgs.stats->isInDepthProfilingEnabled() ) {
-            frameArgs.stats->addRenderInfosForNode( getNode(),  NodePtr(), it->first.getComponentsGlobalName(), renderMappedRectToRender, timeRecorder->getTimeSinceCreation() );
+            frameArgs.stats->addRenderInfosForNode( getNode(),  NodePtr(), it->first.getComponentsGlobalName(), renderMappedRectToRender, renderTime );
         }
     } // for (std::map<ImageComponents,PlaneToRender>::const_iterator it = outputPlanes.begin(); it != outputPlanes.end(); ++it) {
 
@@ -2693,9 +2782,21 @@ EffectInstance::onKnobSlaved(KnobI* slave,
                              int dimension,
                              bool isSlave)
 {
+    ///The slaved knobs are not copied
+    onKnobRenderValueChanged(slave);
     getNode()->onKnobSlaved(slave, master, dimension, isSlave);
 }
 
+void
+EffectInstance::onKnobRenderValueChanged(KnobI* /*knob*/)
+{
+    ///The renders started after the change must not read the previous copy of the knobs
+    QMutexLocker k(&_imp->knobsSnapshotMutex);
+
+    _imp->knobsSnapshot.reset();
+    ++_imp->knobsSnapshotAge;
+}
+
 void
 EffectInstance::setCurrentViewportForOverlays_public(OverlaySupport* viewport)
 {
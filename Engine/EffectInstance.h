@@ -599,6 +599,11 @@ public:
 
     const ParallelRenderArgs* getParallelRenderArgsTLS() const;
 
+    /**
+     * @brief Returns the copy of the knobs for the renders, taking a new one if a knob changed since the last call.
+     **/
+    boost::shared_ptr<const KnobsSnapshotMap> getKnobsSnapshot();
+
     //Implem in ParallelRenderArgs.cpp
     static Natron::StatusEnum getInputsRoIsFunctor(bool useTransforms,
                                                    double time,
@@ -716,6 +721,7 @@ public:
     virtual void abortAnyEvaluation() OVERRIDE FINAL;
     virtual double getCurrentTime() const OVERRIDE WARN_UNUSED_RETURN;
     virtual int getCurrentView() const OVERRIDE WARN_UNUSED_RETURN;
+    virtual const KnobSnapshotI* getKnobSnapshot(const KnobI* knob) const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual bool getCanTransform() const
     {
         return false;
@@ -1735,6 +1741,7 @@ private:
     virtual void onKnobSlaved(KnobI* slave, KnobI* master,
                               int dimension,
                               bool isSlave) OVERRIDE FINAL;
+    virtual void onKnobRenderValueChanged(KnobI* knob) OVERRIDE FINAL;
     enum RenderingFunctorRetEnum
     {
         eRenderingFunctorRetFailed, //< must stop rendering
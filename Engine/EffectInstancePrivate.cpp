@@ -339,6 +339,9 @@ EffectInstance::Implementation::Implementation(EffectInstance* publicInterface)
     , pluginMemoryChunks()
     , supportsRenderScale(eSupportsMaybe)
     , actionsCache(appPTR->getHardwareIdealThreadCount() * 2)
+    , knobsSnapshotMutex()
+    , knobsSnapshot()
+    , knobsSnapshotAge(0)
 #if NATRON_ENABLE_TRIMAP
     , imagesBeingRenderedMutex()
     , imagesBeingRendered()
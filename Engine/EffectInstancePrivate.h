@@ -199,6 +199,11 @@ struct EffectInstance::Implementation
     /// Mt-Safe actions cache
     ActionsCache actionsCache;
 
+    ///The last copy of the knobs taken for the renders, shared until a knob changes
+    mutable QMutex knobsSnapshotMutex; //< protects knobsSnapshot & knobsSnapshotAge
+    boost::shared_ptr<const KnobsSnapshotMap> knobsSnapshot;
+    U64 knobsSnapshotAge; //< incremented each time a knob changes, so that a copy taken meanwhile is not kept
+
 #if NATRON_ENABLE_TRIMAP
     ///Store all images being rendered to avoid 2 threads rendering the same portion of an image
     struct ImageBeingRendered
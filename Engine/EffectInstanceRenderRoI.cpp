@@ -63,6 +63,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/OutputSchedulerThread.h"
 #include "Engine/PluginMemory.h"
 #include "Engine/Project.h"
+#include "Engine/RenderScheduler.h"
 #include "Engine/RenderStats.h"
 #include "Engine/RotoContext.h"
 #include "Engine/RotoDrawableItem.h"
@@ -709,6 +710,17 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
     getPreferredDepthAndComponents(-1, &outputClipPrefComps, &outputDepth);
     assert( !outputClipPrefComps.empty() );
 
+    /*
+     * The bitdepth of the images cached for this node: floating point images may be stored in half float to save memory.
+     * The plug-in still renders in outputDepth onto a temporary image which is then converted to the cached image.
+     * Images painted over themselves are rendered directly in the cached image and must keep the plug-in depth.
+     */
+    Natron::ImageBitDepthEnum cacheDepth = outputDepth;
+    if ( (outputDepth == eImageBitDepthFloat) && (args.bitdepth == eImageBitDepthFloat) && !useDiskCacheNode &&
+         !isPaintingOverItselfEnabled() && getApp()->getProject()->isNodeCacheHalfFloatEnabled() ) {
+        cacheDepth = eImageBitDepthHalf;
+    }
+
 
     ImagePlanesToRender planesToRender;
     FramesNeededMap framesNeeded;
@@ -749,7 +761,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
                                                     renderFullScaleThenDownscale ? &upscaledImageBounds : &downscaledImageBounds,
                                                     &rod,
                                                     args.bitdepth, *it,
-                                                    outputDepth,
+                                                    cacheDepth,
                                                     *components,
                                                     args.inputImagesList,
                                                     frameRenderArgs.stats,
@@ -1151,7 +1163,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
                                                 renderFullScaleThenDownscale ? &upscaledImageBounds : &downscaledImageBounds,
                                                 &rod,
                                                 args.bitdepth, it->first,
-                                                outputDepth, *components,
+                                                cacheDepth, *components,
                                                 args.inputImagesList, frameRenderArgs.stats, &it->second.fullscaleImage);
 
             ///We must retrieve from the cache exactly the originally retrieved image, otherwise we might have to call  renderInputImagesForRoI
@@ -1262,7 +1274,7 @@ EffectInstance::renderRoI(const RenderRoIArgs & args,
 
             if (!it->second.fullscaleImage) {
                 ///The image is not cached
-                allocateImagePlane(key, rod, downscaledImageBounds, upscaledImageBounds, isProjectFormat, framesNeeded, *components, args.bitdepth, par, args.mipMapLevel, renderFullScaleThenDownscale, useDiskCacheNode, createInCache, &it->second.fullscaleImage, &it->second.downscaleImage);
+                allocateImagePlane(key, rod, downscaledImageBounds, upscaledImageBounds, isProjectFormat, framesNeeded, *components, cacheDepth, par, args.mipMapLevel, renderFullScaleThenDownscale, useDiskCacheNode, createInCache, &it->second.fullscaleImage, &it->second.downscaleImage);
             } else {
                 /*
                  * There might be a situation  where the RoD of the cached image
@@ -1635,7 +1647,6 @@ EffectInstance::renderRoIInternal(double time,
         ///Also check that the number of threads indicating by the settings are appropriate for this render mode.
         if ( !frameArgs.tilesSupported || (nbThreads == -1) || (nbThreads == 1) ||
             ( (nbThreads == 0) && (appPTR->getHardwareIdealThreadCount() == 1) ) ||
-            ( QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount() ) ||
             isRotoPaintNode() ) {
             safety = eRenderSafetyFullySafe;
         }
@@ -1721,14 +1732,23 @@ EffectInstance::renderRoIInternal(double time,
 #else
 
 
-            QFuture<RenderingFunctorRetEnum> ret = QtConcurrent::mapped( planesToRender.rectsToRender,
-                                                                        boost::bind(&EffectInstance::tiledRenderingFunctor,
-                                                                                    this,
-                                                                                    tiledArgs,
-                                                                                    _1,
-                                                                                    currentThread) );
-            ret.waitForFinished();
-            QFuture<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
+            ///The tiles are rendered by the render scheduler: the tiles that its threads did not start are rendered
+            ///by this thread, so this never waits behind other renders
+            std::vector<EffectInstance::RenderingFunctorRetEnum> ret;
+            RenderTaskTimings timings;
+            mapInRenderScheduler(planesToRender.rectsToRender.begin(),
+                                 planesToRender.rectsToRender.end(),
+                                 boost::bind(&EffectInstance::tiledRenderingFunctor,
+                                             this,
+                                             tiledArgs,
+                                             _1,
+                                             currentThread),
+                                 &ret,
+                                 &timings);
+            if ( frameArgs.stats && frameArgs.stats->isInDepthProfilingEnabled() ) {
+                frameArgs.stats->addTasksInfosForNode(getNode(), timings);
+            }
+            std::vector<EffectInstance::RenderingFunctorRetEnum>::const_iterator it2;
 
 #endif
             for (it2 = ret.begin(); it2 != ret.end(); ++it2) {
@@ -86,6 +86,8 @@ SOURCES += \
     Bezier.cpp \
     BezierCP.cpp \
     BlockingBackgroundRender.cpp \
+    CacheCompression.cpp \
+    CachePackAllocator.cpp \
     CLArgs.cpp \
     CoonsRegularization.cpp \
     Curve.cpp \
@@ -106,12 +108,15 @@ SOURCES += \
     Hash64.cpp \
     HistogramCPU.cpp \
     Image.cpp \
+    ImageBufferPool.cpp \
     ImageConvert.cpp \
     ImageCopyChannels.cpp \
     ImageComponents.cpp \
     ImageKey.cpp \
+    ImageKernels.cpp \
     ImageMaskMix.cpp \
     ImageParamsSerialization.cpp \
+    ImageStatistics.cpp \
     Interpolation.cpp \
     Knob.cpp \
     KnobSerialization.cpp \
@@ -151,7 +156,9 @@ SOURCES += \
     PySideCompat.cpp \
     RectD.cpp \
     RectI.cpp \
+    RenderScheduler.cpp \
     RenderStats.cpp \
+    RenderThreadsController.cpp \
     RotoContext.cpp \
     RotoDrawableItem.cpp \
     RotoItem.cpp \
@@ -226,6 +233,8 @@ HEADERS += \
     Cache.h \
     CacheEntry.h \
     CacheEntryHolder.h \
+    CacheCompression.h \
+    CachePackAllocator.h \
     CacheSerialization.h \
     CoonsRegularization.h \
     Curve.h \
@@ -250,16 +259,20 @@ HEADERS += \
     GlobalFunctionsWrapper.h \
     GroupInput.h \
     GroupOutput.h \
+    Half.h \
     Hash64.h \
     HistogramCPU.h \
     ImageInfo.h \
     Image.h \
+    ImageBufferPool.h \
     ImageComponents.h \
     ImageKey.h \
+    ImageKernels.h \
     ImageLocker.h \
     ImageSerialization.h \
     ImageParams.h \
     ImageParamsSerialization.h \
+    ImageStatistics.h \
     Interpolation.h \
     KeyHelper.h \
     Knob.h \
@@ -298,6 +311,7 @@ HEADERS += \
     OutputSchedulerThread.h \
     OverlaySupport.h \
     ParameterWrapper.h \
+    ParallelReduce.h \
     ParallelRenderArgs.h \
     Plugin.h \
     PluginMemory.h \
@@ -310,7 +324,9 @@ HEADERS += \
     RectDSerialization.h \
     RectI.h \
     RectISerialization.h \
+    RenderScheduler.h \
     RenderStats.h \
+    RenderThreadsController.h \
     RotoContext.h \
     RotoContextPrivate.h \
     RotoContextSerialization.h \
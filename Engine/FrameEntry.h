@@ -54,9 +54,8 @@ public:
     FrameEntry(const FrameKey & key,
                const boost::shared_ptr<FrameParams> &  params,
                const Natron::CacheAPI* cache,
-               Natron::StorageModeEnum storage,
-               const std::string & path)
-        : CacheEntryHelper<U8,FrameKey,FrameParams>(key,params,cache,storage,path)
+               Natron::StorageModeEnum storage)
+        : CacheEntryHelper<U8,FrameKey,FrameParams>(key,params,cache,storage)
         , _aborted(false)
         , _abortedMutex()
     {
@@ -84,6 +83,12 @@ public:
 
     const U8* pixelAt(int x, int y ) const WARN_UNUSED_RETURN;
 
+    virtual std::size_t getCompressionElementSize() const OVERRIDE FINAL
+    {
+        ///Textures are RGBA, either 8-bit or 32-bit floating point
+        return _key.getBitDepth() == (int)Natron::eImageBitDepthFloat ? 4 * sizeof(float) : 4;
+    }
+
     void copy(const FrameEntry& other);
 
     void setAborted(bool aborted) {
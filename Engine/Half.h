@@ -0,0 +1,197 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_HALF_H
+#define NATRON_ENGINE_HALF_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstddef>
+#include <cstring> // memcpy
+
+#include "Global/GlobalDefines.h"
+
+namespace Natron {
+
+/**
+ * @brief A 16-bit IEEE 754 floating point number (1 sign bit, 5 exponent bits, 10 mantissa bits), the pixel type
+ * of eImageBitDepthHalf images. It has the same memory layout as the OpenEXR and OpenFX half type.
+ * Half converts implicitly from and to float so that the image processing templates can use it like any other pixel
+ * type: all the arithmetic is done in float and the result is rounded to the nearest half when stored.
+ * Note that since both conversions are implicit, a conditional expression mixing a Half and a number is ambiguous:
+ * convert one of the operands explicitly, e.g: cond ? pix : PIX(0).
+ **/
+class Half
+{
+public:
+
+    Half()
+    {
+    }
+
+    Half(float f)
+        : _bits( fromFloat(f) )
+    {
+    }
+
+    operator float() const
+    {
+        return toFloat(_bits);
+    }
+
+    Half& operator+=(float f)
+    {
+        _bits = fromFloat(toFloat(_bits) + f);
+
+        return *this;
+    }
+
+    Half& operator-=(float f)
+    {
+        _bits = fromFloat(toFloat(_bits) - f);
+
+        return *this;
+    }
+
+    Half& operator*=(float f)
+    {
+        _bits = fromFloat(toFloat(_bits) * f);
+
+        return *this;
+    }
+
+    Half& operator/=(float f)
+    {
+        _bits = fromFloat(toFloat(_bits) / f);
+
+        return *this;
+    }
+
+    U16 bits() const
+    {
+        return _bits;
+    }
+
+    static Half fromBits(U16 bits)
+    {
+        Half ret;
+
+        ret._bits = bits;
+
+        return ret;
+    }
+
+    /**
+     * @brief Returns the float equal to the half whose bits are given. Infinities and NaNs are preserved,
+     * denormals are converted exactly.
+     **/
+    static float toFloat(U16 h)
+    {
+        const U32 shiftedExponent = 0x7c00 << 13;
+        U32 o = (U32)(h & 0x7fff) << 13; // exponent/mantissa bits
+        U32 exponent = shiftedExponent & o;
+
+        o += (127 - 15) << 23; // exponent adjust
+        if (exponent == shiftedExponent) {
+            // Inf/NaN
+            o += (128 - 16) << 23;
+        } else if (exponent == 0) {
+            // Zero/Denormal: renormalize
+            o += 1 << 23;
+            o = floatToBits(bitsToFloat(o) - bitsToFloat(113 << 23));
+        }
+        o |= (U32)(h & 0x8000) << 16; // sign bit
+
+        return bitsToFloat(o);
+    }
+
+    /**
+     * @brief Returns the bits of the half nearest to f, ties going to the half with an even mantissa like the
+     * IEEE 754 default rounding. Values beyond the half range become infinities, NaNs stay NaNs and values too
+     * small for a half denormal become 0.
+     **/
+    static U16 fromFloat(float f)
+    {
+        const U32 f32infty = 255 << 23;
+        const U32 f16max = (127 + 16) << 23; // the floats from which the result is an infinity
+        const U32 minNormal = (127 - 14) << 23; // the smallest float giving a normalized half
+        const U32 denormMagic = ( (127 - 15) + (23 - 10) + 1 ) << 23;
+        U32 u = floatToBits(f);
+        U32 sign = u & 0x80000000u;
+        U16 o;
+
+        u ^= sign;
+        if (u >= f16max) {
+            // NaN->qNaN and Inf->Inf, overflows become infinities
+            o = (u > f32infty) ? 0x7e00 : 0x7c00;
+        } else if (u < minNormal) {
+            // Zero/Denormal: adding the magic number aligns the 10 bits of the mantissa at the bottom of the float,
+            // the float addition does the rounding to nearest even
+            o = (U16)( floatToBits( bitsToFloat(u) + bitsToFloat(denormMagic) ) - denormMagic );
+        } else {
+            // Rebias the exponent and round the mantissa, adding 1 to the rounding bias when the result is odd so
+            // that ties go to the even mantissa. A carry out of the mantissa correctly increments the exponent
+            U32 mantissaOdd = (u >> 13) & 1;
+            u -= (127 - 15) << 23;
+            u += 0xfff + mantissaOdd;
+            o = (U16)(u >> 13);
+        }
+
+        return (U16)(o | (sign >> 16));
+    }
+
+private:
+
+    static U32 floatToBits(float f)
+    {
+        U32 u;
+
+        memcpy( &u, &f, sizeof(float) );
+
+        return u;
+    }
+
+    static float bitsToFloat(U32 u)
+    {
+        float f;
+
+        memcpy( &f, &u, sizeof(float) );
+
+        return f;
+    }
+
+    U16 _bits;
+};
+
+/**
+ * @brief Converts count halfs to floats. Implemented in ImageKernels.cpp with SIMD instructions when available.
+ **/
+void convertHalfToFloat(const Half* src, float* dst, std::size_t count);
+
+/**
+ * @brief Converts count floats to halfs. The results are bit-identical to Half(float), whatever the instruction set.
+ **/
+void convertFloatToHalf(const float* src, Half* dst, std::size_t count);
+
+} // namespace Natron
+
+#endif // NATRON_ENGINE_HALF_H
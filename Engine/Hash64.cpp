@@ -24,16 +24,16 @@
 
 #include "Hash64.h"
 
-#include <algorithm>  // for std::for_each
-#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
-#include <boost/crc.hpp>
-#endif
 #include <QtCore/QString>
 
 #include "Engine/Node.h"
 
 using namespace Natron;
 
+/*
+ * The values are hashed a whole word at a time with the mixing function of MurmurHash64A
+ * (public domain, Austin Appleby), which is much cheaper than a byte-wise CRC.
+ */
 void
 Hash64::computeHash()
 {
@@ -41,10 +41,23 @@ Hash64::computeHash()
         return;
     }
 
-    const unsigned char* data = reinterpret_cast<const unsigned char*>( &node_values.front() );
-    boost::crc_optimal<64,0x42F0E1EBA9EA3693ULL,0,0,false,false> crc_64;
-    crc_64 = std::for_each( data, data + node_values.size() * sizeof(node_values[0]), crc_64 );
-    hash = crc_64();
+    const U64 m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    U64 h = 0x9e3779b97f4a7c15ULL ^ ( (U64)node_values.size() * sizeof(node_values[0]) * m );
+
+    for (std::vector<U64>::const_iterator it = node_values.begin(); it != node_values.end(); ++it) {
+        U64 k = *it;
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    hash = h;
 }
 
 void
@@ -58,8 +71,21 @@ void
 Hash64_appendQString(Hash64* hash,
                      const QString & str)
 {
-    for (int i = 0; i < str.size(); ++i) {
-        hash->append<unsigned short>( str.at(i).unicode() );
+    ///Pack 4 UTF-16 characters per word
+    const ushort* data = str.utf16();
+    int size = str.size();
+    int i = 0;
+    for (; i + 4 <= size; i += 4) {
+        hash->append<U64>( (U64)data[i] | ( (U64)data[i + 1] << 16 ) | ( (U64)data[i + 2] << 32 ) | ( (U64)data[i + 3] << 48 ) );
+    }
+    if (i < size) {
+        U64 last = 0;
+        for (int j = 0; i + j < size; ++j) {
+            last |= (U64)data[i + j] << (16 * j);
+        }
+        hash->append<U64>(last);
     }
+    ///Append the size so that strings ending with null characters do not collide
+    hash->append<int>(size);
 }
 
@@ -25,10 +25,28 @@
 #include "HistogramCPU.h"
 
 #include <algorithm>
+
+#ifndef Q_MOC_RUN
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <boost/bind.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#endif
+
 #include <QMutex>
 #include <QWaitCondition>
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QThread>
+CLANG_DIAG_ON(deprecated)
 
 #include "Engine/Image.h"
+#include "Engine/ImageKernels.h"
+#include "Engine/RenderScheduler.h"
+
+///The histograms are computed with upscale more bins, then smoothed and downsampled
+#define NATRON_HISTOGRAM_UPSCALE 5
+
+///Maximum size in bytes of the copy of the counted pixels kept to update the counts incrementally
+#define NATRON_HISTOGRAM_MAX_COPY_SIZE 33554432
 
 
 struct HistogramRequest
@@ -40,6 +58,7 @@ struct HistogramRequest
     double vmin;
     double vmax;
     int smoothingKernelSize;
+    RectI updatedRect; //< null if the whole image changed
 
     HistogramRequest()
         : binsCount(0)
@@ -49,6 +68,7 @@ struct HistogramRequest
           , vmin(0)
           , vmax(0)
           , smoothingKernelSize(0)
+          , updatedRect()
     {
     }
 
@@ -58,7 +78,8 @@ struct HistogramRequest
                      const RectI & rect,
                      double vmin,
                      double vmax,
-                     int smoothingKernelSize)
+                     int smoothingKernelSize,
+                     const RectI & updatedRect)
         : binsCount(binsCount)
           , mode(mode)
           , image(image)
@@ -66,10 +87,54 @@ struct HistogramRequest
           , vmin(vmin)
           , vmax(vmax)
           , smoothingKernelSize(smoothingKernelSize)
+          , updatedRect(updatedRect)
+    {
+    }
+};
+
+///What is computed for a request
+struct ScopesParams
+{
+    RectI rect;
+    int binsCount; //< the bins count of the upscaled histograms
+    float vmin;
+    float scale; //< the bin of a value v is (v - vmin) * scale, 0 if there's no valid range
+    int waveformColumns; //< 0 if the waveform is not computed
+    bool vectorscope;
+
+    ScopesParams()
+        : rect()
+          , binsCount(0)
+          , vmin(0)
+          , scale(0)
+          , waveformColumns(0)
+          , vectorscope(false)
+    {
+    }
+
+    bool operator==(const ScopesParams & other) const
     {
+        return rect == other.rect && binsCount == other.binsCount && vmin == other.vmin && scale == other.scale &&
+               waveformColumns == other.waveformColumns && vectorscope == other.vectorscope;
     }
 };
 
+///The raw counts of the pixels of an image. They are signed so that the counts of a portion of an image
+///can be removed from them.
+struct ScopesCounts
+{
+    std::vector<int> histograms[5]; //< R,G,B,A,Y
+    std::vector<int> waveforms[3]; //< R,G,B, empty if the waveform is not computed
+    std::vector<int> vectorscope; //< empty if the vectorscope is not computed
+};
+
+///A portion of the image computed by a thread
+struct ScopesJob
+{
+    RectI rect;
+    ScopesCounts counts;
+};
+
 struct FinishedHistogram
 {
     std::vector<float> histogram1;
@@ -106,6 +171,13 @@ struct HistogramCPUPrivate
     QMutex mustQuitMutex;
     bool mustQuit;
 
+    ///The counts, the parameters and the hash of the image they were computed from, and if it is small enough
+    ///a copy of the counted pixels. Only accessed by the histogram thread.
+    boost::shared_ptr<Natron::Image> countedImage;
+    ScopesParams countedParams;
+    U64 countedHash;
+    ScopesCounts counts;
+
     HistogramCPUPrivate()
         : requestCond()
           , requestMutex()
@@ -115,7 +187,37 @@ struct HistogramCPUPrivate
           , mustQuitCond()
           , mustQuitMutex()
           , mustQuit(false)
+          , countedImage()
+          , countedParams()
+          , countedHash(0)
+          , counts()
+    {
+    }
+
+    /**
+     * @brief Keeps a copy of the pixels of rect, so that the next request updating only a portion of the image can
+     * remove the pixels previously counted there. No copy is kept if it would exceed NATRON_HISTOGRAM_MAX_COPY_SIZE,
+     * the next requests then count the whole image again. The buffer is reused while the rect does not change.
+     **/
+    void copyCountedPixels(const Natron::Image & image,
+                           const RectI & rect)
     {
+        std::size_t copySize = (std::size_t)rect.area() * image.getComponentsCount() * sizeof(float);
+
+        if ( rect.isNull() || (copySize > NATRON_HISTOGRAM_MAX_COPY_SIZE) ) {
+            countedImage.reset();
+
+            return;
+        }
+        if ( !countedImage || (countedImage->getBounds() != rect) || (countedImage->getComponents() != image.getComponents()) ||
+             (countedImage->getMipMapLevel() != image.getMipMapLevel()) ) {
+            ///Free the previous copy before allocating the new one
+            countedImage.reset();
+            countedImage.reset( new Natron::Image(image.getComponents(), image.getRoD(), rect,
+                                                  image.getMipMapLevel(), image.getPixelAspectRatio(),
+                                                  image.getBitDepth(), false) );
+        }
+        countedImage->pasteFrom(image, rect, false);
     }
 };
 
@@ -137,13 +239,14 @@ HistogramCPU::computeHistogram(int mode,      //< corresponds to the enum Histog
                                int binsCount,
                                double vmin,
                                double vmax,
-                               int smoothingKernelSize)
+                               int smoothingKernelSize,
+                               const RectI & updatedRect)
 {
     /*Starting or waking-up the thread*/
     QMutexLocker quitLocker(&_imp->mustQuitMutex);
     QMutexLocker locker(&_imp->requestMutex);
 
-    _imp->requests.push_back( HistogramRequest(binsCount,mode,image,rect,vmin,vmax,smoothingKernelSize) );
+    _imp->requests.push_back( HistogramRequest(binsCount,mode,image,rect,vmin,vmax,smoothingKernelSize,updatedRect) );
     if (!isRunning() && !_imp->mustQuit) {
         quitLocker.unlock();
         start(HighestPriority);
@@ -162,7 +265,7 @@ HistogramCPU::quitAnyComputation()
 
         ///post a fake request to wakeup the thread
         l.unlock();
-        computeHistogram(0, boost::shared_ptr<Natron::Image>(), RectI(), 0,0,0,0);
+        computeHistogram(0, boost::shared_ptr<Natron::Image>(), RectI(), 0,0,0,0, RectI());
         l.relock();
         while (_imp->mustQuit) {
             _imp->mustQuitCond.wait(&_imp->mustQuitMutex);
@@ -212,74 +315,206 @@ HistogramCPU::getMostRecentlyProducedHistogram(std::vector<float>* histogram1,
     return true;
 }
 
-///putting these in an anonymous namespace will yield this error on gcc 4.2:
-///"function has not external linkage"
-struct pix_red
+///Same as histogramBinsKernel for one pixel
+static void
+histogramBins(const float* rgba,
+              const ScopesParams & p,
+              int* bins)
 {
-    static float val(const float *pix)
-    {
-        return pix[0];
+    float lum = 0.299f * rgba[0] + 0.587f * rgba[1] + 0.114f * rgba[2];
+
+    for (int c = 0; c < 5; ++c) {
+        float t = ( (c < 4 ? rgba[c] : lum) - p.vmin ) * p.scale;
+        bins[c] = (t >= 0.f && t < (float)p.binsCount) ? (int)t : -1;
     }
-};
+}
 
-struct pix_green
+///Returns the level of a value of [0,1] in the waveform and the vectorscope, or -1 if it is out of range
+static int
+scopeLevel(float v)
 {
-    static float val(const float *pix)
-    {
-        return pix[1];
+    float t = v * NATRON_SCOPE_RESOLUTION;
+
+    if ( !(t >= 0.f && t <= NATRON_SCOPE_RESOLUTION) ) {
+        return -1;
     }
-};
 
-struct pix_blue
+    return std::min( (int)t, NATRON_SCOPE_RESOLUTION - 1 );
+}
+
+///Reads a pixel of nComps components as RGBA
+static const float*
+pixelToRGBA(const float* pix,
+            int nComps,
+            float* rgba)
 {
-    static float val(const float *pix)
-    {
-        return pix[2];
+    switch (nComps) {
+    case 4:
+
+        return pix;
+    case 3:
+        rgba[0] = pix[0]; rgba[1] = pix[1]; rgba[2] = pix[2]; rgba[3] = 1.f;
+        break;
+    case 2:
+        rgba[0] = pix[0]; rgba[1] = pix[1]; rgba[2] = 0.f; rgba[3] = 1.f;
+        break;
+    default:
+        rgba[0] = rgba[1] = rgba[2] = 0.f; rgba[3] = pix[0];
+        break;
     }
-};
 
-struct pix_alpha
+    return rgba;
+}
+
+static void
+initCounts(const ScopesParams & p,
+           ScopesCounts* counts)
+{
+    for (int c = 0; c < 5; ++c) {
+        counts->histograms[c].assign(p.binsCount, 0);
+    }
+    for (int c = 0; c < 3; ++c) {
+        counts->waveforms[c].assign(p.waveformColumns * NATRON_SCOPE_RESOLUTION, 0);
+    }
+    counts->vectorscope.assign(p.vectorscope ? NATRON_SCOPE_RESOLUTION * NATRON_SCOPE_RESOLUTION : 0, 0);
+}
+
+///Adds the pixels of the portion job.rect of the image to job.counts, in a single pass
+static void
+computeScopesJob(const Natron::Image* image,
+                 const ScopesParams & p,
+                 ScopesJob & job)
 {
-    static float val(const float *pix)
-    {
-        return pix[3];
+    ///Images come from the viewer which is in float.
+    assert(image->getBitDepth() == Natron::eImageBitDepthFloat);
+
+    initCounts(p, &job.counts);
+
+    const RectI & rect = job.rect;
+    int width = rect.width();
+    int nComps = image->getComponentsCount();
+    bool useKernel = nComps == 4 && Natron::kernelsEnabled();
+    std::vector<int> bins(width * 5);
+    std::vector<int> columns;
+    if (p.waveformColumns > 0) {
+        columns.resize(width);
+        for (int x = 0; x < width; ++x) {
+            columns[x] = (int)( (double)(rect.x1 + x - p.rect.x1) * p.waveformColumns / p.rect.width() );
+        }
     }
-};
+    Natron::Image::ReadAccess acc = image->getReadRights();
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        const float* row = (const float*)acc.pixelAt(rect.x1, y);
+
+        if (p.scale > 0) {
+            if (useKernel) {
+                Natron::histogramBinsKernel(row, width, p.vmin, p.scale, p.binsCount, &bins[0]);
+            } else {
+                const float* pix = row;
+                for (int x = 0; x < width; ++x, pix += nComps) {
+                    float rgba[4];
+                    histogramBins(pixelToRGBA(pix, nComps, rgba), p, &bins[x * 5]);
+                }
+            }
+            const int* b = &bins[0];
+            for (int x = 0; x < width; ++x, b += 5) {
+                for (int c = 0; c < 5; ++c) {
+                    if (b[c] >= 0) {
+                        ++job.counts.histograms[c][b[c]];
+                    }
+                }
+            }
+        }
 
-struct pix_lum
+        if ( (p.waveformColumns > 0) || p.vectorscope ) {
+            const float* pix = row;
+            for (int x = 0; x < width; ++x, pix += nComps) {
+                float tmp[4];
+                const float* rgba = pixelToRGBA(pix, nComps, tmp);
+                if (p.waveformColumns > 0) {
+                    for (int c = 0; c < 3; ++c) {
+                        int level = scopeLevel(rgba[c]);
+                        if (level >= 0) {
+                            ++job.counts.waveforms[c][level * p.waveformColumns + columns[x]];
+                        }
+                    }
+                }
+                if (p.vectorscope) {
+                    ///Rec. 601 chroma, with the luminance of the Y histogram
+                    float lum = 0.299f * rgba[0] + 0.587f * rgba[1] + 0.114f * rgba[2];
+                    int cb = scopeLevel(0.564f * (rgba[2] - lum) + 0.5f);
+                    int cr = scopeLevel(0.713f * (rgba[0] - lum) + 0.5f);
+                    if ( (cb >= 0) && (cr >= 0) ) {
+                        ++job.counts.vectorscope[cr * NATRON_SCOPE_RESOLUTION + cb];
+                    }
+                }
+            }
+        }
+    }
+} // computeScopesJob
+
+static void
+addCounts(const std::vector<int> & src,
+          int sign,
+          std::vector<int>* dst)
 {
-    static float val(const float *pix)
-    {
-        return 0.299 * pix[0] + 0.587 * pix[1] + 0.114 * pix[2];
+    assert( src.size() == dst->size() );
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        (*dst)[i] += sign * src[i];
     }
-};
+}
 
+///Adds (or removes if sign is -1) the pixels of the portion rect of the image to counts.
+///The portion is split across the threads of the render scheduler.
+static void
+computeScopes(const Natron::Image & image,
+              const ScopesParams & p,
+              const RectI & rect,
+              int sign,
+              ScopesCounts* counts)
+{
+    std::vector<RectI> splits = rect.splitIntoSmallerRects( QThread::idealThreadCount() );
+    std::vector<ScopesJob> jobs( std::max( (std::size_t)1, splits.size() ) );
 
-template <float pix_func(const float*)>
-void
-computeHisto(const HistogramRequest & request,
-             int upscale,
-             std::vector<float> *histo)
+    if (splits.size() <= 1) {
+        jobs[0].rect = rect;
+        computeScopesJob(&image, p, jobs[0]);
+    } else {
+        for (std::size_t i = 0; i < splits.size(); ++i) {
+            jobs[i].rect = splits[i];
+        }
+        forEachInRenderScheduler( jobs.begin(), jobs.end(), boost::bind(&computeScopesJob, &image, boost::cref(p), _1) );
+    }
+
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+        for (int c = 0; c < 5; ++c) {
+            addCounts(jobs[i].counts.histograms[c], sign, &counts->histograms[c]);
+        }
+        for (int c = 0; c < 3; ++c) {
+            addCounts(jobs[i].counts.waveforms[c], sign, &counts->waveforms[c]);
+        }
+        addCounts(jobs[i].counts.vectorscope, sign, &counts->vectorscope);
+    }
+}
+
+///Converts the counts to values in [0,1], scaled so that the highest one is 1
+static void
+normalizeScopes(const std::vector<int>* counts,
+                int scopesCount,
+                std::vector<float>** scopes)
 {
-    assert(histo);
-    histo->resize(request.binsCount * upscale);
-    std::fill(histo->begin(), histo->end(), 0.f);
-    double binSize = (request.vmax - request.vmin) / histo->size();
+    int maxCount = 0;
 
-    ///Images come from the viewer which is in float.
-    assert(request.image->getBitDepth() == Natron::eImageBitDepthFloat);
-
-    Natron::Image::ReadAccess acc = request.image->getReadRights();
-    
-    for (int y = request.rect.bottom(); y < request.rect.top(); ++y) {
-        for (int x = request.rect.left(); x < request.rect.right(); ++x) {
-            const float *pix = (const float*)acc.pixelAt(x, y);
-            float v = pix_func(pix);
-            if ( (request.vmin <= v) && (v < request.vmax) ) {
-                int index = (int)( (v - request.vmin) / binSize );
-                assert( 0 <= index && index < (int)histo->size() );
-                (*histo)[index] += 1.f;
-            }
+    for (int i = 0; i < scopesCount; ++i) {
+        for (std::size_t j = 0; j < counts[i].size(); ++j) {
+            maxCount = std::max(maxCount, counts[i][j]);
+        }
+    }
+    for (int i = 0; i < scopesCount; ++i) {
+        scopes[i]->resize( counts[i].size() );
+        for (std::size_t j = 0; j < counts[i].size(); ++j) {
+            (*scopes[i])[j] = maxCount > 0 ? (float)counts[i][j] / maxCount : 0.f;
         }
     }
 }
@@ -422,10 +657,11 @@ iir_1d_filter(SrcIterator src,
 
 static void
 computeHistogramStatic(const HistogramRequest & request,
+                       const ScopesCounts & counts,
                        boost::shared_ptr<FinishedHistogram> ret,
                        int histogramIndex)
 {
-    const int upscale = 5;
+    const int upscale = NATRON_HISTOGRAM_UPSCALE;
     std::vector<float> *histo = 0;
 
     switch (histogramIndex) {
@@ -455,30 +691,34 @@ computeHistogramStatic(const HistogramRequest & request,
         mode = histogramIndex + 2;
     }
 
-    ret->pixelsCount = request.rect.area();
     // a histogram with upscale more bins
-    std::vector<float> histo_upscaled;
+    const std::vector<int>* counted = 0;
     switch (mode) {
     case 1:     //< A
-        computeHisto<&pix_alpha::val>(request, upscale, &histo_upscaled);
+        counted = &counts.histograms[3];
         break;
     case 2:     //<Y
-        computeHisto<&pix_lum::val>(request, upscale, &histo_upscaled);
+        counted = &counts.histograms[4];
         break;
     case 3:     //< R
-        computeHisto<&pix_red::val>(request, upscale, &histo_upscaled);
+        counted = &counts.histograms[0];
         break;
     case 4:     //< G
-        computeHisto<&pix_green::val>(request, upscale, &histo_upscaled);
+        counted = &counts.histograms[1];
         break;
     case 5:     //< B
-        computeHisto<&pix_blue::val>(request, upscale, &histo_upscaled);
+        counted = &counts.histograms[2];
         break;
 
     default:
         assert(false);
         break;
     }
+    if (!counted) {
+        return;
+    }
+    std::vector<float> histo_upscaled( counted->begin(), counted->end() );
+    histo_upscaled.resize(request.binsCount * upscale);
     double sigma = upscale;
     if (request.smoothingKernelSize > 1) {
         sigma *= request.smoothingKernelSize;
@@ -520,13 +760,22 @@ HistogramCPU::run()
             request = _imp->requests.back();
             _imp->requests.pop_back();
 
-            ///ignore all other requests pending
+            ///ignore all other requests pending, but account for the portions of the image they updated
+            for (std::list<HistogramRequest>::iterator it = _imp->requests.begin();
+                 it != _imp->requests.end() && !request.updatedRect.isNull(); ++it) {
+                if ( it->updatedRect.isNull() ) {
+                    request.updatedRect.clear();
+                } else {
+                    request.updatedRect.merge(it->updatedRect);
+                }
+            }
             _imp->requests.clear();
         }
 
         {
             QMutexLocker l(&_imp->mustQuitMutex);
             if (_imp->mustQuit) {
+                _imp->countedImage.reset();
                 _imp->mustQuit = false;
                 _imp->mustQuitCond.wakeOne();
 
@@ -539,21 +788,63 @@ HistogramCPU::run()
         ret->vmin = request.vmin;
         ret->vmax = request.vmax;
         ret->mipMapLevel = request.image->getMipMapLevel();
-
+        ret->pixelsCount = request.rect.area();
+
+        ScopesParams params;
+        params.rect = request.rect;
+        params.binsCount = request.binsCount * NATRON_HISTOGRAM_UPSCALE;
+        params.vmin = request.vmin;
+        if (request.vmax > request.vmin) {
+            params.scale = params.binsCount / (request.vmax - request.vmin);
+        }
+        params.waveformColumns = request.mode == 6 ? request.binsCount : 0;
+        params.vectorscope = request.mode == 7;
+
+        ///Only account again for the portion of the image that changed if nothing else did: the pixels previously
+        ///counted there are removed from the counts and replaced by the new ones
+        bool incremental = !request.updatedRect.isNull() && _imp->countedImage && _imp->countedParams == params &&
+                           _imp->countedHash == request.image->getHashKey() &&
+                           _imp->countedImage->getComponents() == request.image->getComponents();
+        if (incremental) {
+            RectI updatedRect;
+            if ( request.updatedRect.intersect(request.rect, &updatedRect) ) {
+                computeScopes(*_imp->countedImage, params, updatedRect, -1, &_imp->counts);
+                computeScopes(*request.image, params, updatedRect, 1, &_imp->counts);
+                _imp->countedImage->pasteFrom(*request.image, updatedRect, false);
+            }
+        } else {
+            initCounts(params, &_imp->counts);
+            if ( !request.rect.isNull() ) {
+                computeScopes(*request.image, params, request.rect, 1, &_imp->counts);
+            }
+            _imp->copyCountedPixels(*request.image, request.rect);
+        }
+        _imp->countedParams = params;
+        _imp->countedHash = request.image->getHashKey();
 
         switch (request.mode) {
         case 0:     //< RGB
-            computeHistogramStatic(request, ret, 1);
-            computeHistogramStatic(request, ret, 2);
-            computeHistogramStatic(request, ret, 3);
+            computeHistogramStatic(request, _imp->counts, ret, 1);
+            computeHistogramStatic(request, _imp->counts, ret, 2);
+            computeHistogramStatic(request, _imp->counts, ret, 3);
             break;
         case 1:
         case 2:
         case 3:
         case 4:
         case 5:
-            computeHistogramStatic(request, ret, 1);
+            computeHistogramStatic(request, _imp->counts, ret, 1);
+            break;
+        case 6: {     //< Waveform
+            std::vector<float>* waveforms[3] = { &ret->histogram1, &ret->histogram2, &ret->histogram3 };
+            normalizeScopes(_imp->counts.waveforms, 3, waveforms);
+            break;
+        }
+        case 7: {     //< Vectorscope
+            std::vector<float>* vectorscope = &ret->histogram1;
+            normalizeScopes(&_imp->counts.vectorscope, 1, &vectorscope);
             break;
+        }
         default:
             assert(false);     //< unknown case.
             break;
@@ -567,4 +858,3 @@ HistogramCPU::run()
         Q_EMIT histogramProduced();
     }
 } // run
-
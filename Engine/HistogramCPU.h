@@ -38,6 +38,16 @@ class Image;
 }
 class RectI;
 struct HistogramCPUPrivate;
+
+///The number of levels of the waveform and the size of the vectorscope produced in the waveform and vectorscope modes
+#define NATRON_SCOPE_RESOLUTION 256
+
+/**
+ * @brief Computes the histograms, the waveform and the vectorscope of the images displayed by the viewers.
+ * The R,G,B,A and luminance histograms are computed together in a single pass, split across the threads of the
+ * global thread pool. The raw counts are kept so that when only a portion of the image changed (e.g. while the viewer
+ * reports the progress of a render tile by tile) only that portion is accounted again.
+ **/
 class HistogramCPU
     : public QThread
 {
@@ -51,13 +61,24 @@ public:
 
     virtual ~HistogramCPU();
 
+    /**
+     * @brief Requests the computation of the histogram of the portion rect of image.
+     * In the waveform mode the produced histograms are the R,G,B waveforms, each one made of binsCount columns
+     * of NATRON_SCOPE_RESOLUTION levels covering [0,1] (the value of the column i at level j is at j * binsCount + i).
+     * In the vectorscope mode the first histogram is the NATRON_SCOPE_RESOLUTION x NATRON_SCOPE_RESOLUTION
+     * distribution of the Cb (columns) and Cr (rows) chroma components, each one covering [-0.5,0.5].
+     * The waveform and vectorscope values are normalized so that the highest one is 1.
+     * @param updatedRect If not null, only this portion of the image changed since the image passed to the previous
+     * call: the histograms are then updated incrementally when the other parameters did not change either.
+     **/
     void computeHistogram(int mode, //< corresponds to the enum Histogram::DisplayModeEnum
                           const boost::shared_ptr<Natron::Image> & image,
                           const RectI & rect,
                           int binsCount,
                           double vmin,
                           double vmax,
-                          int smoothingKernelSize);
+                          int smoothingKernelSize,
+                          const RectI & updatedRect);
 
     ////Returns true if a new histogram fully computed is available
     bool hasProducedHistogram() const;
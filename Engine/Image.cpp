@@ -26,191 +26,200 @@
 
 #include <algorithm> // min, max
 
+#ifndef Q_MOC_RUN
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+#include <boost/bind.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#endif
+
 #include <QDebug>
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QThread>
+CLANG_DIAG_ON(deprecated)
 
 #include "Engine/AppManager.h"
+#include "Engine/ImageKernels.h"
+#include "Engine/RenderScheduler.h"
 
 using namespace Natron;
 
-#define BM_GET(i,j) &_map[( i - _bounds.bottom() ) * _bounds.width() + ( j - _bounds.left() )]
-
 #define PIXEL_UNAVAILABLE 2
 
-template <int trimap>
-RectI minimalNonMarkedBbox_internal(const RectI& roi, const RectI& _bounds,const std::vector<char>& _map,
-                                    bool* isBeingRenderedElsewhere)
+#define BITMAP_TILE_SIZE (1 << NATRON_BITMAP_TILE_SIZE_POT)
+
+///The state of a tile whose pixels do not all have the same state
+#define BITMAP_TILE_MIXED -1
+
+namespace {
+
+enum BitmapStateMaskEnum
 {
-    RectI bbox;
-    assert(_bounds.contains(roi));
-    bbox = roi;
-    
-    //find bottom
-    for (int i = bbox.bottom(); i < bbox.top(); ++i) {
-        const char* buf = BM_GET(i, bbox.left());
-        
-        if (trimap) {
-            
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
-            }
-            if (!buf) {
+    eBitmapStateMaskNotRendered = 1 << 0,
+    eBitmapStateMaskRendered = 1 << 1,
+    eBitmapStateMaskUnavailable = 1 << PIXEL_UNAVAILABLE,
+    eBitmapStateMaskAll = eBitmapStateMaskNotRendered | eBitmapStateMaskRendered | eBitmapStateMaskUnavailable
+};
+
+enum BitmapEdgeEnum
+{
+    eBitmapEdgeBottom,
+    eBitmapEdgeTop,
+    eBitmapEdgeLeft,
+    eBitmapEdgeRight
+};
+
+///Returns the index of the tile containing the coordinate x
+inline int
+tileIndex(int x)
+{
+    return x >= 0 ? x / BITMAP_TILE_SIZE : -( (-x + BITMAP_TILE_SIZE - 1) / BITMAP_TILE_SIZE );
+}
+
+inline RectI
+tileRect(int tx,
+         int ty)
+{
+    return RectI(tx * BITMAP_TILE_SIZE, ty * BITMAP_TILE_SIZE, (tx + 1) * BITMAP_TILE_SIZE, (ty + 1) * BITMAP_TILE_SIZE);
+}
+
+///Returns the offset of the pixel (x,y) in the pixels of its tile
+inline int
+pixelIndexInTile(int x,
+                 int y)
+{
+    return (y & (BITMAP_TILE_SIZE - 1) ) * BITMAP_TILE_SIZE + (x & (BITMAP_TILE_SIZE - 1) );
+}
+
+/**
+ * @brief Moves the given edge of rect inward over the rows (or columns) which contain none of the states in stopMask.
+ * The rows within a tile are first tested all at once, so that uniform tiles are crossed without looking at each row.
+ * Returns the mask of the states met in the rows that were skipped. stopStates is set to the states met in the row
+ * which stopped the edge, or 0 if the rect became empty.
+ **/
+int
+shrinkEdge(const Bitmap& bm,
+           RectI* rect,
+           BitmapEdgeEnum edge,
+           int stopMask,
+           int* stopStates)
+{
+    int skippedStates = 0;
+
+    *stopStates = 0;
+    while ( !rect->isNull() ) {
+        RectI band = *rect;
+        switch (edge) {
+        case eBitmapEdgeBottom:
+            band.y2 = std::min(rect->y2, (tileIndex(rect->y1) + 1) * BITMAP_TILE_SIZE);
+            break;
+        case eBitmapEdgeTop:
+            band.y1 = std::max(rect->y1, tileIndex(rect->y2 - 1) * BITMAP_TILE_SIZE);
+            break;
+        case eBitmapEdgeLeft:
+            band.x2 = std::min(rect->x2, (tileIndex(rect->x1) + 1) * BITMAP_TILE_SIZE);
+            break;
+        case eBitmapEdgeRight:
+            band.x1 = std::max(rect->x1, tileIndex(rect->x2 - 1) * BITMAP_TILE_SIZE);
+            break;
+        }
+
+        int states = bm.getStatesInRect(band, stopMask);
+        bool skipBand = !(states & stopMask);
+        if (skipBand) {
+            skippedStates |= states;
+        }
+        ///If the band can't be skipped, go 1 row at a time until the one which stops the edge
+        while ( !band.isNull() ) {
+            RectI line = band;
+            switch (edge) {
+            case eBitmapEdgeBottom:
+                line.y2 = line.y1 + 1;
                 break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                ++bbox.y1;
-            } else {
-                ++bbox.y1;
-            }
-        } else {
-            
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if (!*buf || *buf == PIXEL_UNAVAILABLE) {
-                    buf = 0;
-                    break;
-                }
-                ++buf;
-            }
-            if (!buf) {
+            case eBitmapEdgeTop:
+                line.y1 = line.y2 - 1;
                 break;
-            } else {
-                ++bbox.y1;
-            }
-        }
-    }
-    
-    //find top (will do zero iteration if the bbox is already empty)
-    for (int i = bbox.top() - 1; i >= bbox.bottom(); --i) {
-        const char* buf = BM_GET(i, bbox.left());
-        
-        if (trimap) {
-            
-            const char* lineEnd = buf + bbox.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (!*buf) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE) {
-                    metUnavailablePixel = true;
-                }
-                ++buf;
-            }
-            if (!buf) {
+            case eBitmapEdgeLeft:
+                line.x2 = line.x1 + 1;
                 break;
-            } else if (metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag if the whole row is not 0
-                --bbox.y2;
-            } else {
-                --bbox.y2;
-            }
-            
-        } else {
-            
-            const char* lineEnd = buf + bbox.width();
-            while (buf < lineEnd) {
-                if (!*buf || *buf == PIXEL_UNAVAILABLE) {
-                    buf = 0;
-                    break;
-                }
-                ++buf;
-            }
-            if (!buf) {
+            case eBitmapEdgeRight:
+                line.x1 = line.x2 - 1;
                 break;
-            } else {
-                --bbox.y2;
             }
-        }
-    }
-    
-    // avoid making bbox.width() iterations for nothing
-    if ( bbox.isNull() ) {
-        return bbox;
-    }
-    
-    //find left
-    for (int j = bbox.left(); j < bbox.right(); ++j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
-
-        bool metUnavailablePixel = false;
+            if (skipBand) {
+                line = band;
+            } else {
+                states = bm.getStatesInRect(line, stopMask);
+                if (states & stopMask) {
+                    *stopStates = states;
 
-        for (int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width()) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            }
-            
-            else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
+                    return skippedStates;
                 }
+                skippedStates |= states;
             }
-            
-        }
-        if (pix) {
-            ++bbox.x1;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
+            switch (edge) {
+            case eBitmapEdgeBottom:
+                rect->y1 = line.y2;
+                band.y1 = line.y2;
+                break;
+            case eBitmapEdgeTop:
+                rect->y2 = line.y1;
+                band.y2 = line.y1;
+                break;
+            case eBitmapEdgeLeft:
+                rect->x1 = line.x2;
+                band.x1 = line.x2;
+                break;
+            case eBitmapEdgeRight:
+                rect->x2 = line.x1;
+                band.x2 = line.x1;
+                break;
             }
-        } else {
-            break;
         }
     }
-    
-    //find right
-    for (int j = bbox.right() - 1; j >= bbox.left(); --j) {
-        const char* pix = BM_GET(bbox.bottom(), j);
 
-        bool metUnavailablePixel = false;
+    return skippedStates;
+} // shrinkEdge
 
-        for (int i = bbox.bottom(); i < bbox.top(); ++i, pix += _bounds.width()) {
-            if (!*pix) {
-                pix = 0;
-                break;
-            }
+template <int trimap>
+RectI
+minimalNonMarkedBbox_internal(const RectI& roi,
+                              const Bitmap& bm,
+                              bool* isBeingRenderedElsewhere)
+{
+    RectI bbox;
+    assert( bm.getBounds().contains(roi) );
+    bbox = roi;
 
-            else if (*pix == PIXEL_UNAVAILABLE) {
-                if (trimap) {
-                    metUnavailablePixel = true;
-                } else {
-                    pix = 0;
-                    break;
-                }
-            }
+    ///Rows and columns are removed from the bbox while they do not have any pixel left to render.
+    ///In trimap mode pixels being rendered elsewhere do not need to be rendered, but the caller has to wait for them.
+    int stopMask = trimap ? eBitmapStateMaskNotRendered : (eBitmapStateMaskNotRendered | eBitmapStateMaskUnavailable);
+    int stopStates;
+    int skippedStates = 0;
 
-        }
-        if (pix) {
-            --bbox.x2;
-            if (trimap && metUnavailablePixel) {
-                *isBeingRenderedElsewhere = true; //< only flag is the whole column is not 0
-            }
+    //find bottom
+    skippedStates |= shrinkEdge(bm, &bbox, eBitmapEdgeBottom, stopMask, &stopStates);
+    //find top (will do zero iteration if the bbox is already empty)
+    skippedStates |= shrinkEdge(bm, &bbox, eBitmapEdgeTop, stopMask, &stopStates);
+    //find left
+    skippedStates |= shrinkEdge(bm, &bbox, eBitmapEdgeLeft, stopMask, &stopStates);
+    //find right
+    skippedStates |= shrinkEdge(bm, &bbox, eBitmapEdgeRight, stopMask, &stopStates);
 
-        } else {
-            break;
-        }
+    if ( trimap && (skippedStates & eBitmapStateMaskUnavailable) ) {
+        *isBeingRenderedElsewhere = true; //< only flag if a whole row or column is not 0
     }
-    
-    return bbox;
 
+    return bbox;
 }
 
-
 template <int trimap>
 void
-minimalNonMarkedRects_internal(const RectI & roi,const RectI& _bounds, const std::vector<char>& _map,
-                               std::list<RectI>& ret,bool* isBeingRenderedElsewhere)
+minimalNonMarkedRects_internal(const RectI & roi,
+                               const Bitmap& bm,
+                               std::list<RectI>& ret,
+                               bool* isBeingRenderedElsewhere)
 {
+    const RectI& _bounds = bm.getBounds();
     ///Any out of bounds portion is pushed to the rectangles to render
     RectI intersection;
     roi.intersect(_bounds, &intersection);
@@ -244,7 +253,7 @@ minimalNonMarkedRects_internal(const RectI & roi,const RectI& _bounds, const std
         return;
     }
     
-    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, _bounds, _map, isBeingRenderedElsewhere);
+    RectI bboxM = minimalNonMarkedBbox_internal<trimap>(intersection, bm, isBeingRenderedElsewhere);
     assert((trimap && isBeingRenderedElsewhere) || (!trimap && !isBeingRenderedElsewhere));
     
     //#define NATRON_BITMAP_DISABLE_OPTIMIZATION
@@ -277,184 +286,58 @@ minimalNonMarkedRects_internal(const RectI & roi,const RectI& _bounds, const std
     // CXXXXXXXXXXDDD
     // CXXXXXXXXXXDDD
     // AAAAAAAAAAAAAA
-    
+
+    ///In trimap mode, a rectangle stops at the first pixel being rendered elsewhere
+    int stopMask = trimap ? (eBitmapStateMaskRendered | eBitmapStateMaskUnavailable) : eBitmapStateMaskRendered;
+    int stopStates;
+    RectI bboxX = bboxM;
+
     // First, find if there's an "A" rectangle, and push it to the result
     //find bottom
-    RectI bboxX = bboxM;
-    RectI bboxA = bboxX;
-    bboxA.set_top( bboxX.bottom() );
-    for (int i = bboxX.bottom(); i < bboxX.top(); ++i) {
-        const char* buf = BM_GET(i, bboxX.left());
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE && trimap) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                ++bboxX.y1;
-                bboxA.y2 = bboxX.y1;
-            } else {
-                break;
-            }
-        }
+    shrinkEdge(bm, &bboxX, eBitmapEdgeBottom, stopMask, &stopStates);
+    if ( trimap && (stopStates & eBitmapStateMaskUnavailable) ) {
+        *isBeingRenderedElsewhere = true;
     }
+    RectI bboxA(bboxM.x1, bboxM.y1, bboxM.x2, bboxX.y1);
     if ( !bboxA.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxA);
     }
     
     // Now, find the "B" rectangle
     //find top
-    RectI bboxB = bboxX;
-    bboxB.set_bottom( bboxX.top() );
-    for (int i = bboxX.top() - 1; i >= bboxX.bottom(); --i) {
-        const char* buf = BM_GET(i, bboxX.left());
-        
-        if (trimap) {
-            const char* lineEnd = buf + bboxX.width();
-            bool metUnavailablePixel = false;
-            while (buf < lineEnd) {
-                if (*buf == 1) {
-                    buf = 0;
-                    break;
-                } else if (*buf == PIXEL_UNAVAILABLE && trimap) {
-                    buf = 0;
-                    metUnavailablePixel = true;
-                    break;
-                }
-                ++buf;
-            }
-            if (buf) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                if (metUnavailablePixel) {
-                    *isBeingRenderedElsewhere = true;
-                }
-                break;
-            }
-        } else {
-            if ( !memchr( buf, 1, bboxX.width() ) ) {
-                --bboxX.y2;
-                bboxB.y1 = bboxX.y2;
-            } else {
-                break;
-            }
-            
-        }
+    shrinkEdge(bm, &bboxX, eBitmapEdgeTop, stopMask, &stopStates);
+    if ( trimap && (stopStates & eBitmapStateMaskUnavailable) ) {
+        *isBeingRenderedElsewhere = true;
     }
+    RectI bboxB(bboxM.x1, bboxX.y2, bboxM.x2, bboxM.y2);
     if ( !bboxB.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxB);
     }
     
-	//find left
-	RectI bboxC = bboxX;
-	bboxC.set_right( bboxX.left() );
-	if (bboxX.bottom() < bboxX.top()) {
-		for (int j = bboxX.left(); j < bboxX.right(); ++j) {
-			const char* pix = BM_GET(bboxX.bottom(), j);
-
-			bool metUnavailablePixel = false;
-
-			for (int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width()) {
-				if (*pix == 1) {
-					pix = 0;
-					break;
-				} else if (trimap && *pix == PIXEL_UNAVAILABLE) {
-					pix = 0;
-					metUnavailablePixel = true;
-					break;
-				}
-			}
-			if (pix) {
-                ++bboxX.x1;
-                bboxC.x2 = bboxX.x1;
-			} else {
-				if (metUnavailablePixel) {
-					*isBeingRenderedElsewhere = true;
-				}
-				break;
-			}
-		}
-	}
+    //find left
+    shrinkEdge(bm, &bboxX, eBitmapEdgeLeft, stopMask, &stopStates);
+    if ( trimap && (stopStates & eBitmapStateMaskUnavailable) ) {
+        *isBeingRenderedElsewhere = true;
+    }
+    RectI bboxC(bboxM.x1, bboxX.y1, bboxX.x1, bboxX.y2);
     if ( !bboxC.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxC);
     }
 
-	//find right
-	RectI bboxD = bboxX;
-	bboxD.set_left( bboxX.right() );
-	if (bboxX.bottom() < bboxX.top()) {
-		for (int j = bboxX.right() - 1; j >= bboxX.left(); --j) {
-			const char* pix = BM_GET(bboxX.bottom(), j);
-
-			bool metUnavailablePixel = false;
-
-			for (int i = bboxX.bottom(); i < bboxX.top(); ++i, pix += _bounds.width()) {
-				if (*pix == 1) {
-					pix = 0;
-					break;
-				} else if (trimap && *pix == PIXEL_UNAVAILABLE) {
-					pix = 0;
-					metUnavailablePixel = true;
-					break;
-				}
-			}
-			if (pix) {
-                --bboxX.x2;
-                bboxD.x1 = bboxX.x2;
-			} else {
-				if (metUnavailablePixel) {
-					*isBeingRenderedElsewhere = true;
-				}
-				break;
-			}
-		}
-	}
-	if ( !bboxD.isNull() ) { // empty boxes should not be pushed
+    //find right
+    shrinkEdge(bm, &bboxX, eBitmapEdgeRight, stopMask, &stopStates);
+    if ( trimap && (stopStates & eBitmapStateMaskUnavailable) ) {
+        *isBeingRenderedElsewhere = true;
+    }
+    RectI bboxD(bboxX.x2, bboxX.y1, bboxM.x2, bboxX.y2);
+    if ( !bboxD.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxD);
     }
     
-    assert( bboxA.bottom() == bboxM.bottom() );
-    assert( bboxA.left() == bboxM.left() );
-    assert( bboxA.right() == bboxM.right() );
-    assert( bboxA.top() == bboxX.bottom() );
-    
-    assert( bboxB.top() == bboxM.top() );
-    assert( bboxB.left() == bboxM.left() );
-    assert( bboxB.right() == bboxM.right() );
-    assert( bboxB.bottom() == bboxX.top() );
-    
-    assert( bboxC.top() == bboxX.top() );
-    assert( bboxC.left() == bboxM.left() );
-    assert( bboxC.right() == bboxX.left() );
-    assert( bboxC.bottom() == bboxX.bottom() );
-    
-    assert( bboxD.top() == bboxX.top() );
-    assert( bboxD.left() == bboxX.right() );
-    assert( bboxD.right() == bboxM.right() );
-    assert( bboxD.bottom() == bboxX.bottom() );
-    
     // get the bounding box of what's left (the X rectangle in the drawing above)
-    bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX,_bounds,_map,isBeingRenderedElsewhere);
+    if ( !bboxX.isNull() ) {
+        bboxX = minimalNonMarkedBbox_internal<trimap>(bboxX, bm, isBeingRenderedElsewhere);
+    }
     
     if ( !bboxX.isNull() ) { // empty boxes should not be pushed
         ret.push_back(bboxX);
@@ -463,6 +346,149 @@ minimalNonMarkedRects_internal(const RectI & roi,const RectI& _bounds, const std
 #endif // NATRON_BITMAP_DISABLE_OPTIMIZATION
 
 } // minimalNonMarkedRects
+} // anon namespace
+
+void
+Bitmap::initialize(const RectI & bounds)
+{
+    _bounds = bounds;
+    _tiles.clear();
+    _mixedTilesCount = 0;
+    if ( bounds.isNull() ) {
+        _tilesBounds.clear();
+
+        return;
+    }
+    _tilesBounds.set( tileIndex(bounds.x1), tileIndex(bounds.y1), tileIndex(bounds.x2 - 1) + 1, tileIndex(bounds.y2 - 1) + 1 );
+    _tiles.resize( _tilesBounds.area() );
+}
+
+void
+Bitmap::setTo1()
+{
+    for (std::vector<Tile>::iterator it = _tiles.begin(); it != _tiles.end(); ++it) {
+        it->state = 1;
+        std::vector<char>().swap(it->pixels);
+    }
+    _mixedTilesCount = 0;
+}
+
+char
+Bitmap::getStateAt(int x,
+                   int y) const
+{
+    assert( x >= _bounds.x1 && x < _bounds.x2 && y >= _bounds.y1 && y < _bounds.y2 );
+    const Tile& tile = getTile( tileIndex(x), tileIndex(y) );
+
+    return tile.state == BITMAP_TILE_MIXED ? tile.pixels[pixelIndexInTile(x, y)] : tile.state;
+}
+
+int
+Bitmap::getStatesInRect(const RectI& roi,
+                        int stopMask) const
+{
+    RectI rect;
+
+    if ( !roi.intersect(_bounds, &rect) ) {
+        return 0;
+    }
+    int ret = 0;
+    int ty2 = tileIndex(rect.y2 - 1);
+    int tx2 = tileIndex(rect.x2 - 1);
+    for (int ty = tileIndex(rect.y1); ty <= ty2; ++ty) {
+        for (int tx = tileIndex(rect.x1); tx <= tx2; ++tx) {
+            const Tile& tile = getTile(tx, ty);
+            if (tile.state != BITMAP_TILE_MIXED) {
+                ret |= 1 << tile.state;
+            } else {
+                RectI r;
+                tileRect(tx, ty).intersect(rect, &r);
+                for (int y = r.y1; y < r.y2; ++y) {
+                    const char* pix = &tile.pixels[pixelIndexInTile(r.x1, y)];
+                    const char* end = pix + r.width();
+                    for (; pix < end; ++pix) {
+                        ret |= 1 << *pix;
+                    }
+                }
+            }
+            if ( (ret & stopMask) || (ret == eBitmapStateMaskAll) ) {
+                return ret;
+            }
+        }
+    }
+
+    return ret;
+}
+
+void
+Bitmap::expandTile(Tile& tile)
+{
+    if (tile.state == BITMAP_TILE_MIXED) {
+        return;
+    }
+    tile.pixels.assign(BITMAP_TILE_SIZE * BITMAP_TILE_SIZE, tile.state);
+    tile.state = BITMAP_TILE_MIXED;
+    ++_mixedTilesCount;
+}
+
+void
+Bitmap::compactTile(Tile& tile,
+                    const RectI& rect)
+{
+    assert(tile.state == BITMAP_TILE_MIXED);
+    char state = tile.pixels[pixelIndexInTile(rect.x1, rect.y1)];
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        const char* pix = &tile.pixels[pixelIndexInTile(rect.x1, y)];
+        const char* end = pix + rect.width();
+        for (; pix < end; ++pix) {
+            if (*pix != state) {
+                return;
+            }
+        }
+    }
+    tile.state = state;
+    std::vector<char>().swap(tile.pixels);
+    --_mixedTilesCount;
+}
+
+void
+Bitmap::fill(const RectI& roi,
+             char state)
+{
+    RectI rect;
+
+    if ( !roi.intersect(_bounds, &rect) ) {
+        return;
+    }
+
+    int ty2 = tileIndex(rect.y2 - 1);
+    int tx2 = tileIndex(rect.x2 - 1);
+    for (int ty = tileIndex(rect.y1); ty <= ty2; ++ty) {
+        for (int tx = tileIndex(rect.x1); tx <= tx2; ++tx) {
+            Tile& tile = getTile(tx, ty);
+            RectI tileBounds;
+            tileRect(tx, ty).intersect(_bounds, &tileBounds);
+            RectI r;
+            tileBounds.intersect(rect, &r);
+            if (r == tileBounds) {
+                if (tile.state == BITMAP_TILE_MIXED) {
+                    std::vector<char>().swap(tile.pixels);
+                    --_mixedTilesCount;
+                }
+                tile.state = state;
+                continue;
+            }
+            if (tile.state == state) {
+                continue;
+            }
+            expandTile(tile);
+            for (int y = r.y1; y < r.y2; ++y) {
+                memset( &tile.pixels[pixelIndexInTile(r.x1, y)], state, r.width() );
+            }
+            compactTile(tile, tileBounds);
+        }
+    }
+}
 
 RectI
 Bitmap::minimalNonMarkedBbox(const RectI & roi) const
@@ -472,9 +498,9 @@ Bitmap::minimalNonMarkedBbox(const RectI & roi) const
         if (!roi.intersect(_dirtyZone, &realRoi)) {
             return RectI();
         }
-        return minimalNonMarkedBbox_internal<0>(realRoi, _bounds, _map, NULL);
+        return minimalNonMarkedBbox_internal<0>(realRoi, *this, NULL);
     } else {
-        return minimalNonMarkedBbox_internal<0>(roi, _bounds, _map, NULL);
+        return minimalNonMarkedBbox_internal<0>(roi, *this, NULL);
     }
 }
 
@@ -486,9 +512,9 @@ Bitmap::minimalNonMarkedRects(const RectI & roi,std::list<RectI>& ret) const
         if (!roi.intersect(_dirtyZone, &realRoi)) {
             return;
         }
-        minimalNonMarkedRects_internal<0>(realRoi, _bounds, _map,ret , NULL);
+        minimalNonMarkedRects_internal<0>(realRoi, *this, ret, NULL);
     } else {
-        minimalNonMarkedRects_internal<0>(roi, _bounds, _map,ret , NULL);
+        minimalNonMarkedRects_internal<0>(roi, *this, ret, NULL);
     }
 }
 
@@ -502,9 +528,9 @@ Bitmap::minimalNonMarkedBbox_trimap(const RectI & roi,bool* isBeingRenderedElsew
             *isBeingRenderedElsewhere = false;
             return RectI();
         }
-        return minimalNonMarkedBbox_internal<1>(realRoi, _bounds, _map, isBeingRenderedElsewhere);
+        return minimalNonMarkedBbox_internal<1>(realRoi, *this, isBeingRenderedElsewhere);
     } else {
-        return minimalNonMarkedBbox_internal<1>(roi, _bounds, _map, isBeingRenderedElsewhere);
+        return minimalNonMarkedBbox_internal<1>(roi, *this, isBeingRenderedElsewhere);
     }
 }
 
@@ -518,9 +544,9 @@ Bitmap::minimalNonMarkedRects_trimap(const RectI & roi,std::list<RectI>& ret,boo
             *isBeingRenderedElsewhere = false;
             return;
         }
-        minimalNonMarkedRects_internal<1>(realRoi, _bounds, _map ,ret , isBeingRenderedElsewhere);
+        minimalNonMarkedRects_internal<1>(realRoi, *this, ret, isBeingRenderedElsewhere);
     } else {
-        minimalNonMarkedRects_internal<1>(roi, _bounds, _map ,ret , isBeingRenderedElsewhere);
+        minimalNonMarkedRects_internal<1>(roi, *this, ret, isBeingRenderedElsewhere);
     }
 } 
 #endif
@@ -528,67 +554,38 @@ Bitmap::minimalNonMarkedRects_trimap(const RectI & roi,std::list<RectI>& ret,boo
 void
 Natron::Bitmap::markForRendered(const RectI & roi)
 {
-    char* buf = BM_GET(roi.bottom(), roi.left());
-    int w = _bounds.width();
-    int roiw = roi.width();
-    for (int i = roi.y1; i < roi.y2; ++i, buf += w) {
-        memset( buf, 1, roiw);
-    }
+    fill(roi, 1);
 }
 
 #if NATRON_ENABLE_TRIMAP
 void
 Natron::Bitmap::markForRendering(const RectI & roi)
 {
-    char* buf = BM_GET(roi.bottom(), roi.left());
-    int w = _bounds.width();
-    int roiw = roi.width();
-    for (int i = roi.y1; i < roi.y2; ++i, buf += w) {
-        memset( buf, PIXEL_UNAVAILABLE , roiw );
-    }
+    fill(roi, PIXEL_UNAVAILABLE);
 }
 #endif
 
 void
 Natron::Bitmap::clear(const RectI& roi)
 {
-    char* buf = BM_GET(roi.bottom(), roi.left());
-    int w = _bounds.width();
-    int roiw = roi.width();
-    for (int i = roi.y1; i < roi.y2; ++i, buf += w) {
-        memset( buf, 0 , roiw );
-    }
+    fill(roi, 0);
 }
 
 void
 Natron::Bitmap::swap(Bitmap& other)
 {
-    _map.swap(other._map);
+    _tiles.swap(other._tiles);
+    std::swap(_mixedTilesCount, other._mixedTilesCount);
     _bounds = other._bounds;
+    _tilesBounds = other._tilesBounds;
     _dirtyZone.clear();//merge(other._dirtyZone);
     _dirtyZoneSet = false;
 }
 
-const char*
-Natron::Bitmap::getBitmapAt(int x,
-                            int y) const
+std::size_t
+Natron::Bitmap::getMemorySize() const
 {
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y,x);
-    } else {
-        return NULL;
-    }
-}
-
-char*
-Natron::Bitmap::getBitmapAt(int x,
-                            int y)
-{
-    if ( ( x >= _bounds.left() ) && ( x < _bounds.right() ) && ( y >= _bounds.bottom() ) && ( y < _bounds.top() ) ) {
-        return BM_GET(y,x);
-    } else {
-        return NULL;
-    }
+    return _tiles.size() * sizeof(Tile) + (std::size_t)_mixedTilesCount * BITMAP_TILE_SIZE * BITMAP_TILE_SIZE;
 }
 
 #ifdef DEBUG
@@ -600,16 +597,12 @@ Image::printUnrenderedPixels(const RectI& roi) const
     }
     QReadLocker k(&_entryLock);
     
-    const char* bm = _bitmap.getBitmapAt(roi.x1, roi.y1);
-    int roiw = roi.x2 - roi.x1;
-    int boundsW = _bitmap.getBounds().width();
-    
-    for (int y = roi.y1; y < roi.y2; ++y,
-         bm += (boundsW - roiw)) {
-        for (int x = roi.x1; x < roi.x2; ++x,++bm) {
-            if (*bm == 0) {
+    for (int y = roi.y1; y < roi.y2; ++y) {
+        for (int x = roi.x1; x < roi.x2; ++x) {
+            char state = _bitmap.getStateAt(x, y);
+            if (state == 0) {
                 qDebug() << '(' << x << ',' << y << ") = 0";
-            } else if (*bm == PIXEL_UNAVAILABLE) {
+            } else if (state == PIXEL_UNAVAILABLE) {
                 qDebug() << '(' << x << ',' << y << ") = PIXEL_UNAVAILABLE";
             }
         }
@@ -620,10 +613,12 @@ Image::printUnrenderedPixels(const RectI& roi) const
 Image::Image(const ImageKey & key,
              const boost::shared_ptr<Natron::ImageParams>& params,
              const Natron::CacheAPI* cache,
-             Natron::StorageModeEnum storage,
-             const std::string & path)
-    : CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, cache,storage,path)
+             Natron::StorageModeEnum storage)
+    : CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, cache,storage)
     , _useBitmap(true)
+    , _statisticsMutex()
+    , _statistics()
+    , _statisticsGeneration(0)
 {
     _bitDepth = params->getBitDepth();
     _rod = params->getRoD();
@@ -634,8 +629,11 @@ Image::Image(const ImageKey & key,
 
 Image::Image(const ImageKey & key,
              const boost::shared_ptr<Natron::ImageParams>& params)
-: CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, NULL,Natron::eStorageModeRAM,std::string())
+: CacheEntryHelper<unsigned char, ImageKey,ImageParams>(key, params, NULL,Natron::eStorageModeRAM)
 , _useBitmap(false)
+, _statisticsMutex()
+, _statistics()
+, _statisticsGeneration(0)
 {
     _bitDepth = params->getBitDepth();
     _rod = params->getRoD();
@@ -658,6 +656,9 @@ Image::Image(const ImageComponents& components,
              bool useBitmap)
     : CacheEntryHelper<unsigned char,ImageKey,ImageParams>()
     , _useBitmap(useBitmap)
+    , _statisticsMutex()
+    , _statistics()
+    , _statisticsGeneration(0)
 {
     
     setCacheEntry(makeKey(0, 0, false, 0, 0, false, false),
@@ -671,8 +672,7 @@ Image::Image(const ImageComponents& components,
                                                                    components,
                                                                    std::map<int, std::map<int,std::vector<RangeD> > >() ) ),
                   NULL,
-                  Natron::eStorageModeRAM,
-                  std::string()
+                  Natron::eStorageModeRAM
                   );
 
     _bitDepth = bitdepth;
@@ -708,10 +708,18 @@ Image::onMemoryAllocated(bool diskRestoration)
     
 }
 
+std::size_t
+Image::getCompressionElementSize() const
+{
+    ///Compress pixel by pixel so that the channels are shuffled apart
+    return getComponentsCount() * getSizeOfForBitDepth(_bitDepth);
+}
+
 void
 Image::setBitmapDirtyZone(const RectI& zone)
 {
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     _bitmap.setDirtyZone(zone);
 }
 
@@ -794,10 +802,11 @@ Image::pasteFromForDepth(const Natron::Image & srcImg,
     ///Cannot copy images with different bit depth, this is not the purpose of this function.
     ///@see convert
     assert( getBitDepth() == srcImg.getBitDepth() );
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || ((getBitDepth() == eImageBitDepthShort || getBitDepth() == eImageBitDepthHalf) && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
     // NOTE: before removing the following asserts, please explain why an empty image may happen
     
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     
     boost::shared_ptr<QReadLocker> k2;
     if (takeSrcLock) {
@@ -851,6 +860,7 @@ void
 Image::setRoD(const RectD& rod)
 {
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     _rod = rod;
     _params->setRoD(rod);
 }
@@ -876,7 +886,7 @@ Image::resizeInternal(const Image* srcImg,
     } else {
         boost::shared_ptr<ImageParams> params(new ImageParams(*srcImg->getParams()));
         params->setBounds(merge);
-        outputImage->reset(new Image(srcImg->getKey(), params, srcImg->getCacheAPI(), Natron::eStorageModeRAM,std::string()));
+        outputImage->reset(new Image(srcImg->getKey(), params, srcImg->getCacheAPI(), Natron::eStorageModeRAM));
         (*outputImage)->allocateMemory();
     }
     Natron::ImageBitDepthEnum depth = srcImg->getBitDepth();
@@ -929,9 +939,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             memset(pix, 0, memsize);
             if (setBitmapTo1 && (*outputImage)->usesBitMap()) {
-                char* bm = wacc.bitmapAt(aRect.x1, aRect.y1);
-                assert(bm);
-                memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(aRect);
             }
         }
         if (!cRect.isNull()) {
@@ -941,9 +949,7 @@ Image::resizeInternal(const Image* srcImg,
             std::size_t memsize = a * pixelSize;
             memset(pix, 0, memsize);
             if (setBitmapTo1 && (*outputImage)->usesBitMap()) {
-                char* bm = (char*)wacc.bitmapAt(cRect.x1, cRect.y1);
-                assert(bm);
-                memset(bm, 1, a);
+                (*outputImage)->_bitmap.markForRendered(cRect);
             }
         }
         if (!bRect.isNull()) {
@@ -955,13 +961,11 @@ Image::resizeInternal(const Image* srcImg,
             int bw = bRect.width();
             std::size_t rectRowSize = bw * pixelSize;
             
-            char* bm = (setBitmapTo1 && (*outputImage)->usesBitMap()) ? wacc.bitmapAt(bRect.x1, bRect.y1) : 0;
             for (int y = bRect.y1; y < bRect.y2; ++y, pix += rowsize) {
                 memset(pix, 0, rectRowSize);
-                if (bm) {
-                    memset(bm, 1, bw);
-                    bm += mw;
-                }
+            }
+            if (setBitmapTo1 && (*outputImage)->usesBitMap()) {
+                (*outputImage)->_bitmap.markForRendered(bRect);
             }
         }
         if (!dRect.isNull()) {
@@ -973,13 +977,11 @@ Image::resizeInternal(const Image* srcImg,
             int dw = dRect.width();
             std::size_t rectRowSize = dw * pixelSize;
             
-            char* bm = (setBitmapTo1 && (*outputImage)->usesBitMap()) ? wacc.bitmapAt(dRect.x1, dRect.y1) : 0;
             for (int y = dRect.y1; y < dRect.y2; ++y, pix += rowsize) {
                 memset(pix, 0, rectRowSize);
-                if (bm) {
-                    memset(bm, 1, dw);
-                    bm += mw;
-                }
+            }
+            if (setBitmapTo1 && (*outputImage)->usesBitMap()) {
+                (*outputImage)->_bitmap.markForRendered(dRect);
             }
         }
         
@@ -995,7 +997,7 @@ Image::resizeInternal(const Image* srcImg,
             (*outputImage)->pasteFromForDepth<unsigned short>(*srcImg, srcBounds, srcImg->usesBitMap(), false);
             break;
         case eImageBitDepthHalf:
-            assert(false);
+            (*outputImage)->pasteFromForDepth<Half>(*srcImg, srcBounds, srcImg->usesBitMap(), false);
             break;
         case eImageBitDepthFloat:
             (*outputImage)->pasteFromForDepth<float>(*srcImg, srcBounds, srcImg->usesBitMap(), false);
@@ -1034,6 +1036,7 @@ Image::ensureBounds(const RectI& newBounds, bool fillWithBlackAndTransparant, bo
     }
     
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     
     RectI merge = newBounds;
     merge.merge(_bounds);
@@ -1072,7 +1075,7 @@ Image::pasteFrom(const Natron::Image & src,
         pasteFromForDepth<unsigned short>(src, srcRoi, copyBitmap, true);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        pasteFromForDepth<Half>(src, srcRoi, copyBitmap, true);
         break;
     case eImageBitDepthFloat:
         pasteFromForDepth<float>(src, srcRoi, copyBitmap, true);
@@ -1090,7 +1093,7 @@ Image::fillForDepthForComponents(const RectI & roi_,
                                  float b,
                                  float a)
 {
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || ((getBitDepth() == eImageBitDepthShort || getBitDepth() == eImageBitDepthHalf) && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
     
     RectI roi = roi_;
     bool doInteresect = roi.intersect(_bounds, &roi);
@@ -1107,6 +1110,12 @@ Image::fillForDepthForComponents(const RectI & roi_,
     
     // now we're safe: the image contains the area in roi
     PIX* dst = (PIX*)pixelAt(roi.x1, roi.y1);
+    if ( getBitDepth() == eImageBitDepthFloat && kernelsEnabled() ) {
+        for (int i = 0; i < roi.height(); ++i, dst += rowElems) {
+            fillPixelsKernel( (float*)dst, fillValue, nComps, roi.width() );
+        }
+        return;
+    }
     for ( int i = 0; i < roi.height(); ++i, dst += (rowElems - roi.width() * nComps) ) {
         for (int j = 0; j < roi.width(); ++j, dst += nComps) {
             for (int k = 0; k < nComps; ++k) {
@@ -1161,6 +1170,7 @@ Image::fill(const RectI & roi,
 {
     
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     
     switch ( getBitDepth() ) {
     case eImageBitDepthByte:
@@ -1170,7 +1180,7 @@ Image::fill(const RectI & roi,
         fillForDepth<unsigned short, 65535>(roi, r, g, b, a);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        fillForDepth<Half, 1>(roi, r, g, b, a);
         break;
     case eImageBitDepthFloat:
         fillForDepth<float, 1>(roi, r, g, b, a);
@@ -1184,6 +1194,7 @@ void
 Image::fillZero(const RectI& roi)
 {
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     RectI intersection;
     if (!roi.intersect(_bounds, &intersection)) {
         return;
@@ -1220,6 +1231,7 @@ void
 Image::fillBoundsZero()
 {
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     
     std::size_t rowSize =  getComponents().getNumComponents();
     switch ( getBitDepth() ) {
@@ -1410,7 +1422,7 @@ Image::halveRoIForDepth(const RectI & roi,
                         Natron::Image* output) const
 {
     assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) ||
-           (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) ||
+           ((getBitDepth() == eImageBitDepthShort || getBitDepth() == eImageBitDepthHalf) && sizeof(PIX) == 2) ||
            (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
 
     ///handle case where there is only 1 column/row
@@ -1423,15 +1435,14 @@ Image::halveRoIForDepth(const RectI & roi,
     
     /// Take the lock for both bitmaps since we're about to read/write from them!
     QWriteLocker k1(&output->_entryLock);
+    output->invalidateStatistics();
     QReadLocker k2(&_entryLock);
 
     ///The source rectangle, intersected to this image region of definition in pixels
     const RectI &srcBounds = _bounds;
     const RectI &dstBounds = output->_bounds;
-    const RectI &srcBmBounds = _bitmap.getBounds();
-    const RectI &dstBmBounds = output->_bitmap.getBounds();
     assert(!copyBitMap || usesBitMap());
-    assert(!usesBitMap() ||(srcBmBounds == srcBounds && dstBmBounds == dstBounds));
+    assert(!usesBitMap() ||(_bitmap.getBounds() == srcBounds && output->_bitmap.getBounds() == dstBounds));
 
     // the srcRoD of the output should be enclosed in half the roi.
     // It does not have to be exactly half of the input.
@@ -1457,9 +1468,7 @@ Image::halveRoIForDepth(const RectI & roi,
   
     
     const PIX* const srcPixels      = (const PIX*)pixelAt(srcBounds.x1,   srcBounds.y1);
-    const char* const srcBmPixels   = _bitmap.getBitmapAt(srcBmBounds.x1, srcBmBounds.y1);
     PIX* const dstPixels          = (PIX*)output->pixelAt(dstBounds.x1,   dstBounds.y1);
-    char* const dstBmPixels = output->_bitmap.getBitmapAt(dstBmBounds.x1, dstBmBounds.y1);
 
     int srcRowSize = srcBounds.width() * nComponents;
     int dstRowSize = dstBounds.width() * nComponents;
@@ -1468,17 +1477,9 @@ Image::halveRoIForDepth(const RectI & roi,
     const PIX* const srcData = srcPixels - (srcBounds.x1 * nComponents + srcRowSize * srcBounds.y1);
     PIX* const dstData       = dstPixels - (dstBounds.x1 * nComponents + dstRowSize * dstBounds.y1);
 
-    const int srcBmRowSize = srcBmBounds.width();
-    const int dstBmRowSize = dstBmBounds.width();
-
-    const char* const srcBmData = srcBmPixels - (srcBmBounds.x1 + srcBmRowSize * srcBmBounds.y1);
-    char* const dstBmData       = dstBmPixels - (dstBmBounds.x1 + dstBmRowSize * dstBmBounds.y1);
-
     for (int y = dstRoI.y1; y < dstRoI.y2; ++y) {
         const PIX* const srcLineStart    = srcData + y * 2 * srcRowSize;
         PIX* const dstLineStart          = dstData + y     * dstRowSize;
-        const char* const srcBmLineStart = srcBmData + y * 2 * srcBmRowSize;
-        char* const dstBmLineStart       = dstBmData + y     * dstBmRowSize;
 
         // The current dst row, at y, covers the src rows y*2 (thisRow) and y*2+1 (nextRow).
         // Check that if are within srcBounds.
@@ -1491,9 +1492,7 @@ Image::halveRoIForDepth(const RectI & roi,
         
         for (int x = dstRoI.x1; x < dstRoI.x2; ++x) {
             const PIX* const srcPixStart    = srcLineStart   + x * 2 * nComponents;
-            const char* const srcBmPixStart = srcBmLineStart + x * 2;
             PIX* const dstPixStart          = dstLineStart   + x * nComponents;
-            char* const dstBmPixStart       = dstBmLineStart + x;
 
             // The current dst col, at y, covers the src cols x*2 (thisCol) and x*2+1 (nextCol).
             // Check that if are within srcBounds.
@@ -1510,9 +1509,6 @@ Image::halveRoIForDepth(const RectI & roi,
                 for (int k = 0; k < nComponents; ++k) {
                     dstPixStart[k] = 0;
                 }
-                if (copyBitMap) {
-                    dstBmPixStart[0] = 0;
-                }
                 continue;
             }
 
@@ -1520,52 +1516,21 @@ Image::halveRoIForDepth(const RectI & roi,
                 ///a b
                 ///c d
 
-                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixStart + k) : 0;
-                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixStart + k + nComponents) : 0;
-                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixStart + k + srcRowSize): 0;
-                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixStart + k + srcRowSize  + nComponents)  : 0;
+                const PIX a = (pickThisCol && pickThisRow) ? *(srcPixStart + k) : PIX(0);
+                const PIX b = (pickNextCol && pickThisRow) ? *(srcPixStart + k + nComponents) : PIX(0);
+                const PIX c = (pickThisCol && pickNextRow) ? *(srcPixStart + k + srcRowSize): PIX(0);
+                const PIX d = (pickNextCol && pickNextRow) ? *(srcPixStart + k + srcRowSize  + nComponents)  : PIX(0);
                 
                 assert(sumW == 2 || (sumW == 1 && ((a == 0 && c == 0) || (b == 0 && d == 0))));
                 assert(sumH == 2 || (sumH == 1 && ((a == 0 && b == 0) || (c == 0 && d == 0))));
                 dstPixStart[k] = (a + b + c + d) / sum;
             }
-            
-            if (copyBitMap) {
-                ///a b
-                ///c d
-
-                char a = (pickThisCol && pickThisRow) ? *(srcBmPixStart) : 0;
-                char b = (pickNextCol && pickThisRow) ? *(srcBmPixStart + 1) : 0;
-                char c = (pickThisCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize): 0;
-                char d = (pickNextCol && pickNextRow) ? *(srcBmPixStart + srcBmRowSize  + 1)  : 0;
-#if NATRON_ENABLE_TRIMAP
-                /*
-                 The only correct solution is to convert pixels being rendered to 0 otherwise the caller
-                 would have to wait for the original fullscale image render to be finished and then re-downscale again.
-                 */
-                if (a == PIXEL_UNAVAILABLE) {
-                    a = 0;
-                }
-                if (b == PIXEL_UNAVAILABLE) {
-                    b = 0;
-                }
-                if (c == PIXEL_UNAVAILABLE) {
-                    c = 0;
-                }
-                if (d == PIXEL_UNAVAILABLE) {
-                    d = 0;
-                }
-#endif
-                assert(sumW == 2 || (sumW == 1 && ((a == 0 && c == 0) || (b == 0 && d == 0))));
-                assert(sumH == 2 || (sumH == 1 && ((a == 0 && b == 0) || (c == 0 && d == 0))));
-                assert(a + b + c + d <= sum); // bitmaps are 0 or 1
-                // the following is an integer division, the result can be 0 or 1
-                dstBmPixStart[0] = (a + b + c + d) / sum;
-                assert(dstBmPixStart[0] == 0 || dstBmPixStart[0] == 1);
-            }
         }
     }
 
+    if (copyBitMap) {
+        output->_bitmap.halveFrom(dstRoI, _bitmap);
+    }
 } // halveRoIForDepth
 
 // code proofread and fixed by @devernay on 8/8/2014
@@ -1582,7 +1547,7 @@ Image::halveRoI(const RectI & roi,
         halveRoIForDepth<unsigned short,65535>(roi,copyBitMap, output);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        halveRoIForDepth<Half,1>(roi,copyBitMap,output);
         break;
     case eImageBitDepthFloat:
         halveRoIForDepth<float,1>(roi,copyBitMap,output);
@@ -1606,6 +1571,7 @@ Image::halve1DImageForDepth(const RectI & roi,
     
     /// Take the lock for both bitmaps since we're about to read/write from them!
     QWriteLocker k1(&output->_entryLock);
+    output->invalidateStatistics();
     QReadLocker k2(&_entryLock);
 
     
@@ -1665,7 +1631,7 @@ Image::halve1DImage(const RectI & roi,
         halve1DImageForDepth<unsigned short, 65535>(roi, output);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        halve1DImageForDepth<Half, 1>(roi, output);
         break;
     case eImageBitDepthFloat:
         halve1DImageForDepth<float, 1>(roi, output);
@@ -1696,7 +1662,7 @@ Image::downscaleMipMap(const RectD& dstRod,
 //    roiCanonical.toPixelEnclosing(toLevel, par , &dstRoI);
     unsigned int downscaleLvls = toLevel - fromLevel;
 
-    assert(!copyBitMap || _bitmap.getBitmap());
+    assert( !copyBitMap || usesBitMap() );
     
     RectI dstRoI  = roi.downscalePowerOfTwoSmallestEnclosing(downscaleLvls);
     
@@ -1723,6 +1689,7 @@ Image::checkForNaNs(const RectI& roi)
     }
  
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     
     unsigned int compsCount = getComponentsCount();
 
@@ -1754,7 +1721,7 @@ Image::upscaleMipMapForDepth(const RectI & roi,
                              Natron::Image* output) const
 {
     assert( getBitDepth() == output->getBitDepth() );
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || ((getBitDepth() == eImageBitDepthShort || getBitDepth() == eImageBitDepthHalf) && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
 
     ///You should not call this function with a level equal to 0.
     assert(fromLevel > toLevel);
@@ -1780,6 +1747,7 @@ Image::upscaleMipMapForDepth(const RectI & roi,
     }
     
     QWriteLocker k1(&output->_entryLock);
+    output->invalidateStatistics();
     QReadLocker k2(&_entryLock);
     
     int srcRowSize = _bounds.width() * components;
@@ -1842,7 +1810,7 @@ Image::upscaleMipMap(const RectI & roi,
         upscaleMipMapForDepth<unsigned short, 65535>(roi, fromLevel, toLevel, output);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        upscaleMipMapForDepth<Half,1>(roi, fromLevel, toLevel, output);
         break;
     case eImageBitDepthFloat:
         upscaleMipMapForDepth<float,1>(roi, fromLevel, toLevel, output);
@@ -1861,10 +1829,11 @@ Image::scaleBoxForDepth(const RectI & roi,
                         Natron::Image* output) const
 {
     assert( getBitDepth() == output->getBitDepth() );
-    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || (getBitDepth() == eImageBitDepthShort && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
+    assert( (getBitDepth() == eImageBitDepthByte && sizeof(PIX) == 1) || ((getBitDepth() == eImageBitDepthShort || getBitDepth() == eImageBitDepthHalf) && sizeof(PIX) == 2) || (getBitDepth() == eImageBitDepthFloat && sizeof(PIX) == 4) );
 
     
     QWriteLocker k1(&output->_entryLock);
+    output->invalidateStatistics();
     QReadLocker k2(&_entryLock);
     
     ///The destination rectangle
@@ -2097,7 +2066,7 @@ Image::scaleBox(const RectI & roi,
         scaleBoxForDepth<unsigned short>(roi, output);
         break;
     case eImageBitDepthHalf:
-        assert(false);
+        scaleBoxForDepth<Half>(roi, output);
         break;
     case eImageBitDepthFloat:
         scaleBoxForDepth<float>(roi, output);
@@ -2130,6 +2099,31 @@ Image::buildMipMapLevel(const RectD& dstRoD,
         return;
     }
 
+    ///The pyramid builder handles all the levels at once, except when a level is 1 pixel wide or high
+    bool fused = true;
+    RectI levelRoI = roi;
+    for (unsigned int i = 1; i <= level; ++i) {
+        if ( (levelRoI.width() <= 1) || (levelRoI.height() <= 1) ) {
+            fused = false;
+            break;
+        }
+        levelRoI = levelRoI.downscalePowerOfTwoSmallestEnclosing(1);
+    }
+    if (fused) {
+        std::vector<ImagePtr> intermediateLevels;
+        std::vector<Natron::Image*> levels;
+        levelRoI = roi;
+        for (unsigned int i = 1; i < level; ++i) {
+            levelRoI = levelRoI.downscalePowerOfTwoSmallestEnclosing(1);
+            intermediateLevels.push_back( ImagePtr( new Natron::Image( getComponents(), dstRoD, levelRoI, getMipMapLevel() + i, getPixelAspectRatio(), getBitDepth(), true) ) );
+            levels.push_back( intermediateLevels.back().get() );
+        }
+        levels.push_back(output);
+        buildMipMapPyramid(dstRoD, roi, levels, copyBitMap);
+
+        return;
+    }
+
     const Natron::Image* srcImg = this;
     Natron::Image* dstImg = NULL;
     bool mustFreeSrc = false;
@@ -2170,6 +2164,228 @@ Image::buildMipMapLevel(const RectD& dstRoD,
     }
 } // buildMipMapLevel
 
+///Computes count pixels from 2x2 pixels that are all within the source image
+template <typename PIX>
+static void
+halvePixels(PIX* dst,
+            const PIX* row,
+            const PIX* nextRow,
+            int nComponents,
+            int count)
+{
+    for (int i = 0; i < count; ++i, dst += nComponents, row += 2 * nComponents, nextRow += 2 * nComponents) {
+        for (int k = 0; k < nComponents; ++k) {
+            const int sum = 4;
+            dst[k] = (row[k] + row[k + nComponents] + nextRow[k] + nextRow[k + nComponents]) / sum;
+        }
+    }
+}
+
+static void
+halvePixels(float* dst,
+            const float* row,
+            const float* nextRow,
+            int nComponents,
+            int count)
+{
+    if ( kernelsEnabled() ) {
+        halvePixelsKernel(dst, row, nextRow, nComponents, count);
+
+        return;
+    }
+    for (int i = 0; i < count; ++i, dst += nComponents, row += 2 * nComponents, nextRow += 2 * nComponents) {
+        for (int k = 0; k < nComponents; ++k) {
+            const int sum = 4;
+            dst[k] = (row[k] + row[k + nComponents] + nextRow[k] + nextRow[k + nComponents]) / sum;
+        }
+    }
+}
+
+///Halves the pixels of dstRect, each one being the average of the 2x2 source pixels it covers that are within srcValid,
+///exactly like halveRoIForDepth. src and dst point to the first pixel of the images, whose bounds are given.
+template <typename PIX>
+static void
+halveRect(const PIX* src,
+          const RectI & srcImgBounds,
+          const RectI & srcValid,
+          PIX* dst,
+          const RectI & dstImgBounds,
+          const RectI & dstRect,
+          int nComponents)
+{
+    int srcRowSize = srcImgBounds.width() * nComponents;
+    int dstRowSize = dstImgBounds.width() * nComponents;
+
+    ///The dst columns covering 2 valid src columns
+    int fullX1 = std::max(dstRect.x1, (srcValid.x1 + 1) >> 1);
+    int fullX2 = std::max( fullX1, std::min(dstRect.x2, srcValid.x2 >> 1) );
+
+    for (int y = dstRect.y1; y < dstRect.y2; ++y) {
+        int srcy = y * 2;
+        bool pickThisRow = srcValid.y1 <= (srcy + 0) && (srcy + 0) < srcValid.y2;
+        bool pickNextRow = srcValid.y1 <= (srcy + 1) && (srcy + 1) < srcValid.y2;
+        int sumH = (int)pickNextRow + (int)pickThisRow;
+        assert(sumH == 1 || sumH == 2);
+
+        ///Only form the pointers of the rows that are within the source image
+        const PIX* const srcLineStart = pickThisRow ? src + (srcy - srcImgBounds.y1) * srcRowSize - srcImgBounds.x1 * nComponents : 0;
+        const PIX* const nextLineStart = pickNextRow ? src + (srcy + 1 - srcImgBounds.y1) * srcRowSize - srcImgBounds.x1 * nComponents : 0;
+        PIX* const dstLineStart = dst + (y - dstImgBounds.y1) * dstRowSize - dstImgBounds.x1 * nComponents;
+
+        int x = dstRect.x1;
+        while (x < dstRect.x2) {
+            if ( (sumH == 2) && (x == fullX1) && (fullX1 < fullX2) ) {
+                halvePixels(dstLineStart + x * nComponents, srcLineStart + x * 2 * nComponents, nextLineStart + x * 2 * nComponents,
+                            nComponents, fullX2 - fullX1);
+                x = fullX2;
+                continue;
+            }
+
+            int srcx = x * 2;
+            bool pickThisCol = srcValid.x1 <= (srcx + 0) && (srcx + 0) < srcValid.x2;
+            bool pickNextCol = srcValid.x1 <= (srcx + 1) && (srcx + 1) < srcValid.x2;
+            int sumW = (int)pickThisCol + (int)pickNextCol;
+            assert(sumW == 1 || sumW == 2);
+            const int sum = sumW * sumH;
+            PIX* const dstPixStart = dstLineStart + x * nComponents;
+
+            for (int k = 0; k < nComponents; ++k) {
+                ///a b
+                ///c d
+                const PIX a = (pickThisCol && pickThisRow) ? *(srcLineStart + srcx * nComponents + k) : PIX(0);
+                const PIX b = (pickNextCol && pickThisRow) ? *(srcLineStart + (srcx + 1) * nComponents + k) : PIX(0);
+                const PIX c = (pickThisCol && pickNextRow) ? *(nextLineStart + srcx * nComponents + k) : PIX(0);
+                const PIX d = (pickNextCol && pickNextRow) ? *(nextLineStart + (srcx + 1) * nComponents + k) : PIX(0);
+                dstPixStart[k] = (a + b + c + d) / sum;
+            }
+            ++x;
+        }
+    }
+}
+
+template <typename PIX>
+void
+Image::buildMipMapPyramidTile(const RectI & lastLevelTile,
+                              const RectI & roi,
+                              const std::vector<Natron::Image*>& levels) const
+{
+    int nComponents = getComponents().getNumComponents();
+    unsigned int lastLevel = levels.size();
+    const PIX* src = (const PIX*)pixelAt(_bounds.x1, _bounds.y1);
+    RectI srcImgBounds = _bounds;
+    ///The first level may use the pixels around the roi, the next ones only have the pixels of the previous level roi
+    RectI srcValid = _bounds;
+    RectI levelRoI = roi;
+
+    for (unsigned int i = 1; i <= lastLevel; ++i) {
+        levelRoI = levelRoI.downscalePowerOfTwoSmallestEnclosing(1);
+
+        ///The part of this level covered by the tile of the last level
+        int scale = 1 << (lastLevel - i);
+        RectI dstRect(lastLevelTile.x1 * scale, lastLevelTile.y1 * scale, lastLevelTile.x2 * scale, lastLevelTile.y2 * scale);
+        if ( !dstRect.intersect(levelRoI, &dstRect) ) {
+            break;
+        }
+
+        Natron::Image* output = levels[i - 1];
+        PIX* dst = (PIX*)output->pixelAt(output->_bounds.x1, output->_bounds.y1);
+        halveRect<PIX>(src, srcImgBounds, srcValid, dst, output->_bounds, dstRect, nComponents);
+
+        src = dst;
+        srcImgBounds = output->_bounds;
+        srcValid = levelRoI;
+    }
+}
+
+template <typename PIX>
+void
+Image::buildMipMapPyramidForDepth(const RectI & roi,
+                                  const std::vector<Natron::Image*>& levels) const
+{
+    RectI lastLevelRoI = roi.downscalePowerOfTwoSmallestEnclosing( levels.size() );
+    std::vector<RectI> tiles = lastLevelRoI.splitIntoSmallerRects( QThread::idealThreadCount() );
+
+    if (tiles.size() <= 1) {
+        buildMipMapPyramidTile<PIX>(lastLevelRoI, roi, levels);
+    } else {
+        ///The tiles that the threads of the render scheduler did not start are built by this thread
+        forEachInRenderScheduler( tiles.begin(), tiles.end(), boost::bind(&Image::buildMipMapPyramidTile<PIX>, this, _1, roi, boost::cref(levels)) );
+    }
+}
+
+void
+Image::buildMipMapPyramid(const RectD& dstRoD,
+                          const RectI & roi,
+                          const std::vector<Natron::Image*>& levels,
+                          bool copyBitMap) const
+{
+    if ( levels.empty() ) {
+        return;
+    }
+    assert( !copyBitMap || usesBitMap() );
+
+    bool fused = true;
+    RectI levelRoI = roi;
+    for (std::size_t i = 0; i < levels.size(); ++i) {
+        assert( levels[i]->getComponents() == getComponents() && levels[i]->getBitDepth() == getBitDepth() );
+        if ( (levelRoI.width() <= 1) || (levelRoI.height() <= 1) ) {
+            fused = false;
+        }
+        levelRoI = levelRoI.downscalePowerOfTwoSmallestEnclosing(1);
+        assert( levels[i]->getBounds().contains(levelRoI) );
+    }
+    if (!fused) {
+        ///halve1DImage is needed for the levels that are 1 pixel wide or high, build the levels one by one
+        for (std::size_t i = 0; i < levels.size(); ++i) {
+            buildMipMapLevel(dstRoD, roi, i + 1, copyBitMap, levels[i]);
+        }
+
+        return;
+    }
+
+    {
+        /// Take the lock for all the bitmaps since we're about to read/write from them!
+        QReadLocker k(&_entryLock);
+        std::vector<boost::shared_ptr<QWriteLocker> > outputLocks;
+        for (std::vector<Natron::Image*>::const_iterator it = levels.begin(); it != levels.end(); ++it) {
+            outputLocks.push_back( boost::shared_ptr<QWriteLocker>( new QWriteLocker(&(*it)->_entryLock) ) );
+            (*it)->invalidateStatistics();
+        }
+
+        assert(_bounds.x1 <= roi.x1 && roi.x2 <= _bounds.x2 &&
+               _bounds.y1 <= roi.y1 && roi.y2 <= _bounds.y2);
+
+        switch ( getBitDepth() ) {
+        case eImageBitDepthByte:
+            buildMipMapPyramidForDepth<unsigned char>(roi, levels);
+            break;
+        case eImageBitDepthShort:
+            buildMipMapPyramidForDepth<unsigned short>(roi, levels);
+            break;
+        case eImageBitDepthHalf:
+            buildMipMapPyramidForDepth<Half>(roi, levels);
+            break;
+        case eImageBitDepthFloat:
+            buildMipMapPyramidForDepth<float>(roi, levels);
+            break;
+        case eImageBitDepthNone:
+            break;
+        }
+
+        if (copyBitMap) {
+            const Bitmap* srcBitmap = &_bitmap;
+            levelRoI = roi;
+            for (std::vector<Natron::Image*>::const_iterator it = levels.begin(); it != levels.end(); ++it) {
+                levelRoI = levelRoI.downscalePowerOfTwoSmallestEnclosing(1);
+                if ( (*it)->usesBitMap() ) {
+                    (*it)->_bitmap.halveFrom(levelRoI, *srcBitmap);
+                }
+                srcBitmap = &(*it)->_bitmap;
+            }
+        }
+    }
+} // buildMipMapPyramid
+
 double
 Image::getScaleFromMipMapLevel(unsigned int level)
 {
@@ -2200,15 +2416,7 @@ Image::copyBitmapRowPortion(int x1, int x2,int y, const Image& other)
 void
 Bitmap::copyRowPortion(int x1,int x2,int y,const Bitmap& other)
 {
-    const char* srcBitmap = other.getBitmapAt(x1, y);
-    char* dstBitmap = getBitmapAt(x1, y);
-    const char* end = dstBitmap + (x2 - x1);
-    while (dstBitmap < end) {
-        *dstBitmap = /**srcBitmap == PIXEL_UNAVAILABLE ? 0 : */*srcBitmap;
-        ++dstBitmap;
-        ++srcBitmap;
-    }
-    
+    copyBitmapPortion(RectI(x1, y, x2, y + 1), other);
 }
 
 void
@@ -2223,28 +2431,98 @@ Bitmap::copyBitmapPortion(const RectI& roi, const Bitmap& other)
 {
     assert(roi.x1 >= _bounds.x1 && roi.x2 <= _bounds.x2 && roi.y1 >= _bounds.y1 && roi.y2 <= _bounds.y2);
     assert(roi.x1 >= other._bounds.x1 && roi.x2 <= other._bounds.x2 && roi.y1 >= other._bounds.y1 && roi.y2 <= other._bounds.y2);
-    
-    int srcRowSize = other._bounds.width();
-    int dstRowSize = _bounds.width();
-    
-    const char* srcBitmap = other.getBitmapAt(roi.x1, roi.y1);
-    char* dstBitmap = getBitmapAt(roi.x1, roi.y1);
-    
-    for (int y = roi.y1; y < roi.y2; ++y,
-         srcBitmap += srcRowSize,
-         dstBitmap += dstRowSize) {
-        
-        const char* srcCur = srcBitmap;
-        const char* srcEnd = srcBitmap + roi.width();
-        char* dstCur = dstBitmap;
-        while (srcCur < srcEnd) {
-            *dstCur = /**srcCur == PIXEL_UNAVAILABLE ? 0 : */*srcCur;
-            ++srcCur;
-            ++dstCur;
+
+    if ( roi.isNull() ) {
+        return;
+    }
+
+    ///Both bitmaps have their tiles on the same grid, hence a tile of this bitmap only copies from the same tile of other
+    int ty2 = tileIndex(roi.y2 - 1);
+    int tx2 = tileIndex(roi.x2 - 1);
+    for (int ty = tileIndex(roi.y1); ty <= ty2; ++ty) {
+        for (int tx = tileIndex(roi.x1); tx <= tx2; ++tx) {
+            const Tile& srcTile = other.getTile(tx, ty);
+            RectI r;
+            tileRect(tx, ty).intersect(roi, &r);
+            if (srcTile.state != BITMAP_TILE_MIXED) {
+                fill(r, srcTile.state);
+                continue;
+            }
+            Tile& dstTile = getTile(tx, ty);
+            expandTile(dstTile);
+            for (int y = r.y1; y < r.y2; ++y) {
+                int offset = pixelIndexInTile(r.x1, y);
+                memcpy( &dstTile.pixels[offset], &srcTile.pixels[offset], r.width() );
+            }
+            RectI tileBounds;
+            tileRect(tx, ty).intersect(_bounds, &tileBounds);
+            compactTile(dstTile, tileBounds);
         }
     }
 }
 
+void
+Bitmap::halveFrom(const RectI& dstRoI,
+                  const Bitmap& src)
+{
+    RectI roi;
+
+    if ( !dstRoI.intersect(_bounds, &roi) ) {
+        return;
+    }
+
+    int ty2 = tileIndex(roi.y2 - 1);
+    int tx2 = tileIndex(roi.x2 - 1);
+    for (int ty = tileIndex(roi.y1); ty <= ty2; ++ty) {
+        for (int tx = tileIndex(roi.x1); tx <= tx2; ++tx) {
+            RectI r;
+            tileRect(tx, ty).intersect(roi, &r);
+
+            ///The pixels of src covered by this portion of the tile
+            RectI srcRect(r.x1 * 2, r.y1 * 2, r.x2 * 2, r.y2 * 2);
+            int states = src.getStatesInRect(srcRect);
+            /*
+             Pixels being rendered are converted to 0 otherwise the caller would have to wait for the original
+             fullscale image render to be finished and then re-downscale again.
+             */
+            if ( !(states & eBitmapStateMaskRendered) ) {
+                fill(r, 0);
+                continue;
+            }
+            if (states == eBitmapStateMaskRendered) {
+                fill(r, 1);
+                continue;
+            }
+
+            ///A dst pixel is rendered if all the src pixels it covers within the src bounds are rendered
+            Tile& tile = getTile(tx, ty);
+            expandTile(tile);
+            const RectI& srcBounds = src.getBounds();
+            for (int y = r.y1; y < r.y2; ++y) {
+                char* dst = &tile.pixels[pixelIndexInTile(r.x1, y)];
+                for (int x = r.x1; x < r.x2; ++x, ++dst) {
+                    char rendered = 1;
+                    for (int sy = y * 2; sy < y * 2 + 2 && rendered; ++sy) {
+                        if ( (sy < srcBounds.y1) || (sy >= srcBounds.y2) ) {
+                            continue;
+                        }
+                        for (int sx = x * 2; sx < x * 2 + 2; ++sx) {
+                            if ( (sx >= srcBounds.x1) && (sx < srcBounds.x2) && (src.getStateAt(sx, sy) != 1) ) {
+                                rendered = 0;
+                                break;
+                            }
+                        }
+                    }
+                    *dst = rendered;
+                }
+            }
+            RectI tileBounds;
+            tileRect(tx, ty).intersect(_bounds, &tileBounds);
+            compactTile(tile, tileBounds);
+        }
+    }
+} // halveFrom
+
 template <typename PIX, bool doPremult>
 void
 Image::premultInternal(const RectI& roi)
@@ -2261,6 +2539,12 @@ Image::premultInternal(const RectI& roi)
     int srcRowElements = 4 * _bounds.width();
     
     PIX* dstPix = (PIX*)acc.pixelAt(renderWindow.x1, renderWindow.y1);
+    if ( getBitDepth() == eImageBitDepthFloat && kernelsEnabled() ) {
+        for (int y = renderWindow.y1; y < renderWindow.y2; ++y, dstPix += srcRowElements) {
+            premultPixelsKernel( (float*)dstPix, renderWindow.x2 - renderWindow.x1, doPremult );
+        }
+        return;
+    }
     for (int y = renderWindow.y1; y < renderWindow.y2; ++y, dstPix += (srcRowElements - (renderWindow.x2 - renderWindow.x1) * 4)) {
         for (int x = renderWindow.x1; x < renderWindow.x2; ++x, dstPix += 4) {
             for (int c = 0; c < 3; ++c) {
@@ -2292,6 +2576,9 @@ Image::premultForDepth(const RectI& roi)
         case Natron::eImageBitDepthShort:
             premultInternal<unsigned short, doPremult>(roi);
             break;
+        case Natron::eImageBitDepthHalf:
+            premultInternal<Half, doPremult>(roi);
+            break;
         case Natron::eImageBitDepthFloat:
             premultInternal<float, doPremult>(roi);
             break;
@@ -27,6 +27,7 @@
 
 #include <list>
 #include <map>
+#include <vector>
 #include <algorithm> // min, max
 
 #include "Global/GlobalDefines.h"
@@ -35,17 +36,20 @@ CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QHash>
 CLANG_DIAG_ON(deprecated)
 #include <QtCore/QReadWriteLock>
+#include <QtCore/QMutex>
 
 #include "Engine/ImageKey.h"
 #include "Engine/ImageComponents.h"
 #include "Engine/ImageParams.h"
 #include "Engine/CacheEntry.h"
+#include "Engine/Half.h"
 #include "Engine/RectD.h"
 #include "Engine/OutputSchedulerThread.h"
 
 class CacheEntryHolder;
 
 namespace Natron {
+    class ImageStatistics;
 
     
     class GenericAccess
@@ -59,47 +63,63 @@ namespace Natron {
         }
     };
     
+    /**
+     * @brief Holds the render state of each pixel of an image: 0 if the pixel is not rendered, 1 if it is rendered
+     * and 2 (trimap only) if it is being rendered by another thread.
+     * The bounds are split in tiles of 2^NATRON_BITMAP_TILE_SIZE_POT pixels on each side, aligned on a grid
+     * starting at the origin so that the tiles of 2 bitmaps covering the same pixels match. A tile whose pixels are all
+     * in the same state only stores this state, otherwise it stores one byte per pixel. Renders mark large
+     * rectangles, hence most tiles are uniform and the scans done by minimalNonMarkedRects() jump over them at once.
+     **/
     class Bitmap
     {
+        struct Tile
+        {
+            ///One of the pixel states, or -1 if the tile is mixed and the state of each pixel is in pixels
+            char state;
+            std::vector<char> pixels;
+
+            Tile()
+            : state(0)
+            , pixels()
+            {
+            }
+        };
+
     public:
         Bitmap(const RectI & bounds)
-        : _bounds(bounds)
+        : _bounds()
+        , _tilesBounds()
         , _dirtyZone()
         , _dirtyZoneSet(false)
-        , _map( bounds.area() )
+        , _tiles()
+        , _mixedTilesCount(0)
         {
             //Do not assert !rod.isNull() : An empty image can be created for entries that correspond to
             // "identities" images (i.e: images that are just a link to another image). See EffectInstance :
             // "!!!Note that if isIdentity is true it will allocate an empty image object with 0 bytes of data."
             //assert(!rod.isNull());
-            std::fill(_map.begin(), _map.end(), 0);
+            initialize(bounds);
         }
 
         Bitmap()
         : _bounds()
+        , _tilesBounds()
         , _dirtyZone()
         , _dirtyZoneSet(false)
-        , _map()
+        , _tiles()
+        , _mixedTilesCount(0)
         {
         }
         
-        void initialize(const RectI & bounds)
-        {
-            _bounds = bounds;
-            _map.resize( _bounds.area() );
-
-            std::fill(_map.begin(), _map.end(), 0);
-        }
+        void initialize(const RectI & bounds);
 
         ~Bitmap()
         {
         }
 
         
-        void setTo1()
-        {
-            std::fill(_map.begin(),_map.end(),1);
-        }
+        void setTo1();
 
         const RectI & getBounds() const
         {
@@ -127,30 +147,58 @@ namespace Natron {
         
         void swap(Natron::Bitmap& other);
 
-        const char* getBitmap() const
-        {
-            return &_map.front();
-        }
+        ///Returns the state of the given pixel, which must be inside the bounds
+        char getStateAt(int x,int y) const;
 
-        char* getBitmap()
-        {
-            return &_map.front();
-        }
-
-        const char* getBitmapAt(int x,int y) const;
-        char* getBitmapAt(int x,int y);
+        /**
+         * @brief Returns a mask with the bit (1 << state) set for each state found in the roi.
+         * If stopMask is not 0, the scan stops as soon as one of the states in stopMask is found.
+         **/
+        int getStatesInRect(const RectI& roi, int stopMask = 0) const;
         
         void copyRowPortion(int x1,int x2,int y,const Bitmap& other);
         
         void copyBitmapPortion(const RectI& roi, const Bitmap& other);
+
+        /**
+         * @brief Sets the state of the pixels of dstRoI to the state of the pixels of the 2x larger src bitmap:
+         * a pixel is rendered only if all the pixels of src it covers are rendered.
+         **/
+        void halveFrom(const RectI& dstRoI, const Bitmap& src);
         
         void setDirtyZone(const RectI& zone) {
             _dirtyZone = zone;
             _dirtyZoneSet = true;
         }
+
+        ///The number of bytes used by the bitmap
+        std::size_t getMemorySize() const;
         
     private:
+
+        Tile& getTile(int tx, int ty)
+        {
+            return _tiles[(ty - _tilesBounds.y1) * _tilesBounds.width() + (tx - _tilesBounds.x1)];
+        }
+
+        const Tile& getTile(int tx, int ty) const
+        {
+            return _tiles[(ty - _tilesBounds.y1) * _tilesBounds.width() + (tx - _tilesBounds.x1)];
+        }
+
+        ///Sets the state of all the pixels of roi, which must be contained in the bounds
+        void fill(const RectI& roi, char state);
+
+        ///Converts a uniform tile to a tile storing its pixels
+        void expandTile(Tile& tile);
+
+        ///Converts a tile storing its pixels to a uniform tile if all the pixels of rect (the tile intersected with the bounds) have the same state
+        void compactTile(Tile& tile, const RectI& rect);
+
         RectI _bounds;
+
+        ///The tiles covering _bounds, in tile coordinates
+        RectI _tilesBounds;
         
         /**
          * This represents the zone that has potentially something to render. In minimalNonMarkedRects
@@ -160,7 +208,10 @@ namespace Natron {
          **/
         RectI _dirtyZone;
         bool _dirtyZoneSet;
-        std::vector<char> _map;
+        std::vector<Tile> _tiles;
+
+        ///The number of tiles storing their pixels
+        int _mixedTilesCount;
     };
 
     class Image
@@ -171,8 +222,7 @@ namespace Natron {
         Image(const ImageKey & key,
               const boost::shared_ptr<ImageParams> &  params,
               const Natron::CacheAPI* cache,
-              Natron::StorageModeEnum storage,
-              const std::string & path);
+              Natron::StorageModeEnum storage);
         
         
 
@@ -198,6 +248,8 @@ namespace Natron {
 
         virtual void onMemoryAllocated(bool diskRestoration) OVERRIDE FINAL;
 
+        virtual std::size_t getCompressionElementSize() const OVERRIDE FINAL;
+
         static ImageKey makeKey(const CacheEntryHolder* holder,
                                 U64 nodeHashKey,
                                 bool frameVaryingOrAnimated,
@@ -284,7 +336,7 @@ namespace Natron {
             std::size_t dt = dataSize();
             
             bool got = _entryLock.tryLockForRead();
-            dt += _bitmap.getBounds().area();
+            dt += _bitmap.getMemorySize();
             if (got) {
                 _entryLock.unlock();
             }
@@ -385,12 +437,6 @@ namespace Natron {
                 assert(img);
                 return img->pixelAt(x, y);
             }
-            
-            const char* bitmapAt(int x, int y) const
-            {
-                assert(img);
-                return img->getBitmapAt(x, y);
-            }
         };
         
         /**
@@ -430,12 +476,6 @@ namespace Natron {
             {
                 return img->pixelAt(x, y);
             }
-            
-            char* bitmapAt(int x, int y) const
-            {
-                assert(img);
-                return img->getBitmapAt(x, y);
-            }
         };
         
         ReadAccess getReadRights() const
@@ -458,18 +498,6 @@ namespace Natron {
          * of an image.
          **/
         
-        const char* getBitmapAt(int x,
-                                int y) const
-        {
-            return this->_bitmap.getBitmapAt(x,y);
-        }
-        
-        char* getBitmapAt(int x,
-                          int y)
-        {
-            return this->_bitmap.getBitmapAt(x,y);
-        }
-        
         /**
          * @brief Access pixels. The pointer must be cast to the appropriate type afterwards.
          **/
@@ -500,6 +528,7 @@ namespace Natron {
         void lockForWrite() const
         {
             _entryLock.lockForWrite();
+            invalidateStatistics();
         }
         
         void unlock() const
@@ -646,6 +675,7 @@ namespace Natron {
             RectI intersection;
             _bounds.intersect(roi, &intersection);
             _bitmap.markForRendered(intersection);
+            invalidateStatistics();
         }
         
 #if NATRON_ENABLE_TRIMAP
@@ -671,6 +701,7 @@ namespace Natron {
             RectI intersection;
             _bounds.intersect(roi, &intersection);
             _bitmap.clear(intersection);
+            invalidateStatistics();
         }
         
 #ifdef DEBUG
@@ -724,6 +755,15 @@ namespace Natron {
      **/
         void upscaleMipMap(const RectI & roi, unsigned int fromLevel, unsigned int toLevel, Natron::Image* output) const;
 
+        /**
+     * @brief Builds the mipmap levels 1 to levels.size() of the roi of this image in a single pass: levels[i] receives
+     * the roi halved i + 1 times and must contain roi.downscalePowerOfTwoSmallestEnclosing(i + 1).
+     * The roi is processed by tiles, in parallel, each tile going through all the levels while it is still in the
+     * CPU caches. The results are the same as the ones of buildMipMapLevel for each level.
+     * The output images may be cached images so that the intermediate levels can be reused.
+     **/
+        void buildMipMapPyramid(const RectD& dstRoD, const RectI & roi, const std::vector<Natron::Image*>& levels, bool copyBitMap) const;
+
         /**
      * @brief Scales the roi of this image to the size of the output image.
      * This is used internally by buildMipMapLevel when the image is a NPOT.
@@ -783,6 +823,13 @@ namespace Natron {
                              bool copyBitMap,
                              bool requiresUnpremult,
                              Natron::Image* dstImg) const;
+
+        /**
+         * @brief Returns a new image holding the portion of this image inside roi converted to the given bit depth,
+         * without colorspace conversion. Returns NULL if roi does not intersect the bounds of this image.
+         **/
+        boost::shared_ptr<Image> convertToBitDepth(const RectI& roi,
+                                                   Natron::ImageBitDepthEnum depth) const;
         
     private:
         
@@ -826,6 +873,18 @@ namespace Natron {
          */
         bool checkForNaNs(const RectI& roi) WARN_UNUSED_RETURN;
 
+        /**
+         * @brief Returns the statistics of the given channels of the image over roi (clipped to the bounds), computed in
+         * parallel. The last statistics computed are cached with the image until its pixels are written to.
+         * Implemented in ImageStatistics.cpp
+         **/
+        boost::shared_ptr<const Natron::ImageStatistics> getStatistics(Natron::DisplayChannelsEnum channels, const RectI& roi) const;
+
+        /**
+         * @brief Drops the cached statistics: must be called whenever the pixels are written to.
+         **/
+        void invalidateStatistics() const;
+
         void copyBitmapRowPortion(int x1, int x2,int y, const Image& other);
 
         void copyBitmapPortion(const RectI& roi, const Image& other);
@@ -936,6 +995,12 @@ namespace Natron {
         template <typename PIX, int maxValue>
         void halve1DImageForDepth(const RectI & roi, Natron::Image* output) const;
 
+        template <typename PIX>
+        void buildMipMapPyramidForDepth(const RectI & roi, const std::vector<Natron::Image*>& levels) const;
+
+        template <typename PIX>
+        void buildMipMapPyramidTile(const RectI & lastLevelTile, const RectI & roi, const std::vector<Natron::Image*>& levels) const;
+
         template <typename PIX,int maxValue>
         void upscaleMipMapForDepth(const RectI & roi, unsigned int fromLevel, unsigned int toLevel, Natron::Image* output) const;
 
@@ -958,6 +1023,12 @@ namespace Natron {
         RectI _bounds;
         double _par;
         bool _useBitmap;
+
+        ///The statistics returned by getStatistics(), most recently used first
+        mutable QMutex _statisticsMutex;
+        mutable std::list<boost::shared_ptr<const Natron::ImageStatistics> > _statistics;
+        ///Incremented by invalidateStatistics(): statistics computed while it changed are not cached
+        mutable U64 _statisticsGeneration;
     };
 
     template <typename SRCPIX,typename DSTPIX>
@@ -988,6 +1059,7 @@ namespace Natron {
     template<> inline unsigned char clampIfInt(float v) { return (unsigned char)clamp<float>(v, 0, 255); }
     template<> inline unsigned short clampIfInt(float v) { return (unsigned short)clamp<float>(v, 0, 65535); }
     template<> inline float clampIfInt(float v) { return v; }
+    template<> inline Half clampIfInt(float v) { return v; }
     
     typedef boost::shared_ptr<Natron::Image> ImagePtr;
     typedef std::list<ImagePtr> ImageList;
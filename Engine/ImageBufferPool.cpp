@@ -0,0 +1,451 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageBufferPool.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <map>
+#include <list>
+#include <vector>
+#include <new> // bad_alloc
+#include <algorithm>
+#include <climits>
+
+#include "Global/Macros.h"
+#ifdef __NATRON_WIN32__
+#include <malloc.h> // _aligned_malloc
+#endif
+
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QMutex>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QAtomicInt>
+CLANG_DIAG_ON(deprecated)
+
+///Maximum size of the free-lists before setImageBufferPoolMaximumSize() is called
+#define IMAGE_BUFFER_POOL_DEFAULT_MAXIMUM_SIZE 268435456
+
+using namespace Natron;
+
+namespace {
+
+/**
+ * @brief Rounds up size to its size class. size must be at least NATRON_IMAGE_BUFFER_POOL_MIN_SIZE.
+ * The classes between 2 consecutive powers of 2 are 4 evenly spaced sizes, which are all multiples of the page size.
+ **/
+std::size_t
+getSizeClass(std::size_t size)
+{
+    std::size_t power = NATRON_IMAGE_BUFFER_POOL_MIN_SIZE;
+
+    ///size is then in ]power, 2 * power], unless it is the minimum size
+    while (power * 2 < size) {
+        power *= 2;
+    }
+    if (size <= power) {
+        return power;
+    }
+    std::size_t step = power / 4;
+
+    return power + ( (size - power + step - 1) / step ) * step;
+}
+
+void*
+systemAllocate(std::size_t size)
+{
+#ifdef __NATRON_WIN32__
+
+    return _aligned_malloc(size, NATRON_IMAGE_BUFFER_POOL_ALIGNMENT);
+#else
+    void* ret = 0;
+    if (posix_memalign(&ret, NATRON_IMAGE_BUFFER_POOL_ALIGNMENT, size) != 0) {
+        return 0;
+    }
+
+    return ret;
+#endif
+}
+
+void
+systemFree(void* buffer)
+{
+#ifdef __NATRON_WIN32__
+    _aligned_free(buffer);
+#else
+    free(buffer);
+#endif
+}
+
+typedef std::vector<std::pair<std::size_t, void*> > BuffersList;
+
+/**
+ * @brief The free-list of a thread and its share of the statistics. The lock is only contended when another
+ * thread trims the pool or reads the statistics.
+ **/
+struct ThreadBuffersCache
+{
+    QMutex lock;
+    BuffersList buffers;
+    std::size_t size;
+
+    ///These may become negative because a buffer is not always freed by the thread which allocated it
+    boost::int64_t usedSize;
+    boost::int64_t usedBuffersCount;
+    U64 hits;
+    U64 misses;
+
+    ThreadBuffersCache();
+
+    ~ThreadBuffersCache();
+};
+
+struct ImageBufferPool
+{
+    QMutex lock;
+
+    ///The global free-lists, by size class
+    std::map<std::size_t, std::vector<void*> > buffers;
+    std::size_t size;
+    std::size_t buffersCount;
+    std::list<ThreadBuffersCache*> threadCaches;
+
+    ///The pages held by all the free-lists, the global ones and the ones of the threads, and the maximum allowed.
+    ///They are counted in pages rather than bytes so that they fit in an atomic int: the threads reserve their
+    ///share of the budget without taking the lock.
+    QAtomicInt pooledPages;
+    QAtomicInt maximumPages;
+
+    ///The statistics of the threads that exited
+    boost::int64_t usedSize;
+    boost::int64_t usedBuffersCount;
+    U64 hits;
+    U64 misses;
+
+    ///Owns the ThreadBuffersCache and deletes them when the threads exit
+    QThreadStorage<ThreadBuffersCache*> localCache;
+
+    ImageBufferPool()
+        : lock()
+        , buffers()
+        , size(0)
+        , buffersCount(0)
+        , threadCaches()
+        , pooledPages(0)
+        , maximumPages(IMAGE_BUFFER_POOL_DEFAULT_MAXIMUM_SIZE / NATRON_IMAGE_BUFFER_POOL_ALIGNMENT)
+        , usedSize(0)
+        , usedBuffersCount(0)
+        , hits(0)
+        , misses(0)
+        , localCache()
+    {
+    }
+
+    ThreadBuffersCache* getLocalCache()
+    {
+        if ( !localCache.hasLocalData() ) {
+            ThreadBuffersCache* cache = new ThreadBuffersCache;
+            {
+                QMutexLocker k(&lock);
+                threadCaches.push_back(cache);
+            }
+            localCache.setLocalData(cache);
+        }
+
+        return localCache.localData();
+    }
+
+    /**
+     * @brief Reserves room in the budget for a buffer about to enter a free-list. Returns false if the
+     * buffer would make the free-lists exceed the maximum size, the buffer must then go back to the system.
+     **/
+    bool reservePooledSize(std::size_t sizeClass)
+    {
+        int pages = (int)(sizeClass / NATRON_IMAGE_BUFFER_POOL_ALIGNMENT);
+
+        if (pooledPages.fetchAndAddRelaxed(pages) + pages > (int)maximumPages) {
+            pooledPages.fetchAndAddRelaxed(-pages);
+
+            return false;
+        }
+
+        return true;
+    }
+
+    ///Must be called whenever a buffer leaves a free-list
+    void releasePooledSize(std::size_t sizeClass)
+    {
+        pooledPages.fetchAndAddRelaxed( -(int)(sizeClass / NATRON_IMAGE_BUFFER_POOL_ALIGNMENT) );
+    }
+
+    ///Must be called with lock taken. Returns false if the buffer would make the pool exceed its maximum size.
+    bool pushBuffer_locked(std::size_t sizeClass,
+                           void* buffer)
+    {
+        if ( !reservePooledSize(sizeClass) ) {
+            return false;
+        }
+        buffers[sizeClass].push_back(buffer);
+        size += sizeClass;
+        ++buffersCount;
+
+        return true;
+    }
+
+    ///Must be called with lock taken, appends the released buffers to toFree
+    void trim_locked(std::size_t maxPooledSize,
+                     std::vector<void*>* toFree)
+    {
+        ///Release the largest buffers first, they are the least likely to be reused
+        while ( size > maxPooledSize && !buffers.empty() ) {
+            std::map<std::size_t, std::vector<void*> >::iterator it = buffers.end();
+            --it;
+            toFree->push_back( it->second.back() );
+            it->second.pop_back();
+            size -= it->first;
+            --buffersCount;
+            releasePooledSize(it->first);
+            if ( it->second.empty() ) {
+                buffers.erase(it);
+            }
+        }
+    }
+};
+
+///Never destroyed: buffers may still be freed by other static objects when the application exits
+ImageBufferPool* pool = new ImageBufferPool;
+
+ThreadBuffersCache::ThreadBuffersCache()
+    : lock()
+    , buffers()
+    , size(0)
+    , usedSize(0)
+    , usedBuffersCount(0)
+    , hits(0)
+    , misses(0)
+{
+}
+
+ThreadBuffersCache::~ThreadBuffersCache()
+{
+    ///The thread is exiting: give the free-list back to the global one
+    std::vector<void*> toFree;
+    {
+        QMutexLocker k(&pool->lock);
+        pool->threadCaches.remove(this);
+        for (BuffersList::iterator it = buffers.begin(); it != buffers.end(); ++it) {
+            pool->releasePooledSize(it->first);
+            if ( !pool->pushBuffer_locked(it->first, it->second) ) {
+                toFree.push_back(it->second);
+            }
+        }
+        pool->usedSize += usedSize;
+        pool->usedBuffersCount += usedBuffersCount;
+        pool->hits += hits;
+        pool->misses += misses;
+    }
+    for (std::vector<void*>::iterator it = toFree.begin(); it != toFree.end(); ++it) {
+        systemFree(*it);
+    }
+}
+} // anon namespace
+
+namespace Natron {
+
+void*
+allocateImageBuffer(std::size_t size)
+{
+    if (size < NATRON_IMAGE_BUFFER_POOL_MIN_SIZE) {
+        void* ret = malloc(size);
+        if (!ret) {
+            throw std::bad_alloc();
+        }
+
+        return ret;
+    }
+
+    std::size_t sizeClass = getSizeClass(size);
+    ThreadBuffersCache* localCache = pool->getLocalCache();
+    void* ret = 0;
+    {
+        QMutexLocker k(&localCache->lock);
+        for (BuffersList::reverse_iterator it = localCache->buffers.rbegin(); it != localCache->buffers.rend(); ++it) {
+            if (it->first == sizeClass) {
+                ret = it->second;
+                localCache->buffers.erase( ( it + 1 ).base() );
+                localCache->size -= sizeClass;
+                pool->releasePooledSize(sizeClass);
+                break;
+            }
+        }
+    }
+
+    if (!ret) {
+        QMutexLocker k(&pool->lock);
+        std::map<std::size_t, std::vector<void*> >::iterator found = pool->buffers.find(sizeClass);
+        if ( found != pool->buffers.end() ) {
+            ret = found->second.back();
+            found->second.pop_back();
+            pool->size -= sizeClass;
+            --pool->buffersCount;
+            pool->releasePooledSize(sizeClass);
+            if ( found->second.empty() ) {
+                pool->buffers.erase(found);
+            }
+        }
+    }
+
+    bool hit = ret != 0;
+    if (!ret) {
+        ret = systemAllocate(sizeClass);
+        if (!ret) {
+            ///The free buffers of the other size classes may be what prevents the allocation
+            trimImageBufferPool(0);
+            ret = systemAllocate(sizeClass);
+            if (!ret) {
+                throw std::bad_alloc();
+            }
+        }
+    }
+
+    QMutexLocker k(&localCache->lock);
+    localCache->usedSize += sizeClass;
+    ++localCache->usedBuffersCount;
+    if (hit) {
+        ++localCache->hits;
+    } else {
+        ++localCache->misses;
+    }
+
+    return ret;
+}
+
+void
+freeImageBuffer(void* buffer,
+                std::size_t size)
+{
+    if (!buffer) {
+        return;
+    }
+    if (size < NATRON_IMAGE_BUFFER_POOL_MIN_SIZE) {
+        free(buffer);
+
+        return;
+    }
+
+    std::size_t sizeClass = getSizeClass(size);
+    ThreadBuffersCache* localCache = pool->getLocalCache();
+    {
+        QMutexLocker k(&localCache->lock);
+        localCache->usedSize -= sizeClass;
+        --localCache->usedBuffersCount;
+        ///The free-list of the thread counts against the maximum size of the pool too
+        if ( (localCache->size + sizeClass <= NATRON_IMAGE_BUFFER_POOL_THREAD_CACHE_SIZE) && pool->reservePooledSize(sizeClass) ) {
+            localCache->buffers.push_back( std::make_pair(sizeClass, buffer) );
+            localCache->size += sizeClass;
+
+            return;
+        }
+    }
+
+    bool pooled;
+    {
+        QMutexLocker k(&pool->lock);
+        pooled = pool->pushBuffer_locked(sizeClass, buffer);
+    }
+    if (!pooled) {
+        systemFree(buffer);
+    }
+}
+
+void
+trimImageBufferPool(std::size_t maxPooledSize)
+{
+    std::vector<void*> toFree;
+    {
+        QMutexLocker k(&pool->lock);
+        pool->trim_locked(maxPooledSize, &toFree);
+
+        std::size_t pooledSize = pool->size;
+        for (std::list<ThreadBuffersCache*>::iterator it = pool->threadCaches.begin(); it != pool->threadCaches.end(); ++it) {
+            QMutexLocker tk(&(*it)->lock);
+            pooledSize += (*it)->size;
+        }
+
+        ///Only empty the threads free-lists if the global free-lists could not be trimmed enough
+        if (pooledSize > maxPooledSize) {
+            for (std::list<ThreadBuffersCache*>::iterator it = pool->threadCaches.begin(); it != pool->threadCaches.end(); ++it) {
+                QMutexLocker tk(&(*it)->lock);
+                for (BuffersList::iterator it2 = (*it)->buffers.begin(); it2 != (*it)->buffers.end(); ++it2) {
+                    toFree.push_back(it2->second);
+                    pool->releasePooledSize(it2->first);
+                }
+                (*it)->buffers.clear();
+                (*it)->size = 0;
+            }
+        }
+    }
+    for (std::vector<void*>::iterator it = toFree.begin(); it != toFree.end(); ++it) {
+        systemFree(*it);
+    }
+}
+
+void
+setImageBufferPoolMaximumSize(std::size_t size)
+{
+    pool->maximumPages = (int)std::min( size / NATRON_IMAGE_BUFFER_POOL_ALIGNMENT, (std::size_t)INT_MAX );
+    ///This also empties the free-lists of the threads if they make the pool exceed its new budget
+    trimImageBufferPool(size);
+}
+
+std::size_t
+getImageBufferAllocationSize(std::size_t size)
+{
+    return size < NATRON_IMAGE_BUFFER_POOL_MIN_SIZE ? size : getSizeClass(size);
+}
+
+void
+getImageBufferPoolStats(ImageBufferPoolStats* stats)
+{
+    assert(stats);
+    QMutexLocker k(&pool->lock);
+    boost::int64_t usedSize = pool->usedSize;
+    boost::int64_t usedBuffersCount = pool->usedBuffersCount;
+    stats->pooledSize = pool->size;
+    stats->pooledBuffersCount = pool->buffersCount;
+    stats->hits = pool->hits;
+    stats->misses = pool->misses;
+    for (std::list<ThreadBuffersCache*>::iterator it = pool->threadCaches.begin(); it != pool->threadCaches.end(); ++it) {
+        QMutexLocker tk(&(*it)->lock);
+        usedSize += (*it)->usedSize;
+        usedBuffersCount += (*it)->usedBuffersCount;
+        stats->pooledSize += (*it)->size;
+        stats->pooledBuffersCount += (*it)->buffers.size();
+        stats->hits += (*it)->hits;
+        stats->misses += (*it)->misses;
+    }
+    stats->usedSize = std::max( (boost::int64_t)0, usedSize );
+    stats->usedBuffersCount = std::max( (boost::int64_t)0, usedBuffersCount );
+}
+} // namespace Natron
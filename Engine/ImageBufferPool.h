@@ -0,0 +1,102 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_IMAGEBUFFERPOOL_H
+#define NATRON_ENGINE_IMAGEBUFFERPOOL_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstddef>
+
+#include "Global/GlobalDefines.h"
+
+/*
+ * The image buffer pool recycles the large buffers holding images and plug-ins memory instead of giving them back
+ * to the system allocator: images are allocated and freed continuously during playback and doing it with malloc/free
+ * makes the process memory fragment and grow.
+ *
+ * Buffers of at least NATRON_IMAGE_BUFFER_POOL_MIN_SIZE bytes are page-aligned and their size is rounded up to
+ * a size class: each power of 2 is split in 4 classes so that at most 25% of a buffer is wasted.
+ * A freed buffer first goes to a small free-list owned by the calling thread, which is accessed without contention,
+ * then to the global free-list of its size class. All the free-lists, including the ones of the threads, are bounded
+ * together by setImageBufferPoolMaximumSize() and are trimmed when the system runs short of memory.
+ *
+ * Smaller buffers are handled directly by malloc/free.
+ *
+ * All functions are thread-safe.
+ */
+
+namespace Natron {
+
+struct ImageBufferPoolStats
+{
+    U64 usedSize; //< bytes held by buffers currently in use, including the size class rounding
+    U64 usedBuffersCount;
+    U64 pooledSize; //< bytes held by free buffers waiting to be recycled, in the global and threads free-lists
+    U64 pooledBuffersCount;
+    U64 hits; //< number of allocations served by a recycled buffer
+    U64 misses; //< number of allocations that had to go to the system allocator
+
+    ImageBufferPoolStats()
+        : usedSize(0)
+        , usedBuffersCount(0)
+        , pooledSize(0)
+        , pooledBuffersCount(0)
+        , hits(0)
+        , misses(0)
+    {
+    }
+};
+
+/**
+ * @brief Returns a buffer of at least size bytes. size must be the same value that is given to freeImageBuffer().
+ * Throws std::bad_alloc if the buffer could not be allocated, after trying to release the free buffers of the pool.
+ **/
+void* allocateImageBuffer(std::size_t size);
+
+/**
+ * @brief Gives back a buffer returned by allocateImageBuffer(size) to the pool.
+ **/
+void freeImageBuffer(void* buffer, std::size_t size);
+
+/**
+ * @brief Gives back the free buffers of the pool to the system until the pool holds at most maxPooledSize bytes.
+ * The buffers in the free-lists of the threads are released too.
+ **/
+void trimImageBufferPool(std::size_t maxPooledSize = 0);
+
+/**
+ * @brief Sets the maximum number of bytes the free buffers of the pool may hold. The pool is trimmed accordingly.
+ **/
+void setImageBufferPoolMaximumSize(std::size_t size);
+
+/**
+ * @brief Returns the number of bytes actually taken by a buffer returned by allocateImageBuffer(size), that is
+ * size rounded up to its size class.
+ **/
+std::size_t getImageBufferAllocationSize(std::size_t size);
+
+void getImageBufferPoolStats(ImageBufferPoolStats* stats);
+
+} // namespace Natron
+
+#endif // NATRON_ENGINE_IMAGEBUFFERPOOL_H
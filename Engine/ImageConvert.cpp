@@ -25,6 +25,7 @@
 #include "Image.h"
 
 #include <algorithm> // min, max
+#include <cstring> // memcpy
 
 #include <QDebug>
 #ifndef Q_MOC_RUN
@@ -104,8 +105,57 @@ convertPixelDepth(float pix)
 {
     return pix;
 }
+
+template <>
+Half
+convertPixelDepth(unsigned char pix)
+{
+    return Color::intToFloat<256>(pix);
+}
+
+template <>
+Half
+convertPixelDepth(unsigned short pix)
+{
+    return Color::intToFloat<65536>(pix);
+}
+
+template <>
+Half
+convertPixelDepth(Half pix)
+{
+    return pix;
+}
+
+template <>
+Half
+convertPixelDepth(float pix)
+{
+    return pix;
+}
+
+template <>
+unsigned char
+convertPixelDepth(Half pix)
+{
+    return (unsigned char)Color::floatToInt<256>(pix);
 }
 
+template <>
+unsigned short
+convertPixelDepth(Half pix)
+{
+    return (unsigned short)Color::floatToInt<65536>(pix);
+}
+
+template <>
+float
+convertPixelDepth(Half pix)
+{
+    return pix;
+}
+} // namespace Natron
+
 static const Natron::Color::Lut*
 lutFromColorspace(Natron::ViewerColorSpaceEnum cs)
 {
@@ -130,6 +180,51 @@ lutFromColorspace(Natron::ViewerColorSpaceEnum cs)
     return lut;
 }
 
+///Converts count values without colorspace conversion nor dithering, using the bulk conversion functions
+///when there is one. Returns false if there is none, in which case the pixels must be converted one by one.
+template <typename SRCPIX,typename DSTPIX>
+static bool
+convertRowFast(const SRCPIX* /*src*/,
+               DSTPIX* /*dst*/,
+               std::size_t /*count*/)
+{
+    return false;
+}
+
+///Same depth without colorspace conversion: this is a copy
+template <typename PIX>
+static bool
+convertRowFast(const PIX* src,
+               PIX* dst,
+               std::size_t count)
+{
+    memcpy( dst, src, count * sizeof(PIX) );
+
+    return true;
+}
+
+template <>
+bool
+convertRowFast(const Half* src,
+               float* dst,
+               std::size_t count)
+{
+    convertHalfToFloat(src, dst, count);
+
+    return true;
+}
+
+template <>
+bool
+convertRowFast(const float* src,
+               Half* dst,
+               std::size_t count)
+{
+    convertFloatToHalf(src, dst, count);
+
+    return true;
+}
+
 ///Fast version when components are the same
 template <typename SRCPIX,typename DSTPIX,int srcMaxValue,int dstMaxValue>
 void
@@ -161,6 +256,16 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
         return;
     }
     for (int y = 0; y < intersection.height(); ++y) {
+        if ( !srcLut && !dstLut &&
+             convertRowFast( (const SRCPIX*)srcImg.pixelAt(intersection.x1, intersection.y1 + y),
+                             (DSTPIX*)dstImg.pixelAt(intersection.x1, intersection.y1 + y),
+                             (std::size_t)intersection.width() * nComp ) ) {
+            if (copyBitmap) {
+                dstImg.copyBitmapRowPortion(intersection.x1, intersection.x2, intersection.y1 + y, srcImg);
+            }
+            continue;
+        }
+
         // coverity[dont_call]
         int start = rand() % intersection.width();
         const SRCPIX* srcPixels = (const SRCPIX*)srcImg.pixelAt(intersection.x1 + start, intersection.y1 + y);
@@ -204,7 +309,7 @@ Image::convertToFormatInternal_sameComps(const RectI & renderWindow,
                                                              Color::floatToInt<0xff01>(pixFloat) );
                             pix = error[k] >> 8;
                         } else if (dstDepth == eImageBitDepthShort) {
-                            pix = dstLut ? dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
+                            pix = dstLut ? (DSTPIX)dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
                                   convertPixelDepth<float, DSTPIX>(pixFloat);
                         } else {
                             if (dstLut) {
@@ -346,11 +451,11 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                             break;
                         case 3:
                             // RGB is opaque, so no alpha, unless channelForAlpha is 0-2
-                            pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? 0. : srcPixels[channelForAlpha]);
+                            pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? SRCPIX(0) : srcPixels[channelForAlpha]);
                             break;
                         case 2:
                             // XY is opaque unless channelForAlpha is  0-1
-                            pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? 0. : srcPixels[channelForAlpha]);
+                            pix = convertPixelDepth<SRCPIX, DSTPIX>(channelForAlpha == -1 ? SRCPIX(0) : srcPixels[channelForAlpha]);
                             break;
                         case 1:
                             // just copy alpha disregarding channelForAlpha
@@ -389,7 +494,7 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                         }
                         
                         for (int k = 0; k < 3 && k < dstNComps; ++k) {
-                            SRCPIX sourcePixel = k < srcNComps ? srcPixels[k] : 0.;
+                            SRCPIX sourcePixel = k < srcNComps ? srcPixels[k] : SRCPIX(0);
                             DSTPIX pix;
                             if (!useColorspaces || (!srcLut && !dstLut)) {
                                 if (dstMaxValue == 255) {
@@ -433,7 +538,7 @@ Image::convertToFormatInternalForColorSpace(const RectI & renderWindow,
                                     pix = error[k] >> 8;
                                     
                                 } else if (dstMaxValue == 65535) {
-                                    pix = dstLut ? dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
+                                    pix = dstLut ? (DSTPIX)dstLut->toColorSpaceUint16FromLinearFloatFast(pixFloat) :
                                     convertPixelDepth<float, DSTPIX>(pixFloat);
                                     
                                 } else {
@@ -699,6 +804,7 @@ Image::convertToFormatCommon(const RectI & renderWindow,
 {
     
     QWriteLocker k(&dstImg->_entryLock);
+    dstImg->invalidateStatistics();
     QReadLocker k2(&_entryLock);
     
     assert( _bounds.contains(renderWindow) &&  dstImg->_bounds.contains(renderWindow) );
@@ -719,6 +825,9 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                                      dstColorSpace,copyBitmap);
                         break;
                     case eImageBitDepthHalf:
+                        convertToFormatInternal_sameComps<Half, unsigned char, 1, 255>(renderWindow,*this, *dstImg,
+                                                                                       srcColorSpace,
+                                                                                       dstColorSpace,copyBitmap);
                         break;
                     case eImageBitDepthFloat:
                         convertToFormatInternal_sameComps<float, unsigned char, 1, 255>(renderWindow,*this, *dstImg,
@@ -730,7 +839,6 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                 }
                 break;
             }
-                
             case eImageBitDepthShort: {
                 switch ( getBitDepth() ) {
                     case eImageBitDepthByte:
@@ -745,6 +853,9 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                                         dstColorSpace,copyBitmap);
                         break;
                     case eImageBitDepthHalf:
+                        convertToFormatInternal_sameComps<Half, unsigned short, 1, 65535>(renderWindow,*this, *dstImg,
+                                                                                          srcColorSpace,
+                                                                                          dstColorSpace,copyBitmap);
                         break;
                     case eImageBitDepthFloat:
                         convertToFormatInternal_sameComps<float, unsigned short, 1, 65535>(renderWindow,*this, *dstImg,
@@ -756,10 +867,34 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                 }
                 break;
             }
-
-            case eImageBitDepthHalf:
+            case eImageBitDepthHalf: {
+                switch ( getBitDepth() ) {
+                    case eImageBitDepthByte:
+                        convertToFormatInternal_sameComps<unsigned char, Half, 255, 1>(renderWindow,*this, *dstImg,
+                                                                                       srcColorSpace,
+                                                                                       dstColorSpace,copyBitmap);
+                        break;
+                    case eImageBitDepthShort:
+                        convertToFormatInternal_sameComps<unsigned short, Half, 65535, 1>(renderWindow,*this, *dstImg,
+                                                                                          srcColorSpace,
+                                                                                          dstColorSpace,copyBitmap);
+                        break;
+                    case eImageBitDepthHalf:
+                        ///Same as a copy
+                        convertToFormatInternal_sameComps<Half, Half, 1, 1>(renderWindow,*this, *dstImg,
+                                                                            srcColorSpace,
+                                                                            dstColorSpace,copyBitmap);
+                        break;
+                    case eImageBitDepthFloat:
+                        convertToFormatInternal_sameComps<float, Half, 1, 1>(renderWindow,*this, *dstImg,
+                                                                             srcColorSpace,
+                                                                             dstColorSpace,copyBitmap);
+                        break;
+                    case eImageBitDepthNone:
+                        break;
+                }
                 break;
-
+            }
             case eImageBitDepthFloat: {
                 switch ( getBitDepth() ) {
                     case eImageBitDepthByte:
@@ -773,6 +908,9 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                            dstColorSpace,copyBitmap);
                         break;
                     case eImageBitDepthHalf:
+                        convertToFormatInternal_sameComps<Half, float, 1, 1>(renderWindow,*this, *dstImg,
+                                                                             srcColorSpace,
+                                                                             dstColorSpace,copyBitmap);
                         break;
                     case eImageBitDepthFloat:
                         ///Same as a copy
@@ -785,12 +923,10 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                 }
                 break;
             }
-                
             case eImageBitDepthNone:
                 break;
         } // switch
     } else {
-        
         switch ( dstImg->getBitDepth() ) {
             case eImageBitDepthByte: {
                 switch ( getBitDepth() ) {
@@ -811,6 +947,12 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                                    copyBitmap,requiresUnpremult);
                         break;
                     case eImageBitDepthHalf:
+                        convertToFormatInternalForDepth<Half, unsigned char, 1, 255>(renderWindow,*this, *dstImg,
+                                                                                     srcColorSpace,
+                                                                                     dstColorSpace,
+                                                                                     channelForAlpha,
+                                                                                     useAlpha0,
+                                                                                     copyBitmap,requiresUnpremult);
                         break;
                     case eImageBitDepthFloat:
                         convertToFormatInternalForDepth<float, unsigned char, 1, 255>(renderWindow,*this, *dstImg,
@@ -819,7 +961,6 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                       channelForAlpha,
                                                                                       useAlpha0,
                                                                                       copyBitmap,requiresUnpremult);
-                        
                         break;
                     case eImageBitDepthNone:
                         break;
@@ -835,7 +976,6 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                                    channelForAlpha,
                                                                                                    useAlpha0,
                                                                                                    copyBitmap,requiresUnpremult);
-                        
                         break;
                     case eImageBitDepthShort:
                         convertToFormatInternalForDepth<unsigned short, unsigned short, 65535, 65535>(renderWindow,*this, *dstImg,
@@ -844,9 +984,14 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                                       channelForAlpha,
                                                                                                       useAlpha0,
                                                                                                       copyBitmap,requiresUnpremult);
-                        
                         break;
                     case eImageBitDepthHalf:
+                        convertToFormatInternalForDepth<Half, unsigned short, 1, 65535>(renderWindow,*this, *dstImg,
+                                                                                        srcColorSpace,
+                                                                                        dstColorSpace,
+                                                                                        channelForAlpha,
+                                                                                        useAlpha0,
+                                                                                        copyBitmap,requiresUnpremult);
                         break;
                     case eImageBitDepthFloat:
                         convertToFormatInternalForDepth<float, unsigned short, 1, 65535>(renderWindow,*this, *dstImg,
@@ -861,8 +1006,45 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                 }
                 break;
             }
-            case eImageBitDepthHalf:
+            case eImageBitDepthHalf: {
+                switch ( getBitDepth() ) {
+                    case eImageBitDepthByte:
+                        convertToFormatInternalForDepth<unsigned char, Half, 255, 1>(renderWindow,*this, *dstImg,
+                                                                                     srcColorSpace,
+                                                                                     dstColorSpace,
+                                                                                     channelForAlpha,
+                                                                                     useAlpha0,
+                                                                                     copyBitmap,requiresUnpremult);
+                        break;
+                    case eImageBitDepthShort:
+                        convertToFormatInternalForDepth<unsigned short, Half, 65535, 1>(renderWindow,*this, *dstImg,
+                                                                                        srcColorSpace,
+                                                                                        dstColorSpace,
+                                                                                        channelForAlpha,
+                                                                                        useAlpha0,
+                                                                                        copyBitmap,requiresUnpremult);
+                        break;
+                    case eImageBitDepthHalf:
+                        convertToFormatInternalForDepth<Half, Half, 1, 1>(renderWindow,*this, *dstImg,
+                                                                          srcColorSpace,
+                                                                          dstColorSpace,
+                                                                          channelForAlpha,
+                                                                          useAlpha0,
+                                                                          copyBitmap,requiresUnpremult);
+                        break;
+                    case eImageBitDepthFloat:
+                        convertToFormatInternalForDepth<float, Half, 1, 1>(renderWindow,*this, *dstImg,
+                                                                           srcColorSpace,
+                                                                           dstColorSpace,
+                                                                           channelForAlpha,
+                                                                           useAlpha0,
+                                                                           copyBitmap,requiresUnpremult);
+                        break;
+                    case eImageBitDepthNone:
+                        break;
+                }
                 break;
+            }
             case eImageBitDepthFloat: {
                 switch ( getBitDepth() ) {
                     case eImageBitDepthByte:
@@ -880,9 +1062,14 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                                                                                          channelForAlpha,
                                                                                          useAlpha0,
                                                                                          copyBitmap,requiresUnpremult);
-                        
                         break;
                     case eImageBitDepthHalf:
+                        convertToFormatInternalForDepth<Half, float, 1, 1>(renderWindow,*this, *dstImg,
+                                                                           srcColorSpace,
+                                                                           dstColorSpace,
+                                                                           channelForAlpha,
+                                                                           useAlpha0,
+                                                                           copyBitmap,requiresUnpremult);
                         break;
                     case eImageBitDepthFloat:
                         convertToFormatInternalForDepth<float, float, 1, 1>(renderWindow,*this, *dstImg,
@@ -897,12 +1084,11 @@ Image::convertToFormatCommon(const RectI & renderWindow,
                 }
                 break;
             }
-                
-            default:
+            case eImageBitDepthNone:
                 break;
         } // switch
     }
-}
+} // convertToFormatCommon
 
 void
 Image::convertToFormat(const RectI & renderWindow,
@@ -927,3 +1113,18 @@ Image::convertToFormatAlpha0(const RectI & renderWindow,
 {
     convertToFormatCommon(renderWindow, srcColorSpace, dstColorSpace, channelForAlpha, true, copyBitmap, requiresUnpremult, dstImg);
 }
+
+boost::shared_ptr<Image>
+Image::convertToBitDepth(const RectI & roi,
+                         Natron::ImageBitDepthEnum depth) const
+{
+    RectI bounds;
+
+    if ( !roi.intersect(_bounds, &bounds) ) {
+        return boost::shared_ptr<Image>();
+    }
+    boost::shared_ptr<Image> ret( new Image(getComponents(), getRoD(), bounds, getMipMapLevel(), getPixelAspectRatio(), depth, false) );
+    convertToFormat(bounds, eViewerColorSpaceLinear, eViewerColorSpaceLinear, -1, false, false, ret.get());
+
+    return ret;
+}
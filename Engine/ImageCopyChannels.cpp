@@ -26,6 +26,8 @@
 
 #include <QDebug>
 
+#include "Engine/ImageKernels.h"
+
 using namespace Natron;
 
 template <typename PIX, int maxValue, int srcNComps, int dstNComps, bool doR, bool doG, bool doB, bool doA, bool premult, bool originalPremult>
@@ -54,7 +56,17 @@ Image::copyUnProcessedChannelsForPremult(const RectI& roi,
     assert(srcNComps == 4 || !originalPremult); // only RGBA can be premult
     assert(dstNComps == 4 || !premult); // only RGBA can be premult
 
+    ///The rows of float RGBA pixels entirely covered by the original image are processed by the vectorized kernel
+    const bool useKernel = srcNComps == 4 && dstNComps == 4 && originalImage && getBitDepth() == eImageBitDepthFloat && kernelsEnabled();
+    const bool copyChannel[4] = { doR, doG, doB, doA };
+    const RectI srcBounds = originalImage ? originalImage->_bounds : RectI();
+
     for (int y = roi.y1; y < roi.y2; ++y, dst_pixels += (dstRowElements - (roi.x2 - roi.x1) * dstNComps)) {
+        if ( useKernel && (y >= srcBounds.y1) && (y < srcBounds.y2) && (roi.x1 >= srcBounds.x1) && (roi.x2 <= srcBounds.x2) ) {
+            copyChannelsKernel( (float*)dst_pixels, (const float*)acc.pixelAt(roi.x1, y), roi.x2 - roi.x1, copyChannel, premult, originalPremult );
+            dst_pixels += (roi.x2 - roi.x1) * dstNComps;
+            continue;
+        }
         for (int x = roi.x1; x < roi.x2; ++x, dst_pixels += dstNComps) {
             const PIX* src_pixels = originalImage ? (const PIX*)acc.pixelAt(x, y) : 0;
             PIX srcA = src_pixels ? maxValue : 0; /* be opaque for anything that doesn't contain alpha */
@@ -411,8 +423,14 @@ Image::copyUnProcessedChannels(const RectI& roi,
         return;
     }
     
+    ///The original image may have another bit depth, e.g: when this image is cached in half float
+    ImagePtr original = originalImage;
+    if ( original && (original->getBitDepth() != getBitDepth()) ) {
+        original = original->convertToBitDepth(roi, getBitDepth());
+    }
+
     QWriteLocker k(&_entryLock);
-    assert(!originalImage || getBitDepth() == originalImage->getBitDepth());
+    invalidateStatistics();
     
     
     RectI intersected;
@@ -422,13 +440,16 @@ Image::copyUnProcessedChannels(const RectI& roi,
     bool originalPremult = (originalImagePremult == eImagePremultiplicationPremultiplied);
     switch (getBitDepth()) {
         case eImageBitDepthByte:
-            copyUnProcessedChannelsForDepth<unsigned char, 255>(premult, roi, doR, doG, doB, doA, originalImage, originalPremult);
+            copyUnProcessedChannelsForDepth<unsigned char, 255>(premult, roi, doR, doG, doB, doA, original, originalPremult);
             break;
         case eImageBitDepthShort:
-            copyUnProcessedChannelsForDepth<unsigned short, 65535>(premult, roi, doR, doG, doB, doA, originalImage, originalPremult);
+            copyUnProcessedChannelsForDepth<unsigned short, 65535>(premult, roi, doR, doG, doB, doA, original, originalPremult);
+            break;
+        case eImageBitDepthHalf:
+            copyUnProcessedChannelsForDepth<Half, 1>(premult, roi, doR, doG, doB, doA, original, originalPremult);
             break;
         case eImageBitDepthFloat:
-            copyUnProcessedChannelsForDepth<float, 1>(premult, roi, doR, doG, doB, doA, originalImage, originalPremult);
+            copyUnProcessedChannelsForDepth<float, 1>(premult, roi, doR, doG, doB, doA, original, originalPremult);
             break;
         default:
             return;
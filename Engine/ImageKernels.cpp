@@ -0,0 +1,1523 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageKernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+#include "Engine/Half.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NATRON_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+///AVX2 functions are compiled with the target attribute so that the rest of the code does not require AVX2.
+///This needs GCC 4.9 or a recent clang, older compilers only get the SSE2 kernels.
+#if defined(NATRON_KERNELS_SSE2) && \
+    ( defined(_MSC_VER) || defined(__clang__) || ( defined(__GNUC__) && ( __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9) ) ) )
+#define NATRON_KERNELS_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define NATRON_KERNELS_TARGET_AVX2
+#else
+#define NATRON_KERNELS_TARGET_AVX2 __attribute__( ( target("avx2") ) )
+#endif
+#endif
+
+using namespace Natron;
+
+namespace {
+
+KernelInstructionSetEnum
+detectInstructionSet()
+{
+#ifdef NATRON_KERNELS_AVX2
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osUsesXSave = ( info[2] & (1 << 27) ) != 0;
+        bool cpuHasAVX = ( info[2] & (1 << 28) ) != 0;
+        ///The OS must save the AVX registers on context switches
+        if ( osUsesXSave && cpuHasAVX && ( (_xgetbv(0) & 6) == 6 ) ) {
+            __cpuidex(info, 7, 0);
+            if ( info[1] & (1 << 5) ) {
+                return eKernelInstructionSetAVX2;
+            }
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) {
+        return eKernelInstructionSetAVX2;
+    }
+#endif
+#endif // NATRON_KERNELS_AVX2
+#ifdef NATRON_KERNELS_SSE2
+
+    return eKernelInstructionSetSSE2;
+#else
+
+    return eKernelInstructionSetNone;
+#endif
+}
+
+const KernelInstructionSetEnum supportedInstructionSet = detectInstructionSet();
+KernelInstructionSetEnum currentInstructionSet = supportedInstructionSet;
+
+///The scalar version of statisticsKernel for the values first to count, the partial sums being already started
+inline void
+statisticsTail(const float* values,
+               std::size_t first,
+               std::size_t count,
+               float* minValue,
+               float* maxValue,
+               double* partial,
+               U32* keys)
+{
+    for (std::size_t i = first; i < count; ++i) {
+        float v = values[i];
+        keys[i] = statisticsKey(v);
+        if (v == v) {
+            *minValue = std::min(*minValue, v);
+            *maxValue = std::max(*maxValue, v);
+            partial[i % 4] += v;
+        }
+    }
+}
+
+#ifdef NATRON_KERNELS_SSE2
+
+///Returns the lanes of a where mask is set and the lanes of b elsewhere
+inline __m128
+selectSSE2(__m128 mask,
+           __m128 a,
+           __m128 b)
+{
+    return _mm_or_ps( _mm_and_ps(mask, a), _mm_andnot_ps(mask, b) );
+}
+
+inline __m128
+laneMaskSSE2(bool l0,
+             bool l1,
+             bool l2,
+             bool l3)
+{
+    return _mm_castsi128_ps( _mm_set_epi32(l3 ? -1 : 0, l2 ? -1 : 0, l1 ? -1 : 0, l0 ? -1 : 0) );
+}
+
+inline __m128
+broadcastAlphaSSE2(__m128 p)
+{
+    return _mm_shuffle_ps( p, p, _MM_SHUFFLE(3, 3, 3, 3) );
+}
+
+void
+fillPixelsSSE2(float* dst,
+               const float* pixel,
+               int nComps,
+               std::size_t count)
+{
+    ///4 pixels span nComps vectors
+    float pattern[16];
+
+    for (int i = 0; i < 4 * nComps; ++i) {
+        pattern[i] = pixel[i % nComps];
+    }
+    __m128 v[4];
+    for (int k = 0; k < nComps; ++k) {
+        v[k] = _mm_loadu_ps(pattern + 4 * k);
+    }
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4, dst += 4 * nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            _mm_storeu_ps(dst + 4 * k, v[k]);
+        }
+    }
+    for (; i < count; ++i, dst += nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            dst[k] = pixel[k];
+        }
+    }
+}
+
+void
+premultPixelsSSE2(float* pixels,
+                  std::size_t count,
+                  bool doPremult)
+{
+    const __m128 colorLanes = laneMaskSSE2(true, true, true, false);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (std::size_t i = 0; i < count; ++i, pixels += 4) {
+        __m128 p = _mm_loadu_ps(pixels);
+        __m128 a = broadcastAlphaSSE2(p);
+        if (doPremult) {
+            p = selectSSE2( colorLanes, _mm_mul_ps(p, a), p );
+        } else {
+            p = selectSSE2( _mm_and_ps( colorLanes, _mm_cmpneq_ps(a, zero) ), _mm_div_ps(p, a), p );
+        }
+        _mm_storeu_ps(pixels, p);
+    }
+}
+
+void
+mixPixelsSSE2(float* dst,
+              const float* src,
+              const float* mask,
+              int nComps,
+              std::size_t count,
+              float mix,
+              bool maskInvert)
+{
+    if (!mask) {
+        ///The same alpha for all the pixels, components do not matter
+        std::size_t n = count * nComps;
+        const float oneMinusMix = 1.f - mix;
+        const __m128 alpha = _mm_set1_ps(mix);
+        const __m128 oneMinusAlpha = _mm_set1_ps(oneMinusMix);
+        std::size_t i = 0;
+        if (src) {
+            for (; i + 4 <= n; i += 4) {
+                __m128 d = _mm_loadu_ps(dst + i);
+                __m128 s = _mm_loadu_ps(src + i);
+                _mm_storeu_ps( dst + i, _mm_add_ps( _mm_mul_ps(d, alpha), _mm_mul_ps(oneMinusAlpha, s) ) );
+            }
+            for (; i < n; ++i) {
+                dst[i] = dst[i] * mix + oneMinusMix * src[i];
+            }
+        } else {
+            for (; i + 4 <= n; i += 4) {
+                _mm_storeu_ps( dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), alpha) );
+            }
+            for (; i < n; ++i) {
+                dst[i] = dst[i] * mix;
+            }
+        }
+
+        return;
+    }
+
+    std::size_t i = 0;
+    if (nComps == 4) {
+        for (; i < count; ++i, dst += 4) {
+            float a = mix * (maskInvert ? 1.f - mask[i] : mask[i]);
+            __m128 alpha = _mm_set1_ps(a);
+            __m128 d = _mm_mul_ps(_mm_loadu_ps(dst), alpha);
+            if (src) {
+                d = _mm_add_ps( d, _mm_mul_ps( _mm_set1_ps(1.f - a), _mm_loadu_ps(src) ) );
+                src += 4;
+            }
+            _mm_storeu_ps(dst, d);
+        }
+    } else if (nComps == 1) {
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 mixV = _mm_set1_ps(mix);
+        for (; i + 4 <= count; i += 4) {
+            __m128 m = _mm_loadu_ps(mask + i);
+            if (maskInvert) {
+                m = _mm_sub_ps(one, m);
+            }
+            __m128 alpha = _mm_mul_ps(mixV, m);
+            __m128 d = _mm_mul_ps(_mm_loadu_ps(dst + i), alpha);
+            if (src) {
+                d = _mm_add_ps( d, _mm_mul_ps( _mm_sub_ps(one, alpha), _mm_loadu_ps(src + i) ) );
+            }
+            _mm_storeu_ps(dst + i, d);
+        }
+        dst += i;
+        if (src) {
+            src += i;
+        }
+    }
+    for (; i < count; ++i, dst += nComps) {
+        float a = mix * (maskInvert ? 1.f - mask[i] : mask[i]);
+        for (int c = 0; c < nComps; ++c) {
+            dst[c] = src ? dst[c] * a + (1.f - a) * src[c] : dst[c] * a;
+        }
+        if (src) {
+            src += nComps;
+        }
+    }
+} // mixPixelsSSE2
+
+template <bool premult, bool srcPremult, bool copyAlpha>
+void
+copyChannelsSSE2(float* dst,
+                 const float* src,
+                 std::size_t count,
+                 const bool copyChannel[4])
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 copyLanes = laneMaskSSE2(copyChannel[0], copyChannel[1], copyChannel[2], false);
+    const __m128 keepLanes = laneMaskSSE2(!copyChannel[0], !copyChannel[1], !copyChannel[2], false);
+    const __m128 alphaLane = laneMaskSSE2(false, false, false, true);
+
+    for (std::size_t i = 0; i < count; ++i, dst += 4, src += 4) {
+        __m128 s = _mm_loadu_ps(src);
+        __m128 d = _mm_loadu_ps(dst);
+        __m128 sa = broadcastAlphaSSE2(s);
+        __m128 da = broadcastAlphaSSE2(d);
+        __m128 v;
+        if (srcPremult) {
+            if (premult && copyAlpha) {
+                ///dst will have the same alpha as src
+                v = s;
+            } else {
+                v = _mm_div_ps(s, sa);
+                if (premult) {
+                    v = _mm_mul_ps(v, da);
+                }
+                ///don't try to unpremult pixels with a 0 alpha
+                v = selectSSE2(_mm_cmpeq_ps(sa, zero), s, v);
+            }
+        } else {
+            if (premult) {
+                v = _mm_mul_ps(s, copyAlpha ? sa : da);
+            } else {
+                v = s;
+            }
+        }
+        __m128 out = selectSSE2(copyLanes, v, d);
+        if (copyAlpha) {
+            if (premult) {
+                ///the channels that are not copied keep their color but take the new alpha
+                __m128 repremult = _mm_mul_ps(_mm_div_ps(d, da), sa);
+                out = selectSSE2(_mm_and_ps( keepLanes, _mm_cmpneq_ps(da, zero) ), repremult, out);
+            }
+            out = selectSSE2(alphaLane, sa, out);
+        }
+        _mm_storeu_ps(dst, out);
+    }
+}
+
+void
+halvePixelsSSE2(float* dst,
+                const float* row,
+                const float* nextRow,
+                int nComps,
+                std::size_t count)
+{
+    const __m128 four = _mm_set1_ps(4.f);
+    std::size_t i = 0;
+
+    if (nComps == 4) {
+        for (; i < count; ++i, dst += 4, row += 8, nextRow += 8) {
+            __m128 a = _mm_loadu_ps(row);
+            __m128 b = _mm_loadu_ps(row + 4);
+            __m128 c = _mm_loadu_ps(nextRow);
+            __m128 d = _mm_loadu_ps(nextRow + 4);
+            _mm_storeu_ps( dst, _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(a, b), c), d), four) );
+        }
+
+        return;
+    } else if (nComps == 1) {
+        for (; i + 4 <= count; i += 4, dst += 4, row += 8, nextRow += 8) {
+            ///separate the even and odd columns
+            __m128 r0 = _mm_loadu_ps(row);
+            __m128 r1 = _mm_loadu_ps(row + 4);
+            __m128 n0 = _mm_loadu_ps(nextRow);
+            __m128 n1 = _mm_loadu_ps(nextRow + 4);
+            __m128 a = _mm_shuffle_ps( r0, r1, _MM_SHUFFLE(2, 0, 2, 0) );
+            __m128 b = _mm_shuffle_ps( r0, r1, _MM_SHUFFLE(3, 1, 3, 1) );
+            __m128 c = _mm_shuffle_ps( n0, n1, _MM_SHUFFLE(2, 0, 2, 0) );
+            __m128 d = _mm_shuffle_ps( n0, n1, _MM_SHUFFLE(3, 1, 3, 1) );
+            _mm_storeu_ps( dst, _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(a, b), c), d), four) );
+        }
+    }
+    for (; i < count; ++i, dst += nComps, row += 2 * nComps, nextRow += 2 * nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            dst[k] = (row[k] + row[k + nComps] + nextRow[k] + nextRow[k + nComps]) / 4;
+        }
+    }
+}
+
+void
+gainOffsetPixelsSSE2(float* pixels,
+                     std::size_t count,
+                     float gain,
+                     float offset)
+{
+    const __m128 colorLanes = laneMaskSSE2(true, true, true, false);
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 o = _mm_set1_ps(offset);
+
+    for (std::size_t i = 0; i < count; ++i, pixels += 4) {
+        __m128 p = _mm_loadu_ps(pixels);
+        _mm_storeu_ps( pixels, selectSSE2( colorLanes, _mm_add_ps(_mm_mul_ps(p, g), o), p ) );
+    }
+}
+
+void
+luminancePixelsSSE2(float* pixels,
+                    std::size_t count)
+{
+    const __m128 colorLanes = laneMaskSSE2(true, true, true, false);
+    const __m128 weights = _mm_setr_ps(0.299f, 0.587f, 0.114f, 0.f);
+
+    for (std::size_t i = 0; i < count; ++i, pixels += 4) {
+        __m128 p = _mm_loadu_ps(pixels);
+        __m128 m = _mm_mul_ps(p, weights);
+        __m128 l = _mm_add_ps( _mm_shuffle_ps( m, m, _MM_SHUFFLE(0, 0, 0, 0) ), _mm_shuffle_ps( m, m, _MM_SHUFFLE(1, 1, 1, 1) ) );
+        l = _mm_add_ps( l, _mm_shuffle_ps( m, m, _MM_SHUFFLE(2, 2, 2, 2) ) );
+        _mm_storeu_ps( pixels, selectSSE2(colorLanes, l, p) );
+    }
+}
+
+void
+clampPixelsSSE2(float* pixels,
+                std::size_t count)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+
+    for (std::size_t i = 0; i < count; ++i, pixels += 4) {
+        _mm_storeu_ps( pixels, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pixels), zero), one) );
+    }
+}
+
+///Same as Color::floatToInt<256>
+inline U32
+floatToByte(float v)
+{
+    if (v <= 0) {
+        return 0;
+    } else if (v >= 1.f) {
+        return 255;
+    }
+
+    return (U32)(v * 255.f + 0.5f);
+}
+
+inline void
+pixelToBGRA8(const float* pixel,
+             U32* dst)
+{
+    *dst = (floatToByte(pixel[3]) << 24) | (floatToByte(pixel[0]) << 16) | (floatToByte(pixel[1]) << 8) | floatToByte(pixel[2]);
+}
+
+///Converts a RGBA pixel to 4 ints in the B,G,R,A order, see floatToByte
+inline __m128i
+pixelToBGRAIntsSSE2(const float* pixel)
+{
+    __m128 p = _mm_min_ps( _mm_max_ps( _mm_loadu_ps(pixel), _mm_setzero_ps() ), _mm_set1_ps(1.f) );
+
+    p = _mm_shuffle_ps( p, p, _MM_SHUFFLE(3, 0, 1, 2) );
+
+    return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( p, _mm_set1_ps(255.f) ), _mm_set1_ps(0.5f) ) );
+}
+
+void
+pixelsToBGRA8SSE2(const float* pixels,
+                  U32* dst,
+                  std::size_t count)
+{
+    std::size_t i = 0;
+
+    for (; i + 4 <= count; i += 4, pixels += 16, dst += 4) {
+        __m128i lo = _mm_packs_epi32( pixelToBGRAIntsSSE2(pixels), pixelToBGRAIntsSSE2(pixels + 4) );
+        __m128i hi = _mm_packs_epi32( pixelToBGRAIntsSSE2(pixels + 8), pixelToBGRAIntsSSE2(pixels + 12) );
+        _mm_storeu_si128( (__m128i*)dst, _mm_packus_epi16(lo, hi) );
+    }
+    for (; i < count; ++i, pixels += 4, ++dst) {
+        pixelToBGRA8(pixels, dst);
+    }
+}
+
+///Returns the histogram bins of the 4 lanes of v, see histogramBinsKernel
+inline __m128i
+histogramBinsSSE2(__m128 v,
+                  __m128 vmin,
+                  __m128 scale,
+                  __m128 binsCount)
+{
+    __m128 t = _mm_mul_ps(_mm_sub_ps(v, vmin), scale);
+    __m128i inRange = _mm_castps_si128( _mm_and_ps( _mm_cmpge_ps( t, _mm_setzero_ps() ), _mm_cmplt_ps(t, binsCount) ) );
+
+    return _mm_or_si128( _mm_and_si128(_mm_cvttps_epi32(t), inRange), _mm_andnot_si128( inRange, _mm_set1_epi32(-1) ) );
+}
+
+void
+histogramBinsSSE2(const float* pixels,
+                  std::size_t count,
+                  float vmin,
+                  float scale,
+                  int binsCount,
+                  int* bins)
+{
+    const __m128 weights = _mm_setr_ps(0.299f, 0.587f, 0.114f, 0.f);
+    const __m128 vminV = _mm_set1_ps(vmin);
+    const __m128 scaleV = _mm_set1_ps(scale);
+    const __m128 binsCountV = _mm_set1_ps( (float)binsCount );
+
+    for (std::size_t i = 0; i < count; ++i, pixels += 4, bins += 5) {
+        __m128 p = _mm_loadu_ps(pixels);
+        __m128 m = _mm_mul_ps(p, weights);
+        __m128 l = _mm_add_ps( _mm_shuffle_ps( m, m, _MM_SHUFFLE(0, 0, 0, 0) ), _mm_shuffle_ps( m, m, _MM_SHUFFLE(1, 1, 1, 1) ) );
+        l = _mm_add_ps( l, _mm_shuffle_ps( m, m, _MM_SHUFFLE(2, 2, 2, 2) ) );
+        _mm_storeu_si128( (__m128i*)bins, histogramBinsSSE2(p, vminV, scaleV, binsCountV) );
+        bins[4] = _mm_cvtsi128_si32( histogramBinsSSE2(l, vminV, scaleV, binsCountV) );
+    }
+}
+
+///Returns the histogram keys of the 4 lanes of v, see statisticsKey
+inline __m128i
+statisticsKeysSSE2(__m128 v,
+                   __m128 ordered)
+{
+    __m128i bits = _mm_castps_si128(v);
+    ///~bits for negative values, bits | 0x80000000 for the others
+    __m128i keys = _mm_xor_si128( bits, _mm_or_si128( _mm_srai_epi32(bits, 31), _mm_set1_epi32(0x80000000) ) );
+    __m128i orderedMask = _mm_castps_si128(ordered);
+
+    keys = _mm_srli_epi32(keys, 16);
+
+    return _mm_or_si128( _mm_and_si128(keys, orderedMask), _mm_andnot_si128( orderedMask, _mm_set1_epi32(NATRON_STATISTICS_NAN_KEY) ) );
+}
+
+void
+statisticsSSE2(const float* values,
+               std::size_t count,
+               float* minValue,
+               float* maxValue,
+               double* sum,
+               U32* keys)
+{
+    const __m128 inf = _mm_set1_ps( std::numeric_limits<float>::infinity() );
+    const __m128 minusInf = _mm_set1_ps( -std::numeric_limits<float>::infinity() );
+    __m128 minV = _mm_set1_ps(*minValue);
+    __m128 maxV = _mm_set1_ps(*maxValue);
+    __m128d sumLo = _mm_setzero_pd();
+    __m128d sumHi = _mm_setzero_pd();
+    std::size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_loadu_ps(values + i);
+        __m128 ordered = _mm_cmpord_ps(v, v);
+        minV = _mm_min_ps( minV, selectSSE2(ordered, v, inf) );
+        maxV = _mm_max_ps( maxV, selectSSE2(ordered, v, minusInf) );
+        __m128 summed = _mm_and_ps(ordered, v);
+        sumLo = _mm_add_pd( sumLo, _mm_cvtps_pd(summed) );
+        sumHi = _mm_add_pd( sumHi, _mm_cvtps_pd( _mm_movehl_ps(summed, summed) ) );
+        _mm_storeu_si128( (__m128i*)(keys + i), statisticsKeysSSE2(v, ordered) );
+    }
+
+    float mins[4], maxs[4];
+    double partial[4];
+    _mm_storeu_ps(mins, minV);
+    _mm_storeu_ps(maxs, maxV);
+    _mm_storeu_pd(partial, sumLo);
+    _mm_storeu_pd(partial + 2, sumHi);
+    for (int l = 0; l < 4; ++l) {
+        *minValue = std::min(*minValue, mins[l]);
+        *maxValue = std::max(*maxValue, maxs[l]);
+    }
+    statisticsTail(values, i, count, minValue, maxValue, partial, keys);
+    *sum += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+}
+
+///Branchless conversions of 4 values at a time, see
+///https://gist.github.com/rygorous/2156668 and https://gist.github.com/rygorous/2144712
+///They give the same bits as Half::toFloat() and Half::fromFloat(), including the rounding to nearest even.
+inline __m128
+halfToFloatSSE2(__m128i h)
+{
+    const __m128i maskNoSign = _mm_set1_epi32(0x7fff);
+    const __m128 magic = _mm_castsi128_ps( _mm_set1_epi32( (254 - 15) << 23 ) );
+    const __m128i wasInfNan = _mm_set1_epi32(0x7bff);
+    const __m128 expInfNan = _mm_castsi128_ps( _mm_set1_epi32(255 << 23) );
+    __m128i expmant = _mm_and_si128(maskNoSign, h);
+    __m128i justsign = _mm_xor_si128(h, expmant);
+    __m128i shifted = _mm_slli_epi32(expmant, 13);
+    __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(shifted), magic);
+    __m128i b_wasinfnan = _mm_cmpgt_epi32(expmant, wasInfNan);
+    __m128i sign = _mm_slli_epi32(justsign, 16);
+    __m128 infnanexp = _mm_and_ps(_mm_castsi128_ps(b_wasinfnan), expInfNan);
+    __m128 signInf = _mm_or_ps(_mm_castsi128_ps(sign), infnanexp);
+
+    return _mm_or_ps(scaled, signInf);
+}
+
+inline __m128i
+floatToHalfSSE2(__m128 f)
+{
+    const __m128 maskSign = _mm_castsi128_ps( _mm_set1_epi32(0x80000000u) );
+    const __m128i f32infty = _mm_set1_epi32(255 << 23);
+    const __m128i f16max = _mm_set1_epi32( (127 + 16) << 23 );
+    const __m128i minNormal = _mm_set1_epi32( (127 - 14) << 23 );
+    const __m128i denormMagic = _mm_set1_epi32( ( (127 - 15) + (23 - 10) + 1 ) << 23 );
+    const __m128i normalBias = _mm_set1_epi32( 0xfff - ( (127 - 15) << 23 ) );
+    const __m128i nanBit = _mm_set1_epi32(0x200);
+    const __m128i inftyAsHalf = _mm_set1_epi32(0x7c00);
+    __m128 justsign = _mm_and_ps(maskSign, f);
+    __m128 absf = _mm_xor_ps(f, justsign);
+    __m128i absfInt = _mm_castps_si128(absf);
+    __m128i isNan = _mm_cmpgt_epi32(absfInt, f32infty);
+    __m128i isRegular = _mm_cmpgt_epi32(f16max, absfInt);
+    __m128i isDenormal = _mm_cmpgt_epi32(minNormal, absfInt);
+    __m128i infOrNan = _mm_or_si128(_mm_and_si128(isNan, nanBit), inftyAsHalf);
+    ///The float addition rounds the denormals to nearest even
+    __m128i denormal = _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( absf, _mm_castsi128_ps(denormMagic) ) ), denormMagic );
+    ///-1 if the mantissa of the result is odd: ties then round up to the even mantissa
+    __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absfInt, 31 - 13), 31);
+    __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absfInt, normalBias), mantissaOdd), 13);
+    __m128i finite = _mm_or_si128( _mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal) );
+    __m128i joined = _mm_or_si128( _mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infOrNan) );
+    __m128i sign = _mm_srli_epi32(_mm_castps_si128(justsign), 16);
+
+    return _mm_or_si128(joined, sign);
+}
+
+std::size_t
+halfToFloatSSE2(const Half* src,
+                float* dst,
+                std::size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i h = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm_storeu_ps( dst + i, halfToFloatSSE2( _mm_unpacklo_epi16(h, zero) ) );
+        _mm_storeu_ps( dst + i + 4, halfToFloatSSE2( _mm_unpackhi_epi16(h, zero) ) );
+    }
+
+    return i;
+}
+
+std::size_t
+floatToHalfSSE2(const float* src,
+                Half* dst,
+                std::size_t count)
+{
+    const __m128i low15 = _mm_set1_epi32(0x7fff);
+    const __m128i signBit = _mm_set1_epi16( (short)0x8000 );
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = floatToHalfSSE2( _mm_loadu_ps(src + i) );
+        __m128i hi = floatToHalfSSE2( _mm_loadu_ps(src + i + 4) );
+        ///The values fit in 16 bits but SSE2 can only pack with a signed saturation: remove the sign bit before packing
+        ///and put it back after
+        __m128i signs = _mm_packs_epi32( _mm_srai_epi32(_mm_slli_epi32(lo, 16), 31), _mm_srai_epi32(_mm_slli_epi32(hi, 16), 31) );
+        __m128i packed = _mm_packs_epi32( _mm_and_si128(lo, low15), _mm_and_si128(hi, low15) );
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm_or_si128( packed, _mm_and_si128(signs, signBit) ) );
+    }
+
+    return i;
+}
+
+#endif // NATRON_KERNELS_SSE2
+
+#ifdef NATRON_KERNELS_AVX2
+
+NATRON_KERNELS_TARGET_AVX2
+inline __m256
+laneMaskAVX2(bool l0,
+             bool l1,
+             bool l2,
+             bool l3)
+{
+    ///2 pixels per vector
+    return _mm256_castsi256_ps( _mm256_set_epi32(l3 ? -1 : 0, l2 ? -1 : 0, l1 ? -1 : 0, l0 ? -1 : 0,
+                                                 l3 ? -1 : 0, l2 ? -1 : 0, l1 ? -1 : 0, l0 ? -1 : 0) );
+}
+
+NATRON_KERNELS_TARGET_AVX2
+inline __m256
+broadcastAlphaAVX2(__m256 p)
+{
+    return _mm256_permute_ps( p, _MM_SHUFFLE(3, 3, 3, 3) );
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+fillPixelsAVX2(float* dst,
+               const float* pixel,
+               int nComps,
+               std::size_t count)
+{
+    ///8 pixels span nComps vectors
+    float pattern[32];
+
+    for (int i = 0; i < 8 * nComps; ++i) {
+        pattern[i] = pixel[i % nComps];
+    }
+    __m256 v[4];
+    for (int k = 0; k < nComps; ++k) {
+        v[k] = _mm256_loadu_ps(pattern + 8 * k);
+    }
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8, dst += 8 * nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            _mm256_storeu_ps(dst + 8 * k, v[k]);
+        }
+    }
+    for (; i < count; ++i, dst += nComps) {
+        for (int k = 0; k < nComps; ++k) {
+            dst[k] = pixel[k];
+        }
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+premultPixelsAVX2(float* pixels,
+                  std::size_t count,
+                  bool doPremult)
+{
+    const __m256 colorLanes = laneMaskAVX2(true, true, true, false);
+    const __m256 zero = _mm256_setzero_ps();
+    std::size_t i = 0;
+
+    for (; i + 2 <= count; i += 2, pixels += 8) {
+        __m256 p = _mm256_loadu_ps(pixels);
+        __m256 a = broadcastAlphaAVX2(p);
+        if (doPremult) {
+            p = _mm256_blendv_ps( p, _mm256_mul_ps(p, a), colorLanes );
+        } else {
+            p = _mm256_blendv_ps( p, _mm256_div_ps(p, a), _mm256_and_ps( colorLanes, _mm256_cmp_ps(a, zero, _CMP_NEQ_UQ) ) );
+        }
+        _mm256_storeu_ps(pixels, p);
+    }
+    if (i < count) {
+        premultPixelsSSE2(pixels, count - i, doPremult);
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+mixPixelsAVX2(float* dst,
+              const float* src,
+              const float* mask,
+              int nComps,
+              std::size_t count,
+              float mix,
+              bool maskInvert)
+{
+    std::size_t i = 0;
+
+    if (!mask) {
+        std::size_t n = count * nComps;
+        const __m256 alpha = _mm256_set1_ps(mix);
+        const __m256 oneMinusAlpha = _mm256_set1_ps(1.f - mix);
+        if (src) {
+            for (; i + 8 <= n; i += 8) {
+                __m256 d = _mm256_loadu_ps(dst + i);
+                __m256 s = _mm256_loadu_ps(src + i);
+                _mm256_storeu_ps( dst + i, _mm256_add_ps( _mm256_mul_ps(d, alpha), _mm256_mul_ps(oneMinusAlpha, s) ) );
+            }
+        } else {
+            for (; i + 8 <= n; i += 8) {
+                _mm256_storeu_ps( dst + i, _mm256_mul_ps(_mm256_loadu_ps(dst + i), alpha) );
+            }
+        }
+        ///the remaining elements may not form whole pixels, handle them as single component pixels
+        mixPixelsSSE2(dst + i, src ? src + i : 0, 0, 1, n - i, mix, maskInvert);
+
+        return;
+    }
+
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 mixV = _mm256_set1_ps(mix);
+    if (nComps == 4) {
+        for (; i + 2 <= count; i += 2) {
+            ///mask values of the 2 pixels, each one repeated on the 4 components
+            __m256 m = _mm256_setr_ps(mask[i], mask[i], mask[i], mask[i], mask[i + 1], mask[i + 1], mask[i + 1], mask[i + 1]);
+            if (maskInvert) {
+                m = _mm256_sub_ps(one, m);
+            }
+            __m256 alpha = _mm256_mul_ps(mixV, m);
+            __m256 d = _mm256_mul_ps(_mm256_loadu_ps(dst + i * 4), alpha);
+            if (src) {
+                d = _mm256_add_ps( d, _mm256_mul_ps( _mm256_sub_ps(one, alpha), _mm256_loadu_ps(src + i * 4) ) );
+            }
+            _mm256_storeu_ps(dst + i * 4, d);
+        }
+    } else if (nComps == 1) {
+        for (; i + 8 <= count; i += 8) {
+            __m256 m = _mm256_loadu_ps(mask + i);
+            if (maskInvert) {
+                m = _mm256_sub_ps(one, m);
+            }
+            __m256 alpha = _mm256_mul_ps(mixV, m);
+            __m256 d = _mm256_mul_ps(_mm256_loadu_ps(dst + i), alpha);
+            if (src) {
+                d = _mm256_add_ps( d, _mm256_mul_ps( _mm256_sub_ps(one, alpha), _mm256_loadu_ps(src + i) ) );
+            }
+            _mm256_storeu_ps(dst + i, d);
+        }
+    }
+    mixPixelsSSE2(dst + i * nComps, src ? src + i * nComps : 0, mask + i, nComps, count - i, mix, maskInvert);
+} // mixPixelsAVX2
+
+template <bool premult, bool srcPremult, bool copyAlpha>
+NATRON_KERNELS_TARGET_AVX2
+void
+copyChannelsAVX2(float* dst,
+                 const float* src,
+                 std::size_t count,
+                 const bool copyChannel[4])
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 copyLanes = laneMaskAVX2(copyChannel[0], copyChannel[1], copyChannel[2], false);
+    const __m256 keepLanes = laneMaskAVX2(!copyChannel[0], !copyChannel[1], !copyChannel[2], false);
+    const __m256 alphaLane = laneMaskAVX2(false, false, false, true);
+    std::size_t i = 0;
+
+    for (; i + 2 <= count; i += 2, dst += 8, src += 8) {
+        __m256 s = _mm256_loadu_ps(src);
+        __m256 d = _mm256_loadu_ps(dst);
+        __m256 sa = broadcastAlphaAVX2(s);
+        __m256 da = broadcastAlphaAVX2(d);
+        __m256 v;
+        if (srcPremult) {
+            if (premult && copyAlpha) {
+                v = s;
+            } else {
+                v = _mm256_div_ps(s, sa);
+                if (premult) {
+                    v = _mm256_mul_ps(v, da);
+                }
+                v = _mm256_blendv_ps( v, s, _mm256_cmp_ps(sa, zero, _CMP_EQ_OQ) );
+            }
+        } else {
+            if (premult) {
+                v = _mm256_mul_ps(s, copyAlpha ? sa : da);
+            } else {
+                v = s;
+            }
+        }
+        __m256 out = _mm256_blendv_ps(d, v, copyLanes);
+        if (copyAlpha) {
+            if (premult) {
+                __m256 repremult = _mm256_mul_ps(_mm256_div_ps(d, da), sa);
+                out = _mm256_blendv_ps( out, repremult, _mm256_and_ps( keepLanes, _mm256_cmp_ps(da, zero, _CMP_NEQ_UQ) ) );
+            }
+            out = _mm256_blendv_ps(out, sa, alphaLane);
+        }
+        _mm256_storeu_ps(dst, out);
+    }
+    if (i < count) {
+        copyChannelsSSE2<premult, srcPremult, copyAlpha>(dst, src, count - i, copyChannel);
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+halvePixelsAVX2(float* dst,
+                const float* row,
+                const float* nextRow,
+                int nComps,
+                std::size_t count)
+{
+    const __m256 four = _mm256_set1_ps(4.f);
+    std::size_t i = 0;
+
+    if (nComps == 4) {
+        for (; i + 2 <= count; i += 2, dst += 8, row += 16, nextRow += 16) {
+            ///the even pixels of the row are in a, the odd ones in b
+            __m256 r0 = _mm256_loadu_ps(row);
+            __m256 r1 = _mm256_loadu_ps(row + 8);
+            __m256 n0 = _mm256_loadu_ps(nextRow);
+            __m256 n1 = _mm256_loadu_ps(nextRow + 8);
+            __m256 a = _mm256_permute2f128_ps(r0, r1, 0x20);
+            __m256 b = _mm256_permute2f128_ps(r0, r1, 0x31);
+            __m256 c = _mm256_permute2f128_ps(n0, n1, 0x20);
+            __m256 d = _mm256_permute2f128_ps(n0, n1, 0x31);
+            _mm256_storeu_ps( dst, _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_add_ps(a, b), c), d), four) );
+        }
+    } else if (nComps == 1) {
+        for (; i + 8 <= count; i += 8, dst += 8, row += 16, nextRow += 16) {
+            ///shuffle_ps works within each 128-bit lane: restore the order of the columns afterwards
+            __m256 r0 = _mm256_loadu_ps(row);
+            __m256 r1 = _mm256_loadu_ps(row + 8);
+            __m256 n0 = _mm256_loadu_ps(nextRow);
+            __m256 n1 = _mm256_loadu_ps(nextRow + 8);
+            __m256 sum = _mm256_add_ps( _mm256_shuffle_ps( r0, r1, _MM_SHUFFLE(2, 0, 2, 0) ), _mm256_shuffle_ps( r0, r1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            sum = _mm256_add_ps( sum, _mm256_shuffle_ps( n0, n1, _MM_SHUFFLE(2, 0, 2, 0) ) );
+            sum = _mm256_add_ps( sum, _mm256_shuffle_ps( n0, n1, _MM_SHUFFLE(3, 1, 3, 1) ) );
+            sum = _mm256_castpd_ps( _mm256_permute4x64_pd( _mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0) ) );
+            _mm256_storeu_ps( dst, _mm256_div_ps(sum, four) );
+        }
+    }
+    halvePixelsSSE2(dst, row, nextRow, nComps, count - i);
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+gainOffsetPixelsAVX2(float* pixels,
+                     std::size_t count,
+                     float gain,
+                     float offset)
+{
+    const __m256 colorLanes = laneMaskAVX2(true, true, true, false);
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 o = _mm256_set1_ps(offset);
+    std::size_t i = 0;
+
+    for (; i + 2 <= count; i += 2, pixels += 8) {
+        __m256 p = _mm256_loadu_ps(pixels);
+        _mm256_storeu_ps( pixels, _mm256_blendv_ps( p, _mm256_add_ps(_mm256_mul_ps(p, g), o), colorLanes ) );
+    }
+    if (i < count) {
+        gainOffsetPixelsSSE2(pixels, count - i, gain, offset);
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+luminancePixelsAVX2(float* pixels,
+                    std::size_t count)
+{
+    const __m256 colorLanes = laneMaskAVX2(true, true, true, false);
+    const __m256 weights = _mm256_setr_ps(0.299f, 0.587f, 0.114f, 0.f, 0.299f, 0.587f, 0.114f, 0.f);
+    std::size_t i = 0;
+
+    for (; i + 2 <= count; i += 2, pixels += 8) {
+        __m256 p = _mm256_loadu_ps(pixels);
+        __m256 m = _mm256_mul_ps(p, weights);
+        __m256 l = _mm256_add_ps( _mm256_permute_ps( m, _MM_SHUFFLE(0, 0, 0, 0) ), _mm256_permute_ps( m, _MM_SHUFFLE(1, 1, 1, 1) ) );
+        l = _mm256_add_ps( l, _mm256_permute_ps( m, _MM_SHUFFLE(2, 2, 2, 2) ) );
+        _mm256_storeu_ps( pixels, _mm256_blendv_ps(p, l, colorLanes) );
+    }
+    if (i < count) {
+        luminancePixelsSSE2(pixels, count - i);
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+clampPixelsAVX2(float* pixels,
+                std::size_t count)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    std::size_t i = 0;
+
+    for (; i + 2 <= count; i += 2, pixels += 8) {
+        _mm256_storeu_ps( pixels, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(pixels), zero), one) );
+    }
+    if (i < count) {
+        clampPixelsSSE2(pixels, count - i);
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+inline __m256i
+pixelsToBGRAIntsAVX2(const float* pixels)
+{
+    __m256 p = _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps(pixels), _mm256_setzero_ps() ), _mm256_set1_ps(1.f) );
+
+    p = _mm256_permute_ps( p, _MM_SHUFFLE(3, 0, 1, 2) );
+
+    return _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( p, _mm256_set1_ps(255.f) ), _mm256_set1_ps(0.5f) ) );
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+pixelsToBGRA8AVX2(const float* pixels,
+                  U32* dst,
+                  std::size_t count)
+{
+    ///The packs work within each 128-bit lane: the pixels come out in the 0,2,4,6,1,3,5,7 order
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8, pixels += 32, dst += 8) {
+        __m256i lo = _mm256_packs_epi32( pixelsToBGRAIntsAVX2(pixels), pixelsToBGRAIntsAVX2(pixels + 8) );
+        __m256i hi = _mm256_packs_epi32( pixelsToBGRAIntsAVX2(pixels + 16), pixelsToBGRAIntsAVX2(pixels + 24) );
+        _mm256_storeu_si256( (__m256i*)dst, _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order) );
+    }
+    if (i < count) {
+        pixelsToBGRA8SSE2(pixels, dst, count - i);
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+inline __m256i
+histogramBinsAVX2(__m256 v,
+                  __m256 vmin,
+                  __m256 scale,
+                  __m256 binsCount)
+{
+    __m256 t = _mm256_mul_ps(_mm256_sub_ps(v, vmin), scale);
+    __m256i inRange = _mm256_castps_si256( _mm256_and_ps( _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(t, binsCount, _CMP_LT_OQ) ) );
+
+    return _mm256_or_si256( _mm256_and_si256(_mm256_cvttps_epi32(t), inRange), _mm256_andnot_si256( inRange, _mm256_set1_epi32(-1) ) );
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+histogramBinsAVX2(const float* pixels,
+                  std::size_t count,
+                  float vmin,
+                  float scale,
+                  int binsCount,
+                  int* bins)
+{
+    const __m256 weights = _mm256_setr_ps(0.299f, 0.587f, 0.114f, 0.f, 0.299f, 0.587f, 0.114f, 0.f);
+    const __m256 vminV = _mm256_set1_ps(vmin);
+    const __m256 scaleV = _mm256_set1_ps(scale);
+    const __m256 binsCountV = _mm256_set1_ps( (float)binsCount );
+    std::size_t i = 0;
+
+    for (; i + 2 <= count; i += 2, pixels += 8, bins += 10) {
+        __m256 p = _mm256_loadu_ps(pixels);
+        __m256 m = _mm256_mul_ps(p, weights);
+        __m256 l = _mm256_add_ps( _mm256_permute_ps( m, _MM_SHUFFLE(0, 0, 0, 0) ), _mm256_permute_ps( m, _MM_SHUFFLE(1, 1, 1, 1) ) );
+        l = _mm256_add_ps( l, _mm256_permute_ps( m, _MM_SHUFFLE(2, 2, 2, 2) ) );
+        __m256i b = histogramBinsAVX2(p, vminV, scaleV, binsCountV);
+        __m256i lb = histogramBinsAVX2(l, vminV, scaleV, binsCountV);
+        _mm_storeu_si128( (__m128i*)bins, _mm256_castsi256_si128(b) );
+        bins[4] = _mm_cvtsi128_si32( _mm256_castsi256_si128(lb) );
+        _mm_storeu_si128( (__m128i*)(bins + 5), _mm256_extracti128_si256(b, 1) );
+        bins[9] = _mm_cvtsi128_si32( _mm256_extracti128_si256(lb, 1) );
+    }
+    if (i < count) {
+        histogramBinsSSE2(pixels, count - i, vmin, scale, binsCount, bins);
+    }
+}
+
+NATRON_KERNELS_TARGET_AVX2
+inline __m256i
+statisticsKeysAVX2(__m256 v,
+                   __m256 ordered)
+{
+    __m256i bits = _mm256_castps_si256(v);
+    __m256i keys = _mm256_xor_si256( bits, _mm256_or_si256( _mm256_srai_epi32(bits, 31), _mm256_set1_epi32(0x80000000) ) );
+    __m256i orderedMask = _mm256_castps_si256(ordered);
+
+    keys = _mm256_srli_epi32(keys, 16);
+
+    return _mm256_or_si256( _mm256_and_si256(keys, orderedMask), _mm256_andnot_si256( orderedMask, _mm256_set1_epi32(NATRON_STATISTICS_NAN_KEY) ) );
+}
+
+NATRON_KERNELS_TARGET_AVX2
+void
+statisticsAVX2(const float* values,
+               std::size_t count,
+               float* minValue,
+               float* maxValue,
+               double* sum,
+               U32* keys)
+{
+    const __m256 inf = _mm256_set1_ps( std::numeric_limits<float>::infinity() );
+    const __m256 minusInf = _mm256_set1_ps( -std::numeric_limits<float>::infinity() );
+    __m256 minV = _mm256_set1_ps(*minValue);
+    __m256 maxV = _mm256_set1_ps(*maxValue);
+    ///the lane l sums the values l modulo 4, as in statisticsSSE2
+    __m256d sums = _mm256_setzero_pd();
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_loadu_ps(values + i);
+        __m256 ordered = _mm256_cmp_ps(v, v, _CMP_ORD_Q);
+        minV = _mm256_min_ps( minV, _mm256_blendv_ps(inf, v, ordered) );
+        maxV = _mm256_max_ps( maxV, _mm256_blendv_ps(minusInf, v, ordered) );
+        __m256 summed = _mm256_and_ps(ordered, v);
+        sums = _mm256_add_pd( sums, _mm256_cvtps_pd( _mm256_castps256_ps128(summed) ) );
+        sums = _mm256_add_pd( sums, _mm256_cvtps_pd( _mm256_extractf128_ps(summed, 1) ) );
+        _mm256_storeu_si256( (__m256i*)(keys + i), statisticsKeysAVX2(v, ordered) );
+    }
+    if (i + 4 <= count) {
+        __m128 v = _mm_loadu_ps(values + i);
+        __m128 ordered = _mm_cmpord_ps(v, v);
+        __m128 summed = _mm_and_ps(ordered, v);
+        minV = _mm256_min_ps( minV, _mm256_insertf128_ps( inf, _mm_blendv_ps(_mm256_castps256_ps128(inf), v, ordered), 0 ) );
+        maxV = _mm256_max_ps( maxV, _mm256_insertf128_ps( minusInf, _mm_blendv_ps(_mm256_castps256_ps128(minusInf), v, ordered), 0 ) );
+        sums = _mm256_add_pd( sums, _mm256_cvtps_pd(summed) );
+        _mm_storeu_si128( (__m128i*)(keys + i), statisticsKeysSSE2(v, ordered) );
+        i += 4;
+    }
+
+    float mins[8], maxs[8];
+    double partial[4];
+    _mm256_storeu_ps(mins, minV);
+    _mm256_storeu_ps(maxs, maxV);
+    _mm256_storeu_pd(partial, sums);
+    for (int l = 0; l < 8; ++l) {
+        *minValue = std::min(*minValue, mins[l]);
+        *maxValue = std::max(*maxValue, maxs[l]);
+    }
+    statisticsTail(values, i, count, minValue, maxValue, partial, keys);
+    *sum += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+}
+
+NATRON_KERNELS_TARGET_AVX2
+inline __m256
+halfToFloatAVX2(__m256i h)
+{
+    const __m256i maskNoSign = _mm256_set1_epi32(0x7fff);
+    const __m256 magic = _mm256_castsi256_ps( _mm256_set1_epi32( (254 - 15) << 23 ) );
+    const __m256i wasInfNan = _mm256_set1_epi32(0x7bff);
+    const __m256 expInfNan = _mm256_castsi256_ps( _mm256_set1_epi32(255 << 23) );
+    __m256i expmant = _mm256_and_si256(maskNoSign, h);
+    __m256i justsign = _mm256_xor_si256(h, expmant);
+    __m256i shifted = _mm256_slli_epi32(expmant, 13);
+    __m256 scaled = _mm256_mul_ps(_mm256_castsi256_ps(shifted), magic);
+    __m256i b_wasinfnan = _mm256_cmpgt_epi32(expmant, wasInfNan);
+    __m256i sign = _mm256_slli_epi32(justsign, 16);
+    __m256 infnanexp = _mm256_and_ps(_mm256_castsi256_ps(b_wasinfnan), expInfNan);
+    __m256 signInf = _mm256_or_ps(_mm256_castsi256_ps(sign), infnanexp);
+
+    return _mm256_or_ps(scaled, signInf);
+}
+
+NATRON_KERNELS_TARGET_AVX2
+inline __m256i
+floatToHalfAVX2(__m256 f)
+{
+    const __m256 maskSign = _mm256_castsi256_ps( _mm256_set1_epi32(0x80000000u) );
+    const __m256i f32infty = _mm256_set1_epi32(255 << 23);
+    const __m256i f16max = _mm256_set1_epi32( (127 + 16) << 23 );
+    const __m256i minNormal = _mm256_set1_epi32( (127 - 14) << 23 );
+    const __m256i denormMagic = _mm256_set1_epi32( ( (127 - 15) + (23 - 10) + 1 ) << 23 );
+    const __m256i normalBias = _mm256_set1_epi32( 0xfff - ( (127 - 15) << 23 ) );
+    const __m256i nanBit = _mm256_set1_epi32(0x200);
+    const __m256i inftyAsHalf = _mm256_set1_epi32(0x7c00);
+    __m256 justsign = _mm256_and_ps(maskSign, f);
+    __m256 absf = _mm256_xor_ps(f, justsign);
+    __m256i absfInt = _mm256_castps_si256(absf);
+    __m256i isNan = _mm256_cmpgt_epi32(absfInt, f32infty);
+    __m256i isRegular = _mm256_cmpgt_epi32(f16max, absfInt);
+    __m256i isDenormal = _mm256_cmpgt_epi32(minNormal, absfInt);
+    __m256i infOrNan = _mm256_or_si256(_mm256_and_si256(isNan, nanBit), inftyAsHalf);
+    __m256i denormal = _mm256_sub_epi32( _mm256_castps_si256( _mm256_add_ps( absf, _mm256_castsi256_ps(denormMagic) ) ), denormMagic );
+    __m256i mantissaOdd = _mm256_srai_epi32(_mm256_slli_epi32(absfInt, 31 - 13), 31);
+    __m256i normal = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_add_epi32(absfInt, normalBias), mantissaOdd), 13);
+    __m256i finite = _mm256_blendv_epi8(normal, denormal, isDenormal);
+    __m256i joined = _mm256_blendv_epi8(infOrNan, finite, isRegular);
+    __m256i sign = _mm256_srli_epi32(_mm256_castps_si256(justsign), 16);
+
+    return _mm256_or_si256(joined, sign);
+}
+
+NATRON_KERNELS_TARGET_AVX2
+std::size_t
+halfToFloatAVX2(const Half* src,
+                float* dst,
+                std::size_t count)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i h = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dst + i, halfToFloatAVX2(h) );
+    }
+
+    return i;
+}
+
+NATRON_KERNELS_TARGET_AVX2
+std::size_t
+floatToHalfAVX2(const float* src,
+                Half* dst,
+                std::size_t count)
+{
+    std::size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i h = floatToHalfAVX2( _mm256_loadu_ps(src + i) );
+        ///packus works within each 128-bit lane: gather the 2 packed halves in the low lane
+        __m256i packed = _mm256_permute4x64_epi64( _mm256_packus_epi32( h, _mm256_setzero_si256() ), _MM_SHUFFLE(3, 1, 2, 0) );
+        _mm_storeu_si128( (__m128i*)(dst + i), _mm256_castsi256_si128(packed) );
+    }
+
+    return i;
+}
+
+#endif // NATRON_KERNELS_AVX2
+
+template <bool premult, bool srcPremult>
+void
+copyChannelsForPremult(float* dst,
+                       const float* src,
+                       std::size_t count,
+                       const bool copyChannel[4])
+{
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        if (copyChannel[3]) {
+            copyChannelsAVX2<premult, srcPremult, true>(dst, src, count, copyChannel);
+        } else {
+            copyChannelsAVX2<premult, srcPremult, false>(dst, src, count, copyChannel);
+        }
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    if (copyChannel[3]) {
+        copyChannelsSSE2<premult, srcPremult, true>(dst, src, count, copyChannel);
+    } else {
+        copyChannelsSSE2<premult, srcPremult, false>(dst, src, count, copyChannel);
+    }
+#else
+    (void)dst;
+    (void)src;
+    (void)count;
+    (void)copyChannel;
+    assert(false);
+#endif
+}
+} // anon namespace
+
+namespace Natron {
+
+KernelInstructionSetEnum
+getSupportedKernelInstructionSet()
+{
+    return supportedInstructionSet;
+}
+
+KernelInstructionSetEnum
+getKernelInstructionSet()
+{
+    return currentInstructionSet;
+}
+
+void
+setKernelInstructionSet(KernelInstructionSetEnum instructionSet)
+{
+    currentInstructionSet = instructionSet < supportedInstructionSet ? instructionSet : supportedInstructionSet;
+}
+
+void
+fillPixelsKernel(float* dst,
+                 const float* pixel,
+                 int nComps,
+                 std::size_t count)
+{
+    assert(kernelsEnabled() && nComps >= 1 && nComps <= 4);
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        fillPixelsAVX2(dst, pixel, nComps, count);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    fillPixelsSSE2(dst, pixel, nComps, count);
+#else
+    (void)dst;
+    (void)pixel;
+    (void)nComps;
+    (void)count;
+#endif
+}
+
+void
+premultPixelsKernel(float* pixels,
+                    std::size_t count,
+                    bool doPremult)
+{
+    assert( kernelsEnabled() );
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        premultPixelsAVX2(pixels, count, doPremult);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    premultPixelsSSE2(pixels, count, doPremult);
+#else
+    (void)pixels;
+    (void)count;
+    (void)doPremult;
+#endif
+}
+
+void
+mixPixelsKernel(float* dst,
+                const float* src,
+                const float* mask,
+                int nComps,
+                std::size_t count,
+                float mix,
+                bool maskInvert)
+{
+    assert(kernelsEnabled() && nComps >= 1 && nComps <= 4);
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        mixPixelsAVX2(dst, src, mask, nComps, count, mix, maskInvert);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    mixPixelsSSE2(dst, src, mask, nComps, count, mix, maskInvert);
+#else
+    (void)dst;
+    (void)src;
+    (void)mask;
+    (void)nComps;
+    (void)count;
+    (void)mix;
+    (void)maskInvert;
+#endif
+}
+
+void
+copyChannelsKernel(float* dst,
+                   const float* src,
+                   std::size_t count,
+                   const bool copyChannel[4],
+                   bool premult,
+                   bool srcPremult)
+{
+    assert( kernelsEnabled() );
+    if (premult) {
+        if (srcPremult) {
+            copyChannelsForPremult<true, true>(dst, src, count, copyChannel);
+        } else {
+            copyChannelsForPremult<true, false>(dst, src, count, copyChannel);
+        }
+    } else {
+        if (srcPremult) {
+            copyChannelsForPremult<false, true>(dst, src, count, copyChannel);
+        } else {
+            copyChannelsForPremult<false, false>(dst, src, count, copyChannel);
+        }
+    }
+}
+
+void
+halvePixelsKernel(float* dst,
+                  const float* row,
+                  const float* nextRow,
+                  int nComps,
+                  std::size_t count)
+{
+    assert(kernelsEnabled() && nComps >= 1 && nComps <= 4);
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        halvePixelsAVX2(dst, row, nextRow, nComps, count);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    halvePixelsSSE2(dst, row, nextRow, nComps, count);
+#else
+    (void)dst;
+    (void)row;
+    (void)nextRow;
+    (void)nComps;
+    (void)count;
+#endif
+}
+
+void
+gainOffsetPixelsKernel(float* pixels,
+                       std::size_t count,
+                       float gain,
+                       float offset)
+{
+    assert( kernelsEnabled() );
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        gainOffsetPixelsAVX2(pixels, count, gain, offset);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    gainOffsetPixelsSSE2(pixels, count, gain, offset);
+#else
+    (void)pixels;
+    (void)count;
+    (void)gain;
+    (void)offset;
+#endif
+}
+
+void
+luminancePixelsKernel(float* pixels,
+                      std::size_t count)
+{
+    assert( kernelsEnabled() );
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        luminancePixelsAVX2(pixels, count);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    luminancePixelsSSE2(pixels, count);
+#else
+    (void)pixels;
+    (void)count;
+#endif
+}
+
+void
+clampPixelsKernel(float* pixels,
+                  std::size_t count)
+{
+    assert( kernelsEnabled() );
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        clampPixelsAVX2(pixels, count);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    clampPixelsSSE2(pixels, count);
+#else
+    (void)pixels;
+    (void)count;
+#endif
+}
+
+void
+pixelsToBGRA8Kernel(const float* pixels,
+                    U32* dst,
+                    std::size_t count)
+{
+    assert( kernelsEnabled() );
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        pixelsToBGRA8AVX2(pixels, dst, count);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    pixelsToBGRA8SSE2(pixels, dst, count);
+#else
+    (void)pixels;
+    (void)dst;
+    (void)count;
+#endif
+}
+
+void
+histogramBinsKernel(const float* pixels,
+                    std::size_t count,
+                    float vmin,
+                    float scale,
+                    int binsCount,
+                    int* bins)
+{
+    assert( kernelsEnabled() );
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        histogramBinsAVX2(pixels, count, vmin, scale, binsCount, bins);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    histogramBinsSSE2(pixels, count, vmin, scale, binsCount, bins);
+#else
+    (void)pixels;
+    (void)count;
+    (void)vmin;
+    (void)scale;
+    (void)binsCount;
+    (void)bins;
+#endif
+}
+
+void
+statisticsKernel(const float* values,
+                 std::size_t count,
+                 float* minValue,
+                 float* maxValue,
+                 double* sum,
+                 U32* keys)
+{
+    assert( kernelsEnabled() );
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        statisticsAVX2(values, count, minValue, maxValue, sum, keys);
+
+        return;
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    statisticsSSE2(values, count, minValue, maxValue, sum, keys);
+#else
+    (void)values;
+    (void)count;
+    (void)minValue;
+    (void)maxValue;
+    (void)sum;
+    (void)keys;
+#endif
+}
+
+void
+convertHalfToFloat(const Half* src,
+                   float* dst,
+                   std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        i = halfToFloatAVX2(src, dst, count);
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    if (currentInstructionSet != eKernelInstructionSetNone) {
+        i += halfToFloatSSE2(src + i, dst + i, count - i);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = Half::toFloat( src[i].bits() );
+    }
+}
+
+void
+convertFloatToHalf(const float* src,
+                   Half* dst,
+                   std::size_t count)
+{
+    std::size_t i = 0;
+
+#ifdef NATRON_KERNELS_AVX2
+    if (currentInstructionSet == eKernelInstructionSetAVX2) {
+        i = floatToHalfAVX2(src, dst, count);
+    }
+#endif
+#ifdef NATRON_KERNELS_SSE2
+    if (currentInstructionSet != eKernelInstructionSetNone) {
+        i += floatToHalfSSE2(src + i, dst + i, count - i);
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = Half::fromBits( Half::fromFloat(src[i]) );
+    }
+}
+} // namespace Natron
@@ -0,0 +1,166 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_IMAGEKERNELS_H
+#define NATRON_ENGINE_IMAGEKERNELS_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstddef>
+#include <cstring>
+
+#include "Global/GlobalDefines.h"
+
+/*
+ * Vectorized versions of the per-pixel loops of Natron::Image, of the viewer texture conversion and of the
+ * histogram computation for floating point images, working on one row of pixels at a time. Each kernel has a SSE2 and an AVX2 implementation, the
+ * best one supported by the CPU is selected at runtime.
+ *
+ * The kernels give exactly the same results as the scalar loops they replace: they do the same floating point
+ * operations in the same order. When no vector instruction set is available (or when eKernelInstructionSetNone
+ * is selected) the kernels must not be called: kernelsEnabled() returns false and the callers use their loops.
+ *
+ * The functions below are thread-safe, except setKernelInstructionSet() which is meant for tests.
+ */
+
+///The histogram key of NaNs, see statisticsKey()
+#define NATRON_STATISTICS_NAN_KEY 0x10000
+
+namespace Natron {
+
+enum KernelInstructionSetEnum
+{
+    eKernelInstructionSetNone = 0,
+    eKernelInstructionSetSSE2,
+    eKernelInstructionSetAVX2
+};
+
+/**
+ * @brief Returns the best instruction set supported by both the build and the CPU.
+ **/
+KernelInstructionSetEnum getSupportedKernelInstructionSet();
+
+/**
+ * @brief Returns the instruction set used by the kernels.
+ **/
+KernelInstructionSetEnum getKernelInstructionSet();
+
+/**
+ * @brief Selects the instruction set used by the kernels. It is clamped to the supported instruction set.
+ * This must not be called while images are processed.
+ **/
+void setKernelInstructionSet(KernelInstructionSetEnum instructionSet);
+
+inline bool
+kernelsEnabled()
+{
+    return getKernelInstructionSet() != eKernelInstructionSetNone;
+}
+
+/**
+ * @brief Returns the histogram key of a value: its 16 high bits, mapped so that the keys of the values which are not
+ * NaN are in [0,0xffff] and in the order of the values. NaNs get NATRON_STATISTICS_NAN_KEY.
+ **/
+inline U32
+statisticsKey(float v)
+{
+    if (v != v) {
+        return NATRON_STATISTICS_NAN_KEY;
+    }
+    U32 bits;
+    std::memcpy( &bits, &v, sizeof(bits) );
+
+    return ( (bits & 0x80000000) ? ~bits : (bits | 0x80000000) ) >> 16;
+}
+
+/**
+ * @brief Sets count pixels of nComps components to the value of pixel.
+ **/
+void fillPixelsKernel(float* dst, const float* pixel, int nComps, std::size_t count);
+
+/**
+ * @brief Multiplies (or divides if doPremult is false) the color channels of count RGBA pixels by their alpha.
+ * Pixels with a 0 alpha are left untouched when unpremultiplying.
+ **/
+void premultPixelsKernel(float* pixels, std::size_t count, bool doPremult);
+
+/**
+ * @brief Mixes count pixels of nComps components of dst with src: dst = dst * alpha + (1 - alpha) * src,
+ * where alpha = mix * mask, or mix * (1 - mask) if maskInvert is true.
+ * If mask is NULL alpha = mix. If src is NULL dst = dst * alpha.
+ * The mask has one component per pixel.
+ **/
+void mixPixelsKernel(float* dst, const float* src, const float* mask, int nComps, std::size_t count, float mix, bool maskInvert);
+
+/**
+ * @brief Copies the channels of count RGBA pixels from src to dst, for each channel i where copyChannel[i] is true.
+ * premult and srcPremult tell whether dst and src are premultiplied: in that case the color channels are
+ * unpremultiplied/premultiplied as in Image::copyUnProcessedChannels.
+ **/
+void copyChannelsKernel(float* dst, const float* src, std::size_t count, const bool copyChannel[4], bool premult, bool srcPremult);
+
+/**
+ * @brief Computes count pixels of nComps components, each one being the average of 2x2 pixels: the pixels 2i and 2i+1
+ * of row and of nextRow. This is the box filter used to build the mipmap levels, for the pixels whose 4 source
+ * pixels are all defined.
+ **/
+void halvePixelsKernel(float* dst, const float* row, const float* nextRow, int nComps, std::size_t count);
+
+/**
+ * @brief Applies value * gain + offset to the color channels of count RGBA pixels, alpha is left untouched.
+ **/
+void gainOffsetPixelsKernel(float* pixels, std::size_t count, float gain, float offset);
+
+/**
+ * @brief Replaces the color channels of count RGBA pixels by their luminance 0.299 * r + 0.587 * g + 0.114 * b.
+ **/
+void luminancePixelsKernel(float* pixels, std::size_t count);
+
+/**
+ * @brief Clamps the 4 channels of count RGBA pixels to [0,1].
+ **/
+void clampPixelsKernel(float* pixels, std::size_t count);
+
+/**
+ * @brief Converts count RGBA pixels to 8-bit BGRA pixels (the GL_UNSIGNED_INT_8_8_8_8_REV texture format) with
+ * Color::floatToInt<256>.
+ **/
+void pixelsToBGRA8Kernel(const float* pixels, U32* dst, std::size_t count);
+
+/**
+ * @brief Computes the histogram bins of the R, G, B and A channels and of the luminance 0.299 * r + 0.587 * g + 0.114 * b
+ * of count RGBA pixels. The bin of a value v is (int)t where t = (v - vmin) * scale, or -1 if t is not in [0,binsCount).
+ * bins receives 5 ints per pixel, in the R,G,B,A,Y order.
+ **/
+void histogramBinsKernel(const float* pixels, std::size_t count, float vmin, float scale, int binsCount, int* bins);
+
+/**
+ * @brief Accumulates the statistics of count values. minValue and maxValue are updated with the values which are not
+ * NaN. Their sum is added to sum: it is computed in double precision in 4 partial sums, the value i going to the
+ * partial sum i modulo 4, and sum += (partial[0] + partial[1]) + (partial[2] + partial[3]).
+ * keys receives the histogram key of each value, see statisticsKey().
+ **/
+void statisticsKernel(const float* values, std::size_t count, float* minValue, float* maxValue, double* sum, U32* keys);
+
+} // namespace Natron
+
+#endif // NATRON_ENGINE_IMAGEKERNELS_H
@@ -24,6 +24,8 @@
 
 #include "Image.h"
 
+#include "Engine/ImageKernels.h"
+
 using namespace Natron;
 
 template<int srcNComps, int dstNComps, typename PIX, int maxValue, bool masked, bool maskInvert>
@@ -37,9 +39,39 @@ Image::applyMaskMixForMaskInvert(const RectI& roi,
     
     unsigned int dstRowElements = _bounds.width() * getComponentsCount();
     
+    ///The rows of float pixels are processed by the vectorized kernel when the original and mask images either
+    ///cover the row entirely or do not intersect it
+    const bool useKernel = srcNComps == dstNComps && getBitDepth() == eImageBitDepthFloat && kernelsEnabled() &&
+                           (!masked || !maskImg || maskImg->getComponentsCount() == 1);
+    const RectI srcBounds = originalImg ? originalImg->_bounds : RectI();
+    const RectI maskBounds = (masked && maskImg) ? maskImg->_bounds : RectI();
+
     for (int y = roi.y1; y < roi.y2; ++y,
          dst_pixels += (dstRowElements - (roi.x2 - roi.x1) * dstNComps)) { // 1 row stride minus what was done at previous iteration
         
+        if (useKernel) {
+            bool srcInRow = (y >= srcBounds.y1) && (y < srcBounds.y2) && (roi.x1 < srcBounds.x2) && (roi.x2 > srcBounds.x1);
+            bool srcCoversRow = srcInRow && (roi.x1 >= srcBounds.x1) && (roi.x2 <= srcBounds.x2);
+            bool maskInRow = (y >= maskBounds.y1) && (y < maskBounds.y2) && (roi.x1 < maskBounds.x2) && (roi.x2 > maskBounds.x1);
+            bool maskCoversRow = maskInRow && (roi.x1 >= maskBounds.x1) && (roi.x2 <= maskBounds.x2);
+            if ( (srcCoversRow || !srcInRow) && (!masked || maskCoversRow || !maskInRow) ) {
+                const float* srcRow = srcCoversRow ? (const float*)originalImg->pixelAt(roi.x1, y) : 0;
+                const float* maskRow = 0;
+                float alpha = mix;
+                if (masked) {
+                    if (maskCoversRow) {
+                        maskRow = (const float*)maskImg->pixelAt(roi.x1, y);
+                    } else {
+                        ///outside of the mask
+                        alpha = mix * (maskInvert ? 1.f : 0.f);
+                    }
+                }
+                mixPixelsKernel( (float*)dst_pixels, srcRow, maskRow, dstNComps, roi.x2 - roi.x1, alpha, maskInvert );
+                dst_pixels += (roi.x2 - roi.x1) * dstNComps;
+                continue;
+            }
+        }
+
         for (int x = roi.x1; x < roi.x2; ++x,
              dst_pixels += dstNComps) {
             
@@ -149,6 +181,9 @@ Image::applyMaskMixForDstComponents(const RectI& roi,
         case eImageBitDepthShort:
             applyMaskMixForDepth<srcNComps,dstNComps, unsigned short , 65535>(roi, maskImg, originalImg, masked, maskInvert, mix);
             break;
+        case eImageBitDepthHalf:
+            applyMaskMixForDepth<srcNComps,dstNComps, Half, 1>(roi, maskImg, originalImg, masked, maskInvert, mix);
+            break;
         case eImageBitDepthFloat:
             applyMaskMixForDepth<srcNComps,dstNComps, float, 1>(roi, maskImg, originalImg, masked, maskInvert, mix);
             break;
@@ -204,7 +239,19 @@ Image::applyMaskMix(const RectI& roi,
         return;
     }
     
+    ///The original and mask images may have another bit depth, e.g: when this image is cached in half float
+    ImagePtr convertedOriginal, convertedMask;
+    if ( originalImg && (originalImg->getBitDepth() != getBitDepth()) ) {
+        convertedOriginal = originalImg->convertToBitDepth(roi, getBitDepth());
+        originalImg = convertedOriginal.get();
+    }
+    if ( masked && maskImg && (maskImg->getBitDepth() != getBitDepth()) ) {
+        convertedMask = maskImg->convertToBitDepth(roi, getBitDepth());
+        maskImg = convertedMask.get();
+    }
+
     QWriteLocker k(&_entryLock);
+    invalidateStatistics();
     boost::shared_ptr<QReadLocker> originalLock;
     boost::shared_ptr<QReadLocker> maskLock;
     if (originalImg) {
@@ -216,7 +263,6 @@ Image::applyMaskMix(const RectI& roi,
     RectI realRoI;
     roi.intersect(_bounds, &realRoI);
     
-    assert(!originalImg || getBitDepth() == originalImg->getBitDepth());
     assert(!masked || !maskImg || maskImg->getComponents() == ImageComponents::getAlphaComponents());
     
     int srcNComps = originalImg ? (int)originalImg->getComponentsCount() : 0;
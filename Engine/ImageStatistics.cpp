@@ -0,0 +1,402 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "ImageStatistics.h"
+
+#include <algorithm> // min, max
+#include <cstring> // memcpy
+#include <limits>
+
+#include "Engine/Image.h"
+#include "Engine/ImageKernels.h"
+#include "Engine/ParallelReduce.h"
+
+///The values are accumulated by chunks of this many values, whose histogram keys are stored on the stack
+#define NATRON_STATISTICS_CHUNK_SIZE 1024
+
+///The number of statistics cached by an image
+#define NATRON_IMAGE_STATISTICS_COUNT 4
+
+using namespace Natron;
+
+namespace {
+
+///Converts the 32 bits obtained by mapping the bits of a float the way statisticsKey() does back to the float
+inline float
+orderedBitsToFloat(U32 ordered)
+{
+    U32 bits = (ordered & 0x80000000) ? (ordered & 0x7fffffff) : ~ordered;
+    float v;
+
+    std::memcpy( &v, &bits, sizeof(v) );
+
+    return v;
+}
+
+///Appends the values of the channels of count pixels of nComps components to values
+template <typename PIX, int maxValue>
+void
+gatherValuesForDepth(const PIX* pixels,
+                     int count,
+                     int nComps,
+                     Natron::DisplayChannelsEnum channels,
+                     float* values,
+                     std::size_t* valuesCount)
+{
+    std::size_t n = *valuesCount;
+
+    for (int x = 0; x < count; ++x, pixels += nComps) {
+        float r, g, b, a;
+        switch (nComps) {
+        case 4:
+            r = pixels[0] / (float)maxValue;
+            g = pixels[1] / (float)maxValue;
+            b = pixels[2] / (float)maxValue;
+            a = pixels[3] / (float)maxValue;
+            break;
+        case 3:
+            r = pixels[0] / (float)maxValue;
+            g = pixels[1] / (float)maxValue;
+            b = pixels[2] / (float)maxValue;
+            a = 1.f;
+            break;
+        case 2:
+            r = pixels[0] / (float)maxValue;
+            g = pixels[1] / (float)maxValue;
+            b = 0.f;
+            a = 1.f;
+            break;
+        case 1:
+            a = pixels[0] / (float)maxValue;
+            r = g = b = 0.f;
+            break;
+        default:
+            r = g = b = a = 0.f;
+            break;
+        }
+
+        switch (channels) {
+        case Natron::eDisplayChannelsRGB:
+            values[n++] = r;
+            values[n++] = g;
+            values[n++] = b;
+            break;
+        case Natron::eDisplayChannelsY:
+            values[n++] = 0.299f * r + 0.587f * g + 0.114f * b;
+            break;
+        case Natron::eDisplayChannelsR:
+            values[n++] = r;
+            break;
+        case Natron::eDisplayChannelsG:
+            values[n++] = g;
+            break;
+        case Natron::eDisplayChannelsB:
+            values[n++] = b;
+            break;
+        case Natron::eDisplayChannelsA:
+            values[n++] = a;
+            break;
+        }
+    }
+    *valuesCount = n;
+}
+
+template <typename PIX, int maxValue>
+void
+computeStatisticsForDepth(const Natron::Image & image,
+                          Natron::DisplayChannelsEnum channels,
+                          const RectI & rect,
+                          ImageStatistics* statistics)
+{
+    int nComps = (int)image.getComponentsCount();
+    std::vector<float> values( rect.width() * (channels == Natron::eDisplayChannelsRGB ? 3 : 1) );
+    Natron::Image::ReadAccess acc = image.getReadRights();
+
+    for (int y = rect.y1; y < rect.y2; ++y) {
+        const PIX* pixels = (const PIX*)acc.pixelAt(rect.x1, y);
+        assert(pixels);
+        std::size_t valuesCount = 0;
+        gatherValuesForDepth<PIX, maxValue>(pixels, rect.width(), nComps, channels, &values[0], &valuesCount);
+        statistics->addValues(&values[0], valuesCount);
+    }
+}
+
+///Accumulates the statistics of a split of the region of interest, see Natron::parallelReduce()
+class StatisticsFunctor
+{
+    const Natron::Image* _image;
+    Natron::DisplayChannelsEnum _channels;
+
+public:
+
+    StatisticsFunctor(const Natron::Image* image,
+                      Natron::DisplayChannelsEnum channels)
+        : _image(image)
+          , _channels(channels)
+    {
+    }
+
+    void operator()(const RectI & rect,
+                    ImageStatistics* partial) const
+    {
+        switch ( _image->getBitDepth() ) {
+        case Natron::eImageBitDepthByte:
+            computeStatisticsForDepth<unsigned char, 255>(*_image, _channels, rect, partial);
+            break;
+        case Natron::eImageBitDepthShort:
+            computeStatisticsForDepth<unsigned short, 65535>(*_image, _channels, rect, partial);
+            break;
+        case Natron::eImageBitDepthHalf:
+            computeStatisticsForDepth<Half, 1>(*_image, _channels, rect, partial);
+            break;
+        case Natron::eImageBitDepthFloat:
+            computeStatisticsForDepth<float, 1>(*_image, _channels, rect, partial);
+            break;
+        case Natron::eImageBitDepthNone:
+            break;
+        }
+    }
+};
+} // anon namespace
+
+ImageStatistics::ImageStatistics()
+    : _channels(Natron::eDisplayChannelsRGB)
+      , _roi()
+      , _count(0)
+      , _nanCount(0)
+      , _min( std::numeric_limits<float>::infinity() )
+      , _max( -std::numeric_limits<float>::infinity() )
+      , _sum(0.)
+      , _firstKey(0)
+      , _histogram()
+{
+}
+
+ImageStatistics::ImageStatistics(Natron::DisplayChannelsEnum channels,
+                                 const RectI & roi)
+    : _channels(channels)
+      , _roi(roi)
+      , _count(0)
+      , _nanCount(0)
+      , _min( std::numeric_limits<float>::infinity() )
+      , _max( -std::numeric_limits<float>::infinity() )
+      , _sum(0.)
+      , _firstKey(0)
+      , _histogram()
+{
+}
+
+void
+ImageStatistics::compute(const Natron::Image & image,
+                         Natron::DisplayChannelsEnum channels,
+                         const RectI & roi,
+                         ImageStatistics* statistics)
+{
+    assert( roi.isNull() || image.getBounds().contains(roi) );
+    Natron::parallelReduce(roi, StatisticsFunctor(&image, channels), statistics);
+}
+
+void
+ImageStatistics::addValues(const float* values,
+                           std::size_t count)
+{
+    U32 keys[NATRON_STATISTICS_CHUNK_SIZE];
+    const bool useKernel = kernelsEnabled();
+
+    for (std::size_t first = 0; first < count; first += NATRON_STATISTICS_CHUNK_SIZE) {
+        const float* chunk = values + first;
+        std::size_t chunkSize = std::min( (std::size_t)NATRON_STATISTICS_CHUNK_SIZE, count - first );
+        float chunkMin = std::numeric_limits<float>::infinity();
+        float chunkMax = -std::numeric_limits<float>::infinity();
+        if (useKernel) {
+            statisticsKernel(chunk, chunkSize, &chunkMin, &chunkMax, &_sum, keys);
+        } else {
+            double partial[4] = { 0., 0., 0., 0. };
+            for (std::size_t i = 0; i < chunkSize; ++i) {
+                float v = chunk[i];
+                keys[i] = statisticsKey(v);
+                if (v == v) {
+                    chunkMin = std::min(chunkMin, v);
+                    chunkMax = std::max(chunkMax, v);
+                    partial[i % 4] += v;
+                }
+            }
+            _sum += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+        }
+
+        if (chunkMin <= chunkMax) {
+            ///-0 and +0 compare equal but do not have the same key
+            ensureKeyRange( statisticsKey(chunkMin == 0.f ? -0.f : chunkMin), statisticsKey(chunkMax == 0.f ? 0.f : chunkMax) );
+            _min = std::min(_min, chunkMin);
+            _max = std::max(_max, chunkMax);
+        }
+        for (std::size_t i = 0; i < chunkSize; ++i) {
+            if (keys[i] == NATRON_STATISTICS_NAN_KEY) {
+                ++_nanCount;
+            } else {
+                ++_histogram[keys[i] - _firstKey];
+                ++_count;
+            }
+        }
+    }
+}
+
+void
+ImageStatistics::merge(const ImageStatistics & other)
+{
+    _count += other._count;
+    _nanCount += other._nanCount;
+    _min = std::min(_min, other._min);
+    _max = std::max(_max, other._max);
+    _sum += other._sum;
+    if ( other._histogram.empty() ) {
+        return;
+    }
+    ensureKeyRange( other._firstKey, other._firstKey + (U32)other._histogram.size() - 1 );
+    U64* bins = &_histogram[other._firstKey - _firstKey];
+    for (std::size_t i = 0; i < other._histogram.size(); ++i) {
+        bins[i] += other._histogram[i];
+    }
+}
+
+void
+ImageStatistics::ensureKeyRange(U32 firstKey,
+                                U32 lastKey)
+{
+    assert(firstKey <= lastKey && lastKey < NATRON_STATISTICS_NAN_KEY);
+    if ( _histogram.empty() ) {
+        _firstKey = firstKey;
+        _histogram.resize(lastKey - firstKey + 1, 0);
+
+        return;
+    }
+    if (firstKey < _firstKey) {
+        _histogram.insert(_histogram.begin(), _firstKey - firstKey, 0);
+        _firstKey = firstKey;
+    }
+    if (lastKey >= _firstKey + _histogram.size()) {
+        _histogram.resize(lastKey - _firstKey + 1, 0);
+    }
+}
+
+double
+ImageStatistics::getMin() const
+{
+    return _count ? _min : 0.;
+}
+
+double
+ImageStatistics::getMax() const
+{
+    return _count ? _max : 0.;
+}
+
+double
+ImageStatistics::getMean() const
+{
+    return _count ? _sum / _count : 0.;
+}
+
+double
+ImageStatistics::getPercentile(double p) const
+{
+    if (_count == 0) {
+        return 0.;
+    }
+    if (p <= 0.) {
+        return _min;
+    }
+    if (p >= 1.) {
+        return _max;
+    }
+
+    double rank = p * _count;
+    double cumulated = 0.;
+    for (std::size_t i = 0; i < _histogram.size(); ++i) {
+        if ( !_histogram[i] || (cumulated + _histogram[i] < rank) ) {
+            cumulated += _histogram[i];
+            continue;
+        }
+        ///Interpolate between the smallest and the largest values of the bin
+        U32 key = _firstKey + (U32)i;
+        double lower = orderedBitsToFloat(key << 16);
+        double upper = orderedBitsToFloat( (key << 16) | 0xffff );
+        double value = lower;
+        if ( (upper == upper) && (upper != lower) ) {
+            value += (upper - lower) * (rank - cumulated) / _histogram[i];
+        }
+
+        return std::min( std::max(value, (double)_min), (double)_max );
+    }
+
+    return _max;
+}
+
+boost::shared_ptr<const ImageStatistics>
+Image::getStatistics(Natron::DisplayChannelsEnum channels,
+                     const RectI & roi) const
+{
+    RectI rect;
+    if ( !roi.intersect(getBounds(), &rect) ) {
+        rect.clear();
+    }
+
+    U64 generation;
+    {
+        QMutexLocker k(&_statisticsMutex);
+        for (std::list<boost::shared_ptr<const ImageStatistics> >::iterator it = _statistics.begin(); it != _statistics.end(); ++it) {
+            if ( ( (*it)->getChannels() == channels ) && ( (*it)->getRoI() == rect ) ) {
+                boost::shared_ptr<const ImageStatistics> ret = *it;
+                _statistics.erase(it);
+                _statistics.push_front(ret);
+
+                return ret;
+            }
+        }
+        generation = _statisticsGeneration;
+    }
+
+    boost::shared_ptr<ImageStatistics> ret( new ImageStatistics(channels, rect) );
+    ImageStatistics::compute(*this, channels, rect, ret.get());
+
+    QMutexLocker k(&_statisticsMutex);
+    ///Do not cache statistics of pixels which were written during the computation
+    if (generation == _statisticsGeneration) {
+        _statistics.push_front(ret);
+        if ( (int)_statistics.size() > NATRON_IMAGE_STATISTICS_COUNT ) {
+            _statistics.pop_back();
+        }
+    }
+
+    return ret;
+}
+
+void
+Image::invalidateStatistics() const
+{
+    QMutexLocker k(&_statisticsMutex);
+
+    ++_statisticsGeneration;
+    _statistics.clear();
+}
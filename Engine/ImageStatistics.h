@@ -0,0 +1,125 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_IMAGESTATISTICS_H
+#define NATRON_ENGINE_IMAGESTATISTICS_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstddef>
+#include <vector>
+
+#include "Global/GlobalDefines.h"
+
+#include "Engine/RectI.h"
+
+namespace Natron {
+class Image;
+
+/**
+ * @brief The statistics of the values of a channel of an image over a rectangle: the minimum, maximum and mean of the
+ * values and their histogram, from which percentiles are computed. The values of the eDisplayChannelsRGB channels are
+ * the R, G and B values of each pixel and the values of eDisplayChannelsY are the luminances 0.299 * r + 0.587 * g + 0.114 * b.
+ * NaNs are counted but otherwise ignored.
+ *
+ * The histogram has one bin per 16 high bits of the values (see Natron::statisticsKey()), which makes percentiles
+ * accurate to about 1/128 of their value. Statistics are computed by Image::getStatistics(), which caches them.
+ **/
+class ImageStatistics
+{
+public:
+
+    ///An empty statistics, as used by the partial results of the computation
+    ImageStatistics();
+
+    ImageStatistics(Natron::DisplayChannelsEnum channels,
+                    const RectI & roi);
+
+    /**
+     * @brief Computes the statistics of channels of image over roi (which must be included in the image bounds),
+     * in parallel.
+     **/
+    static void compute(const Natron::Image & image,
+                        Natron::DisplayChannelsEnum channels,
+                        const RectI & roi,
+                        ImageStatistics* statistics);
+
+    /**
+     * @brief Accumulates count values. The result does not depend on how the values are split in several calls, except
+     * for the rounding of the sum.
+     **/
+    void addValues(const float* values, std::size_t count);
+
+    ///Accumulates the values of other, used by Natron::parallelReduce()
+    void merge(const ImageStatistics & other);
+
+    Natron::DisplayChannelsEnum getChannels() const
+    {
+        return _channels;
+    }
+
+    const RectI & getRoI() const
+    {
+        return _roi;
+    }
+
+    ///The number of values which are not NaN
+    U64 getCount() const
+    {
+        return _count;
+    }
+
+    U64 getNaNCount() const
+    {
+        return _nanCount;
+    }
+
+    ///The minimum, maximum and mean of the values which are not NaN, 0 if there is none
+    double getMin() const;
+    double getMax() const;
+    double getMean() const;
+
+    /**
+     * @brief Returns the value below which a proportion p (in [0,1]) of the values which are not NaN are.
+     * Percentiles 0 and 1 are the exact minimum and maximum, the others are interpolated in the histogram bins.
+     **/
+    double getPercentile(double p) const;
+
+private:
+
+    ///Makes sure the histogram has bins for the keys from firstKey to lastKey
+    void ensureKeyRange(U32 firstKey, U32 lastKey);
+
+    Natron::DisplayChannelsEnum _channels;
+    RectI _roi;
+    U64 _count;
+    U64 _nanCount;
+    float _min, _max;
+    double _sum;
+
+    ///The histogram bins of the keys from _firstKey, the keys out of the vector having no value
+    U32 _firstKey;
+    std::vector<U64> _histogram;
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_IMAGESTATISTICS_H
@@ -67,35 +67,6 @@ hermiteToCubicCoeffs(double P0,
     *c3 = -2 * (P3 - P0) + P0pr + P3pl;
 }
 
-// evaluate at t
-static double
-cubicEval(double c0,
-          double c1,
-          double c2,
-          double c3,
-          double t)
-{
-    const double t2 = t * t;
-    const double t3 = t2 * t;
-
-    return c0 + c1 * t + c2 * t2 + c3 * t3;
-}
-
-// integrate from 0 to t
-static double
-cubicIntegrate(double c0,
-               double c1,
-               double c2,
-               double c3,
-               double t)
-{
-    const double t2 = t * t;
-    const double t3 = t2 * t;
-    const double t4 = t3 * t;
-
-    return c0 * t + c1 * t2 / 2. + c2 * t3 / 3 + c3 * t4 / 4;
-}
-
 // derive at t
 static double
 cubicDerive(double /*c0*/,
@@ -398,25 +369,22 @@ Natron::solveQuartic(double c0,
     return num;
 } // solveQuartic
 
-/**
- * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
- * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
- * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
- * t \in [t1,t2]) the value at 'currentTime' using the
- * interpolation method "interp".
- * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
- * which will compute the derivatives for you.
- **/
-double
-Natron::interpolate(double tcur,
-                    const double vcur,                     //start control point
-                    const double vcurDerivRight,        //being the derivative dv/dt at tcur
-                    const double vnextDerivLeft,        //being the derivative dv/dt at tnext
-                    double tnext,
-                    const double vnext,                      //end control point
-                    double currentTime,
-                    Natron::KeyframeTypeEnum interp,
-                    Natron::KeyframeTypeEnum interpNext)
+/// the coefficients of the cubic between two control points, shared by interpolate(), derive() and integrate()
+void
+Natron::cubicCoefficients(double tcur,
+                          const double vcur,                     //start control point
+                          const double vcurDerivRight,        //being the derivative dv/dt at tcur
+                          const double vnextDerivLeft,        //being the derivative dv/dt at tnext
+                          double tnext,
+                          const double vnext,                      //end control point
+                          Natron::KeyframeTypeEnum interp,
+                          Natron::KeyframeTypeEnum interpNext,
+                          double *tstart,
+                          double *tend,
+                          double *c0,
+                          double *c1,
+                          double *c2,
+                          double *c3)
 {
     double P0 = vcur;
     double P3 = vnext;
@@ -424,8 +392,6 @@ Natron::interpolate(double tcur,
     double P0pr = vcurDerivRight * (tnext - tcur); // normalize for x \in [0,1]
     double P3pl = vnextDerivLeft * (tnext - tcur); // normalize for x \in [0,1]
 
-    // if the following is true, this makes the special case for eKeyframeTypeConstant at tnext useless, and we can always use a cubic - the strict "currentTime < tnext" is the key
-    assert( ( (interp == eKeyframeTypeNone) || (tcur <= currentTime) ) && ( (currentTime < tnext) || (interpNext == eKeyframeTypeNone) ) );
     // after the last / before the first keyframe, derivatives are wrt currentTime (i.e. non-normalized)
     if (interp == eKeyframeTypeNone) {
         // virtual previous frame at t-1
@@ -443,8 +409,35 @@ Natron::interpolate(double tcur,
         P3 = P0 + P0pr;
         tnext = tcur + 1;
     }
+    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, c0, c1, c2, c3);
+    *tstart = tcur;
+    *tend = tnext;
+}
+
+/**
+ * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
+ * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
+ * t \in [t1,t2]) and P2(t2,v2) (being the derivative at P3 with respect to
+ * t \in [t1,t2]) the value at 'currentTime' using the
+ * interpolation method "interp".
+ * Note that for CATMULL-ROM you must use the function interpolate_catmullRom
+ * which will compute the derivatives for you.
+ **/
+double
+Natron::interpolate(double tcur,
+                    const double vcur,                     //start control point
+                    const double vcurDerivRight,        //being the derivative dv/dt at tcur
+                    const double vnextDerivLeft,        //being the derivative dv/dt at tnext
+                    double tnext,
+                    const double vnext,                      //end control point
+                    double currentTime,
+                    Natron::KeyframeTypeEnum interp,
+                    Natron::KeyframeTypeEnum interpNext)
+{
+    // if the following is true, this makes the special case for eKeyframeTypeConstant at tnext useless, and we can always use a cubic - the strict "currentTime < tnext" is the key
+    assert( ( (interp == eKeyframeTypeNone) || (tcur <= currentTime) ) && ( (currentTime < tnext) || (interpNext == eKeyframeTypeNone) ) );
     double c0, c1, c2, c3;
-    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c0, &c1, &c2, &c3);
+    cubicCoefficients(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext, interp, interpNext, &tcur, &tnext, &c0, &c1, &c2, &c3);
 
     const double t = (currentTime - tcur) / (tnext - tcur);
     double ret = cubicEval(c0, c1, c2, c3, t);
@@ -467,33 +460,10 @@ Natron::derive(double tcur,
                Natron::KeyframeTypeEnum interp,
                Natron::KeyframeTypeEnum interpNext)
 {
-    double P0 = vcur;
-    double P3 = vnext;
-    // Hermite coefficients P0' and P3' are the derivatives with respect to x \in [0,1]
-    double P0pr = vcurDerivRight * (tnext - tcur); // normalize for x \in [0,1]
-    double P3pl = vnextDerivLeft * (tnext - tcur); // normalize for x \in [0,1]
-
     // if the following is true, this makes the special case for eKeyframeTypeConstant at tnext useless, and we can always use a cubic - the strict "currentTime < tnext" is the key
     assert( ( (interp == eKeyframeTypeNone) || (tcur <= currentTime) ) && ( (currentTime < tnext) || (interpNext == eKeyframeTypeNone) ) );
-    // after the last / before the first keyframe, derivatives are wrt currentTime (i.e. non-normalized)
-    if (interp == eKeyframeTypeNone) {
-        // virtual previous frame at t-1
-        P0 = P3 - P3pl;
-        P0pr = P3pl;
-        tcur = tnext - 1.;
-    } else if (interp == eKeyframeTypeConstant) {
-        P0pr = 0.;
-        P3pl = 0.;
-        P3 = P0;
-    }
-    if (interpNext == eKeyframeTypeNone) {
-        // virtual next frame at t+1
-        P3pl = P0pr;
-        P3 = P0 + P0pr;
-        tnext = tcur + 1;
-    }
     double c0, c1, c2, c3;
-    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c0, &c1, &c2, &c3);
+    cubicCoefficients(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext, interp, interpNext, &tcur, &tnext, &c0, &c1, &c2, &c3);
 
     const double t = (currentTime - tcur) / (tnext - tcur);
     double ret = cubicDerive(c0, c1, c2, c3, t);
@@ -570,33 +540,10 @@ Natron::integrate(double tcur,
                   Natron::KeyframeTypeEnum interp,
                   Natron::KeyframeTypeEnum interpNext)
 {
-    double P0 = vcur;
-    double P3 = vnext;
-    // Hermite coefficients P0' and P3' are the derivatives with respect to x \in [0,1]
-    double P0pr = vcurDerivRight * (tnext - tcur); // normalize for x \in [0,1]
-    double P3pl = vnextDerivLeft * (tnext - tcur); // normalize for x \in [0,1]
-
     // in the next expression, the correct test is t2 <= tnext (not <), in order to integrate from tcur to tnext
     assert( ( (interp == eKeyframeTypeNone) || (tcur <= time1) ) && (time1 <= time2) && ( (time2 <= tnext) || (interpNext == eKeyframeTypeNone) ) );
-    // after the last / before the first keyframe, derivatives are wrt currentTime (i.e. non-normalized)
-    if (interp == eKeyframeTypeNone) {
-        // virtual previous frame at t-1
-        P0 = P3 - P3pl;
-        P0pr = P3pl;
-        tcur = tnext - 1.;
-    } else if (interp == eKeyframeTypeConstant) {
-        P0pr = 0.;
-        P3pl = 0.;
-        P3 = P0;
-    }
-    if (interpNext == eKeyframeTypeNone) {
-        // virtual next frame at t+1
-        P3pl = P0pr;
-        P3 = P0 + P0pr;
-        tnext = tcur + 1;
-    }
     double c0, c1, c2, c3;
-    hermiteToCubicCoeffs(P0, P0pr, P3pl, P3, &c0, &c1, &c2, &c3);
+    cubicCoefficients(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext, interp, interpNext, &tcur, &tnext, &c0, &c1, &c2, &c3);
 
     const double t2 = (time2 - tcur) / (tnext - tcur);
     double ret = cubicIntegrate(c0, c1, c2, c3, t2);
@@ -27,6 +27,50 @@
 
 #include "Global/Enums.h"
 namespace Natron {
+/// evaluate the cubic c0 + c1 t + c2 t^2 + c3 t^3 at t
+inline double
+cubicEval(double c0,
+          double c1,
+          double c2,
+          double c3,
+          double t)
+{
+    const double t2 = t * t;
+    const double t3 = t2 * t;
+
+    return c0 + c1 * t + c2 * t2 + c3 * t3;
+}
+
+/// integrate the cubic c0 + c1 t + c2 t^2 + c3 t^3 from 0 to t
+inline double
+cubicIntegrate(double c0,
+               double c1,
+               double c2,
+               double c3,
+               double t)
+{
+    const double t2 = t * t;
+    const double t3 = t2 * t;
+    const double t4 = t3 * t;
+
+    return c0 * t + c1 * t2 / 2. + c2 * t3 / 3 + c3 * t4 / 4;
+}
+
+/**
+ * @brief Computes the coefficients of the cubic used by interpolate(), derive() and integrate() between
+ * the two control points: the value at currentTime is cubicEval(c0, c1, c2, c3, t) with
+ * t = (currentTime - tstart) / (tend - tstart).
+ * tstart and tend differ from tcur and tnext before the first and after the last control point.
+ **/
+void cubicCoefficients(double tcur, const double vcur, //start control point
+                       const double vcurDerivRight, //being the derivative dv/dt at tcur
+                       const double vnextDerivLeft, //being the derivative dv/dt at tnext
+                       double tnext, const double vnext, //end control point
+                       KeyframeTypeEnum interp,
+                       KeyframeTypeEnum interpNext,
+                       double *tstart, double *tend,
+                       double *c0, double *c1, double *c2, double *c3);
+
 /**
  * @brief Interpolates using the control points P0(t0,v0) , P3(t3,v3)
  * and the derivatives P1(t1,v1) (being the derivative at P0 with respect to
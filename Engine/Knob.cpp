@@ -1336,6 +1336,10 @@ KnobHelper::evaluateValueChange(int dimension,
     
     bool guiFrozen = app && _imp->gui && _imp->gui->isGuiFrozenForPlayback();
 
+    if (reason != Natron::eValueChangedReasonTimeChanged && _imp->holder) {
+        _imp->holder->onKnobRenderValueChanged(this);
+    }
+
     /// For eValueChangedReasonTimeChanged we never call the instanceChangedAction and evaluate otherwise it would just throttle down
     /// the application responsiveness
     if (reason != Natron::eValueChangedReasonTimeChanged && _imp->holder) {
@@ -48,6 +48,7 @@
 class KnobPage;
 class Curve;
 class KeyFrame;
+class Hash64;
 class KnobHolder;
 class AppInstance;
 class KnobSerialization;
@@ -62,6 +63,27 @@ class OfxParamOverlayInteract;
 class DockablePanelI;
 
 class KnobI;
+
+/**
+ * @brief An immutable copy of the values and animation of a knob, taken when a render starts so that
+ * the render threads can read the knob without locking nor allocating. See KnobI::createSnapshot()
+ **/
+class KnobSnapshotI
+{
+public:
+
+    KnobSnapshotI()
+    {
+    }
+
+    virtual ~KnobSnapshotI()
+    {
+    }
+};
+
+template <typename T>
+class KnobSnapshot;
+
 class KnobSignalSlotHandler
 : public QObject
 {
@@ -638,6 +660,15 @@ public:
     virtual bool onKeyFrameSet(SequenceTime time,const KeyFrame& key,int dimension) = 0;
     virtual bool setKeyFrame(const KeyFrame& key,int dimension,Natron::ValueChangedReasonEnum reason) = 0;
 
+    /**
+     * @brief Sets all the keyframes in the given dimension at once: the curve computes its derivatives once,
+     * the gui is notified once and a single render is triggered. Use it rather than setKeyFrame or
+     * setValueAtTime to import many keyframes.
+     * Like setValueAtTime, the infinite or NaN values are replaced by the maximum of the knob. The keyframes at an
+     * infinite or NaN time are ignored, and so are all the keyframes if the knob cannot be animated or is a string knob.
+     **/
+    virtual void setKeyFrames(const std::list<KeyFrame>& keys,int dimension,Natron::ValueChangedReasonEnum reason) = 0;
+
     /**
      * @brief Called when the current time of the timeline changes.
      * It must get the value at the given time and notify  the gui it must
@@ -1056,6 +1087,21 @@ public:
      **/
     virtual bool isTypeCompatible(const boost::shared_ptr<KnobI> & other) const = 0;
 
+    /**
+     * @brief Appends to the hash the name of the knob and, for each dimension, its expression, its keyframes
+     * or its value. This is used by the content-based hash of the nodes.
+     * @returns False if the value of a dimension depends on something else than the content of the knob,
+     * i.e: it has an expression.
+     **/
+    virtual bool appendToHash(Hash64* hash) const = 0;
+
+    /**
+     * @brief Returns a copy of the values and keyframes of the knob for the render threads.
+     * Returns NULL if the knob cannot be copied, i.e: its value depends on something else than its content
+     * (an expression or a master knob), or it does not trigger a render when it changes.
+     **/
+    virtual boost::shared_ptr<KnobSnapshotI> createSnapshot() const = 0;
+
     KnobPage* getTopLevelPage();
 };
 
@@ -1475,6 +1521,8 @@ public:
                         KeyFrame* newKey);
 
     virtual bool setKeyFrame(const KeyFrame& key,int dimension,Natron::ValueChangedReasonEnum reason) OVERRIDE FINAL;
+
+    virtual void setKeyFrames(const std::list<KeyFrame>& keys,int dimension,Natron::ValueChangedReasonEnum reason) OVERRIDE FINAL;
     
     /**
      * @brief Set the value of the knob in the given dimension with the given reason.
@@ -1614,6 +1662,12 @@ public:
     virtual bool isTypePOD() const OVERRIDE FINAL WARN_UNUSED_RETURN;
     virtual bool isTypeCompatible(const boost::shared_ptr<KnobI> & other) const OVERRIDE FINAL WARN_UNUSED_RETURN;
 
+    ///Cannot be overloaded by KnobHelper as it requires the value member
+    virtual bool appendToHash(Hash64* hash) const OVERRIDE;
+
+    ///Cannot be overloaded by KnobHelper as it requires the value member
+    virtual boost::shared_ptr<KnobSnapshotI> createSnapshot() const OVERRIDE FINAL;
+
     ///Cannot be overloaded by KnobHelper as it requires setValueAtTime
     virtual bool onKeyFrameSet(SequenceTime time,int dimension) OVERRIDE FINAL;
     virtual bool onKeyFrameSet(SequenceTime time,const KeyFrame& key,int dimension) OVERRIDE FINAL;
@@ -1668,6 +1722,12 @@ public:
     
     bool getValueFromCurve(double time,int dimension, bool useGuiCurve, bool byPassMaster, bool clamp, T* ret) const;
     
+    /**
+     * @brief Reads the value from the copy of the knob taken when the render of the current thread started.
+     * Returns false if there is no such copy.
+     **/
+    bool getValueFromSnapshot(double time,int dimension, bool clamp, T* ret) const;
+    
 protected:
     
     virtual void resetExtraToDefaultValue(int /*dimension*/) {}
@@ -2155,6 +2215,14 @@ public:
         return 0;
     }
     
+    /**
+     * @brief Returns the copy of the given knob taken when the render of the current thread started,
+     * or NULL if the current thread is not rendering.
+     **/
+    virtual const KnobSnapshotI* getKnobSnapshot(const KnobI* /*knob*/) const {
+        return 0;
+    }
+    
 protected:
 
 
@@ -2220,6 +2288,14 @@ public:
     {
     }
 
+    /**
+     * @brief Called in the thread which made the change, before it is evaluated, when the values, keyframes or
+     * expression used by the renders of a knob changed.
+     **/
+    virtual void onKnobRenderValueChanged(KnobI* /*knob*/)
+    {
+    }
+
 public Q_SLOTS:
     
     void onDoEndChangesOnMainThreadTriggered();
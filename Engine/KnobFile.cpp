@@ -26,11 +26,20 @@
 
 #include <utility>
 #include <stdexcept>
+#include <cassert>
 
 #include <QtCore/QStringList>
 #include <QtCore/QMutexLocker>
+#include <QtCore/QFileInfo>
+#include <QtCore/QDateTime>
+#include <QtCore/QThread>
+#include <QtCore/QCoreApplication>
 #include <QDebug>
 
+#include "Engine/AppInstance.h"
+#include "Engine/EffectInstance.h"
+#include "Engine/Hash64.h"
+#include "Engine/Node.h"
 #include "Engine/Transform.h"
 #include "Engine/StringAnimationManager.h"
 #include "Engine/KnobTypes.h"
@@ -50,6 +59,7 @@ KnobFile::KnobFile(KnobHolder* holder,
                      bool declaredByPlugin)
     : AnimatingKnobStringHelper(holder, description, dimension,declaredByPlugin)
       , _isInputImage(false)
+      , _reloadCount(0)
 {
 }
 
@@ -113,6 +123,42 @@ KnobFile::getFileName(int time) const
     }
 }
 
+void
+KnobFile::reloadFile()
+{
+    ///appendToHash() is called in the main thread only, when the hash of the node is computed
+    assert( QThread::currentThread() == qApp->thread() );
+    ++_reloadCount;
+
+    ///With the content-based hash, the images of the previous states of the node are not purged when its hash
+    ///changes, but they were all read from the previous version of the file
+    Natron::EffectInstance* effect = dynamic_cast<Natron::EffectInstance*>( getHolder() );
+    if ( effect && effect->getNode() ) {
+        effect->getNode()->removeAllImagesFromCache();
+    }
+}
+
+bool
+KnobFile::appendToHash(Hash64* hash) const
+{
+    bool contentOnly = AnimatingKnobStringHelper::appendToHash(hash);
+
+    ///The content of the file is not part of the knob: hash the reloads and, when the value names a single file,
+    ///its modification time, which also covers the files modified while the project was closed.
+    ///The files of a sequence are not checked, they would all have to be read.
+    hash->append(_reloadCount);
+    std::string filePath = getValue();
+    if ( getHolder() && getHolder()->getApp() ) {
+        getHolder()->getApp()->getProject()->canonicalizePath(filePath);
+    }
+    QFileInfo info( QString( filePath.c_str() ) );
+    if ( info.isFile() ) {
+        hash->append( info.lastModified().toMSecsSinceEpoch() );
+    }
+
+    return contentOnly;
+}
+
 /***********************************KnobOutputFile*****************************************/
 
 KnobOutputFile::KnobOutputFile(KnobHolder* holder,
@@ -103,6 +103,13 @@ public:
      */
     std::string getFileName(int time) const;
 
+    /**
+     * @brief Called when the file changed on disk or the user asked to reload it: removes the images of the node from
+     * the caches and changes its content-based hash, so that the images read from the previous version of the file
+     * are no longer found. This does not trigger a render.
+     **/
+    void reloadFile();
+
 Q_SIGNALS:
 
     void openFile();
@@ -112,11 +119,13 @@ private:
 
     virtual bool canAnimate() const OVERRIDE FINAL;
     virtual const std::string & typeName() const OVERRIDE FINAL;
+    virtual bool appendToHash(Hash64* hash) const OVERRIDE FINAL;
 
     int frameCount() const;
 
     static const std::string _typeNameStr;
     int _isInputImage;
+    int _reloadCount; //< only accessed in the main thread
 };
 
 /******************************KnobOutputFile**************************************/
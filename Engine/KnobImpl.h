@@ -54,6 +54,7 @@ GCC_DIAG_ON(unused-parameter)
 #include "Engine/AppInstance.h"
 #include "Engine/Project.h"
 #include "Engine/EffectInstance.h"
+#include "Engine/Hash64.h"
 #include "Engine/KnobTypes.h"
 
 
@@ -424,6 +425,64 @@ Knob<T>::evaluateExpression_pod(double time, int dimension) const
 
 }
 
+/**
+ * @brief The copy of a Knob<T> used by the render threads, see KnobI::createSnapshot()
+ **/
+template <typename T>
+class KnobSnapshot
+    : public KnobSnapshotI
+{
+public:
+
+    struct Dimension
+    {
+        T value;
+        T clampedValue;
+        CurveSnapshot curve;
+    };
+
+    std::vector<Dimension> dimensions;
+
+    KnobSnapshot()
+        : KnobSnapshotI()
+        , dimensions()
+    {
+    }
+
+    virtual ~KnobSnapshot()
+    {
+    }
+};
+
+template <>
+bool Knob<std::string>::getValueFromSnapshot(double /*time*/,int /*dimension*/,bool /*clamp*/,std::string* /*ret*/) const
+{
+    ///Strings are not copied: reading them allocates anyway
+    return false;
+}
+
+template <typename T>
+bool Knob<T>::getValueFromSnapshot(double time,int dimension,bool clamp,T* ret) const
+{
+    KnobHolder* holder = getHolder();
+    if (!holder) {
+        return false;
+    }
+    const KnobSnapshot<T>* snapshot = static_cast<const KnobSnapshot<T>*>( holder->getKnobSnapshot(this) );
+    if (!snapshot) {
+        return false;
+    }
+    assert( dimension < (int)snapshot->dimensions.size() );
+    const typename KnobSnapshot<T>::Dimension & dim = snapshot->dimensions[dimension];
+    if ( dim.curve.isAnimated() ) {
+        //getValueAt already clamps to the range for us
+        *ret = (T)dim.curve.getValueAt(time,clamp);
+    } else {
+        *ret = clamp ? dim.clampedValue : dim.value;
+    }
+    return true;
+}
+
 template <typename T>
 bool Knob<T>::getValueFromExpression(double time,int dimension,bool clamp,T* ret) const
 {
@@ -595,6 +654,15 @@ Knob<T>::getValue(int dimension,bool clamp) const
     }
  
     assert(dimension < (int)_values.size() && dimension >= 0);
+    
+    ///During a render, read the copy of the knob taken when the render started
+    if (!useGuiValues) {
+        T ret;
+        if (getValueFromSnapshot(getCurrentTime(),dimension,clamp,&ret)) {
+            return ret;
+        }
+    }
+    
     std::string hasExpr = getExpression(dimension);
     if (!hasExpr.empty()) {
         T ret;
@@ -684,6 +752,14 @@ Knob<T>::getValueAtTime(double time, int dimension,bool clamp ,bool byPassMaster
     
     bool useGuiValues = QThread::currentThread() == qApp->thread();
     
+    ///During a render, read the copy of the knob taken when the render started
+    if (!useGuiValues && !byPassMaster) {
+        T ret;
+        if (getValueFromSnapshot(time,dimension,clamp,&ret)) {
+            return ret;
+        }
+    }
+    
     std::string hasExpr = getExpression(dimension);
     if (!hasExpr.empty()) {
         T ret;
@@ -1669,6 +1745,95 @@ Knob<T>::isTypeCompatible(const boost::shared_ptr<KnobI> & other) const
     return isTypePOD() == other->isTypePOD();
 }
 
+template<typename T>
+static void
+appendKnobValueToHash(const T& value,
+                      Hash64* hash)
+{
+    hash->append(value);
+}
+
+template<>
+void
+appendKnobValueToHash(const std::string& value,
+                      Hash64* hash)
+{
+    Hash64_appendQString( hash, QString( value.c_str() ) );
+}
+
+template<typename T>
+bool
+Knob<T>::appendToHash(Hash64* hash) const
+{
+    bool contentOnly = true;
+
+    Hash64_appendQString( hash, QString( getName().c_str() ) );
+    for (int i = 0; i < getDimension(); ++i) {
+        std::string expr = getExpression(i);
+        if ( !expr.empty() ) {
+            ///The result of an expression depends on other parameters and on the time, which are not part of this knob
+            Hash64_appendQString( hash, QString( expr.c_str() ) );
+            contentOnly = false;
+            continue;
+        }
+        ///getCurve() and getValue() return the ones of the master if this dimension is slaved
+        boost::shared_ptr<Curve> curve = getCurve(i);
+        if ( curve && curve->isAnimated() ) {
+            curve->appendToHash(hash);
+            if ( !isTypePOD() ) {
+                ///The keyframes of string knobs only hold indexes in the string animation, hash the strings themselves
+                KeyFrameSet keys = curve->getKeyFrames_mt_safe();
+                for (KeyFrameSet::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+                    appendKnobValueToHash(getValueAtTime(it->getTime(), i), hash);
+                }
+            }
+        } else {
+            appendKnobValueToHash(getValue(i), hash);
+        }
+    }
+
+    return contentOnly;
+}
+
+template<>
+boost::shared_ptr<KnobSnapshotI>
+Knob<std::string>::createSnapshot() const
+{
+    ///Strings are not copied: reading them allocates anyway
+    return boost::shared_ptr<KnobSnapshotI>();
+}
+
+template<typename T>
+boost::shared_ptr<KnobSnapshotI>
+Knob<T>::createSnapshot() const
+{
+    ///The other knobs may change without changing the hash of the node the snapshot is kept for
+    if ( !getEvaluateOnChange() ) {
+        return boost::shared_ptr<KnobSnapshotI>();
+    }
+    
+    boost::shared_ptr<KnobSnapshot<T> > snapshot(new KnobSnapshot<T>);
+    snapshot->dimensions.resize( getDimension() );
+    for (int i = 0; i < getDimension(); ++i) {
+        ///Expressions and links to other knobs are evaluated when read
+        if ( !getExpression(i).empty() || getMaster(i).second ) {
+            return boost::shared_ptr<KnobSnapshotI>();
+        }
+        typename KnobSnapshot<T>::Dimension & dim = snapshot->dimensions[i];
+        boost::shared_ptr<Curve> curve = getCurve(i);
+        if (curve) {
+            curve->getSnapshot(&dim.curve);
+        }
+        {
+            QMutexLocker l(&_valueMutex);
+            dim.value = _values[i];
+        }
+        dim.clampedValue = clampToMinMax(dim.value,i);
+    }
+    
+    return snapshot;
+}
+
 template<typename T>
 bool
 Knob<T>::onKeyFrameSet(SequenceTime time,
@@ -1722,6 +1887,81 @@ Knob<T>::setKeyFrame(const KeyFrame& key,int dimension,Natron::ValueChangedReaso
     return ret;
 }
 
+template<typename T>
+void
+Knob<T>::setKeyFrames(const std::list<KeyFrame>& keys,int dimension,Natron::ValueChangedReasonEnum reason)
+{
+    assert(dimension >= 0 && dimension < getDimension());
+    if ( keys.empty() ) {
+        return;
+    }
+    if ( !canAnimate() || !isAnimationEnabled() ) {
+        qDebug() << "WARNING: Attempting to call setKeyFrames on " << getName().c_str() << " which does not have animation enabled.";
+        return;
+    }
+    if ( !isTypePOD() ) {
+        ///The keyframes of string knobs hold indexes in their string animation, not values
+        qDebug() << "WARNING: Attempting to call setKeyFrames on the string parameter " << getName().c_str();
+        return;
+    }
+    boost::shared_ptr<Curve> curve;
+    KnobHolder* holder = getHolder();
+    bool useGuiCurve = (!holder || !holder->isSetValueCurrentlyPossible()) && getKnobGuiPointer();
+    
+    if (!useGuiCurve) {
+        if (holder && getEvaluateOnChange()) {
+            holder->abortAnyEvaluation();
+        }
+        curve = getCurve(dimension,true);
+    } else {
+        curve = getGuiCurve(dimension);
+        setGuiCurveHasChanged(dimension,true);
+    }
+    assert(curve);
+
+    ///round the values the same way makeKeyFrame does
+    std::list<KeyFrame> keyFrames;
+    std::list<SequenceTime> keysAdded; //< the times where there was no keyframe, for the timeline
+    bool clampToIntegers = curve->areKeyFramesValuesClampedToIntegers();
+    bool clampToBooleans = curve->areKeyFramesValuesClampedToBooleans();
+    for (std::list<KeyFrame>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+        KeyFrame k(*it);
+        if (k.getTime() != k.getTime() || boost::math::isinf( k.getTime() )) { // check for NaN or infinity
+            qDebug() << "WARNING: setKeyFrames on " << getName().c_str() << " ignores a keyframe at an invalid time.";
+            continue;
+        }
+        if (clampToIntegers) {
+            k.setValue( std::floor(k.getValue() + 0.5) );
+        } else if (clampToBooleans) {
+            k.setValue( (bool)k.getValue() );
+        }
+        if (k.getValue() != k.getValue() || boost::math::isinf( k.getValue() )) { // check for NaN or infinity
+            k.setValue( (double)getMaximum(0) );
+        }
+        KeyFrame existingKey;
+        if ( !curve->getKeyFrameWithTime(k.getTime(), &existingKey) ) {
+            keysAdded.push_back( (SequenceTime)k.getTime() );
+        }
+        keyFrames.push_back(k);
+    }
+    if ( keyFrames.empty() ) {
+        return;
+    }
+    
+    curve->addKeyFrames(keyFrames);
+    if (holder) {
+        holder->setHasAnimation(true);
+    }
+    
+    if (!useGuiCurve) {
+        guiCurveCloneInternalCurve(Natron::eCurveChangeReasonInternal,dimension, reason);
+        evaluateValueChange(dimension, getCurrentTime(), reason);
+    }
+    if ( _signalSlotHandler && !keysAdded.empty() ) {
+        _signalSlotHandler->s_multipleKeyFramesSet(keysAdded, dimension, (int)reason);
+    }
+}
+
 template<typename T>
 bool
 Knob<T>::onKeyFrameSet(SequenceTime /*time*/,const KeyFrame& key,int dimension)
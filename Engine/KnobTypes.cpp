@@ -44,6 +44,7 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 #include "Engine/Curve.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/Format.h"
+#include "Engine/Hash64.h"
 #include "Engine/Image.h"
 #include "Engine/KnobFile.h"
 #include "Engine/KnobSerialization.h"
@@ -1698,6 +1699,17 @@ KnobParametric::setDefaultCurvesFromCurves()
     }
 }
 
+bool
+KnobParametric::appendToHash(Hash64* hash) const
+{
+    bool contentOnly = Knob<double>::appendToHash(hash);
+    for (std::size_t i = 0; i < _curves.size(); ++i) {
+        _curves[i]->appendToHash(hash);
+    }
+
+    return contentOnly;
+}
+
 bool
 KnobParametric::hasModificationsVirtual(int dimension) const
 {
@@ -214,6 +214,50 @@ public:
         return std::make_pair( key_type(),V() );
     }
 
+    // Among the maxCandidates least-recently-used elements that are not referenced
+    // anywhere else, purge the one with the lowest score. SCORE is a functor
+    // returning a double for a given V. Ties are broken in favour of the least recently used element.
+    template <typename SCORE>
+    std::pair<key_type,V> evictLowestScore(const SCORE & score,
+                                           unsigned int maxCandidates)
+    {
+        typename key_to_value_type::iterator best = _key_to_value.end();
+        typename std::list<V>::iterator bestValue;
+        double bestScore = 0.;
+        unsigned int nCandidates = 0;
+
+        for (typename key_tracker_type::iterator kit = _key_tracker.begin();
+             kit != _key_tracker.end() && nCandidates < maxCandidates;
+             ++kit) {
+            typename key_to_value_type::iterator it = _key_to_value.find(*kit);
+            assert( it != _key_to_value.end() );
+            for (typename std::list<V>::iterator it2 = it->second.first.begin(); it2 != it->second.first.end(); ++it2) {
+                if ( (*it2).use_count() == 1 ) {
+                    double s = score(*it2);
+                    if ( ( best == _key_to_value.end() ) || (s < bestScore) ) {
+                        best = it;
+                        bestValue = it2;
+                        bestScore = s;
+                    }
+                    ++nCandidates;
+                }
+            }
+        }
+        if ( best == _key_to_value.end() ) {
+            return std::make_pair( key_type(),V() );
+        }
+        std::pair<key_type,V> ret = std::make_pair(best->first,*bestValue);
+        if (best->second.first.size() == 1) {
+            // Erase both elements to completely purge record
+            _key_tracker.erase(best->second.second);
+            _key_to_value.erase(best);
+        } else {
+            best->second.first.erase(bestValue);
+        }
+
+        return ret;
+    }
+
     unsigned int size()
     {
         return _container.size();
@@ -327,6 +371,46 @@ public:
         return std::make_pair( key_type(),V() );
     }
 
+    // Among the maxCandidates least-recently-used elements that are not referenced
+    // anywhere else, purge the one with the lowest score. SCORE is a functor
+    // returning a double for a given V. Ties are broken in favour of the least recently used element.
+    template <typename SCORE>
+    std::pair<key_type,V> evictLowestScore(const SCORE & score,
+                                           unsigned int maxCandidates)
+    {
+        typename container_type::right_iterator best = _container.right.end();
+        typename std::list<V>::iterator bestValue;
+        double bestScore = 0.;
+        unsigned int nCandidates = 0;
+
+        for (typename container_type::right_iterator it = _container.right.begin();
+             it != _container.right.end() && nCandidates < maxCandidates;
+             ++it) {
+            for (typename std::list<V>::iterator it2 = it->first.begin(); it2 != it->first.end(); ++it2) {
+                if ( (*it2).use_count() == 1 ) {
+                    double s = score(*it2);
+                    if ( ( best == _container.right.end() ) || (s < bestScore) ) {
+                        best = it;
+                        bestValue = it2;
+                        bestScore = s;
+                    }
+                    ++nCandidates;
+                }
+            }
+        }
+        if ( best == _container.right.end() ) {
+            return std::make_pair( key_type(),V() );
+        }
+        std::pair<key_type,V> ret = std::make_pair(best->second,*bestValue);
+        if (best->first.size() == 1) {
+            _container.right.erase(best);
+        } else {
+            best->first.erase(bestValue);
+        }
+
+        return ret;
+    }
+
     unsigned int size()
     {
         return _container.size();
@@ -448,6 +532,50 @@ public:
         return std::make_pair( key_type(),V() );
     }
 
+    // Among the maxCandidates least-recently-used elements that are not referenced
+    // anywhere else, purge the one with the lowest score. SCORE is a functor
+    // returning a double for a given V. Ties are broken in favour of the least recently used element.
+    template <typename SCORE>
+    std::pair<key_type,V> evictLowestScore(const SCORE & score,
+                                           unsigned int maxCandidates)
+    {
+        typename key_to_value_type::iterator best = _key_to_value.end();
+        typename std::list<V>::iterator bestValue;
+        double bestScore = 0.;
+        unsigned int nCandidates = 0;
+
+        for (typename key_tracker_type::iterator kit = _key_tracker.begin();
+             kit != _key_tracker.end() && nCandidates < maxCandidates;
+             ++kit) {
+            typename key_to_value_type::iterator it = _key_to_value.find(*kit);
+            assert( it != _key_to_value.end() );
+            for (typename std::list<V>::iterator it2 = it->second.first.begin(); it2 != it->second.first.end(); ++it2) {
+                if ( (*it2).use_count() == 1 ) {
+                    double s = score(*it2);
+                    if ( ( best == _key_to_value.end() ) || (s < bestScore) ) {
+                        best = it;
+                        bestValue = it2;
+                        bestScore = s;
+                    }
+                    ++nCandidates;
+                }
+            }
+        }
+        if ( best == _key_to_value.end() ) {
+            return std::make_pair( key_type(),V() );
+        }
+        std::pair<key_type,V> ret = std::make_pair(best->first,*bestValue);
+        if (best->second.first.size() == 1) {
+            // Erase both elements to completely purge record
+            _key_tracker.erase(best->second.second);
+            _key_to_value.erase(best);
+        } else {
+            best->second.first.erase(bestValue);
+        }
+
+        return ret;
+    }
+
     unsigned int size()
     {
         return _key_to_value.size();
@@ -555,6 +683,46 @@ public:
         return std::make_pair( key_type(),V() );
     }
 
+    // Among the maxCandidates least-recently-used elements that are not referenced
+    // anywhere else, purge the one with the lowest score. SCORE is a functor
+    // returning a double for a given V. Ties are broken in favour of the least recently used element.
+    template <typename SCORE>
+    std::pair<key_type,V> evictLowestScore(const SCORE & score,
+                                           unsigned int maxCandidates)
+    {
+        typename container_type::right_iterator best = _container.right.end();
+        typename std::list<V>::iterator bestValue;
+        double bestScore = 0.;
+        unsigned int nCandidates = 0;
+
+        for (typename container_type::right_iterator it = _container.right.begin();
+             it != _container.right.end() && nCandidates < maxCandidates;
+             ++it) {
+            for (typename std::list<V>::iterator it2 = it->first.begin(); it2 != it->first.end(); ++it2) {
+                if ( (*it2).use_count() == 1 ) {
+                    double s = score(*it2);
+                    if ( ( best == _container.right.end() ) || (s < bestScore) ) {
+                        best = it;
+                        bestValue = it2;
+                        bestScore = s;
+                    }
+                    ++nCandidates;
+                }
+            }
+        }
+        if ( best == _container.right.end() ) {
+            return std::make_pair( key_type(),V() );
+        }
+        std::pair<key_type,V> ret = std::make_pair(best->second,*bestValue);
+        if (best->first.size() == 1) {
+            _container.right.erase(best);
+        } else {
+            best->first.erase(bestValue);
+        }
+
+        return ret;
+    }
+
     unsigned int size()
     {
         return _container.size();
@@ -658,6 +826,46 @@ public:
         return std::make_pair( key_type(),V() );
     }
 
+    // Among the maxCandidates least-recently-used elements that are not referenced
+    // anywhere else, purge the one with the lowest score. SCORE is a functor
+    // returning a double for a given V. Ties are broken in favour of the least recently used element.
+    template <typename SCORE>
+    std::pair<key_type,V> evictLowestScore(const SCORE & score,
+                                           unsigned int maxCandidates)
+    {
+        typename container_type::right_iterator best = _container.right.end();
+        typename std::list<V>::iterator bestValue;
+        double bestScore = 0.;
+        unsigned int nCandidates = 0;
+
+        for (typename container_type::right_iterator it = _container.right.begin();
+             it != _container.right.end() && nCandidates < maxCandidates;
+             ++it) {
+            for (typename std::list<V>::iterator it2 = it->first.begin(); it2 != it->first.end(); ++it2) {
+                if ( (*it2).use_count() == 1 ) {
+                    double s = score(*it2);
+                    if ( ( best == _container.right.end() ) || (s < bestScore) ) {
+                        best = it;
+                        bestValue = it2;
+                        bestScore = s;
+                    }
+                    ++nCandidates;
+                }
+            }
+        }
+        if ( best == _container.right.end() ) {
+            return std::make_pair( key_type(),V() );
+        }
+        std::pair<key_type,V> ret = std::make_pair(best->second,*bestValue);
+        if (best->first.size() == 1) {
+            _container.right.erase(best);
+        } else {
+            best->first.erase(bestValue);
+        }
+
+        return ret;
+    }
+
     unsigned int size()
     {
         return _container.size();
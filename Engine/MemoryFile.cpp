@@ -39,6 +39,7 @@
 #endif
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
 
 #include "Global/Macros.h"
 #include "Global/GlobalDefines.h"
@@ -361,6 +362,26 @@ MemoryFile::flush()
 #endif
 }
 
+bool
+MemoryFile::flush(size_t offset,
+                  size_t length)
+{
+    if ( !_imp->data || (offset >= _imp->size) ) {
+        return true;
+    }
+    length = std::min(length, _imp->size - offset);
+#if defined(__NATRON_UNIX__)
+    ///msync requires the address to be a multiple of the page size
+    static const size_t pageSize = (size_t)::sysconf(_SC_PAGESIZE);
+    size_t alignedOffset = offset - (offset % pageSize);
+
+    return ::msync(_imp->data + alignedOffset, length + (offset - alignedOffset), MS_SYNC) == 0;
+#elif defined(__NATRON_WIN32__)
+
+    return ::FlushViewOfFile(_imp->data + offset, length) != 0;
+#endif
+}
+
 MemoryFile::~MemoryFile()
 {
     if (_imp->data) {
@@ -132,6 +132,11 @@ public:
      **/
     bool flush();
 
+    /**
+     * @brief Same as flush() but only for the given range of bytes of the file.
+     **/
+    bool flush(size_t offset,size_t length);
+
     /**
      * @brief Returns the filepath of the backing file.
      **/
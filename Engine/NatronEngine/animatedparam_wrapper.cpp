@@ -794,6 +794,103 @@ static PyObject* Sbk_AnimatedParamFunc_setExpression(PyObject* self, PyObject* a
         return 0;
 }
 
+static PyObject* Sbk_AnimatedParamFunc_setValuesAtTimes(PyObject* self, PyObject* args, PyObject* kwds)
+{
+    AnimatedParamWrapper* cppSelf = 0;
+    SBK_UNUSED(cppSelf)
+    if (!Shiboken::Object::isValid(self))
+        return 0;
+    cppSelf = (AnimatedParamWrapper*)((::AnimatedParam*)Shiboken::Conversions::cppPointer(SbkNatronEngineTypes[SBK_ANIMATEDPARAM_IDX], (SbkObject*)self));
+    int overloadId = -1;
+    PythonToCppFunc pythonToCpp[] = { 0, 0, 0 };
+    SBK_UNUSED(pythonToCpp)
+    int numNamedArgs = (kwds ? PyDict_Size(kwds) : 0);
+    int numArgs = PyTuple_GET_SIZE(args);
+    PyObject* pyArgs[] = {0, 0, 0};
+
+    // invalid argument lengths
+    if (numArgs + numNamedArgs > 3) {
+        PyErr_SetString(PyExc_TypeError, "NatronEngine.AnimatedParam.setValuesAtTimes(): too many arguments");
+        return 0;
+    } else if (numArgs < 2) {
+        PyErr_SetString(PyExc_TypeError, "NatronEngine.AnimatedParam.setValuesAtTimes(): not enough arguments");
+        return 0;
+    }
+
+    if (!PyArg_ParseTuple(args, "|OOO:setValuesAtTimes", &(pyArgs[0]), &(pyArgs[1]), &(pyArgs[2])))
+        return 0;
+
+
+    // Overloaded function decisor
+    // 0: setValuesAtTimes(std::vector<double>,std::vector<double>,int)
+    if (numArgs >= 2
+        && (pythonToCpp[0] = Shiboken::Conversions::isPythonToCppConvertible(SbkNatronEngineTypeConverters[SBK_NATRONENGINE_STD_VECTOR_DOUBLE_IDX], (pyArgs[0])))
+        && (pythonToCpp[1] = Shiboken::Conversions::isPythonToCppConvertible(SbkNatronEngineTypeConverters[SBK_NATRONENGINE_STD_VECTOR_DOUBLE_IDX], (pyArgs[1])))) {
+        if (numArgs == 2) {
+            overloadId = 0; // setValuesAtTimes(std::vector<double>,std::vector<double>,int)
+        } else if ((pythonToCpp[2] = Shiboken::Conversions::isPythonToCppConvertible(Shiboken::Conversions::PrimitiveTypeConverter<int>(), (pyArgs[2])))) {
+            overloadId = 0; // setValuesAtTimes(std::vector<double>,std::vector<double>,int)
+        }
+    }
+
+    // Function signature not found.
+    if (overloadId == -1) goto Sbk_AnimatedParamFunc_setValuesAtTimes_TypeError;
+
+    // Call function/method
+    {
+        if (kwds) {
+            PyObject* value = PyDict_GetItemString(kwds, "dimension");
+            if (value && pyArgs[2]) {
+                PyErr_SetString(PyExc_TypeError, "NatronEngine.AnimatedParam.setValuesAtTimes(): got multiple values for keyword argument 'dimension'.");
+                return 0;
+            } else if (value) {
+                pyArgs[2] = value;
+                if (!(pythonToCpp[2] = Shiboken::Conversions::isPythonToCppConvertible(Shiboken::Conversions::PrimitiveTypeConverter<int>(), (pyArgs[2]))))
+                    goto Sbk_AnimatedParamFunc_setValuesAtTimes_TypeError;
+            }
+        }
+        ::std::vector<double > cppArg0;
+        pythonToCpp[0](pyArgs[0], &cppArg0);
+        ::std::vector<double > cppArg1;
+        pythonToCpp[1](pyArgs[1], &cppArg1);
+        int cppArg2 = 0;
+        if (pythonToCpp[2]) pythonToCpp[2](pyArgs[2], &cppArg2);
+
+        if (!PyErr_Occurred()) {
+            // setValuesAtTimes(std::vector<double>,std::vector<double>,int)
+            // Begin code injection
+
+            if (cppArg0.size() != cppArg1.size()) {
+                PyErr_SetString(PyExc_ValueError, "NatronEngine.AnimatedParam.setValuesAtTimes(): times and values must have the same length");
+                return 0;
+            }
+            if (dynamic_cast<StringParamBase*>(cppSelf)) {
+                PyErr_SetString(PyExc_TypeError, "NatronEngine.AnimatedParam.setValuesAtTimes(): string parameters cannot be animated from values");
+                return 0;
+            }
+            if (!cppSelf->getCanAnimate() || !cppSelf->getIsAnimationEnabled()) {
+                PyErr_SetString(PyExc_ValueError, "NatronEngine.AnimatedParam.setValuesAtTimes(): the parameter cannot be animated");
+                return 0;
+            }
+            cppSelf->setValuesAtTimes(cppArg0,cppArg1,cppArg2);
+
+            // End of code injection
+
+
+        }
+    }
+
+    if (PyErr_Occurred()) {
+        return 0;
+    }
+    Py_RETURN_NONE;
+
+    Sbk_AnimatedParamFunc_setValuesAtTimes_TypeError:
+        const char* overloads[] = {"list, list, int = 0", 0};
+        Shiboken::setErrorAboutWrongArguments(args, "NatronEngine.AnimatedParam.setValuesAtTimes", overloads);
+        return 0;
+}
+
 static PyMethodDef Sbk_AnimatedParam_methods[] = {
     {"deleteValueAtTime", (PyCFunction)Sbk_AnimatedParamFunc_deleteValueAtTime, METH_VARARGS|METH_KEYWORDS},
     {"getCurrentTime", (PyCFunction)Sbk_AnimatedParamFunc_getCurrentTime, METH_NOARGS},
@@ -806,6 +903,7 @@ static PyMethodDef Sbk_AnimatedParam_methods[] = {
     {"getNumKeys", (PyCFunction)Sbk_AnimatedParamFunc_getNumKeys, METH_VARARGS|METH_KEYWORDS},
     {"removeAnimation", (PyCFunction)Sbk_AnimatedParamFunc_removeAnimation, METH_VARARGS|METH_KEYWORDS},
     {"setExpression", (PyCFunction)Sbk_AnimatedParamFunc_setExpression, METH_VARARGS|METH_KEYWORDS},
+    {"setValuesAtTimes", (PyCFunction)Sbk_AnimatedParamFunc_setValuesAtTimes, METH_VARARGS|METH_KEYWORDS},
 
     {0} // Sentinel
 };
@@ -123,17 +123,18 @@ extern SbkConverter** SbkNatronEngineTypeConverters;
 #define SBK_STD_SIZE_T_IDX                                           0
 #define SBK_NATRONENGINE_STD_VECTOR_RECTI_IDX                        1 // std::vector<RectI >
 #define SBK_NATRONENGINE_STD_VECTOR_STD_STRING_IDX                   2 // std::vector<std::string >
-#define SBK_NATRONENGINE_STD_PAIR_STD_STRING_STD_STRING_IDX          3 // std::pair<std::string, std::string >
-#define SBK_NATRONENGINE_STD_LIST_STD_PAIR_STD_STRING_STD_STRING_IDX 4 // const std::list<std::pair<std::string, std::string > > &
-#define SBK_NATRONENGINE_STD_LIST_ITEMBASEPTR_IDX                    5 // std::list<ItemBase * >
-#define SBK_NATRONENGINE_STD_LIST_PARAMPTR_IDX                       6 // std::list<Param * >
-#define SBK_NATRONENGINE_STD_LIST_EFFECTPTR_IDX                      7 // std::list<Effect * >
-#define SBK_NATRONENGINE_STD_LIST_INT_IDX                            8 // const std::list<int > &
-#define SBK_NATRONENGINE_STD_LIST_STD_STRING_IDX                     9 // std::list<std::string >
-#define SBK_NATRONENGINE_QLIST_QVARIANT_IDX                          10 // QList<QVariant >
-#define SBK_NATRONENGINE_QLIST_QSTRING_IDX                           11 // QList<QString >
-#define SBK_NATRONENGINE_QMAP_QSTRING_QVARIANT_IDX                   12 // QMap<QString, QVariant >
-#define SBK_NatronEngine_CONVERTERS_IDX_COUNT                        13
+#define SBK_NATRONENGINE_STD_VECTOR_DOUBLE_IDX                       3 // const std::vector<double > &
+#define SBK_NATRONENGINE_STD_PAIR_STD_STRING_STD_STRING_IDX          4 // std::pair<std::string, std::string >
+#define SBK_NATRONENGINE_STD_LIST_STD_PAIR_STD_STRING_STD_STRING_IDX 5 // const std::list<std::pair<std::string, std::string > > &
+#define SBK_NATRONENGINE_STD_LIST_ITEMBASEPTR_IDX                    6 // std::list<ItemBase * >
+#define SBK_NATRONENGINE_STD_LIST_PARAMPTR_IDX                       7 // std::list<Param * >
+#define SBK_NATRONENGINE_STD_LIST_EFFECTPTR_IDX                      8 // std::list<Effect * >
+#define SBK_NATRONENGINE_STD_LIST_INT_IDX                            9 // const std::list<int > &
+#define SBK_NATRONENGINE_STD_LIST_STD_STRING_IDX                     10 // std::list<std::string >
+#define SBK_NATRONENGINE_QLIST_QVARIANT_IDX                          11 // QList<QVariant >
+#define SBK_NATRONENGINE_QLIST_QSTRING_IDX                           12 // QList<QString >
+#define SBK_NATRONENGINE_QMAP_QSTRING_QVARIANT_IDX                   13 // QMap<QString, QVariant >
+#define SBK_NatronEngine_CONVERTERS_IDX_COUNT                        14
 
 // Macros for type check
 
@@ -37,6 +37,8 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 // /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
 #include <boost/bind.hpp>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#include <boost/unordered_set.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <ofxNatron.h>
 
@@ -1143,14 +1145,11 @@ Node::getCacheID() const
 }
 
 
-void
-Node::computeHashInternal(std::list<Natron::Node*>& marked)
+bool
+Node::computeHashInternal()
 {
-    if (std::find(marked.begin(), marked.end(), this) != marked.end()) {
-        return;
-    }
     if (!_imp->liveInstance) {
-        return;
+        return false;
     }
     ///Always called in the main thread
     assert( QThread::currentThread() == qApp->thread() );
@@ -1158,6 +1157,30 @@ Node::computeHashInternal(std::list<Natron::Node*>& marked)
         qDebug() << "Node::computeHash(): inputs not initialized";
     }
     
+    const bool contentHash = appPTR->getCurrentSettings()->isContentBasedNodeHashEnabled();
+    
+    ///The content of the node, hashed before taking the lock since it reads the values of the knobs
+    Hash64 contentHashValue;
+    bool contentOnly = false;
+    if (contentHash) {
+        ::Hash64_appendQString( &contentHashValue, QString( getPluginID().c_str() ) );
+        contentHashValue.append( getMajorVersion() );
+        contentHashValue.append( getMinorVersion() );
+        
+        ///The shapes of the roto nodes are not knobs, these nodes still rely on their age
+        contentOnly = !_imp->rotoContext && !_imp->paintStroke.lock();
+        const std::vector< boost::shared_ptr<KnobI> > & knobs = getKnobs();
+        for (std::vector< boost::shared_ptr<KnobI> >::const_iterator it = knobs.begin(); it != knobs.end(); ++it) {
+            ///Only the knobs which trigger a render when they change, the same ones that increment the age
+            if ( (*it)->getEvaluateOnChange() ) {
+                if ( !(*it)->appendToHash(&contentHashValue) ) {
+                    contentOnly = false;
+                }
+            }
+        }
+        contentHashValue.computeHash();
+    }
+    
     U64 oldHash,newHash;
     {
         QWriteLocker l(&_imp->knobsAgeMutex);
@@ -1167,8 +1190,15 @@ Node::computeHashInternal(std::list<Natron::Node*>& marked)
         ///reset the hash value
         _imp->hash.reset();
         
-        ///append the effect's own age
-        _imp->hash.append(_imp->knobsAge);
+        if (contentHash) {
+            _imp->hash.append( contentHashValue.value() );
+            if (!contentOnly) {
+                _imp->hash.append(_imp->knobsAge);
+            }
+        } else {
+            ///append the effect's own age
+            _imp->hash.append(_imp->knobsAge);
+        }
         
         ///append all inputs hash
         boost::shared_ptr<RotoDrawableItem> attachedStroke = _imp->paintStroke.lock();
@@ -1221,9 +1251,12 @@ Node::computeHashInternal(std::list<Natron::Node*>& marked)
         ::Hash64_appendQString( &_imp->hash, QString( getScriptName().c_str() ) );
         
         ///Also append the project's creation time in the hash because 2 projects openend concurrently
-        ///could reproduce the same (especially simple graphs like Viewer-Reader)
-        qint64 creationTime =  getApp()->getProject()->getProjectCreationTime();
-        _imp->hash.append(creationTime);
+        ///could reproduce the same (especially simple graphs like Viewer-Reader).
+        ///With the content-based hash, identical graphs are meant to share their images.
+        if (!contentHash || !contentOnly) {
+            qint64 creationTime =  getApp()->getProject()->getProjectCreationTime();
+            _imp->hash.append(creationTime);
+        }
         
         _imp->hash.computeHash();
         
@@ -1231,19 +1264,30 @@ Node::computeHashInternal(std::list<Natron::Node*>& marked)
         
     } // QWriteLocker l(&_imp->knobsAgeMutex);
     
-    marked.push_back(this);
-    
-    if (oldHash != newHash) {
+    if (oldHash != newHash && !contentHash) {
         /*
          * We changed the node hash. That means all cache entries for this node with a different hash
          * are impossible to re-create again. Just discard them all. This is done in a separate thread.
+         * With the content-based hash, the previous entries are found again when the node gets back to a
+         * previous state (e.g: undo), they are left to the eviction policy of the caches.
          */
         removeAllImagesFromCacheWithMatchingIDAndDifferentKey(newHash);
     }
     
+    _imp->liveInstance->onNodeHashChanged(newHash);
+    
+    return oldHash != newHash;
+}
+
+void
+Node::getHashDependents(std::list<Natron::Node*>* dependents) const
+{
+    if (!_imp->liveInstance) {
+        return;
+    }
     bool isRotoPaint = _imp->liveInstance->isRotoPaintNode();
     
-    ///call it on all the outputs
+    ///The outputs
     std::list<Node*> outputs;
     getOutputsWithGroupRedirection(outputs);
     for (std::list<Node*>::iterator it = outputs.begin(); it != outputs.end(); ++it) {
@@ -1254,34 +1298,27 @@ Node::computeHashInternal(std::list<Natron::Node*>& marked)
         if (isRotoPaint && attachedStroke && attachedStroke->getContext()->getNode().get() == this) {
             continue;
         }
-        (*it)->computeHashInternal(marked);
+        dependents->push_back(*it);
     }
     
-    _imp->liveInstance->onNodeHashChanged(getHashValue());
-    
-    ///If the node has a rotopaint tree, compute the hash of the nodes in the tree
+    ///If the node has a rotopaint tree, the nodes in the tree
     if (_imp->rotoContext) {
         NodeList allItems;
         _imp->rotoContext->getRotoPaintTreeNodes(&allItems);
         for (NodeList::iterator it = allItems.begin(); it!=allItems.end(); ++it) {
-            (*it)->computeHashInternal(marked);
+            dependents->push_back(it->get());
         }
-        
     }
     
-    
-    ///If the node is a group, call it on all nodes in the group
-    ///Also force a change to their hash
-    NodeGroup* group = dynamic_cast<NodeGroup*>(getLiveInstance());
+    ///If the node is a group, all nodes in the group
+    NodeGroup* group = dynamic_cast<NodeGroup*>(_imp->liveInstance.get());
     if (group) {
         NodeList nodes = group->getNodes();
         for (NodeList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
             assert(*it);
-            (*it)->incrementKnobsAge();
-            (*it)->computeHashInternal(marked);
+            dependents->push_back(it->get());
         }
     }
-
 }
 
 void
@@ -1324,8 +1361,66 @@ Node::computeHash()
         Q_EMIT mustComputeHashOnMainThread();
         return;
     }
-    std::list<Natron::Node*> marked;
-    computeHashInternal(marked);
+    
+    /*
+     * Sort the nodes depending on this node in topological order (reverse post-order of a depth-first search) so that
+     * each of them is hashed once, after all its inputs downstream of this node.
+     * The search is iterative so that long chains of nodes do not overflow the stack.
+     */
+    typedef boost::unordered_map<Node*, std::list<Node*> > DependentsMap;
+    DependentsMap dependents;
+    std::vector<Node*> sorted;
+    {
+        std::vector<std::pair<Node*, std::list<Node*>::iterator> > stack;
+        std::list<Node*>& thisDependents = dependents[this];
+        getHashDependents(&thisDependents);
+        stack.push_back( std::make_pair(this, thisDependents.begin()) );
+        while ( !stack.empty() ) {
+            Node* node = stack.back().first;
+            std::list<Node*>::iterator& next = stack.back().second;
+            if ( next == dependents[node].end() ) {
+                sorted.push_back(node);
+                stack.pop_back();
+                continue;
+            }
+            Node* dependent = *next;
+            ++next;
+            std::pair<DependentsMap::iterator, bool> inserted = dependents.insert( std::make_pair( dependent, std::list<Node*>() ) );
+            if (!inserted.second) {
+                ///Already visited
+                continue;
+            }
+            dependent->getHashDependents(&inserted.first->second);
+            stack.push_back( std::make_pair(dependent, inserted.first->second.begin()) );
+        }
+    }
+    
+    /*
+     * Recompute the hashes in that order. A node is recomputed only if one of the nodes it depends on had its hash
+     * changed, so that the propagation stops as soon as a hash is left unchanged.
+     */
+    boost::unordered_set<Node*> dirty;
+    dirty.insert(this);
+    for (std::vector<Node*>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it) {
+        Node* node = *it;
+        if ( dirty.find(node) == dirty.end() ) {
+            continue;
+        }
+        bool changed = node->computeHashInternal();
+        
+        ///The nodes of a group are forced to change their hash along with the group
+        NodeGroup* group = dynamic_cast<NodeGroup*>( node->getLiveInstance() );
+        
+        const std::list<Node*>& nodeDependents = dependents[node];
+        for (std::list<Node*>::const_iterator it2 = nodeDependents.begin(); it2 != nodeDependents.end(); ++it2) {
+            if (group && (*it2)->getGroup().get() == group) {
+                (*it2)->incrementKnobsAgeInternal();
+            } else if (!changed) {
+                continue;
+            }
+            dirty.insert(*it2);
+        }
+    }
     
 } // computeHash
 
@@ -1828,6 +1923,14 @@ Node::setKnobsAge(U64 newAge)
 
 void
 Node::incrementKnobsAge()
+{
+    incrementKnobsAgeInternal();
+    
+    computeHash();
+}
+
+void
+Node::incrementKnobsAgeInternal()
 {
     U32 newAge;
     {
@@ -1843,8 +1946,6 @@ Node::incrementKnobsAge()
         newAge = _imp->knobsAge;
     }
     Q_EMIT knobsAgeChanged(newAge);
-    
-    computeHash();
 }
 
 U64
@@ -4735,8 +4836,10 @@ Node::makePreviewImage(SequenceTime time,
             renderPreview<unsigned short, 65535>(*img, elemCount, width, height,convertToSrgb, buf);
             break;
         }
-        case Natron::eImageBitDepthHalf:
+        case Natron::eImageBitDepthHalf: {
+            renderPreview<Half, 1>(*img, elemCount, width, height,convertToSrgb, buf);
             break;
+        }
         case Natron::eImageBitDepthFloat: {
             renderPreview<float, 1>(*img, elemCount, width, height,convertToSrgb, buf);
             break;
@@ -1195,12 +1195,21 @@ protected:
     /**
      * @brief Recompute the hash value of this node and notify all the clone effects that the values they store in their
      * knobs is dirty and that they should refresh it by cloning the live instance.
+     * The hash of the nodes depending on this node is then recomputed in topological order, stopping wherever
+     * a hash is left unchanged.
      **/
     void computeHash();
 
 private:
     
-    void computeHashInternal(std::list<Natron::Node*>& marked);
+    ///Recompute the hash value of this node only, returns true if it changed
+    bool computeHashInternal();
+    
+    ///The nodes whose hash depends on the hash of this node: its outputs, the nodes of its rotopaint tree and of its group
+    void getHashDependents(std::list<Natron::Node*>* dependents) const;
+    
+    ///Increments the age of the knobs without recomputing the hash
+    void incrementKnobsAgeInternal();
     
     void declareRotoPythonField();
 
@@ -42,7 +42,6 @@ CLANG_DIAG_ON(deprecated-register)
 #ifdef OFX_SUPPORTS_MULTITHREAD
 #include <QtCore/QThread>
 #include <QtCore/QThreadStorage>
-#include <QtConcurrentMap>
 GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
 // /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
 #include <boost/bind.hpp>
@@ -94,6 +93,8 @@ CLANG_DIAG_ON(unknown-pragmas)
 #include "Engine/Node.h"
 #include "Engine/AppInstance.h"
 #include "Engine/Project.h"
+#include "Engine/RenderScheduler.h"
+#include "Engine/RenderStats.h"
 #include "Engine/ThreadStorage.h"
 
 using namespace Natron;
@@ -830,8 +831,8 @@ Natron::OfxHost::setThreadAsActionCaller(Natron::OfxImageEffectInstance* instanc
 
 namespace {
     
-///Using QtConcurrent doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
-///to be created. As QtConcurrent's thread-pool recycles thread, it seems to make Furnace crash.
+///Using the render scheduler doesn't work with The Foundry Furnace plug-ins because they expect fresh threads
+///to be created. As the scheduler recycles its threads, it seems to make Furnace crash.
 ///We think this is because Furnace must keep an internal thread-local state that becomes then dirty
 ///if we re-use the same thread.
 
@@ -840,6 +841,7 @@ threadFunctionWrapper(OfxThreadFunctionV1 func,
                       unsigned int threadIndex,
                       unsigned int threadMax,
                       const std::map<boost::shared_ptr<Natron::Node>,ParallelRenderArgs >& tlsCopy,
+                      const QThread* callingThread,
                       void *customArg)
 {
     assert(threadIndex < threadMax);
@@ -847,8 +849,8 @@ threadFunctionWrapper(OfxThreadFunctionV1 func,
     local.threadIndexes.push_back((int)threadIndex);
     
     boost::shared_ptr<ParallelRenderArgsSetter> tlsRaii;
-    //Set the TLS if not NULL
-    if (!tlsCopy.empty()) {
+    //Set the TLS if not NULL. The calling thread may run some of the threads functions itself, it already has the TLS
+    if ( !tlsCopy.empty() && (QThread::currentThread() != callingThread) ) {
         tlsRaii.reset(new ParallelRenderArgsSetter(tlsCopy));
     }
 
@@ -968,11 +970,12 @@ Natron::OfxHost::multiThread(OfxThreadFunctionV1 func,
     
     //Retrieve a handle to the thread calling this action if possible so we can copy the TLS
     std::map<boost::shared_ptr<Natron::Node>,ParallelRenderArgs > tlsCopy;
+    Natron::EffectInstance* instance = 0;
     QVariant imageEffectPointerProperty = QThread::currentThread()->property(kNatronTLSEffectPointerProperty);
     if (!imageEffectPointerProperty.isNull()) {
         QObject* pointerqobject = imageEffectPointerProperty.value<QObject*>();
         if (pointerqobject) {
-            Natron::EffectInstance* instance = dynamic_cast<Natron::EffectInstance*>(pointerqobject);
+            instance = dynamic_cast<Natron::EffectInstance*>(pointerqobject);
             if (instance) {
                 instance->getApp()->getProject()->getParallelRenderArgs(tlsCopy);
             }
@@ -988,14 +991,20 @@ Natron::OfxHost::multiThread(OfxThreadFunctionV1 func,
             threadIndexes[i] = i;
         }
         
-        /// DON'T set the maximum thread count, this is a global application setting, and see the documentation excerpt above
-        //QThreadPool::globalInstance()->setMaxThreadCount(nThreads);
-        QFuture<OfxStatus> future = QtConcurrent::mapped( threadIndexes, boost::bind(::threadFunctionWrapper,func, _1, nThreads, tlsCopy, customArg) );
-        future.waitForFinished();
-        ///DON'T reset back to the original value the maximum thread count
-        //QThreadPool::globalInstance()->setMaxThreadCount(QThread::idealThreadCount());
+        ///The thread functions run in the render scheduler, this thread runs those that its threads did not start
+        std::vector<OfxStatus> status;
+        Natron::RenderTaskTimings timings;
+        Natron::mapInRenderScheduler( threadIndexes.begin(), threadIndexes.end(),
+                                      boost::bind(::threadFunctionWrapper, func, _1, nThreads, tlsCopy, QThread::currentThread(), customArg),
+                                      &status, &timings );
+        if (instance) {
+            const ParallelRenderArgs* frameArgs = instance->getParallelRenderArgsTLS();
+            if ( frameArgs && frameArgs->stats && frameArgs->stats->isInDepthProfilingEnabled() ) {
+                frameArgs->stats->addTasksInfosForNode(instance->getNode(), timings);
+            }
+        }
         
-        for (QFuture<OfxStatus>::const_iterator it = future.begin(); it != future.end(); ++it) {
+        for (std::vector<OfxStatus>::const_iterator it = status.begin(); it != status.end(); ++it) {
             OfxStatus stat = *it;
             if (stat != kOfxStatOK) {
                 return stat;
@@ -349,6 +349,14 @@ OutputEffectInstance::reportStats(int time,
     for (std::map<boost::shared_ptr<Natron::Node>, NodeRenderStats >::const_iterator it = stats.begin(); it != stats.end(); ++it) {
         ofile << "------------------------------- " << it->first->getScriptName_mt_safe() << "------------------------------- " << std::endl;
         ofile << "Time spent rendering: " << Timer::printAsTime(it->second.getTotalTimeSpentRendering(), false).toStdString() << std::endl;
+        Natron::RenderThreadsDecision threadsDecision;
+        if ( it->second.getRenderThreadsDecision(&threadsDecision) ) {
+            ofile << "Parallel renders: " << threadsDecision.threadsCount << " (" << threadsDecision.reason << ")" << std::endl;
+            ofile << "Throughput with " << threadsDecision.previousThreadsCount << " parallel renders: " << threadsDecision.framesPerSecond
+                  << " fps, " << Timer::printAsTime(threadsDecision.frameLatency, false).toStdString() << " per frame" << std::endl;
+            ofile << "Memory per frame in flight: " << (U64)threadsDecision.memoryPerFrame / (1024 * 1024) << " MiB, allowing "
+                  << threadsDecision.maxThreadsCount << " parallel renders" << std::endl;
+        }
         const RectD & rod = it->second.getRoD();
         ofile << "Region of definition: x1 = " << rod.x1  << " y1 = " << rod.y1 << " x2 = " << rod.x2 << " y2 = " << rod.y2 << std::endl;
         ofile << "Is Identity to Effect? ";
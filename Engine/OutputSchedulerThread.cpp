@@ -28,13 +28,13 @@
 #include <set>
 #include <list>
 #include <algorithm> // min, max
+#include <cmath>
 
 #include <QMetaType>
 #include <QMutex>
 #include <QWaitCondition>
 #include <QCoreApplication>
 #include <QString>
-#include <QThreadPool>
 #include <QDebug>
 #include <QtConcurrentRun>
 #include <QFuture>
@@ -51,7 +51,9 @@
 #include "Engine/Node.h"
 #include "Engine/OpenGLViewerI.h"
 #include "Engine/Project.h"
+#include "Engine/RenderScheduler.h"
 #include "Engine/RenderStats.h"
+#include "Engine/RenderThreadsController.h"
 #include "Engine/Settings.h"
 #include "Engine/Timer.h"
 #include "Engine/TimeLine.h"
@@ -60,6 +62,11 @@
 
 #define NATRON_FPS_REFRESH_RATE_SECONDS 1.5
 
+///In automatic mode, at most this number of frames per core are rendered in parallel
+#define NATRON_PARALLEL_RENDERS_PER_CORE_MAX 2
+///The ratio of the RAM that the frames in flight may use at least, whatever the cache settings
+#define NATRON_PARALLEL_RENDERS_MEMORY_BUDGET_MIN 0.1
+
 
 using namespace Natron;
 
@@ -237,6 +244,9 @@ struct OutputSchedulerThreadPrivate
     QMutex runningCallbackMutex;
     QWaitCondition runningCallbackCond;
     
+    ///Decides how many frames are rendered in parallel, MT-safe
+    RenderThreadsController threadsController;
+    
     OutputSchedulerThreadPrivate(RenderEngine* engine,Natron::OutputEffectInstance* effect,OutputSchedulerThread::ProcessFrameModeEnum mode)
     : buf()
     , bufCondition()
@@ -282,6 +292,7 @@ struct OutputSchedulerThreadPrivate
     , runningCallback(false)
     , runningCallbackMutex()
     , runningCallbackCond()
+    , threadsController()
     {
        
     }
@@ -389,6 +400,19 @@ struct OutputSchedulerThreadPrivate
         }
     }
     
+    ///The render threads which are not scheduled for removal
+    int getNRenderThreadsNotQuitting() const {
+        ///Private shouldn't lock
+        assert( !renderThreadsMutex.tryLock() );
+        int ret = 0;
+        for (RenderThreads::const_iterator it = renderThreads.begin(); it != renderThreads.end(); ++it) {
+            if ( !it->thread->mustQuit() ) {
+                ++ret;
+            }
+        }
+        return ret;
+    }
+    
     int getNActiveRenderThreads() const {
         ///Private shouldn't lock
         assert( !renderThreadsMutex.tryLock() );
@@ -829,7 +853,10 @@ OutputSchedulerThread::startRender()
         nThreads = (int)_imp->renderThreads.size();
     }
     
-    ///Start with one thread if it doesn't exist
+    ///Measure the throughput of this render from scratch, starting with one parallel render per core
+    _imp->threadsController.reset( appPTR->getHardwareIdealThreadCount() );
+    
+    ///Start the threads if they don't exist
     if (nThreads == 0) {
         int lastNThreads;
         adjustNumberOfThreads(&nThreads, &lastNThreads);
@@ -1212,50 +1239,63 @@ OutputSchedulerThread::run()
 void
 OutputSchedulerThread::adjustNumberOfThreads(int* newNThreads, int *lastNThreads)
 {
-    ///////////
-    /////If we were analysing the CPU activity, now set the appropriate number of threads to render.
-    int optimalNThreads;
-    
     ///How many parallel renders the user wants
-    int userSettingParallelThreads = appPTR->getCurrentSettings()->getNumberOfParallelRenders();
-    
-    ///How many threads are running in the application
-    int runningThreads = appPTR->getNRunningThreads() + QThreadPool::globalInstance()->activeThreadCount();
+    boost::shared_ptr<Settings> settings = appPTR->getCurrentSettings();
+    int userSettingParallelThreads = settings->getNumberOfParallelRenders();
     
     ///How many current threads are used by THIS renderer
-    int currentParallelRenders = getNRenderThreads();
+    int currentParallelRenders;
+    {
+        QMutexLocker l(&_imp->renderThreadsMutex);
+        currentParallelRenders = _imp->getNRenderThreadsNotQuitting();
+    }
     *lastNThreads = currentParallelRenders;
     
+    int minNThreads, maxNThreads;
     if (userSettingParallelThreads == 0) {
-        ///User wants it to be automatically computed, do a simple heuristic: launch as many parallel renders
-        ///as there are cores
-        optimalNThreads = appPTR->getHardwareIdealThreadCount();
+        ///User wants it to be automatically computed: the controller looks for the best throughput. Go beyond the number
+        ///of cores because renders waiting on the disk (readers) leave their core idle
+        minNThreads = 1;
+        maxNThreads = appPTR->getHardwareIdealThreadCount() * NATRON_PARALLEL_RENDERS_PER_CORE_MAX;
     } else {
-        optimalNThreads = userSettingParallelThreads;
+        minNThreads = maxNThreads = userSettingParallelThreads;
+    }
+    
+    ///The frames in flight may use the RAM which is neither dedicated to the caches nor kept free for the system
+    double memoryBudgetRatio = std::max(NATRON_PARALLEL_RENDERS_MEMORY_BUDGET_MIN,
+                                        1. - settings->getRamMaximumPercent() - settings->getUnreachableRamPercent());
+    _imp->threadsController.setLimits(minNThreads, maxNThreads, memoryBudgetRatio * getSystemTotalRAM());
+    
+    int optimalNThreads;
+    if (currentParallelRenders == 0) {
+        ///Starting the render, nothing was measured yet
+        optimalNThreads = _imp->threadsController.getInitialThreadsCount();
+    } else {
+        ///The image buffers which are not in the caches are held by the frames in flight
+        double inFlightMemory = (double)appPTR->getImageBuffersUsedMemorySize() - (double)appPTR->getCachesTotalMemorySize();
+        optimalNThreads = _imp->threadsController.notifyFrameDone( currentParallelRenders, std::max(0., inFlightMemory) );
     }
     optimalNThreads = std::max(1,optimalNThreads);
 
-
-    if ((runningThreads < optimalNThreads && currentParallelRenders < optimalNThreads) || currentParallelRenders == 0) {
-     
+    if (optimalNThreads > currentParallelRenders) {
         ////////
-        ///Launch 1 thread
+        ///Launch threads
         QMutexLocker l(&_imp->renderThreadsMutex);
-        
-        _imp->appendRunnable(createRunnable());
-        *newNThreads = currentParallelRenders +  1;
-        
-    } else if (runningThreads > optimalNThreads && currentParallelRenders > optimalNThreads) {
+        for (int i = currentParallelRenders; i < optimalNThreads; ++i) {
+            _imp->appendRunnable(createRunnable());
+        }
+    } else if (optimalNThreads < currentParallelRenders) {
         ////////
-        ///Stop 1 thread
-        stopRenderThreads(1);
-        *newNThreads = currentParallelRenders - 1;
-        
-    } else {
-        /////////
-        ///Keep the current count
-        *newNThreads = std::max(1,currentParallelRenders);
+        ///Stop threads
+        stopRenderThreads(currentParallelRenders - optimalNThreads);
     }
+    *newNThreads = optimalNThreads;
+}
+
+void
+OutputSchedulerThread::notifyFrameRenderTime(double timeSpent)
+{
+    _imp->threadsController.notifyFrameRenderTime(timeSpent);
 }
 
 void
@@ -1270,6 +1310,13 @@ OutputSchedulerThread::notifyFrameRendered(int frame,
     double timeSpent;
     int nbCurParallelRenders;
     
+    ///Log the number of frames rendered in parallel and why
+    Natron::RenderThreadsDecision threadsDecision;
+    bool hasThreadsDecision = _imp->threadsController.getLastDecision(&threadsDecision);
+    if (stats && hasThreadsDecision && stats->isInDepthProfilingEnabled()) {
+        stats->setRenderThreadsDecisionForNode(_imp->outputEffect->getNode(), threadsDecision);
+    }
+    
     if (stats) {
         std::map<boost::shared_ptr<Natron::Node>,NodeRenderStats > statResults = stats->getStats(&timeSpent);
         if (!statResults.empty()) {
@@ -1344,6 +1391,12 @@ OutputSchedulerThread::notifyFrameRendered(int frame,
             QString timeRemainingStr = Timer::printAsTime(timeRemaining, true);
             ts << "\nTime elapsed for frame: " << timeSpentStr;
             ts << "\nTime remaining: " << timeRemainingStr;
+            ts << "\nCache lock contentions: " << appPTR->getCachesLockContentionCount();
+            if (hasThreadsDecision) {
+                ts << "\nParallel renders: " << threadsDecision.threadsCount << " (" << threadsDecision.reason.c_str()
+                   << ", " << QString::number(threadsDecision.framesPerSecond, 'f', 2) << " fps with "
+                   << threadsDecision.previousThreadsCount << ")";
+            }
             frameStr.append(';');
             frameStr.append(QString::number(timeSpent));
             frameStr.append(';');
@@ -1916,7 +1969,9 @@ RenderThreadTask::run()
             break;
         }
         
+        TimeLapse frameTime;
         renderFrame(time,enableRenderStats);
+        _imp->scheduler->notifyFrameRenderTime( frameTime.getTimeSinceCreation() );
         
         if ( mustQuit() ) {
             break;
@@ -2445,7 +2500,9 @@ ViewerDisplayScheduler::ViewerDisplayScheduler(RenderEngine* engine,ViewerInstan
 
 ViewerDisplayScheduler::~ViewerDisplayScheduler()
 {
-    
+    if (_prefetcher) {
+        _prefetcher->quitThread();
+    }
 }
 
 
@@ -2612,9 +2669,25 @@ ViewerDisplayScheduler::handleRenderFailure(const std::string& /*errorMessage*/)
     _viewer->disconnectViewer();
 }
 
+void
+ViewerDisplayScheduler::aboutToStartRender()
+{
+    int first,last;
+    getFrameRangeRequestedToRender(first, last);
+    if (!_prefetcher) {
+        _prefetcher.reset(new ViewerPlaybackPrefetcher(_viewer,this));
+    }
+    _prefetcher->startPrefetch(first, last);
+}
+
 void
 ViewerDisplayScheduler::onRenderStopped(bool /*/aborted*/)
 {
+    ///The render threads are done, stop reading ahead too. If the playback was aborted, so is the frame being read ahead
+    if (_prefetcher) {
+        _prefetcher->stopPrefetch();
+    }
+    
     ///Refresh all previews in the tree
     _viewer->getNode()->refreshPreviewsRecursivelyUpstream(_viewer->getTimeline()->currentFrame());
     
@@ -2629,6 +2702,464 @@ ViewerDisplayScheduler::getLastRenderedTime() const
     return _viewer->getLastRenderedTime();
 }
 
+////////////////////////// ViewerPlaybackPrefetcher
+
+/**
+ * @brief Renders the frame into the viewer cache the same way the playback threads do, without displaying it.
+ * Returns false if nothing was rendered, because of a failure, an abort or because the viewer does not cache its textures.
+ **/
+static bool
+renderViewerFrameIntoCache(ViewerInstance* viewer,
+                           int time)
+{
+    int viewsCount = viewer->getRenderViewsCount();
+    int view = viewsCount > 0 ? viewer->getViewerCurrentView() : 0;
+    U64 viewerHash = viewer->getHash();
+    boost::shared_ptr<ViewerArgs> args[2];
+    
+    Natron::StatusEnum status[2] = {
+        eStatusFailed, eStatusFailed
+    };
+    
+    for (int i = 0; i < 2; ++i) {
+        args[i].reset(new ViewerArgs);
+        status[i] = viewer->getRenderViewerArgsAndCheckCache_public(time, true, true, view, i, viewerHash, NodePtr(), true, RenderStatsPtr(), args[i].get());
+        if (status[i] == eStatusFailed) {
+            continue;
+        }
+        if (args[i]->userRoIEnabled || args[i]->autoContrast) {
+            ///The viewer does not cache the textures in that case
+            return false;
+        }
+        if (args[i]->params && args[i]->params->ramBuffer) {
+            ///Already in the cache
+            args[i].reset();
+        }
+    }
+    
+    if (status[0] == eStatusFailed && status[1] == eStatusFailed) {
+        return false;
+    } else if (status[0] == eStatusReplyDefault || status[1] == eStatusReplyDefault) {
+        return false;
+    }
+    if (!args[0] && !args[1]) {
+        return true;
+    }
+    
+    Natron::StatusEnum stat;
+    try {
+        stat = viewer->renderViewer(view, false, true, viewerHash, true, NodePtr(), true, args, boost::shared_ptr<RequestedFrame>(), RenderStatsPtr());
+    } catch (...) {
+        stat = eStatusFailed;
+    }
+    
+    ///The textures are reset if the render was aborted
+    return stat != eStatusFailed && ( (args[0] && args[0]->params) || (args[1] && args[1]->params) );
+}
+
+
+struct ViewerPlaybackPrefetcherPrivate
+{
+    ViewerInstance* viewer;
+    OutputSchedulerThread* scheduler;
+    
+    mutable QMutex mutex; //< protects all the fields below
+    QWaitCondition cond; //< wakes up the thread when there is something to read ahead or when it must quit
+    QWaitCondition idleCond; //< signaled when the thread is no longer rendering a frame
+    bool active; //< true while the playback runs
+    bool working; //< true while a frame is rendered
+    bool mustQuit;
+    U64 generation; //< incremented each time the reading is stopped, so that a frame started before is not reported
+    int firstFrame,lastFrame;
+    
+    ///The frames read ahead, along the playback direction. The playback threads render the frames right after the
+    ///playhead, so the reading starts a few frames ahead of it.
+    bool hasReadAhead;
+    int firstFrameRead,lastFrameRead;
+    bool forward;
+    int windowSize; //< the number of frames read ahead of the playhead
+    
+    ViewerPlaybackPrefetcherPrivate(ViewerInstance* viewer, OutputSchedulerThread* scheduler)
+    : viewer(viewer)
+    , scheduler(scheduler)
+    , mutex()
+    , cond()
+    , idleCond()
+    , active(false)
+    , working(false)
+    , mustQuit(false)
+    , generation(0)
+    , firstFrame(0)
+    , lastFrame(0)
+    , hasReadAhead(false)
+    , firstFrameRead(0)
+    , lastFrameRead(0)
+    , forward(true)
+    , windowSize(0)
+    {
+        
+    }
+    
+    /**
+     * @brief Moves frame by offset frames along the playback direction, looping over the frame range if the playback
+     * loops. Returns false if the result is out of the frame range.
+     **/
+    bool stepFrame(int frame, int offset, Natron::PlaybackModeEnum mode, int* ret) const
+    {
+        int t = forward ? frame + offset : frame - offset;
+        if (t < firstFrame || t > lastFrame) {
+            if (mode != Natron::ePlaybackModeLoop) {
+                return false;
+            }
+            int rangeSize = lastFrame - firstFrame + 1;
+            t = firstFrame + ( ( (t - firstFrame) % rangeSize ) + rangeSize ) % rangeSize;
+        }
+        *ret = t;
+        return true;
+    }
+    
+    ///The number of frames from `from` to `to` along the playback direction, negative if `to` is behind
+    int getDistance(int from, int to, Natron::PlaybackModeEnum mode) const
+    {
+        int d = forward ? to - from : from - to;
+        if (d < 0 && mode == Natron::ePlaybackModeLoop) {
+            d += lastFrame - firstFrame + 1;
+        }
+        return d;
+    }
+    
+    ///Must be called with the mutex locked. Returns false if the frames of the read-ahead window are all rendered.
+    bool getNextFrameToRender(int* time);
+    
+    ///Reports the frames read ahead between the playhead and the last frame read to the timeline, or clears them
+    ///if the playhead is no longer behind them
+    void refreshTimelineRange(int currentFrame, Natron::PlaybackModeEnum mode);
+    
+};
+
+bool
+ViewerPlaybackPrefetcherPrivate::getNextFrameToRender(int* time)
+{
+    double readAhead = appPTR->getCurrentSettings()->getPlaybackReadAheadDuration();
+    if (readAhead <= 0 || lastFrame < firstFrame) {
+        return false;
+    }
+    Natron::PlaybackModeEnum mode = viewer->getRenderEngine()->getPlaybackMode();
+    windowSize = std::max(1, (int)std::ceil(readAhead * scheduler->getDesiredFPS()));
+    windowSize = std::min(windowSize, lastFrame - firstFrame);
+    int currentFrame = viewer->getTimeline()->currentFrame();
+    
+    int distance = -1;
+    if (hasReadAhead) {
+        distance = getDistance(currentFrame, lastFrameRead, mode);
+        if (distance < 0 || distance > windowSize) {
+            ///The playhead jumped, changed direction or went past the frames read ahead: start again from the playhead
+            hasReadAhead = false;
+        }
+    }
+    if (!hasReadAhead) {
+        forward = scheduler->getDirectionRequestedToRender() == OutputSchedulerThread::eRenderDirectionForward;
+        ///Skip the frames the playback threads are rendering
+        distance = std::max(1, scheduler->getNRenderThreads());
+    } else {
+        ++distance;
+    }
+    refreshTimelineRange(currentFrame, mode);
+    if (distance > windowSize) {
+        return false;
+    }
+    return stepFrame(currentFrame, distance, mode, time);
+}
+
+void
+ViewerPlaybackPrefetcherPrivate::refreshTimelineRange(int currentFrame, Natron::PlaybackModeEnum mode)
+{
+    boost::shared_ptr<TimeLine> timeline = viewer->getTimeline();
+    int toLast = hasReadAhead ? getDistance(currentFrame, lastFrameRead, mode) : 0;
+    if (toLast <= 0 || toLast > windowSize) {
+        timeline->clearReadAheadRange();
+        return;
+    }
+    int first = firstFrameRead;
+    int toFirst = getDistance(currentFrame, first, mode);
+    if (toFirst <= 0 || toFirst > toLast) {
+        ///The playback reached the first frames read ahead
+        ignore_result( stepFrame(currentFrame, 1, mode, &first) );
+    }
+    if (forward ? first > lastFrameRead : first < lastFrameRead) {
+        ///The frames read ahead wrap around the frame range, only show the part before the end of the range
+        timeline->setReadAheadRange(first, forward ? lastFrame : firstFrame);
+    } else {
+        timeline->setReadAheadRange(first, lastFrameRead);
+    }
+}
+
+ViewerPlaybackPrefetcher::ViewerPlaybackPrefetcher(ViewerInstance* viewer, OutputSchedulerThread* scheduler)
+: QThread()
+, _imp(new ViewerPlaybackPrefetcherPrivate(viewer,scheduler))
+{
+    setObjectName("ViewerPlaybackPrefetcher");
+}
+
+ViewerPlaybackPrefetcher::~ViewerPlaybackPrefetcher()
+{
+    
+}
+
+void
+ViewerPlaybackPrefetcher::startPrefetch(int firstFrame,
+                                        int lastFrame)
+{
+    QMutexLocker k(&_imp->mutex);
+    _imp->active = true;
+    _imp->hasReadAhead = false;
+    _imp->firstFrame = firstFrame;
+    _imp->lastFrame = lastFrame;
+    if (isRunning()) {
+        _imp->cond.wakeOne();
+    } else {
+        ///Read ahead without slowing down the frames the playback is waiting for
+        start(QThread::LowPriority);
+    }
+}
+
+void
+ViewerPlaybackPrefetcher::stopPrefetch()
+{
+    QMutexLocker k(&_imp->mutex);
+    _imp->active = false;
+    _imp->hasReadAhead = false;
+    ++_imp->generation;
+    while (_imp->working) {
+        _imp->idleCond.wait(&_imp->mutex);
+    }
+    _imp->viewer->getTimeline()->clearReadAheadRange();
+}
+
+void
+ViewerPlaybackPrefetcher::quitThread()
+{
+    if (!isRunning()) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->mutex);
+        _imp->mustQuit = true;
+        _imp->cond.wakeOne();
+    }
+    wait();
+}
+
+void
+ViewerPlaybackPrefetcher::run()
+{
+    ///The tiles of the frames read ahead are rendered by the scheduler only when the playback leaves it idle
+    Natron::RenderSchedulerLowPriorityScope lowPriority;
+    
+    for (;;) {
+        int time;
+        U64 generation;
+        {
+            QMutexLocker k(&_imp->mutex);
+            for (;;) {
+                if (_imp->mustQuit) {
+                    return;
+                }
+                if ( _imp->active && _imp->getNextFrameToRender(&time) ) {
+                    break;
+                }
+                if (_imp->active) {
+                    ///The read-ahead window is full, check again once the playhead moved by a frame
+                    double fps = std::max(1., _imp->scheduler->getDesiredFPS());
+                    _imp->cond.wait(&_imp->mutex, (unsigned long)std::ceil(1000. / fps));
+                } else {
+                    _imp->cond.wait(&_imp->mutex);
+                }
+            }
+            _imp->working = true;
+            generation = _imp->generation;
+        }
+        
+        bool rendered = renderViewerFrameIntoCache(_imp->viewer, time);
+        
+        QMutexLocker k(&_imp->mutex);
+        _imp->working = false;
+        _imp->idleCond.wakeAll();
+        if (generation != _imp->generation) {
+            continue;
+        }
+        if (!rendered) {
+            ///Don't try again in a loop, the playback will report the failure
+            _imp->active = false;
+            _imp->hasReadAhead = false;
+            _imp->viewer->getTimeline()->clearReadAheadRange();
+            continue;
+        }
+        if (!_imp->hasReadAhead) {
+            _imp->hasReadAhead = true;
+            _imp->firstFrameRead = time;
+        }
+        _imp->lastFrameRead = time;
+        _imp->refreshTimelineRange(_imp->viewer->getTimeline()->currentFrame(), _imp->viewer->getRenderEngine()->getPlaybackMode());
+    }
+}
+
+////////////////////////// ViewerCacheWarmer
+
+struct ViewerCacheWarmerPrivate
+{
+    ViewerInstance* viewer;
+    
+    mutable QMutex mutex; //< protects all the fields below
+    QWaitCondition cond; //< wakes up the thread when there is a range to render or when it must quit
+    QWaitCondition idleCond; //< signaled when the thread is no longer rendering a frame
+    bool active; //< true while there are frames to render
+    bool working; //< true while a frame is rendered
+    bool aborting; //< true while the frame being rendered is aborted
+    bool mustQuit;
+    int firstFrame,lastFrame;
+    int nextFrame; //< the next frame to render
+    int framesLeft; //< the number of frames of the range not rendered yet
+    
+    ViewerCacheWarmerPrivate(ViewerInstance* viewer)
+    : viewer(viewer)
+    , mutex()
+    , cond()
+    , idleCond()
+    , active(false)
+    , working(false)
+    , aborting(false)
+    , mustQuit(false)
+    , firstFrame(0)
+    , lastFrame(0)
+    , nextFrame(0)
+    , framesLeft(0)
+    {
+        
+    }
+};
+
+ViewerCacheWarmer::ViewerCacheWarmer(ViewerInstance* viewer)
+: QThread()
+, _imp(new ViewerCacheWarmerPrivate(viewer))
+{
+    setObjectName("ViewerCacheWarmer");
+}
+
+ViewerCacheWarmer::~ViewerCacheWarmer()
+{
+    
+}
+
+void
+ViewerCacheWarmer::warmFrameRange(int firstFrame,
+                                  int lastFrame)
+{
+    if (lastFrame < firstFrame) {
+        return;
+    }
+    QMutexLocker k(&_imp->mutex);
+    _imp->active = true;
+    _imp->firstFrame = firstFrame;
+    _imp->lastFrame = lastFrame;
+    ///Start from the current frame, it is the most likely to be played first
+    _imp->nextFrame = std::min( std::max( (int)_imp->viewer->getTimeline()->currentFrame(), firstFrame ), lastFrame );
+    _imp->framesLeft = lastFrame - firstFrame + 1;
+    if (isRunning()) {
+        _imp->cond.wakeOne();
+    } else {
+        start(QThread::LowPriority);
+    }
+}
+
+void
+ViewerCacheWarmer::abortWarming(bool blocking)
+{
+    QMutexLocker k(&_imp->mutex);
+    _imp->active = false;
+    if (_imp->working) {
+        _imp->aborting = true;
+    }
+    while (blocking && _imp->working) {
+        _imp->idleCond.wait(&_imp->mutex);
+    }
+}
+
+bool
+ViewerCacheWarmer::isWarming() const
+{
+    QMutexLocker k(&_imp->mutex);
+    return _imp->active || _imp->working;
+}
+
+bool
+ViewerCacheWarmer::isAborting() const
+{
+    QMutexLocker k(&_imp->mutex);
+    return _imp->aborting;
+}
+
+void
+ViewerCacheWarmer::quitThread()
+{
+    if (!isRunning()) {
+        return;
+    }
+    {
+        QMutexLocker k(&_imp->mutex);
+        _imp->mustQuit = true;
+        _imp->active = false;
+        if (_imp->working) {
+            _imp->aborting = true;
+        }
+        _imp->cond.wakeOne();
+    }
+    wait();
+}
+
+void
+ViewerCacheWarmer::run()
+{
+    ///The tiles of the warmed frames must not delay the renders the user is waiting for
+    Natron::RenderSchedulerLowPriorityScope lowPriority;
+    
+    for (;;) {
+        int time;
+        {
+            QMutexLocker k(&_imp->mutex);
+            _imp->working = false;
+            _imp->aborting = false;
+            _imp->idleCond.wakeAll();
+            while (!_imp->mustQuit && (!_imp->active || _imp->framesLeft <= 0)) {
+                _imp->active = false;
+                _imp->cond.wait(&_imp->mutex);
+            }
+            if (_imp->mustQuit) {
+                return;
+            }
+            
+            ///Stop before the viewer cache starts evicting frames, which may be the ones just rendered
+            if (appPTR->getViewerCacheOccupancy() >= NATRON_CACHE_WARMING_MAX_OCCUPANCY) {
+                _imp->active = false;
+                continue;
+            }
+            
+            time = _imp->nextFrame;
+            _imp->nextFrame = time < _imp->lastFrame ? time + 1 : _imp->firstFrame;
+            --_imp->framesLeft;
+            _imp->working = true;
+        }
+        
+        if ( !renderViewerFrameIntoCache(_imp->viewer, time) ) {
+            QMutexLocker k(&_imp->mutex);
+            if (!_imp->aborting) {
+                ///Failures are not reported in the background, the next render of the viewer will report them
+                _imp->active = false;
+            }
+        }
+    }
+}
+
 
 ////////////////////////// RenderEngine
 
@@ -2644,6 +3175,8 @@ struct RenderEnginePrivate
     
     ViewerCurrentFrameRequestScheduler* currentFrameScheduler;
     
+    ViewerCacheWarmer* cacheWarmer;
+    
     RenderEnginePrivate(Natron::OutputEffectInstance* output)
     : schedulerCreationLock()
     , scheduler(0)
@@ -2651,9 +3184,17 @@ struct RenderEnginePrivate
     , pbModeMutex()
     , pbMode(ePlaybackModeLoop)
     , currentFrameScheduler(0)
+    , cacheWarmer(0)
     {
         
     }
+    
+    void abortCacheWarming(bool blocking)
+    {
+        if (cacheWarmer) {
+            cacheWarmer->abortWarming(blocking);
+        }
+    }
 };
 
 RenderEngine::RenderEngine(Natron::OutputEffectInstance* output)
@@ -2664,6 +3205,7 @@ RenderEngine::RenderEngine(Natron::OutputEffectInstance* output)
 
 RenderEngine::~RenderEngine()
 {
+    delete _imp->cacheWarmer;
     delete _imp->currentFrameScheduler;
     delete _imp->scheduler;
 }
@@ -2677,6 +3219,9 @@ RenderEngine::createScheduler(Natron::OutputEffectInstance* effect)
 void
 RenderEngine::renderFrameRange(bool enableRenderStats,int firstFrame,int lastFrame,OutputSchedulerThread::RenderDirectionEnum forward)
 {
+    ///The frames being aborted by the cache warmer would abort the sequential renders too, wait for them
+    _imp->abortCacheWarming(true);
+    
     {
         QMutexLocker k(&_imp->schedulerCreationLock);
         if (!_imp->scheduler) {
@@ -2690,6 +3235,7 @@ RenderEngine::renderFrameRange(bool enableRenderStats,int firstFrame,int lastFra
 void
 RenderEngine::renderFromCurrentFrame(bool enableRenderStats,OutputSchedulerThread::RenderDirectionEnum forward)
 {
+    _imp->abortCacheWarming(true);
     
     {
         QMutexLocker k(&_imp->schedulerCreationLock);
@@ -2704,6 +3250,8 @@ RenderEngine::renderFromCurrentFrame(bool enableRenderStats,OutputSchedulerThrea
 void
 RenderEngine::renderFromCurrentFrameUsingCurrentDirection(bool enableRenderStats)
 {
+    _imp->abortCacheWarming(true);
+    
     {
         QMutexLocker k(&_imp->schedulerCreationLock);
         if (!_imp->scheduler) {
@@ -2725,6 +3273,8 @@ RenderEngine::renderCurrentFrame(bool enableRenderStats,bool canAbort)
         return;
     }
     
+    _imp->abortCacheWarming(false);
+    
     
     ///If the scheduler is already doing playback, continue it
     if ( _imp->scheduler ) {
@@ -2755,9 +3305,39 @@ RenderEngine::renderCurrentFrame(bool enableRenderStats,bool canAbort)
 
 
 
+void
+RenderEngine::warmViewerCache(int firstFrame,
+                              int lastFrame)
+{
+    assert(QThread::currentThread() == qApp->thread());
+    
+    ViewerInstance* isViewer = dynamic_cast<ViewerInstance*>(_imp->output);
+    if ( !isViewer ) {
+        qDebug() << "RenderEngine::warmViewerCache for a writer is unsupported";
+        return;
+    }
+    if ( isDoingSequentialRender() ) {
+        return;
+    }
+    if (!_imp->cacheWarmer) {
+        _imp->cacheWarmer = new ViewerCacheWarmer(isViewer);
+    }
+    _imp->cacheWarmer->warmFrameRange(firstFrame, lastFrame);
+}
+
+bool
+RenderEngine::isWarmingViewerCache() const
+{
+    return _imp->cacheWarmer ? _imp->cacheWarmer->isWarming() : false;
+}
+
 void
 RenderEngine::quitEngine()
 {
+    if (_imp->cacheWarmer) {
+        _imp->cacheWarmer->quitThread();
+    }
+    
     if (_imp->scheduler) {
         _imp->scheduler->quitThread();
     }
@@ -2770,6 +3350,10 @@ RenderEngine::quitEngine()
 bool
 RenderEngine::isSequentialRenderBeingAborted() const
 {
+    ///The frames rendered by the cache warmer are sequential renders too
+    if ( _imp->cacheWarmer && _imp->cacheWarmer->isAborting() ) {
+        return true;
+    }
     if (!_imp->scheduler) {
         return false;
     }
@@ -2788,8 +3372,12 @@ RenderEngine::hasThreadsAlive() const
     if (_imp->currentFrameScheduler) {
         currentFrameSchedulerRunning = _imp->currentFrameScheduler->isRunning();
     }
+    bool cacheWarmerRunning = false;
+    if (_imp->cacheWarmer) {
+        cacheWarmerRunning = _imp->cacheWarmer->isRunning();
+    }
     
-    return schedulerRunning || currentFrameSchedulerRunning;
+    return schedulerRunning || currentFrameSchedulerRunning || cacheWarmerRunning;
 }
 
 bool
@@ -2824,6 +3412,8 @@ RenderEngine::abortRendering(bool enableAutoRestartPlayback, bool blocking)
         viewer->markAllOnRendersAsAborted();
         
     }
+    ///The cache warming is not reported as work being aborted: it must not restart playback
+    _imp->abortCacheWarming(blocking);
     if (_imp->scheduler && _imp->scheduler->isWorking()) {
         _imp->scheduler->abortRendering(enableAutoRestartPlayback, blocking);
         return true;
@@ -3317,16 +3907,11 @@ ViewerCurrentFrameRequestScheduler::renderCurrentFrame(bool enableRenderStats,bo
         functorArgs.request = request;
         
         /*
-         * Let at least 1 free thread in the thread-pool to allow the renderer to use the thread pool if we use the thread-pool
-         * with QtConcurrent::run
+         * The render itself runs its tiles in the render scheduler, it does not need free threads in the thread-pool:
+         * a request started while the thread-pool is busy just waits for a thread.
+         * When painting, render on a single thread to be sure strokes are painted in the right order
          */
-        int maxThreads = QThreadPool::globalInstance()->maxThreadCount();
-        
-        //When painting, limit the number of threads to 1 to be sure strokes are painted in the right order
         if (_imp->viewer->getApp()->getIsUserPainting().get() != 0) {
-            maxThreads = 1;
-        }
-        if (maxThreads == 1 || (QThreadPool::globalInstance()->activeThreadCount() >= maxThreads - 1)) {
             _imp->backupThread.renderCurrentFrame(functorArgs);
         } else {
             QtConcurrent::run(renderCurrentFrameFunctor,functorArgs);
@@ -269,6 +269,11 @@ public:
      **/
     int pickFrameToRender(RenderThreadTask* thread, bool* enableRenderStats);
     
+    /**
+     * @brief Called by render-threads with the time they spent rendering a frame, to adapt the number of parallel renders
+     **/
+    void notifyFrameRenderTime(double timeSpent);
+    
 
     /**
      * @brief Called by the render-threads when mustQuit() is true on the thread
@@ -432,8 +437,9 @@ private:
     void pushAllFrameRange();
     
     /**
-     * @brief Starts/stops more threads according to CPU activity and user preferences 
-     * @param optimalNThreads[out] Will be set to the new number of threads
+     * @brief Starts/stops threads according to the throughput measured by the threads controller, the memory
+     * budget and user preferences. Called each time a frame is done.
+     * @param newNThreads[out] Will be set to the new number of threads
      **/
     void adjustNumberOfThreads(int* newNThreads, int *lastNThreads);
     
@@ -493,6 +499,75 @@ private:
 
 
 class ViewerInstance;
+
+/**
+ * @brief Renders in the background, during playback, the frames that the viewer is about to display so that they
+ * are in the viewer cache when the playback reaches them. The frames are rendered one at a time ahead of the frames
+ * being rendered by the playback threads, up to the read-ahead duration of the settings, and the frames read ahead are
+ * reported to the timeline. The reading restarts from the current frame whenever the playhead jumps.
+ **/
+struct ViewerPlaybackPrefetcherPrivate;
+class ViewerPlaybackPrefetcher : public QThread
+{
+public:
+    
+    ViewerPlaybackPrefetcher(ViewerInstance* viewer, OutputSchedulerThread* scheduler);
+    
+    virtual ~ViewerPlaybackPrefetcher();
+    
+    /**
+     * @brief Starts reading ahead of the playhead within [firstFrame,lastFrame]. The direction, frame rate and
+     * playback mode are read from the scheduler.
+     **/
+    void startPrefetch(int firstFrame,int lastFrame);
+    
+    /**
+     * @brief Stops reading ahead and waits for the frame being rendered, if any. It is aborted if the playback is.
+     **/
+    void stopPrefetch();
+    
+    void quitThread();
+    
+private:
+    
+    virtual void run() OVERRIDE FINAL;
+    
+    boost::scoped_ptr<ViewerPlaybackPrefetcherPrivate> _imp;
+};
+
+/**
+ * @brief Renders a frame range of a viewer into the viewer cache in the background, at a low priority, e.g. while the
+ * application is idle. The frames are not displayed and the timeline does not move. It stops when the viewer cache
+ * is almost full. The frame being rendered is aborted by abortWarming(), @see RenderEngine::isSequentialRenderBeingAborted
+ **/
+struct ViewerCacheWarmerPrivate;
+class ViewerCacheWarmer : public QThread
+{
+public:
+    
+    ViewerCacheWarmer(ViewerInstance* viewer);
+    
+    virtual ~ViewerCacheWarmer();
+    
+    ///Renders the frames of [firstFrame,lastFrame] not cached yet, starting from the current frame
+    void warmFrameRange(int firstFrame,int lastFrame);
+    
+    ///If blocking, waits for the frame being rendered to be aborted
+    void abortWarming(bool blocking);
+    
+    bool isWarming() const;
+    
+    bool isAborting() const;
+    
+    void quitThread();
+    
+private:
+    
+    virtual void run() OVERRIDE FINAL;
+    
+    boost::scoped_ptr<ViewerCacheWarmerPrivate> _imp;
+};
+
 class ViewerDisplayScheduler : public OutputSchedulerThread
 {
     
@@ -525,9 +600,14 @@ private:
     
     virtual int getLastRenderedTime() const OVERRIDE FINAL WARN_UNUSED_RETURN;
     
+    virtual void aboutToStartRender() OVERRIDE FINAL;
+    
     virtual void onRenderStopped(bool aborted) OVERRIDE FINAL;
     
     ViewerInstance* _viewer;
+    
+    ///Created on the first playback, only accessed by the scheduler thread
+    boost::scoped_ptr<ViewerPlaybackPrefetcher> _prefetcher;
 };
 
 /**
@@ -653,6 +733,18 @@ public:
     
     void renderFromCurrentFrameUsingCurrentDirection(bool enableRenderStats);
     
+    /**
+     * @brief Renders the frames of [firstFrame,lastFrame] into the viewer cache in the background, without displaying them.
+     * This is only supported by viewers and does nothing while the viewer is doing playback.
+     * The warming is aborted by abortRendering() and by any other render of this engine.
+     **/
+    void warmViewerCache(int firstFrame,int lastFrame);
+    
+    /**
+     * @brief Returns true while warmViewerCache() is rendering frames
+     **/
+    bool isWarmingViewerCache() const;
+    
     /**
      * @brief Basically it just renders with the current frame on the timeline.
      * @param abortPrevious If true then it will stop any ongoing render and render the current frame
@@ -0,0 +1,114 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_PARALLELREDUCE_H
+#define NATRON_ENGINE_PARALLELREDUCE_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <vector>
+
+#include "Global/Macros.h"
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QThread>
+CLANG_DIAG_ON(deprecated)
+
+#include "Engine/RectI.h"
+#include "Engine/RenderScheduler.h"
+
+///The rectangle of a reduction is split in this many pieces per thread, so that the threads which start late
+///or which are slowed down do not delay the others
+#define NATRON_PARALLEL_REDUCE_SPLITS_PER_THREAD 4
+
+namespace Natron {
+namespace ParallelReducePrivate {
+///Accumulates one split into its partial result. Each task has its own copy of the functor.
+template <typename RESULT, typename FUNCTOR>
+struct ReduceSplitTask
+{
+    FUNCTOR functor;
+    const RectI* split;
+    RESULT* partial;
+
+    ReduceSplitTask(const FUNCTOR & functor,
+                    const RectI* split,
+                    RESULT* partial)
+        : functor(functor)
+          , split(split)
+          , partial(partial)
+    {
+    }
+
+    void operator()()
+    {
+        functor(*split, partial);
+    }
+};
+} // namespace ParallelReducePrivate
+
+/**
+ * @brief Computes a result over rect in parallel. rect is split with RectI::splitIntoSmallerRects, each split is
+ * accumulated by functor(split, &partial) into a default-constructed RESULT, then the partial results are merged into
+ * result with result->merge(partial), in the order of the splits so that the result does not depend on the scheduling.
+ * The splits run in the render scheduler: the calling thread computes those that no thread of the scheduler started,
+ * instead of waiting for them. An exception thrown by the functor is rethrown once all the splits are done.
+ * The functor is copied and may be called concurrently from several threads.
+ **/
+template <typename RESULT, typename FUNCTOR>
+void
+parallelReduce(const RectI & rect,
+               const FUNCTOR & functor,
+               RESULT* result)
+{
+    if ( rect.isNull() ) {
+        return;
+    }
+
+    int threadsCount = QThread::idealThreadCount();
+    std::vector<RectI> splits;
+    if (threadsCount > 1) {
+        splits = rect.splitIntoSmallerRects(threadsCount * NATRON_PARALLEL_REDUCE_SPLITS_PER_THREAD);
+    }
+    if (splits.size() <= 1) {
+        RESULT partial;
+        functor(rect, &partial);
+        result->merge(partial);
+
+        return;
+    }
+
+    std::vector<RESULT> partials( splits.size() );
+    {
+        RenderTaskGroup group;
+        for (std::size_t i = 0; i < splits.size(); ++i) {
+            group.run( ParallelReducePrivate::ReduceSplitTask<RESULT, FUNCTOR>(functor, &splits[i], &partials[i]) );
+        }
+        group.wait();
+    }
+
+    for (std::size_t i = 0; i < partials.size(); ++i) {
+        result->merge(partials[i]);
+    }
+}
+} // namespace Natron
+
+#endif // NATRON_ENGINE_PARALLELREDUCE_H
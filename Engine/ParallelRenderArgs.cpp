@@ -24,16 +24,153 @@
 
 #include "ParallelRenderArgs.h"
 
+#include <QtCore/QThread>
+#if !defined(SBK_RUN) && !defined(Q_MOC_RUN)
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_OFF
+// /usr/local/include/boost/bind/arg.hpp:37:9: warning: unused typedef 'boost_static_assert_typedef_37' [-Wunused-local-typedef]
+#include <boost/bind.hpp>
+GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
+#endif
+
+#include "Engine/AppInstance.h"
 #include "Engine/AppManager.h"
 #include "Engine/Settings.h"
 #include "Engine/EffectInstance.h"
 #include "Engine/Image.h"
 #include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/Plugin.h"
+#include "Engine/Project.h"
+#include "Engine/RenderScheduler.h"
+#include "Engine/RenderStats.h"
 #include "Engine/RotoContext.h"
 #include "Engine/RotoDrawableItem.h"
 
 using namespace Natron;
 
+namespace {
+
+/*
+ * The inputs of a node (and the frames needed from each input) are independent branches of the tree: they are rendered
+ * concurrently in the render scheduler, so that wide trees use as many threads as deep ones.
+ * The renders that may not run concurrently are put in the same batch and run one after another:
+ * - the frames of a same input (the renders of an instance share its locks and the images being rendered by it)
+ * - the inputs sharing the lock of an eRenderSafetyInstanceSafe or eRenderSafetyUnsafe plug-in
+ */
+struct InputRenderBatch
+{
+    std::vector<EffectInstance*> inputEffects;
+    std::vector<EffectInstance::RenderRoIArgs> args;
+    std::vector<ImageList*> outputs; //< where to append the images rendered by each render, may be NULL
+};
+
+struct InputRenderBatchResult
+{
+    EffectInstance::RenderRoIRetCode code;
+    std::vector<ImageList> images; //< the images rendered by each render of the batch
+
+    InputRenderBatchResult()
+    : code(EffectInstance::eRenderRoIRetCodeOk)
+    , images()
+    {
+    }
+};
+
+///Renders sharing the same key are put in the same batch
+const void*
+getInputRenderBatchKey(EffectInstance* inputEffect)
+{
+    Natron::RenderSafetyEnum safety = inputEffect->getCurrentThreadSafetyThreadLocal();
+    if (safety == eRenderSafetyInstanceSafe) {
+        return &inputEffect->getNode()->getRenderInstancesSharedMutex();
+    } else if (safety == eRenderSafetyUnsafe) {
+        const Natron::Plugin* p = inputEffect->getNode()->getPlugin();
+        assert(p);
+        return p->getPluginLock();
+    }
+    return inputEffect;
+}
+
+InputRenderBatchResult
+renderInputBatch(const InputRenderBatch & batch,
+                 EffectInstance* effect,
+                 const std::map<boost::shared_ptr<Natron::Node>, ParallelRenderArgs > & frameTLS,
+                 const QThread* callingThread)
+{
+    ///Make the thread-storage live as long as the renders if we're in a thread of the render scheduler
+    boost::shared_ptr<ParallelRenderArgsSetter> scopedFrameArgs;
+    if ( !frameTLS.empty() && ( callingThread != QThread::currentThread() ) ) {
+        scopedFrameArgs.reset( new ParallelRenderArgsSetter(frameTLS) );
+    }
+
+    InputRenderBatchResult ret;
+    ret.images.resize( batch.args.size() );
+    for (std::size_t i = 0; i < batch.args.size(); ++i) {
+        ret.code = batch.inputEffects[i]->renderRoI(batch.args[i], &ret.images[i]);
+        if (ret.code != EffectInstance::eRenderRoIRetCodeOk) {
+            return ret;
+        }
+        if ( effect->aborted() ) {
+            ret.code = EffectInstance::eRenderRoIRetCodeAborted;
+            return ret;
+        }
+    }
+    return ret;
+}
+
+EffectInstance::RenderRoIRetCode
+renderInputsBatches(EffectInstance* effect,
+                    const std::vector<InputRenderBatch> & batches)
+{
+    if ( batches.empty() ) {
+        return EffectInstance::eRenderRoIRetCodeOk;
+    }
+
+    std::vector<InputRenderBatchResult> results;
+    if (batches.size() == 1) {
+        ///A single branch, render it in this thread
+        std::map<boost::shared_ptr<Natron::Node>, ParallelRenderArgs > noTLS;
+        results.push_back( renderInputBatch(batches.front(), effect, noTLS, QThread::currentThread()) );
+    } else {
+        std::map<boost::shared_ptr<Natron::Node>, ParallelRenderArgs > tlsCopy;
+        effect->getApp()->getProject()->getParallelRenderArgs(tlsCopy);
+
+        RenderTaskTimings timings;
+        mapInRenderScheduler( batches.begin(), batches.end(),
+                              boost::bind(&renderInputBatch, _1, effect, boost::cref(tlsCopy), QThread::currentThread()),
+                              &results, &timings );
+
+        const ParallelRenderArgs* frameArgs = effect->getParallelRenderArgsTLS();
+        if ( frameArgs && frameArgs->stats && frameArgs->stats->isInDepthProfilingEnabled() ) {
+            frameArgs->stats->addTasksInfosForNode(effect->getNode(), timings);
+        }
+    }
+
+    ///Report the first error in the order the inputs were visited, and hand the images in that order too
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        if (results[i].code != EffectInstance::eRenderRoIRetCodeOk) {
+            return results[i].code;
+        }
+    }
+    for (std::size_t i = 0; i < batches.size(); ++i) {
+        for (std::size_t j = 0; j < batches[i].outputs.size(); ++j) {
+            ImageList* output = batches[i].outputs[j];
+            if (!output) {
+                continue;
+            }
+            const ImageList & images = results[i].images[j];
+            for (ImageList::const_iterator it = images.begin(); it != images.end(); ++it) {
+                if (*it) {
+                    output->push_back(*it);
+                }
+            }
+        }
+    }
+    return EffectInstance::eRenderRoIRetCodeOk;
+}
+
+} // anon namespace
+
 Natron::EffectInstance::RenderRoIRetCode EffectInstance::treeRecurseFunctor(bool isRenderFunctor,
                                                                             const boost::shared_ptr<Natron::Node>& node,
                                                                             const FramesNeededMap& framesNeeded,
@@ -51,6 +188,11 @@ Natron::EffectInstance::RenderRoIRetCode EffectInstance::treeRecurseFunctor(bool
     EffectInstance* effect = node->getLiveInstance();
     bool isRoto = node->isRotoPaintingNode();
     
+    ///Render functor specific: the renders of the inputs, rendered once all the inputs are visited
+    std::vector<InputRenderBatch> batches;
+    std::map<const void*, std::size_t> batchesIndexes;
+    std::list<boost::shared_ptr<EffectInstance::NotifyInputNRenderingStarted_RAII> > inputsRendering_RAII;
+    
     ///For all frames/views needed, call recursively on inputs with the appropriate RoI
     for (FramesNeededMap::const_iterator it = framesNeeded.begin(); it != framesNeeded.end(); ++it) {
         
@@ -174,11 +316,10 @@ Natron::EffectInstance::RenderRoIRetCode EffectInstance::treeRecurseFunctor(bool
             assert(it->first != -1); //< see getInputNumber
             
             {
-                boost::shared_ptr<EffectInstance::NotifyInputNRenderingStarted_RAII> inputNIsRendering_RAII;
                 if (isRenderFunctor) {
-                    inputNIsRendering_RAII.reset(new EffectInstance::NotifyInputNRenderingStarted_RAII(node.get(),inputNb));
+                    inputsRendering_RAII.push_back( boost::shared_ptr<EffectInstance::NotifyInputNRenderingStarted_RAII>(new EffectInstance::NotifyInputNRenderingStarted_RAII(node.get(),inputNb)) );
                 }
-                
+
                 ///For all views requested in input
                 for (std::map<int, std::vector<OfxRangeD> >::const_iterator viewIt = it->second.begin(); viewIt != it->second.end(); ++viewIt) {
                     
@@ -256,25 +397,20 @@ Natron::EffectInstance::RenderRoIRetCode EffectInstance::treeRecurseFunctor(bool
                                     
                                     
                                     
-                                    ImageList inputImgs;
-                                    EffectInstance::RenderRoIRetCode ret = inputEffect->renderRoI(inArgs, &inputImgs); //< requested bitdepth
-                                    if (ret != EffectInstance::eRenderRoIRetCodeOk) {
-                                        return ret;
-                                    }
-                                    
-                                    for (ImageList::iterator it3 = inputImgs.begin(); it3 != inputImgs.end(); ++it3) {
-                                        if (inputImagesList && *it3) {
-                                            inputImagesList->push_back(*it3);
-                                        }
-                                    }
-                                    
-                                    if (effect->aborted()) {
-                                        return EffectInstance::eRenderRoIRetCodeAborted;
-                                    }
-                                    
-                                    if (!inputImgs.empty()) {
-                                        ++nbFramesPreFetched;
+                                    ///The render is queued in the batch of the input, see renderInputsBatches
+                                    const void* batchKey = getInputRenderBatchKey(inputEffect);
+                                    std::map<const void*, std::size_t>::iterator foundBatch = batchesIndexes.find(batchKey);
+                                    if (foundBatch == batchesIndexes.end()) {
+                                        foundBatch = batchesIndexes.insert( std::make_pair( batchKey, batches.size() ) ).first;
+                                        batches.push_back( InputRenderBatch() );
                                     }
+                                    InputRenderBatch & batch = batches[foundBatch->second];
+                                    batch.inputEffects.push_back(inputEffect);
+                                    batch.args.push_back(inArgs); //< requested bitdepth
+                                    batch.outputs.push_back(inputImagesList);
+
+                                    ///Frames are counted when queued: we do not know yet whether they will produce an image
+                                    ++nbFramesPreFetched;
                                 } // if (!isRenderFunctor) {
                                 
                             } // for all frames
@@ -282,12 +418,16 @@ Natron::EffectInstance::RenderRoIRetCode EffectInstance::treeRecurseFunctor(bool
                         
                     } // for all ranges
                 } // for all views
-            } // EffectInstance::NotifyInputNRenderingStarted_RAII
+            }
             
         } // if (inputEffect) {
         
     } // for all inputs
-    return EffectInstance::eRenderRoIRetCodeOk;
+    
+    if (!isRenderFunctor) {
+        return EffectInstance::eRenderRoIRetCodeOk;
+    }
+    return renderInputsBatches(effect, batches);
 }
 
 Natron::StatusEnum Natron::EffectInstance::getInputsRoIsFunctor(bool useTransforms,
@@ -45,6 +45,8 @@
 
 class RectI;
 class TimeLine;
+class KnobI;
+class KnobSnapshotI;
 namespace Natron {
     class EffectInstance;
     class Node;
@@ -67,6 +69,9 @@ struct InputMatrix
 
 typedef std::map<int,InputMatrix> InputMatrixMap;
 
+///The copies of the knobs of a node read by the render threads, see KnobI::createSnapshot()
+typedef std::map<const KnobI*, boost::shared_ptr<KnobSnapshotI> > KnobsSnapshotMap;
+
 struct NodeFrameRequest;
 
 /**
@@ -148,6 +153,10 @@ struct ParallelRenderArgs
     ///Various stats local to the render of a frame
     boost::shared_ptr<RenderStats> stats;
     
+    ///The copy of the knobs of the node taken when the render started, shared by all the threads rendering
+    ///with the same node hash and read without locking
+    boost::shared_ptr<const KnobsSnapshotMap> knobsSnapshot;
+    
     
     ParallelRenderArgs()
     : time(0)
@@ -171,6 +180,7 @@ struct ParallelRenderArgs
     , tilesSupported(false)
     , viewerProgressReportEnabled(false)
     , stats()
+    , knobsSnapshot()
     {
         
     }
@@ -304,6 +304,17 @@ AnimatedParam::removeAnimation(int dimension)
     getInternalKnob()->removeAnimation(dimension);
 }
 
+void
+AnimatedParam::setValuesAtTimes(const std::vector<double>& times,const std::vector<double>& values,int dimension)
+{
+    assert( times.size() == values.size() );
+    std::list<KeyFrame> keys;
+    for (std::size_t i = 0; i < times.size() && i < values.size(); ++i) {
+        keys.push_back( KeyFrame(times[i], values[i]) );
+    }
+    getInternalKnob()->setKeyFrames(keys, dimension, Natron::eValueChangedReasonNatronInternalEdited);
+}
+
 double
 AnimatedParam::getDerivativeAtTime(double time, int dimension) const
 {
@@ -224,6 +224,13 @@ public:
      * @brief Removes all animation for the given dimension.
      **/
     void removeAnimation(int dimension = 0);
+
+    /**
+     * @brief Sets a keyframe with values[i] at times[i] for each i, in the given dimension.
+     * This is much faster than calling setValueAtTime for each keyframe, e.g to import a curve
+     * with thousands of keyframes: the param is refreshed and rendered only once.
+     **/
+    void setValuesAtTimes(const std::vector<double>& times,const std::vector<double>& values,int dimension = 0);
     
     /**
      * @brief Compute the derivative at time as a double
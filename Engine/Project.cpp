@@ -819,6 +819,18 @@ Project::initializeKnobs()
     _imp->colorSpace32f->populateChoices(colorSpaces);
     _imp->colorSpace32f->setDefaultValue(1);
     page->addKnob(_imp->colorSpace32f);
+
+    _imp->halfFloatNodeCache = Natron::createKnob<KnobBool>(this, "Store Intermediate Images in Half Float");
+    _imp->halfFloatNodeCache->setName("halfFloatNodeCache");
+    _imp->halfFloatNodeCache->setHintToolTip("When checked, the 32-bit floating point images rendered by the nodes are kept in the cache "
+                                             "as 16-bit half floating point images: twice as many images fit in the cache, at the cost "
+                                             "of a lower precision (about 3 decimal digits) and a range limited to +/-65504. "
+                                             "The plug-ins still render and receive 32-bit floating point images. "
+                                             "Images written by the DiskCache node are not affected.");
+    _imp->halfFloatNodeCache->setAnimationEnabled(false);
+    _imp->halfFloatNodeCache->setEvaluateOnChange(false);
+    _imp->halfFloatNodeCache->setDefaultValue(false,0);
+    page->addKnob(_imp->halfFloatNodeCache);
     
     _imp->frameRange = Natron::createKnob<KnobInt>(this, "Frame Range",2);
     _imp->frameRange->setDefaultValue(1,0);
@@ -1153,6 +1165,12 @@ Project::isAutoPreviewEnabled() const
     return _imp->previewMode->getValue();
 }
 
+bool
+Project::isNodeCacheHalfFloatEnabled() const
+{
+    return _imp->halfFloatNodeCache->getValue();
+}
+
 void
 Project::toggleAutoPreview()
 {
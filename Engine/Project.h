@@ -150,6 +150,11 @@ public:
 
     void toggleAutoPreview();
 
+    /**
+     * @brief Returns true if the nodes should cache their floating point images in half float.
+     **/
+    bool isNodeCacheHalfFloatEnabled() const;
+
     boost::shared_ptr<TimeLine> getTimeLine() const WARN_UNUSED_RETURN;
 
     int currentFrame() const WARN_UNUSED_RETURN;
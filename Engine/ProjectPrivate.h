@@ -121,6 +121,7 @@ struct ProjectPrivate
     boost::shared_ptr<KnobChoice> colorSpace8u;
     boost::shared_ptr<KnobChoice> colorSpace16u;
     boost::shared_ptr<KnobChoice> colorSpace32f;
+    boost::shared_ptr<KnobBool> halfFloatNodeCache; //< store the floating point images of the nodes in half float
     boost::shared_ptr<KnobDouble> frameRate;
     boost::shared_ptr<KnobInt> frameRange;
     boost::shared_ptr<KnobBool> lockFrameRange;
@@ -0,0 +1,517 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RenderScheduler.h"
+
+#include <deque>
+#include <algorithm> // min, max
+#include <cassert>
+#include <new> // bad_alloc
+#include <stdexcept>
+#include <string>
+
+CLANG_DIAG_OFF(deprecated)
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+#include <QtCore/QWaitCondition>
+CLANG_DIAG_ON(deprecated)
+
+#include "Engine/Timer.h"
+
+///The maximum number of worker threads of the scheduler
+#define NATRON_RENDER_SCHEDULER_MAX_THREADS 256
+
+using namespace Natron;
+
+namespace {
+class RenderWorker;
+
+struct RenderTask
+{
+    boost::function<void ()> function;
+    boost::shared_ptr<RenderTaskGroupPrivate> group; //< reset once the task is done, the group holds the task
+    RenderWorker* owner; //< the worker in whose deque the task was queued, NULL if it was not queued in a deque
+    bool lowPriority; //< queued in the low-priority lane, see RenderSchedulerLowPriorityScope
+    TimeLapse submissionTime;
+    QAtomicInt claimed; //< set to 1 by the thread which runs the task, the other threads drop it
+
+    RenderTask(const boost::function<void ()> & function,
+               const boost::shared_ptr<RenderTaskGroupPrivate> & group,
+               bool lowPriority)
+        : function(function)
+          , group(group)
+          , owner(0)
+          , lowPriority(lowPriority)
+          , submissionTime()
+          , claimed(0)
+    {
+    }
+};
+
+typedef boost::shared_ptr<RenderTask> RenderTaskPtr;
+
+class RenderWorker
+    : public QThread
+{
+public:
+
+    const int index;
+
+    ///The tasks submitted by this worker or given to it. It takes the newest ones, the other workers steal the oldest.
+    QMutex tasksLock;
+    std::deque<RenderTaskPtr> tasks;
+
+    RenderWorker(int index)
+        : QThread()
+          , index(index)
+          , tasksLock()
+          , tasks()
+    {
+        setObjectName( QString("RenderScheduler worker %1").arg(index) );
+    }
+
+    virtual ~RenderWorker()
+    {
+    }
+
+private:
+
+    virtual void run() OVERRIDE FINAL;
+};
+
+struct RenderScheduler
+{
+    QMutex lock;
+
+    ///Woken when a task is queued, waited for by the active workers
+    QWaitCondition tasksAvailableCond;
+
+    ///Woken when threadsCount changes, waited for by the workers beyond threadsCount
+    QWaitCondition threadsCountChangedCond;
+
+    ///The workers are never deleted so that they can be read without the lock up to workersCount
+    RenderWorker* workers[NATRON_RENDER_SCHEDULER_MAX_THREADS];
+    QAtomicInt workersCount;
+
+    ///Only the workers whose index is below threadsCount run tasks. Protected by lock.
+    int threadsCount;
+    int nextWorker; //< the worker which receives the next task submitted by another thread, protected by lock
+    bool initialized; //< protected by lock
+    bool quit; //< protected by lock
+
+    ///The low-priority tasks of all the threads, in submission order. The workers run them when all the deques are empty.
+    QMutex lowPriorityTasksLock;
+    std::deque<RenderTaskPtr> lowPriorityTasks;
+
+    ///For each thread, the number of RenderSchedulerLowPriorityScope it is in. The tasks it submits are low-priority
+    ///when it is positive. The workers are in one while they run a low-priority task.
+    QThreadStorage<int> lowPriorityDepth;
+
+    ///The number of tasks in the deques and in the low-priority lane, including the ones claimed by the threads
+    ///waiting for their group
+    QAtomicInt queuedTasksCount;
+    QAtomicInt busyThreadsCount;
+
+    RenderScheduler()
+        : lock()
+          , tasksAvailableCond()
+          , threadsCountChangedCond()
+          , workersCount(0)
+          , threadsCount(0)
+          , nextWorker(0)
+          , initialized(false)
+          , quit(false)
+          , lowPriorityTasksLock()
+          , lowPriorityTasks()
+          , lowPriorityDepth()
+          , queuedTasksCount(0)
+          , busyThreadsCount(0)
+    {
+        std::fill(workers, workers + NATRON_RENDER_SCHEDULER_MAX_THREADS, (RenderWorker*)0);
+    }
+
+    ///Must be called with lock taken
+    void setThreadsCount_locked(int count)
+    {
+        initialized = true;
+        threadsCount = std::max( 0, std::min(count, NATRON_RENDER_SCHEDULER_MAX_THREADS) );
+        for (int i = workersCount.fetchAndAddOrdered(0); i < threadsCount; ++i) {
+            workers[i] = new RenderWorker(i);
+            workers[i]->start();
+            workersCount.fetchAndStoreRelease(i + 1);
+        }
+        threadsCountChangedCond.wakeAll();
+        tasksAvailableCond.wakeAll();
+    }
+
+    bool isCurrentThreadLowPriority()
+    {
+        return lowPriorityDepth.hasLocalData() && lowPriorityDepth.localData() > 0;
+    }
+
+    void addLowPriorityDepth(int delta)
+    {
+        int depth = lowPriorityDepth.hasLocalData() ? lowPriorityDepth.localData() : 0;
+
+        lowPriorityDepth.setLocalData(depth + delta);
+    }
+
+    ///Queues the task in the deque of a worker or in the low-priority lane, returns false if there is no worker to run it
+    bool submit(const RenderTaskPtr & task)
+    {
+        RenderWorker* current = dynamic_cast<RenderWorker*>( QThread::currentThread() );
+        QMutexLocker k(&lock);
+
+        if (!initialized) {
+            setThreadsCount_locked( QThread::idealThreadCount() );
+        }
+        if ( (threadsCount == 0) || quit ) {
+            return false;
+        }
+        if (task->lowPriority) {
+            {
+                QMutexLocker l(&lowPriorityTasksLock);
+                lowPriorityTasks.push_back(task);
+            }
+            queuedTasksCount.fetchAndAddOrdered(1);
+            tasksAvailableCond.wakeOne();
+
+            return true;
+        }
+        RenderWorker* worker = current;
+        if ( !worker || (worker->index >= threadsCount) ) {
+            nextWorker = (nextWorker + 1) % threadsCount;
+            worker = workers[nextWorker];
+        }
+        task->owner = worker;
+        {
+            QMutexLocker l(&worker->tasksLock);
+            worker->tasks.push_back(task);
+        }
+        queuedTasksCount.fetchAndAddOrdered(1);
+        tasksAvailableCond.wakeOne();
+
+        return true;
+    }
+
+    ///Returns the next task the worker must run: its newest task, or else the oldest task of another worker,
+    ///or else the oldest low-priority task
+    RenderTaskPtr takeTask(RenderWorker* worker)
+    {
+        for (;; ) {
+            RenderTaskPtr task;
+            {
+                QMutexLocker l(&worker->tasksLock);
+                if ( worker->tasks.empty() ) {
+                    break;
+                }
+                task = worker->tasks.back();
+                worker->tasks.pop_back();
+            }
+            queuedTasksCount.fetchAndAddOrdered(-1);
+            if ( task->claimed.testAndSetOrdered(0, 1) ) {
+                return task;
+            }
+        }
+
+        int count = workersCount.fetchAndAddOrdered(0);
+        for (int i = 1; i < count; ++i) {
+            RenderWorker* victim = workers[(worker->index + i) % count];
+            for (;; ) {
+                RenderTaskPtr task;
+                {
+                    QMutexLocker l(&victim->tasksLock);
+                    if ( victim->tasks.empty() ) {
+                        break;
+                    }
+                    task = victim->tasks.front();
+                    victim->tasks.pop_front();
+                }
+                queuedTasksCount.fetchAndAddOrdered(-1);
+                if ( task->claimed.testAndSetOrdered(0, 1) ) {
+                    return task;
+                }
+            }
+        }
+
+        for (;; ) {
+            RenderTaskPtr task;
+            {
+                QMutexLocker l(&lowPriorityTasksLock);
+                if ( lowPriorityTasks.empty() ) {
+                    break;
+                }
+                task = lowPriorityTasks.front();
+                lowPriorityTasks.pop_front();
+            }
+            queuedTasksCount.fetchAndAddOrdered(-1);
+            if ( task->claimed.testAndSetOrdered(0, 1) ) {
+                return task;
+            }
+        }
+
+        return RenderTaskPtr();
+    }
+};
+
+///Never destroyed: the workers may still be running when the static objects are destroyed
+RenderScheduler* scheduler = new RenderScheduler;
+} // anon namespace
+
+namespace Natron {
+struct RenderTaskGroupPrivate
+{
+    mutable QMutex lock;
+    QWaitCondition tasksFinishedCond;
+
+    ///The tasks submitted since the last wait(), the ones from nextTaskToClaim were not claimed by the waiting thread
+    std::vector<RenderTaskPtr> tasks;
+    std::size_t nextTaskToClaim;
+    int pendingTasksCount;
+    RenderTaskTimings timings;
+
+    ///The first exception thrown by a task since the last wait(), rethrown by wait()
+    bool failed;
+    bool failedWithBadAlloc;
+    std::string failureMessage;
+
+    RenderTaskGroupPrivate()
+        : lock()
+          , tasksFinishedCond()
+          , tasks()
+          , nextTaskToClaim(0)
+          , pendingTasksCount(0)
+          , timings()
+          , failed(false)
+          , failedWithBadAlloc(false)
+          , failureMessage()
+    {
+    }
+};
+} // namespace Natron
+
+namespace {
+///Runs a claimed task. executor is the worker running it, or NULL if it is run by the thread waiting for its group.
+void
+runTask(const RenderTaskPtr & task,
+        RenderWorker* executor)
+{
+    double queuedTime = task->submissionTime.getTimeSinceCreation();
+    TimeLapse runningTimer;
+
+    if (executor) {
+        scheduler->busyThreadsCount.fetchAndAddOrdered(1);
+        if (task->lowPriority) {
+            ///The tasks it submits are low-priority too
+            scheduler->addLowPriorityDepth(1);
+        }
+    }
+    bool failed = false;
+    bool failedWithBadAlloc = false;
+    std::string failureMessage;
+    try {
+        task->function();
+    } catch (const std::bad_alloc &) {
+        failed = true;
+        failedWithBadAlloc = true;
+    } catch (const std::exception & e) {
+        failed = true;
+        failureMessage = e.what();
+    } catch (...) {
+        failed = true;
+        failureMessage = "A render task threw an unknown exception";
+    }
+    if (executor) {
+        if (task->lowPriority) {
+            scheduler->addLowPriorityDepth(-1);
+        }
+        scheduler->busyThreadsCount.fetchAndAddOrdered(-1);
+    }
+    double runningTime = runningTimer.getTimeSinceCreation();
+
+    ///Release what the task holds now, the group keeps the task until it is waited for
+    boost::shared_ptr<RenderTaskGroupPrivate> group = task->group;
+    task->group.reset();
+    task->function.clear();
+
+    QMutexLocker k(&group->lock);
+    ++group->timings.tasksCount;
+    if (failed && !group->failed) {
+        group->failed = true;
+        group->failedWithBadAlloc = failedWithBadAlloc;
+        group->failureMessage = failureMessage;
+    }
+    if (!executor) {
+        ++group->timings.waitingThreadTasksCount;
+    } else if ( task->owner && (executor != task->owner) ) {
+        ++group->timings.stolenTasksCount;
+    }
+    group->timings.queuedTime += queuedTime;
+    group->timings.runningTime += runningTime;
+    --group->pendingTasksCount;
+    if (group->pendingTasksCount == 0) {
+        group->tasksFinishedCond.wakeAll();
+    }
+}
+
+void
+RenderWorker::run()
+{
+    for (;; ) {
+        {
+            QMutexLocker k(&scheduler->lock);
+            for (;; ) {
+                if (scheduler->quit) {
+                    return;
+                }
+                if (index >= scheduler->threadsCount) {
+                    scheduler->threadsCountChangedCond.wait(&scheduler->lock);
+                } else if (scheduler->queuedTasksCount.fetchAndAddOrdered(0) > 0) {
+                    break;
+                } else {
+                    scheduler->tasksAvailableCond.wait(&scheduler->lock);
+                }
+            }
+        }
+        RenderTaskPtr task = scheduler->takeTask(this);
+        if (task) {
+            runTask(task, this);
+        }
+    }
+}
+} // anon namespace
+
+RenderTaskGroup::RenderTaskGroup()
+    : _imp( new RenderTaskGroupPrivate() )
+{
+}
+
+RenderTaskGroup::~RenderTaskGroup()
+{
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void
+RenderTaskGroup::run(const boost::function<void ()> & function)
+{
+    RenderTaskPtr task( new RenderTask( function, _imp, scheduler->isCurrentThreadLowPriority() ) );
+    {
+        QMutexLocker k(&_imp->lock);
+        _imp->tasks.push_back(task);
+        ++_imp->pendingTasksCount;
+    }
+    ///If there is no worker, the task is run by wait()
+    scheduler->submit(task);
+}
+
+void
+RenderTaskGroup::wait()
+{
+    for (;; ) {
+        RenderTaskPtr task;
+        {
+            QMutexLocker k(&_imp->lock);
+            while ( !task && _imp->nextTaskToClaim < _imp->tasks.size() ) {
+                const RenderTaskPtr & candidate = _imp->tasks[_imp->nextTaskToClaim];
+                ++_imp->nextTaskToClaim;
+                if ( candidate->claimed.testAndSetOrdered(0, 1) ) {
+                    task = candidate;
+                }
+            }
+            if (!task) {
+                ///All the tasks are claimed, wait for the ones run by the workers
+                while (_imp->pendingTasksCount > 0) {
+                    _imp->tasksFinishedCond.wait(&_imp->lock);
+                }
+                _imp->tasks.clear();
+                _imp->nextTaskToClaim = 0;
+                if (!_imp->failed) {
+                    return;
+                }
+                _imp->failed = false;
+                if (_imp->failedWithBadAlloc) {
+                    throw std::bad_alloc();
+                }
+                throw std::runtime_error(_imp->failureMessage);
+            }
+        }
+        runTask(task, 0);
+    }
+}
+
+RenderSchedulerLowPriorityScope::RenderSchedulerLowPriorityScope()
+{
+    scheduler->addLowPriorityDepth(1);
+}
+
+RenderSchedulerLowPriorityScope::~RenderSchedulerLowPriorityScope()
+{
+    scheduler->addLowPriorityDepth(-1);
+}
+
+RenderTaskTimings
+RenderTaskGroup::getTimings() const
+{
+    QMutexLocker k(&_imp->lock);
+
+    return _imp->timings;
+}
+
+namespace Natron {
+void
+setRenderSchedulerThreadsCount(int threadsCount)
+{
+    QMutexLocker k(&scheduler->lock);
+
+    if (!scheduler->quit) {
+        scheduler->setThreadsCount_locked(threadsCount);
+    }
+}
+
+int
+getRenderSchedulerBusyThreadsCount()
+{
+    return scheduler->busyThreadsCount.fetchAndAddOrdered(0);
+}
+
+void
+quitRenderScheduler()
+{
+    {
+        QMutexLocker k(&scheduler->lock);
+        scheduler->quit = true;
+        scheduler->threadsCountChangedCond.wakeAll();
+        scheduler->tasksAvailableCond.wakeAll();
+    }
+    int count = scheduler->workersCount.fetchAndAddOrdered(0);
+    for (int i = 0; i < count; ++i) {
+        scheduler->workers[i]->wait();
+    }
+}
+} // namespace Natron
@@ -0,0 +1,239 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_RENDERSCHEDULER_H
+#define NATRON_ENGINE_RENDERSCHEDULER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <iterator>
+#include <vector>
+
+#include "Global/Macros.h"
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/shared_ptr.hpp>
+#include <boost/function.hpp>
+#endif
+
+/*
+ * The render scheduler runs the tiles of the renders, the viewer textures conversion and the threads of the OpenFX
+ * multi-thread suite on its own worker threads, with work-stealing: each worker has a deque of tasks, it runs the
+ * tasks it submits itself last-in first-out (they are the most likely to have their data in the cache) and when its
+ * deque is empty it steals the oldest task of another worker. Tasks submitted from other threads are spread over the
+ * deques of the workers in turn.
+ *
+ * Tasks are submitted to a RenderTaskGroup. Waiting for a group runs in the waiting thread the tasks of the group that
+ * no worker started yet, then waits for the ones that are running: a render nested in a task never waits for tasks
+ * queued behind it, so nested renders neither deadlock nor need to guess whether the pool has free threads.
+ * The waiting thread only runs tasks of its own group so that the thread-local render arguments it holds are those
+ * the tasks expect.
+ *
+ * The tasks of the background renders (playback read-ahead, cache warming) go to a low-priority lane shared by all the
+ * workers, which run them only when no other task is queued.
+ *
+ * When the scheduler has no thread (the user disabled multi-threading), the tasks all run in the waiting thread.
+ * All functions are thread-safe.
+ */
+
+namespace Natron {
+
+/**
+ * @brief The timings of the tasks of a RenderTaskGroup, for the render statistics
+ **/
+struct RenderTaskTimings
+{
+    int tasksCount;
+    int stolenTasksCount; //< tasks run by another worker than the one which submitted them
+    int waitingThreadTasksCount; //< tasks run by the thread waiting for the group
+    double queuedTime; //< seconds spent by the tasks between their submission and their start, summed
+    double runningTime; //< seconds spent running the tasks, summed
+
+    RenderTaskTimings()
+        : tasksCount(0)
+          , stolenTasksCount(0)
+          , waitingThreadTasksCount(0)
+          , queuedTime(0.)
+          , runningTime(0.)
+    {
+    }
+};
+
+struct RenderTaskGroupPrivate;
+class RenderTaskGroup
+{
+public:
+
+    RenderTaskGroup();
+
+    ///Waits for the tasks which were not waited for. Their exceptions are dropped.
+    ~RenderTaskGroup();
+
+    /**
+     * @brief Submits a task to the scheduler. An exception thrown by the task is rethrown by wait().
+     **/
+    void run(const boost::function<void ()> & task);
+
+    /**
+     * @brief Returns once all the tasks submitted so far are done, running those that did not start in the calling thread.
+     * If tasks threw, the first exception is then rethrown: std::bad_alloc as is, the others as a std::runtime_error
+     * with the same message.
+     **/
+    void wait();
+
+    ///The timings of the tasks done so far
+    RenderTaskTimings getTimings() const;
+
+private:
+
+    boost::shared_ptr<RenderTaskGroupPrivate> _imp;
+};
+
+/**
+ * @brief While an instance exists, the tasks submitted by the thread which created it go to the low-priority lane of
+ * the scheduler, and so do the tasks they submit in turn. Instances may be nested.
+ **/
+class RenderSchedulerLowPriorityScope
+{
+public:
+
+    RenderSchedulerLowPriorityScope();
+
+    ~RenderSchedulerLowPriorityScope();
+
+private:
+
+    RenderSchedulerLowPriorityScope(const RenderSchedulerLowPriorityScope &);
+    RenderSchedulerLowPriorityScope & operator=(const RenderSchedulerLowPriorityScope &);
+};
+
+/**
+ * @brief Sets the number of worker threads of the scheduler. With 0, tasks run only in the threads waiting for them.
+ * Until it is called the scheduler has QThread::idealThreadCount() threads.
+ **/
+void setRenderSchedulerThreadsCount(int threadsCount);
+
+/**
+ * @brief Returns the number of worker threads of the scheduler currently running a task.
+ **/
+int getRenderSchedulerBusyThreadsCount();
+
+/**
+ * @brief Stops the worker threads, once they finished their current task. Called when the application exits.
+ **/
+void quitRenderScheduler();
+
+namespace RenderSchedulerPrivate {
+///A task calling the functor on one element and storing its result. Each task has its own copy of the functor.
+template <typename RESULT, typename FUNCTOR, typename ARG>
+struct StoreResultTask
+{
+    FUNCTOR functor;
+    const ARG* arg;
+    RESULT* result;
+
+    StoreResultTask(const FUNCTOR & functor,
+                    const ARG* arg,
+                    RESULT* result)
+        : functor(functor)
+          , arg(arg)
+          , result(result)
+    {
+    }
+
+    void operator()()
+    {
+        *result = functor(*arg);
+    }
+};
+
+///A task calling the functor on one element. The element is reached through its iterator so that the functor may
+///modify it.
+template <typename FUNCTOR, typename ITERATOR>
+struct CallFunctorTask
+{
+    FUNCTOR functor;
+    ITERATOR it;
+
+    CallFunctorTask(const FUNCTOR & functor,
+                    ITERATOR it)
+        : functor(functor)
+          , it(it)
+    {
+    }
+
+    void operator()()
+    {
+        functor(*it);
+    }
+};
+} // namespace RenderSchedulerPrivate
+
+/**
+ * @brief Calls functor(*it) for each element of [begin,end) in the render scheduler and returns once all the calls
+ * are done. results receives the values returned by the calls, in the order of the elements.
+ * The elements must remain valid until the function returns. If timings is not NULL, it receives the timings of the calls.
+ * If calls threw, the first exception is rethrown as by RenderTaskGroup::wait(), once all the calls are done.
+ **/
+template <typename RESULT, typename ITERATOR, typename FUNCTOR>
+void
+mapInRenderScheduler(ITERATOR begin,
+                     ITERATOR end,
+                     FUNCTOR functor,
+                     std::vector<RESULT>* results,
+                     RenderTaskTimings* timings = 0)
+{
+    typedef typename std::iterator_traits<ITERATOR>::value_type ARG;
+
+    results->resize( std::distance(begin, end) );
+    RenderTaskGroup group;
+    std::size_t i = 0;
+    for (ITERATOR it = begin; it != end; ++it, ++i) {
+        group.run( RenderSchedulerPrivate::StoreResultTask<RESULT, FUNCTOR, ARG>(functor, &*it, &(*results)[i]) );
+    }
+    group.wait();
+    if (timings) {
+        *timings = group.getTimings();
+    }
+}
+
+/**
+ * @brief Same as mapInRenderScheduler() for functors which do not return a value. The functor may modify the elements.
+ **/
+template <typename ITERATOR, typename FUNCTOR>
+void
+forEachInRenderScheduler(ITERATOR begin,
+                         ITERATOR end,
+                         FUNCTOR functor,
+                         RenderTaskTimings* timings = 0)
+{
+    RenderTaskGroup group;
+    for (ITERATOR it = begin; it != end; ++it) {
+        group.run( RenderSchedulerPrivate::CallFunctorTask<FUNCTOR, ITERATOR>(functor, it) );
+    }
+    group.wait();
+    if (timings) {
+        *timings = group.getTimings();
+    }
+}
+} // namespace Natron
+
+#endif // NATRON_ENGINE_RENDERSCHEDULER_H
@@ -72,6 +72,13 @@ struct NodeRenderStatsPrivate
     //Premultiplication of the output imge
     Natron::ImagePremultiplicationEnum outputPremult;
     
+    //Timings of the tasks run in the render scheduler
+    Natron::RenderTaskTimings tasksTimings;
+    
+    //Output nodes only: the number of frames rendered in parallel when the frame was done
+    bool hasThreadsDecision;
+    Natron::RenderThreadsDecision threadsDecision;
+    
     NodeRenderStatsPrivate()
     : totalTimeSpentRendering(0)
     , rod()
@@ -87,6 +94,9 @@ struct NodeRenderStatsPrivate
     , renderScaleSupportEnabled(false)
     , channelsEnabled()
     , outputPremult(Natron::eImagePremultiplicationOpaque)
+    , tasksTimings()
+    , hasThreadsDecision(false)
+    , threadsDecision()
     {
         for (int i = 0; i < 4; ++i) {
             channelsEnabled[i] = false;
@@ -130,6 +140,9 @@ NodeRenderStats::operator=(const NodeRenderStats& other)
         _imp->channelsEnabled[i] = other._imp->channelsEnabled[i];
     }
     _imp->outputPremult = other._imp->outputPremult;
+    _imp->tasksTimings = other._imp->tasksTimings;
+    _imp->hasThreadsDecision = other._imp->hasThreadsDecision;
+    _imp->threadsDecision = other._imp->threadsDecision;
 }
 
 void
@@ -245,6 +258,39 @@ NodeRenderStats::getCacheAccessInfos(int* nbCacheMisses, int* nbCacheHits, int*
     *nbCacheHitButDownscaledImages = _imp->nbCacheHitButDownscaledImages;
 }
 
+void
+NodeRenderStats::addTasksTimings(const Natron::RenderTaskTimings& timings)
+{
+    _imp->tasksTimings.tasksCount += timings.tasksCount;
+    _imp->tasksTimings.stolenTasksCount += timings.stolenTasksCount;
+    _imp->tasksTimings.waitingThreadTasksCount += timings.waitingThreadTasksCount;
+    _imp->tasksTimings.queuedTime += timings.queuedTime;
+    _imp->tasksTimings.runningTime += timings.runningTime;
+}
+
+const Natron::RenderTaskTimings&
+NodeRenderStats::getTasksTimings() const
+{
+    return _imp->tasksTimings;
+}
+
+void
+NodeRenderStats::setRenderThreadsDecision(const Natron::RenderThreadsDecision& decision)
+{
+    _imp->hasThreadsDecision = true;
+    _imp->threadsDecision = decision;
+}
+
+bool
+NodeRenderStats::getRenderThreadsDecision(Natron::RenderThreadsDecision* decision) const
+{
+    if (!_imp->hasThreadsDecision) {
+        return false;
+    }
+    *decision = _imp->threadsDecision;
+    return true;
+}
+
 void
 NodeRenderStats::setTilesSupported(bool tilesSupported)
 {
@@ -411,6 +457,28 @@ RenderStats::addCacheInfosForNode(const boost::shared_ptr<Natron::Node>& node,
     stats.addCacheAccessInfo(isCacheMiss, hasDownscaled);
 }
 
+void
+RenderStats::addTasksInfosForNode(const boost::shared_ptr<Natron::Node>& node,
+                                  const Natron::RenderTaskTimings& timings)
+{
+    QMutexLocker k(&_imp->lock);
+    assert(_imp->doNodesProfiling);
+    
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.addTasksTimings(timings);
+}
+
+void
+RenderStats::setRenderThreadsDecisionForNode(const boost::shared_ptr<Natron::Node>& node,
+                                             const Natron::RenderThreadsDecision& decision)
+{
+    QMutexLocker k(&_imp->lock);
+    assert(_imp->doNodesProfiling);
+    
+    NodeRenderStats& stats = _imp->findOrCreateNodeStats(node);
+    stats.setRenderThreadsDecision(decision);
+}
+
 void
 RenderStats::addRenderInfosForNode(const boost::shared_ptr<Natron::Node>& node,
                            const boost::shared_ptr<Natron::Node>& identity,
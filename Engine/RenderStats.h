@@ -42,6 +42,8 @@
 
 #include "Engine/RectI.h"
 #include "Engine/RectD.h"
+#include "Engine/RenderScheduler.h"
+#include "Engine/RenderThreadsController.h"
 
 namespace Natron {
     class Node;
@@ -98,6 +100,14 @@ public:
     void setOutputPremult(Natron::ImagePremultiplicationEnum premult);
     Natron::ImagePremultiplicationEnum getOutputPremult() const;
     
+    ///The timings of the render scheduler tasks of the node, accumulated over all its renders for the frame
+    void addTasksTimings(const Natron::RenderTaskTimings& timings);
+    const Natron::RenderTaskTimings& getTasksTimings() const;
+    
+    ///Output nodes only: the last decision of the controller of the number of frames rendered in parallel
+    void setRenderThreadsDecision(const Natron::RenderThreadsDecision& decision);
+    bool getRenderThreadsDecision(Natron::RenderThreadsDecision* decision) const;
+    
 private:
     
     boost::scoped_ptr<NodeRenderStatsPrivate> _imp;
@@ -141,6 +151,12 @@ public:
                         const RectI& rectangle,
                         double timeSpent);
     
+    void addTasksInfosForNode(const boost::shared_ptr<Natron::Node>& node,
+                              const Natron::RenderTaskTimings& timings);
+    
+    void setRenderThreadsDecisionForNode(const boost::shared_ptr<Natron::Node>& node,
+                                         const Natron::RenderThreadsDecision& decision);
+    
     std::map<boost::shared_ptr<Natron::Node>,NodeRenderStats > getStats(double *totalTimeSpent) const;
     
 private:
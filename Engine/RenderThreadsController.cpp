@@ -0,0 +1,379 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "RenderThreadsController.h"
+
+#include <map>
+#include <algorithm> // min, max
+#include <cassert>
+
+#include <QtCore/QMutex>
+
+#include "Engine/Timer.h"
+
+///A window of measures lasts at least this number of frames (and at least one frame per parallel render)...
+#define NATRON_RENDER_THREADS_CONTROLLER_MIN_WINDOW_FRAMES 4
+///...and at least this number of seconds
+#define NATRON_RENDER_THREADS_CONTROLLER_MIN_WINDOW_DURATION 0.5
+///A change of the number of parallel renders must improve the throughput by this ratio to be kept
+#define NATRON_RENDER_THREADS_CONTROLLER_MIN_GAIN 0.05
+///Once settled, the controller probes again after this number of windows
+#define NATRON_RENDER_THREADS_CONTROLLER_SETTLED_WINDOWS 8
+
+using namespace Natron;
+
+namespace {
+enum ControllerStateEnum
+{
+    eControllerStateProbing = 0, //< stepping the number of parallel renders while the throughput improves
+    eControllerStateSettled //< keeping the best number of parallel renders found
+};
+}
+
+struct Natron::RenderThreadsControllerPrivate
+{
+    mutable QMutex lock;
+    TimeLapse clock;
+
+    int minThreadsCount;
+    int maxThreadsCount;
+    double memoryBudget;
+
+    int targetThreadsCount;
+
+    ///The window of measures in progress
+    int measuredThreadsCount; //< the number of parallel renders the window measures
+    int framesToSkip; //< frames started before measuredThreadsCount was applied
+    int windowFrames;
+    double windowStart;
+    double latencySum;
+    int latencyCount;
+
+    double memoryPerFrame;
+
+    ControllerStateEnum state;
+    int direction; //< +1 or -1
+    int stepsInDirection;
+    bool otherDirectionTried;
+    std::map<int, double> throughputs; //< the throughput measured for each number of parallel renders during this probe
+    double lastFps;
+    double settledFps;
+    int settledWindows;
+
+    bool hasDecision;
+    RenderThreadsDecision lastDecision;
+
+    RenderThreadsControllerPrivate()
+        : lock()
+          , clock()
+          , minThreadsCount(1)
+          , maxThreadsCount(1)
+          , memoryBudget(0.)
+          , targetThreadsCount(1)
+          , measuredThreadsCount(0)
+          , framesToSkip(0)
+          , windowFrames(0)
+          , windowStart(0.)
+          , latencySum(0.)
+          , latencyCount(0)
+          , memoryPerFrame(0.)
+          , state(eControllerStateProbing)
+          , direction(1)
+          , stepsInDirection(0)
+          , otherDirectionTried(false)
+          , throughputs()
+          , lastFps(0.)
+          , settledFps(0.)
+          , settledWindows(0)
+          , hasDecision(false)
+          , lastDecision()
+    {
+    }
+
+    ///The maximum number of parallel renders, with the memory budget applied
+    int getMaxThreadsCount() const
+    {
+        int ret = maxThreadsCount;
+
+        if ( (memoryBudget > 0.) && (memoryPerFrame > 0.) ) {
+            ret = std::min( ret, (int)(memoryBudget / memoryPerFrame) );
+        }
+
+        return std::max(1, ret);
+    }
+
+    void startWindow(int threadsCount,
+                     double now)
+    {
+        measuredThreadsCount = threadsCount;
+        ///The frames in flight were started before the change, do not count them
+        framesToSkip = threadsCount;
+        windowFrames = 0;
+        windowStart = now;
+        latencySum = 0.;
+        latencyCount = 0;
+    }
+
+    void startProbe(int baseThreadsCount,
+                    double fps)
+    {
+        state = eControllerStateProbing;
+        direction = 1;
+        stepsInDirection = 0;
+        otherDirectionTried = false;
+        throughputs.clear();
+        throughputs[baseThreadsCount] = fps;
+    }
+
+    ///The lowest number of parallel renders whose throughput is not significantly exceeded by a higher one
+    int getBestThreadsCount(double* fps) const
+    {
+        assert( !throughputs.empty() );
+        std::map<int, double>::const_iterator best = throughputs.begin();
+        for (std::map<int, double>::const_iterator it = throughputs.begin(); it != throughputs.end(); ++it) {
+            if ( it->second > best->second * (1. + NATRON_RENDER_THREADS_CONTROLLER_MIN_GAIN) ) {
+                best = it;
+            }
+        }
+        *fps = best->second;
+
+        return best->first;
+    }
+
+    ///Steps from current in the probe direction, or from the best count in the other direction, or settles
+    int stepOrSettle(int current,
+                     int maxCount,
+                     bool improved,
+                     std::string* reason)
+    {
+        int lowerBound = std::min(minThreadsCount, maxCount);
+
+        if ( improved && (current + direction >= lowerBound) && (current + direction <= maxCount) ) {
+            ++stepsInDirection;
+            *reason = stepsInDirection == 1 ? "probing" : "throughput improved";
+
+            return current + direction;
+        }
+
+        double bestFps;
+        int best = getBestThreadsCount(&bestFps);
+
+        ///Going further in this direction is useless: if the first step did not help, try the other direction
+        if ( !otherDirectionTried && (stepsInDirection <= 1) ) {
+            otherDirectionTried = true;
+            direction = -direction;
+            stepsInDirection = 1;
+            int next = best + direction;
+            if ( (next >= lowerBound) && (next <= maxCount) && ( throughputs.find(next) == throughputs.end() ) ) {
+                *reason = "probing the other direction";
+
+                return next;
+            }
+        }
+
+        state = eControllerStateSettled;
+        settledFps = bestFps;
+        settledWindows = 0;
+        *reason = "settled on the best throughput";
+
+        return best;
+    }
+};
+
+RenderThreadsController::RenderThreadsController()
+    : _imp( new RenderThreadsControllerPrivate() )
+{
+}
+
+RenderThreadsController::~RenderThreadsController()
+{
+}
+
+void
+RenderThreadsController::reset(int initialThreadsCount)
+{
+    QMutexLocker l(&_imp->lock);
+
+    _imp->targetThreadsCount = std::max(1, initialThreadsCount);
+    _imp->measuredThreadsCount = 0;
+    _imp->framesToSkip = 0;
+    _imp->windowFrames = 0;
+    _imp->memoryPerFrame = 0.;
+    _imp->state = eControllerStateProbing;
+    _imp->direction = 1;
+    _imp->stepsInDirection = 0;
+    _imp->otherDirectionTried = false;
+    _imp->throughputs.clear();
+    _imp->lastFps = 0.;
+    _imp->hasDecision = false;
+}
+
+void
+RenderThreadsController::setLimits(int minThreadsCount,
+                                   int maxThreadsCount,
+                                   double memoryBudget)
+{
+    QMutexLocker l(&_imp->lock);
+
+    _imp->minThreadsCount = std::max(1, minThreadsCount);
+    _imp->maxThreadsCount = std::max(_imp->minThreadsCount, maxThreadsCount);
+    _imp->memoryBudget = memoryBudget;
+}
+
+int
+RenderThreadsController::getInitialThreadsCount() const
+{
+    QMutexLocker l(&_imp->lock);
+    int maxCount = _imp->getMaxThreadsCount();
+
+    return std::max( std::min(_imp->targetThreadsCount, maxCount), std::min(_imp->minThreadsCount, maxCount) );
+}
+
+void
+RenderThreadsController::notifyFrameRenderTime(double timeSpent)
+{
+    QMutexLocker l(&_imp->lock);
+
+    _imp->latencySum += timeSpent;
+    ++_imp->latencyCount;
+}
+
+int
+RenderThreadsController::notifyFrameDone(int currentThreadsCount,
+                                         double inFlightMemory)
+{
+    QMutexLocker l(&_imp->lock);
+    double now = _imp->clock.getTimeSinceCreation();
+
+    currentThreadsCount = std::max(1, currentThreadsCount);
+
+    ///Follow increases of the memory used by a frame right away, decreases slowly
+    if (inFlightMemory > 0.) {
+        double sample = inFlightMemory / currentThreadsCount;
+        if (sample > _imp->memoryPerFrame) {
+            _imp->memoryPerFrame = sample;
+        } else {
+            _imp->memoryPerFrame = 0.9 * _imp->memoryPerFrame + 0.1 * sample;
+        }
+    }
+
+    int maxCount = _imp->getMaxThreadsCount();
+    int lowerBound = std::min(_imp->minThreadsCount, maxCount);
+    std::string reason;
+    int next = currentThreadsCount;
+
+    if (currentThreadsCount != _imp->measuredThreadsCount) {
+        _imp->startWindow(currentThreadsCount, now);
+    }
+
+    if (_imp->framesToSkip > 0) {
+        --_imp->framesToSkip;
+        if (_imp->framesToSkip == 0) {
+            _imp->windowStart = now;
+            _imp->latencySum = 0.;
+            _imp->latencyCount = 0;
+        }
+        next = _imp->targetThreadsCount;
+    } else {
+        ++_imp->windowFrames;
+        double duration = now - _imp->windowStart;
+        if ( (_imp->windowFrames < std::max(NATRON_RENDER_THREADS_CONTROLLER_MIN_WINDOW_FRAMES, currentThreadsCount)) ||
+             (duration < NATRON_RENDER_THREADS_CONTROLLER_MIN_WINDOW_DURATION) ) {
+            next = _imp->targetThreadsCount;
+        } else {
+            ///The window is complete
+            double fps = _imp->windowFrames / duration;
+            double latency = _imp->latencyCount > 0 ? _imp->latencySum / _imp->latencyCount : 0.;
+
+            if (_imp->state == eControllerStateProbing) {
+                bool improved;
+                if ( _imp->throughputs.empty() ) {
+                    _imp->startProbe(currentThreadsCount, fps);
+                    improved = true;
+                } else {
+                    ///Compare with the count we stepped from
+                    std::map<int, double>::const_iterator previous = _imp->throughputs.find(currentThreadsCount - _imp->direction);
+                    double previousFps = previous != _imp->throughputs.end() ? previous->second : _imp->lastFps;
+                    improved = fps > previousFps * (1. + NATRON_RENDER_THREADS_CONTROLLER_MIN_GAIN);
+                    _imp->throughputs[currentThreadsCount] = fps;
+                }
+                next = _imp->stepOrSettle(currentThreadsCount, maxCount, improved, &reason);
+            } else {
+                ++_imp->settledWindows;
+                if ( fps < _imp->settledFps * (1. - NATRON_RENDER_THREADS_CONTROLLER_MIN_GAIN) ) {
+                    _imp->startProbe(currentThreadsCount, fps);
+                    next = _imp->stepOrSettle(currentThreadsCount, maxCount, true, &reason);
+                    reason = "throughput dropped, " + reason;
+                } else if (_imp->settledWindows >= NATRON_RENDER_THREADS_CONTROLLER_SETTLED_WINDOWS) {
+                    _imp->startProbe(currentThreadsCount, fps);
+                    next = _imp->stepOrSettle(currentThreadsCount, maxCount, true, &reason);
+                }
+            }
+            _imp->lastFps = fps;
+
+            if (next != currentThreadsCount) {
+                _imp->hasDecision = true;
+                _imp->lastDecision.threadsCount = next;
+                _imp->lastDecision.previousThreadsCount = currentThreadsCount;
+                _imp->lastDecision.framesPerSecond = fps;
+                _imp->lastDecision.frameLatency = latency;
+                _imp->lastDecision.memoryPerFrame = _imp->memoryPerFrame;
+                _imp->lastDecision.maxThreadsCount = maxCount;
+                _imp->lastDecision.reason = reason;
+            }
+            _imp->startWindow(currentThreadsCount, now);
+            _imp->framesToSkip = 0;
+        }
+    }
+
+    ///The memory budget applies right away
+    if (next > maxCount) {
+        next = maxCount;
+        if (currentThreadsCount > maxCount) {
+            _imp->hasDecision = true;
+            _imp->lastDecision.threadsCount = next;
+            _imp->lastDecision.previousThreadsCount = currentThreadsCount;
+            _imp->lastDecision.memoryPerFrame = _imp->memoryPerFrame;
+            _imp->lastDecision.maxThreadsCount = maxCount;
+            _imp->lastDecision.reason = "memory budget";
+        }
+    }
+    next = std::max(next, lowerBound);
+    _imp->targetThreadsCount = next;
+
+    return next;
+} // notifyFrameDone
+
+bool
+RenderThreadsController::getLastDecision(RenderThreadsDecision* decision) const
+{
+    QMutexLocker l(&_imp->lock);
+
+    if (!_imp->hasDecision) {
+        return false;
+    }
+    *decision = _imp->lastDecision;
+
+    return true;
+}
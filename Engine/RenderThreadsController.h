@@ -0,0 +1,122 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef NATRON_ENGINE_RENDERTHREADSCONTROLLER_H
+#define NATRON_ENGINE_RENDERTHREADSCONTROLLER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <string>
+
+#include "Global/Macros.h"
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+/*
+ * The render threads controller decides how many frames an OutputSchedulerThread renders in parallel.
+ * It measures the throughput (frames per second) over windows of frames and climbs towards the number of parallel
+ * renders giving the best throughput: it tries one more (or one less) parallel render, keeps going while the
+ * throughput improves and settles on the best count otherwise. Once settled, it probes again from time to time or when
+ * the throughput drops, since the cost of the frames changes along the sequence.
+ * Between counts giving the same throughput it prefers the lowest one, which has the lowest latency per frame.
+ * The number of parallel renders is limited so that the memory used by the frames in flight fits in a budget.
+ * All functions are thread-safe.
+ */
+
+namespace Natron {
+
+/**
+ * @brief A decision of the controller, reported in the render statistics
+ **/
+struct RenderThreadsDecision
+{
+    int threadsCount; //< the number of parallel renders decided
+    int previousThreadsCount; //< the number of parallel renders measured
+    double framesPerSecond; //< the throughput measured with previousThreadsCount
+    double frameLatency; //< the average time spent rendering a frame with previousThreadsCount, in seconds
+    double memoryPerFrame; //< the estimated memory used by a frame in flight, in bytes
+    int maxThreadsCount; //< the maximum number of parallel renders, once the memory budget is applied
+    std::string reason;
+
+    RenderThreadsDecision()
+        : threadsCount(0)
+          , previousThreadsCount(0)
+          , framesPerSecond(0.)
+          , frameLatency(0.)
+          , memoryPerFrame(0.)
+          , maxThreadsCount(0)
+          , reason()
+    {
+    }
+};
+
+struct RenderThreadsControllerPrivate;
+class RenderThreadsController
+{
+public:
+
+    RenderThreadsController();
+
+    ~RenderThreadsController();
+
+    /**
+     * @brief Forgets the measures of the previous render and starts with initialThreadsCount parallel renders.
+     * Called when a render starts.
+     **/
+    void reset(int initialThreadsCount);
+
+    /**
+     * @brief Sets the bounds of the number of parallel renders and the memory the frames in flight may use, in bytes.
+     **/
+    void setLimits(int minThreadsCount,
+                   int maxThreadsCount,
+                   double memoryBudget);
+
+    /**
+     * @brief Returns the number of parallel renders to start with, before any frame is done.
+     **/
+    int getInitialThreadsCount() const;
+
+    /**
+     * @brief Called by a render thread with the time it spent rendering a frame, in seconds.
+     **/
+    void notifyFrameRenderTime(double timeSpent);
+
+    /**
+     * @brief Called each time a frame is done, while currentThreadsCount renders are running.
+     * inFlightMemory is the memory held by the images of the frames being rendered, in bytes.
+     * Returns the number of parallel renders to run.
+     **/
+    int notifyFrameDone(int currentThreadsCount,
+                        double inFlightMemory);
+
+    ///The last decision which changed the number of parallel renders. Returns false if there was none since reset()
+    bool getLastDecision(RenderThreadsDecision* decision) const;
+
+private:
+
+    boost::scoped_ptr<RenderThreadsControllerPrivate> _imp;
+};
+} // namespace Natron
+
+#endif // NATRON_ENGINE_RENDERTHREADSCONTROLLER_H
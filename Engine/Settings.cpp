@@ -682,6 +682,28 @@ Settings::initializeKnobsViewers()
                                           "is unchecked.");
     _viewersTab->addKnob(_enableProgressReport);
     
+    _progressiveViewerRender = Natron::createKnob<KnobBool>(this, "Progressive render");
+    _progressiveViewerRender->setName("progressiveViewerRender");
+    _progressiveViewerRender->setAnimationEnabled(false);
+    _progressiveViewerRender->setHintToolTip("When enabled, the viewer first displays the portion to render at a lower resolution, "
+                                             "then refines it tile by tile from the center of the viewer outwards. Each pass is "
+                                             "abandoned as soon as a newer render is requested, e.g while dragging a parameter. "
+                                             "This has the same limitations as the progress-report option for effects that need "
+                                             "a larger region than the render window (e.g: Blur).");
+    _viewersTab->addKnob(_progressiveViewerRender);
+    
+    _playbackReadAhead = Natron::createKnob<KnobDouble>(this, "Playback read-ahead (seconds)");
+    _playbackReadAhead->setName("playbackReadAhead");
+    _playbackReadAhead->setAnimationEnabled(false);
+    _playbackReadAhead->setMinimum(0.);
+    _playbackReadAhead->setDisplayMinimum(0.);
+    _playbackReadAhead->setMaximum(30.);
+    _playbackReadAhead->setDisplayMaximum(10.);
+    _playbackReadAhead->setHintToolTip("During playback, the viewer renders in the background the frames that are about to be "
+                                       "displayed, up to this duration ahead of the current frame, and stores them in the viewer cache. "
+                                       "The frames read ahead are shown on the timeline. Set to 0 to disable.");
+    _viewersTab->addKnob(_playbackReadAhead);
+    
 }
 
 void
@@ -900,6 +922,55 @@ Settings::initializeKnobsCaching()
                                                                                                                            "which have multiple outputs, or their parameter \"Force caching\" checked or if one of its "
                                                                                                                            "output has its settings panel opened.");
     _cachingTab->addKnob(_aggressiveCaching);
+
+    _cacheEvictionPolicy = Natron::createKnob<KnobChoice>(this, "Cache eviction policy");
+    _cacheEvictionPolicy->setName("cacheEvictionPolicy");
+    _cacheEvictionPolicy->setAnimationEnabled(false);
+    std::vector<std::string> evictionPolicies;
+    std::vector<std::string> helpStringsEvictionPolicies;
+    evictionPolicies.push_back("Least recently used");
+    helpStringsEvictionPolicies.push_back("When the cache is full, the images that were not used for the longest time are removed first.");
+    evictionPolicies.push_back("Render cost");
+    helpStringsEvictionPolicies.push_back("When the cache is full, the images that took the least time to render relatively "
+                                          "to their size are removed first (GreedyDual-Size). Images that are slow to compute, "
+                                          "such as the output of a large blur, stay longer in the cache.");
+    _cacheEvictionPolicy->populateChoices(evictionPolicies, helpStringsEvictionPolicies);
+    _cacheEvictionPolicy->setHintToolTip("Controls which images are removed from the caches when they are full."
+                                         " Hover each option with the mouse for a detailed description.");
+    _cachingTab->addKnob(_cacheEvictionPolicy);
+
+    _cacheCompression = Natron::createKnob<KnobBool>(this, "Compress evicted images in RAM");
+    _cacheCompression->setName("cacheCompression");
+    _cacheCompression->setAnimationEnabled(false);
+    _cacheCompression->setHintToolTip("When checked, images removed from the RAM portion of the caches are first kept compressed in RAM "
+                                      "before being written to disk or destroyed. Fetching them back only costs a decompression, which "
+                                      "is much faster than re-rendering them or reading them from disk. Up to half of the RAM dedicated "
+                                      "to each cache can be used to hold compressed images.");
+    _cachingTab->addKnob(_cacheCompression);
+    
+    _contentBasedNodeHash = Natron::createKnob<KnobBool>(this, "Content-based node hash");
+    _contentBasedNodeHash->setName("contentBasedNodeHash");
+    _contentBasedNodeHash->setAnimationEnabled(false);
+    _contentBasedNodeHash->setHintToolTip("When checked, the images of a node are identified in the caches by the plug-in, the values, "
+                                          "animation and expressions of its parameters and by its inputs, instead of by the number "
+                                          "of changes made to the node. Setting a parameter back to a previous value, undoing, "
+                                          "or reopening a project then finds the images already rendered, including in the disk cache. "
+                                          "Nodes whose parameters use expressions, and roto nodes, still get a new identifier on each change.");
+    _cachingTab->addKnob(_contentBasedNodeHash);
+    
+    _idleCacheWarmingDelay = Natron::createKnob<KnobInt>(this, "Fill the caches when idle for (seconds, 0 = never)");
+    _idleCacheWarmingDelay->setName("idleCacheWarmingDelay");
+    _idleCacheWarmingDelay->setAnimationEnabled(false);
+    _idleCacheWarmingDelay->setMinimum(0);
+    _idleCacheWarmingDelay->setDisplayMinimum(0);
+    _idleCacheWarmingDelay->setDisplayMaximum(300);
+    _idleCacheWarmingDelay->disableSlider();
+    _idleCacheWarmingDelay->setHintToolTip("When there was no mouse or keyboard activity for this duration, " NATRON_APPLICATION_NAME
+                                           " renders in the background the frame range of the active viewer into the playback cache, "
+                                           "as well as the frame range of the DiskCache nodes, so that the next playback does not have to "
+                                           "render them. The rendering stops as soon as you use the application again or when the "
+                                           "caches are full.");
+    _cachingTab->addKnob(_idleCacheWarmingDelay);
     
     _maxRAMPercent = Natron::createKnob<KnobInt>(this, "Maximum amount of RAM memory used for caching (% of total RAM)");
     _maxRAMPercent->setName("maxRAMPercent");
@@ -1002,6 +1073,19 @@ Settings::initializeKnobsCaching()
                                    "This is provided in case " NATRON_APPLICATION_NAME " lost track of cached images "
                                    "for some reason.");
     _cachingTab->addKnob(_wipeDiskCache);
+
+    _cacheShards = Natron::createKnob<KnobInt>(this, "Number of cache shards (0 = number of cores)");
+    _cacheShards->setName("cacheShards");
+    _cacheShards->setAnimationEnabled(false);
+    _cacheShards->setMinimum(0);
+    _cacheShards->setMaximum(256);
+    _cacheShards->setHintToolTip("WARNING: Changing this parameter requires a restart of the application. \n"
+                                 "The caches are split into this number of independent partitions, each protected by its own lock, "
+                                 "so that render threads looking-up different images do not wait on each other. "
+                                 "When set to 1, all the threads share the same lock. When set to 0, one partition "
+                                 "is created per core. Higher values reduce contention on machines with many cores "
+                                 "but make the least recently used policy less accurate.");
+    _cachingTab->addKnob(_cacheShards);
 }
 
 void
@@ -1216,16 +1300,23 @@ Settings::setDefaultValues()
     _autoProxyWhenScrubbingTimeline->setDefaultValue(true);
     _autoProxyLevel->setDefaultValue(1);
     _enableProgressReport->setDefaultValue(false);
+    _progressiveViewerRender->setDefaultValue(false);
+    _playbackReadAhead->setDefaultValue(1.,0);
     
     _warnOcioConfigKnobChanged->setDefaultValue(true);
     _ocioStartupCheck->setDefaultValue(true);
 
     _aggressiveCaching->setDefaultValue(false);
+    _cacheEvictionPolicy->setDefaultValue(0,0);
+    _cacheCompression->setDefaultValue(true);
+    _contentBasedNodeHash->setDefaultValue(false);
+    _idleCacheWarmingDelay->setDefaultValue(30,0);
     _maxRAMPercent->setDefaultValue(50,0);
     _maxPlayBackPercent->setDefaultValue(25,0);
     _unreachableRAMPercent->setDefaultValue(5);
     _maxViewerDiskCacheGB->setDefaultValue(5,0);
     _maxDiskCacheNodeGB->setDefaultValue(10,0);
+    _cacheShards->setDefaultValue(0);
     setCachingLabels();
     _autoTurbo->setDefaultValue(false);
     _usePluginIconsInNodeGraph->setDefaultValue(true);
@@ -1761,6 +1852,18 @@ Settings::onKnobValueChanged(KnobI* k,
         if (!_restoringSettings) {
             appPTR->setApplicationsCachesMaximumDiskSpace(getMaximumDiskCacheNodeSize());
         }
+    } else if ( k == _cacheEvictionPolicy.get() ) {
+        if (!_restoringSettings) {
+            appPTR->setApplicationsCachesEvictionPolicy( getCacheEvictionPolicy() );
+        }
+    } else if ( k == _cacheCompression.get() ) {
+        if (!_restoringSettings) {
+            appPTR->setApplicationsCachesCompressionEnabled( isCacheCompressionEnabled() );
+        }
+    } else if ( k == _contentBasedNodeHash.get() ) {
+        if (!_restoringSettings) {
+            appPTR->recomputeNodesHash();
+        }
     } else if ( k == _maxRAMPercent.get() ) {
         if (!_restoringSettings) {
             appPTR->setApplicationsCachesMaximumMemoryPercent( getRamMaximumPercent() );
@@ -1897,6 +2000,12 @@ Settings::getMaximumDiskCacheNodeSize() const
     return (U64)( _maxDiskCacheNodeGB->getValue() ) * std::pow(1024.,3.);
 }
 
+int
+Settings::getCacheShardsCount() const
+{
+    return _cacheShards->getValue();
+}
+
 double
 Settings::getUnreachableRamPercent() const
 {
@@ -2772,6 +2881,30 @@ Settings::isAggressiveCachingEnabled() const
     return _aggressiveCaching->getValue();
 }
 
+Natron::CacheEvictionPolicyEnum
+Settings::getCacheEvictionPolicy() const
+{
+    return (Natron::CacheEvictionPolicyEnum)_cacheEvictionPolicy->getValue();
+}
+
+bool
+Settings::isCacheCompressionEnabled() const
+{
+    return _cacheCompression->getValue();
+}
+
+bool
+Settings::isContentBasedNodeHashEnabled() const
+{
+    return _contentBasedNodeHash->getValue();
+}
+
+int
+Settings::getIdleCacheWarmingDelay() const
+{
+    return _idleCacheWarmingDelay->getValue();
+}
+
 bool
 Settings::isAutoTurboEnabled() const
 {
@@ -3088,6 +3221,18 @@ Settings::isInViewerProgressReportEnabled() const
     return _enableProgressReport->getValue();
 }
 
+bool
+Settings::isProgressiveViewerRenderEnabled() const
+{
+    return _progressiveViewerRender->getValue();
+}
+
+double
+Settings::getPlaybackReadAheadDuration() const
+{
+    return _playbackReadAhead->getValue();
+}
+
 bool
 Settings::isDefaultAppearanceOutdated() const
 {
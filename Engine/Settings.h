@@ -95,6 +95,12 @@ public:
     
     U64 getMaximumDiskCacheNodeSize() const;
 
+    /**
+     * @brief Returns the number of shards the caches should be partitioned into, 0 meaning
+     * one shard per hardware thread.
+     **/
+    int getCacheShardsCount() const;
+
     double getUnreachableRamPercent() const;
 
     bool getColorPickerLinear() const;
@@ -244,6 +250,16 @@ public:
     bool notifyOnFileChange() const;
     
     bool isAggressiveCachingEnabled() const;
+
+    Natron::CacheEvictionPolicyEnum getCacheEvictionPolicy() const;
+
+    bool isCacheCompressionEnabled() const;
+    
+    ///When true the hash of the nodes is computed from the values of their parameters rather than from their age
+    bool isContentBasedNodeHashEnabled() const;
+    
+    ///The idle duration, in seconds, after which the caches are filled in the background, 0 if disabled
+    int getIdleCacheWarmingDelay() const;
     
     bool isAutoTurboEnabled() const;
     
@@ -304,6 +320,12 @@ public:
     
     bool isInViewerProgressReportEnabled() const;
     
+    ///When true the viewer renders a coarse preview of the image first, then refines it from the center outwards
+    bool isProgressiveViewerRenderEnabled() const;
+    
+    ///The duration, in seconds, of the frames rendered ahead of the current frame during playback
+    double getPlaybackReadAheadDuration() const;
+    
     bool isDefaultAppearanceOutdated() const;
     void restoreDefaultAppearance();
     
@@ -367,6 +389,10 @@ private:
     boost::shared_ptr<KnobPage> _cachingTab;
 
     boost::shared_ptr<KnobBool> _aggressiveCaching;
+    boost::shared_ptr<KnobChoice> _cacheEvictionPolicy;
+    boost::shared_ptr<KnobBool> _cacheCompression;
+    boost::shared_ptr<KnobBool> _contentBasedNodeHash;
+    boost::shared_ptr<KnobInt> _idleCacheWarmingDelay;
     ///The percentage of the value held by _maxRAMPercent to dedicate to playback cache (viewer cache's in-RAM portion) only
     boost::shared_ptr<KnobInt> _maxPlayBackPercent;
     boost::shared_ptr<KnobString> _maxPlaybackLabel;
@@ -390,6 +416,9 @@ private:
     boost::shared_ptr<KnobInt> _maxDiskCacheNodeGB;
     boost::shared_ptr<KnobPath> _diskCachePath;
     boost::shared_ptr<KnobButton> _wipeDiskCache;
+
+    ///Number of independent hash-partitions of the caches, each with its own lock
+    boost::shared_ptr<KnobInt> _cacheShards;
     
     boost::shared_ptr<KnobPage> _viewersTab;
     boost::shared_ptr<KnobChoice> _texturesMode;
@@ -401,6 +430,8 @@ private:
     boost::shared_ptr<KnobBool> _autoProxyWhenScrubbingTimeline;
     boost::shared_ptr<KnobChoice> _autoProxyLevel;
     boost::shared_ptr<KnobBool> _enableProgressReport;
+    boost::shared_ptr<KnobBool> _progressiveViewerRender;
+    boost::shared_ptr<KnobDouble> _playbackReadAhead;
     
     boost::shared_ptr<KnobPage> _nodegraphTab;
     boost::shared_ptr<KnobBool> _autoTurbo;
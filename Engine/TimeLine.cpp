@@ -37,6 +37,9 @@
 
 TimeLine::TimeLine(Natron::Project* project)
 : _currentFrame(1)
+, _hasReadAhead(false)
+, _readAheadFirst(0)
+, _readAheadLast(0)
 , _keyframes()
 , _project(project)
 {
@@ -262,6 +265,48 @@ TimeLine::getKeyframes(std::list<SequenceTime>* keys) const
     *keys = _keyframes;
 }
 
+void
+TimeLine::setReadAheadRange(SequenceTime first,
+                            SequenceTime last)
+{
+    {
+        QMutexLocker l(&_lock);
+        if (_hasReadAhead && _readAheadFirst == first && _readAheadLast == last) {
+            return;
+        }
+        _hasReadAhead = true;
+        _readAheadFirst = first;
+        _readAheadLast = last;
+    }
+    Q_EMIT readAheadRangeChanged();
+}
+
+void
+TimeLine::clearReadAheadRange()
+{
+    {
+        QMutexLocker l(&_lock);
+        if (!_hasReadAhead) {
+            return;
+        }
+        _hasReadAhead = false;
+    }
+    Q_EMIT readAheadRangeChanged();
+}
+
+bool
+TimeLine::getReadAheadRange(SequenceTime* first,
+                            SequenceTime* last) const
+{
+    QMutexLocker l(&_lock);
+    if (!_hasReadAhead) {
+        return false;
+    }
+    *first = _readAheadFirst;
+    *last = _readAheadLast;
+    return true;
+}
+
 void
 TimeLine::goToPreviousKeyframe()
 {
@@ -104,6 +104,18 @@ public:
 
     void getKeyframes(std::list<SequenceTime>* keys) const;
 
+    /**
+     * @brief Sets the range of frames rendered ahead of the current frame during playback, which are displayed
+     * along with the cached frames. first may be greater than last when playing backward.
+     * MT-safe, emits readAheadRangeChanged().
+     **/
+    void setReadAheadRange(SequenceTime first,SequenceTime last);
+
+    void clearReadAheadRange();
+
+    ///Returns false if no frame was read ahead. MT-safe
+    bool getReadAheadRange(SequenceTime* first,SequenceTime* last) const;
+
 public Q_SLOTS:
 
 
@@ -123,10 +135,14 @@ Q_SIGNALS:
 
     void keyframeIndicatorsChanged();
 
+    void readAheadRangeChanged();
+
 private:
     
     mutable QMutex _lock; // protects the following SequenceTime members
     SequenceTime _currentFrame;
+    bool _hasReadAhead;
+    SequenceTime _readAheadFirst,_readAheadLast;
     
     // not MT-safe
     std::list<SequenceTime> _keyframes;
@@ -36,7 +36,6 @@ GCC_DIAG_UNUSED_LOCAL_TYPEDEFS_ON
 
 CLANG_DIAG_OFF(deprecated)
 #include <QtCore/QtGlobal>
-#include <QtConcurrentMap> // QtCore on Qt4, QtConcurrent on Qt<<(
 #include <QtCore/QFutureWatcher>
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
@@ -50,6 +49,8 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/Image.h"
 #include "Engine/ImageInfo.h"
 #include "Engine/ImageInfo.h"
+#include "Engine/ImageKernels.h"
+#include "Engine/ImageStatistics.h"
 #include "Engine/Log.h"
 #include "Engine/Lut.h"
 #include "Engine/MemoryFile.h"
@@ -58,6 +59,7 @@ CLANG_DIAG_ON(deprecated)
 #include "Engine/OpenGLViewerI.h"
 #include "Engine/OutputSchedulerThread.h"
 #include "Engine/Project.h"
+#include "Engine/RenderScheduler.h"
 #include "Engine/RenderStats.h"
 #include "Engine/RotoContext.h"
 #include "Engine/RotoPaint.h"
@@ -73,6 +75,17 @@ CLANG_DIAG_ON(deprecated)
 
 #define NATRON_TIME_ELASPED_BEFORE_PROGRESS_REPORT 0.4
 
+///The progressive render first displays the image this many mipmap levels above the level of the texture
+#define NATRON_VIEWER_PROGRESSIVE_COARSE_LEVELS 2
+
+///The number of display transforms kept by each viewer
+#define NATRON_VIEWER_DISPLAY_LUTS_COUNT 4
+
+///The auto-contrast maps these percentiles of the displayed values to 0 and 1, so that a few outliers do not
+///squash the rest of the image
+#define NATRON_VIEWER_AUTOCONTRAST_LOW_PERCENTILE 0.001
+#define NATRON_VIEWER_AUTOCONTRAST_HIGH_PERCENTILE 0.999
+
 using namespace Natron;
 using std::make_pair;
 using boost::shared_ptr;
@@ -80,7 +93,6 @@ using boost::shared_ptr;
 
 static void scaleToTexture8bits(const RectI& roi,
                                 const RenderViewerArgs & args,
-                                ViewerInstance* viewer,
                                 U32* output);
 static void scaleToTexture32bits(const RectI& roi,
                                  const RenderViewerArgs & args,
@@ -91,9 +103,37 @@ findAutoContrastVminVmax(boost::shared_ptr<const Natron::Image> inputImage,
                          const RectI & rect);
 static void renderFunctor(const RectI& roi,
                           const RenderViewerArgs & args,
-                          ViewerInstance* viewer,
                           void *buffer);
 
+namespace {
+///Orders tiles by the distance of their center to a point, so that the tiles close to the center of the viewport are rendered first
+struct TileDistanceCompare
+{
+    double x, y;
+
+    TileDistanceCompare(double x_,
+                        double y_)
+        : x(x_)
+        , y(y_)
+    {
+    }
+
+    double distance(const RectI& r) const
+    {
+        double dx = (r.x1 + r.x2) / 2. - x;
+        double dy = (r.y1 + r.y2) / 2. - y;
+
+        return dx * dx + dy * dy;
+    }
+
+    bool operator()(const RectI& a,
+                    const RectI& b) const
+    {
+        return distance(a) < distance(b);
+    }
+};
+} // anon namespace
+
 /**
  *@brief Actually converting to ARGB... but it is called BGRA by
    the texture format GL_UNSIGNED_INT_8_8_8_8_REV
@@ -133,6 +173,85 @@ ViewerInstance::lutFromColorspace(Natron::ViewerColorSpaceEnum cs)
 }
 
 
+DisplayLut::DisplayLut(double gain,
+                       double gamma,
+                       double offset,
+                       const Natron::Color::Lut* colorSpace)
+    : _gain(gain)
+    , _gamma(gamma)
+    , _offset(offset)
+    , _colorSpace(colorSpace)
+    , _table(0x10001)
+{
+    assert(colorSpace);
+    for (U32 i = 0; i < 0x10000; ++i) {
+        U32 bits = i << 16;
+        float f;
+        memcpy(&f, &bits, sizeof(float));
+
+        ///Same operations as scaleToTexture8bits_generic
+        double v = 0.;
+        if (gamma != 0.) {
+            v = f * gain + offset;
+            if (v != v) {
+                ///NaN
+                v = 0.;
+            }
+            if (gamma != 1.) {
+                v = v <= 0. ? 0. : ( v >= 1. ? 1. : std::pow(v, gamma) );
+            }
+        }
+        _table[i] = colorSpace->toColorSpaceUint8xxFromLinearFloatFast( (float)v );
+    }
+    _table[0x10000] = _table[0xffff];
+}
+
+/**
+ * @brief Returns whether the 8-bit texture of the render may apply its display transform with a DisplayLut. It does not:
+ * - in luminance mode, which mixes the channels before the colorspace conversion
+ * - with auto-contrast, whose gain and offset change with each frame: a table would be built for each frame
+ * - for a linear output colorspace, which is converted without error diffusion
+ **/
+static bool canUseDisplayLut(const ViewerArgs& inArgs) WARN_UNUSED_RETURN;
+bool
+canUseDisplayLut(const ViewerArgs& inArgs)
+{
+    return inArgs.key->getBitDepth() != Natron::eImageBitDepthFloat &&
+           inArgs.channels != Natron::eDisplayChannelsY &&
+           !inArgs.autoContrast &&
+           inArgs.params->lut != Natron::eViewerColorSpaceLinear;
+}
+
+DisplayLutPtr
+ViewerInstance::ViewerInstancePrivate::getDisplayLut(double gain,
+                                                     double gamma,
+                                                     double offset,
+                                                     const Natron::Color::Lut* colorSpace)
+{
+    {
+        QMutexLocker k(&displayLutsMutex);
+        for (std::list<DisplayLutPtr>::iterator it = displayLuts.begin(); it != displayLuts.end(); ++it) {
+            if ( (*it)->matches(gain, gamma, offset, colorSpace) ) {
+                DisplayLutPtr ret = *it;
+                displayLuts.erase(it);
+                displayLuts.push_front(ret);
+
+                return ret;
+            }
+        }
+    }
+
+    ///Build it without holding the lock: another thread may build the same table, which is harmless
+    DisplayLutPtr ret( new DisplayLut(gain, gamma, offset, colorSpace) );
+    QMutexLocker k(&displayLutsMutex);
+    displayLuts.push_front(ret);
+    if (displayLuts.size() > NATRON_VIEWER_DISPLAY_LUTS_COUNT) {
+        displayLuts.pop_back();
+    }
+
+    return ret;
+}
+
 class ViewerRenderingStarted_RAII
 {
     ViewerInstance* _node;
@@ -958,11 +1077,8 @@ ViewerInstance::getRenderViewerArgsAndCheckCache(SequenceTime time,
         outArgs->params->alphaLayer = _imp->viewerParamsAlphaLayer;
         outArgs->params->alphaChannelName = _imp->viewerParamsAlphaChannelName;
     }
-    {
-        QMutexLocker k(&_imp->gammaLookupMutex);
-        if (_imp->gammaLookup.empty()) {
-            _imp->fillGammaLut(1. / outArgs->params->gamma);
-        }
+    if ( !_imp->getGammaLut() ) {
+        _imp->fillGammaLut(1. / outArgs->params->gamma);
     }
     std::string inputToRenderName = outArgs->activeInputToRender->getNode()->getScriptName_mt_safe();
     
@@ -1148,8 +1264,10 @@ ViewerInstance::renderViewer_internal(int view,
     ///Make sure the parallel render args are set on the thread and die when rendering is finished
     boost::shared_ptr<ViewerParallelRenderArgsSetter> frameArgs;
     bool tilingProgressReportPrefEnabled = false;
+    bool progressiveRenderPrefEnabled = false;
     if (useTLS) {
-        tilingProgressReportPrefEnabled = appPTR->getCurrentSettings()->isInViewerProgressReportEnabled();
+        progressiveRenderPrefEnabled = appPTR->getCurrentSettings()->isProgressiveViewerRenderEnabled();
+        tilingProgressReportPrefEnabled = appPTR->getCurrentSettings()->isInViewerProgressReportEnabled() || progressiveRenderPrefEnabled;
         
         RectD canonicalRoi;
         roi.toCanonical(inArgs.params->mipMapLevel, inArgs.activeInputToRender->getPreferredAspectRatio(), inArgs.params->rod, &canonicalRoi);
@@ -1343,6 +1461,28 @@ ViewerInstance::renderViewer_internal(int view,
          Split the RoI in tiles and update viewer if rendering takes too much time.
          */
        splitRoi = roi.splitIntoSmallerRects(0);
+        
+        if (progressiveRenderPrefEnabled && splitRoi.size() > 1) {
+            /*
+             Refine the tiles from the center of the viewport outwards instead of in scan-line order
+             */
+            RectI viewport = _imp->uiContext->getExactImageRectangleDisplayed(inArgs.params->rod, inArgs.params->textureRect.par, inArgs.params->mipMapLevel);
+            if (!viewport.intersect(roi, &viewport)) {
+                viewport = roi;
+            }
+            std::stable_sort(splitRoi.begin(), splitRoi.end(), TileDistanceCompare((viewport.x1 + viewport.x2) / 2., (viewport.y1 + viewport.y2) / 2.));
+            
+            if (!renderViewerCoarsePass(view, singleThreaded, roi, requestedComponents, imageDepth, alphaChannelIndex, request, stats, inArgs)) {
+                if (inArgs.params->cachedFrame) {
+                    inArgs.params->cachedFrame->setAborted(true);
+                    appPTR->removeFromViewerCache(inArgs.params->cachedFrame);
+                    inArgs.params->cachedFrame.reset();
+                }
+                _imp->removeOngoingRender(inArgs.params->textureIndex, inArgs.params->renderAge);
+                
+                return eStatusReplyDefault;
+            }
+        }
     } else {
         /*
          Just render 1 tile
@@ -1388,7 +1528,11 @@ ViewerInstance::renderViewer_internal(int view,
     
     for (std::size_t rectIndex = 0; rectIndex < splitRoi.size(); ++rectIndex) {
         
-        bool reportProgress = false;
+        ///The progressive render already displays the coarse pass, so each refined tile replaces it as soon as it is ready
+        bool reportProgress = progressiveRenderPrefEnabled;
+
+        ///Time spent producing this tile of the texture, including the render of the upstream tree
+        TimeLapse tileRenderTimeRecorder;
 
         
         // If an exception occurs here it is probably fatal, since
@@ -1470,6 +1614,8 @@ ViewerInstance::renderViewer_internal(int view,
         
         assert(alphaChannelIndex < (int)image->getComponentsCount());
         
+        const bool useDisplayLut = canUseDisplayLut(inArgs);
+        
         //Make sure the viewer does not render something outside the bounds
         RectI viewerRenderRoI;
         splitRoi[rectIndex].intersect(image->getBounds(), &viewerRenderRoI);
@@ -1500,30 +1646,34 @@ ViewerInstance::renderViewer_internal(int view,
                 inArgs.params->offset = -vmin / ( vmax - vmin);
             }
             
+            const double gamma = inArgs.params->gamma == 0. ? 0. : 1. / inArgs.params->gamma;
+            const Natron::Color::Lut* colorSpace = lutFromColorspace(inArgs.params->lut);
+            DisplayLutPtr displayLut;
+            if (useDisplayLut) {
+                displayLut = _imp->getDisplayLut(inArgs.params->gain, gamma, inArgs.params->offset, colorSpace);
+            }
             const RenderViewerArgs args(image,
                                         inArgs.params->textureRect,
                                         inArgs.channels,
                                         inArgs.params->srcPremult,
                                         inArgs.key->getBitDepth(),
                                         inArgs.params->gain,
-                                        inArgs.params->gamma == 0. ? 0. : 1. / inArgs.params->gamma,
+                                        gamma,
                                         inArgs.params->offset,
                                         lutFromColorspace(srcColorSpace),
-                                        lutFromColorspace(inArgs.params->lut),
+                                        colorSpace,
+                                        _imp->getGammaLut(),
+                                        displayLut,
                                         alphaChannelIndex);
             
-            QMutexLocker k(&_imp->gammaLookupMutex);
             renderFunctor(viewerRenderRoI,
                           args,
-                          this,
                           inArgs.params->ramBuffer);
         } else {
             
-            bool runInCurrentThread = QThreadPool::globalInstance()->activeThreadCount() >= QThreadPool::globalInstance()->maxThreadCount();
+            ///When the viewer renders tile by tile, the tiles are small enough to be converted in one go
+            bool runInCurrentThread = splitRoi.size() > 1;
             std::vector<RectI> splitRects;
-            if (!runInCurrentThread && splitRoi.size() > 1) {
-                runInCurrentThread = true;
-            }
             if (!runInCurrentThread) {
                 splitRects = viewerRenderRoI.splitIntoSmallerRects(appPTR->getHardwareIdealThreadCount());
             }
@@ -1531,32 +1681,9 @@ ViewerInstance::renderViewer_internal(int view,
             ///if autoContrast is enabled, find out the vmin/vmax before rendering and mapping against new values
             if (inArgs.autoContrast) {
                 
-                double vmin = std::numeric_limits<double>::infinity();
-                double vmax = -std::numeric_limits<double>::infinity();
-                
-                if (!runInCurrentThread) {
-                    
-                    QFuture<std::pair<double,double> > future = QtConcurrent::mapped( splitRects,
-                                                                                     boost::bind(findAutoContrastVminVmax,
-                                                                                                 image,
-                                                                                                 inArgs.channels,
-                                                                                                 _1) );
-                    future.waitForFinished();
-                    
-                    std::pair<double,double> vMinMax;
-                    Q_FOREACH ( vMinMax, future.results() ) {
-                        if (vMinMax.first < vmin) {
-                            vmin = vMinMax.first;
-                        }
-                        if (vMinMax.second > vmax) {
-                            vmax = vMinMax.second;
-                        }
-                    }
-                } else { //!runInCurrentThread
-                    std::pair<double,double> vMinMax = findAutoContrastVminVmax(image, inArgs.channels, viewerRenderRoI);
-                    vmin = vMinMax.first;
-                    vmax = vMinMax.second;
-                }
+                std::pair<double,double> vMinMax = findAutoContrastVminVmax(image, inArgs.channels, viewerRenderRoI);
+                double vmin = vMinMax.first;
+                double vmax = vMinMax.second;
                 
                 if (vmax == vmin) {
                     vmin = vmax - 1.;
@@ -1571,29 +1698,40 @@ ViewerInstance::renderViewer_internal(int view,
                 }
             }
             
+            const double gamma = inArgs.params->gamma == 0. ? 0. : 1. / inArgs.params->gamma;
+            const Natron::Color::Lut* colorSpace = lutFromColorspace(inArgs.params->lut);
+            DisplayLutPtr displayLut;
+            if (useDisplayLut) {
+                displayLut = _imp->getDisplayLut(inArgs.params->gain, gamma, inArgs.params->offset, colorSpace);
+            }
             const RenderViewerArgs args(image,
                                         inArgs.params->textureRect,
                                         inArgs.channels,
                                         inArgs.params->srcPremult,
                                         inArgs.key->getBitDepth(),
                                         inArgs.params->gain,
-                                        inArgs.params->gamma == 0. ? 0. : 1. / inArgs.params->gamma,
+                                        gamma,
                                         inArgs.params->offset,
                                         lutFromColorspace(srcColorSpace),
-                                        lutFromColorspace(inArgs.params->lut),
+                                        colorSpace,
+                                        _imp->getGammaLut(),
+                                        displayLut,
                                         alphaChannelIndex);
             if (runInCurrentThread) {
-                QMutexLocker k(&_imp->gammaLookupMutex);
                 renderFunctor(viewerRenderRoI,
-                              args, this, inArgs.params->ramBuffer);
+                              args, inArgs.params->ramBuffer);
             } else {
-                QMutexLocker k(&_imp->gammaLookupMutex);
-                QtConcurrent::map( splitRects,
-                                  boost::bind(&renderFunctor,
-                                              _1,
-                                              args,
-                                              this,
-                                              inArgs.params->ramBuffer) ).waitForFinished();
+                RenderTaskTimings timings;
+                forEachInRenderScheduler(splitRects.begin(),
+                                         splitRects.end(),
+                                         boost::bind(&renderFunctor,
+                                                     _1,
+                                                     args,
+                                                     inArgs.params->ramBuffer),
+                                         &timings);
+                if ( stats && stats->isInDepthProfilingEnabled() ) {
+                    stats->addTasksInfosForNode(getNode(), timings);
+                }
             }
             
             if (splitRoi.size() > 1 && rectIndex < (splitRoi.size() -1)) {
@@ -1606,6 +1744,7 @@ ViewerInstance::renderViewer_internal(int view,
         } // if (singleThreaded)
         if (inArgs.params->cachedFrame && image) {
             inArgs.params->cachedFrame->addOriginalTile(image);
+            inArgs.params->cachedFrame->addRenderCost( tileRenderTimeRecorder.getTimeSinceCreation() );
         }
         
         if (stats && stats->isInDepthProfilingEnabled()) {
@@ -1632,6 +1771,131 @@ ViewerInstance::renderViewer_internal(int view,
     return eStatusOK;
 } // renderViewer_internal
 
+bool
+ViewerInstance::renderViewerCoarsePass(int view,
+                                       bool singleThreaded,
+                                       const RectI& roi,
+                                       const std::list<Natron::ImageComponents>& requestedComponents,
+                                       Natron::ImageBitDepthEnum imageDepth,
+                                       int alphaChannelIndex,
+                                       const boost::shared_ptr<RequestedFrame>& request,
+                                       const boost::shared_ptr<RenderStats>& stats,
+                                       ViewerArgs& inArgs)
+{
+    const unsigned int levels = NATRON_VIEWER_PROGRESSIVE_COARSE_LEVELS;
+    const unsigned int coarseLevel = inArgs.params->mipMapLevel + levels;
+    
+    RectI coarseBounds;
+    inArgs.params->rod.toPixelEnclosing(coarseLevel, inArgs.params->textureRect.par, &coarseBounds);
+    RectI coarseRoi = roi.downscalePowerOfTwoSmallestEnclosing(levels);
+    if (!coarseRoi.intersect(coarseBounds, &coarseRoi)) {
+        return true;
+    }
+    
+    RenderScale scale;
+    scale.x = scale.y = Natron::Image::getScaleFromMipMapLevel(coarseLevel);
+    
+    ImagePtr coarseImage;
+    {
+        ImageList planes;
+        EffectInstance::RenderRoIRetCode retCode =
+        inArgs.activeInputToRender->renderRoI(EffectInstance::RenderRoIArgs(inArgs.params->time,
+                                                                            scale,
+                                                                            coarseLevel,
+                                                                            view,
+                                                                            inArgs.forceRender,
+                                                                            coarseRoi,
+                                                                            inArgs.params->rod,
+                                                                            requestedComponents,
+                                                                            imageDepth, false, this),&planes);
+        if (retCode == EffectInstance::eRenderRoIRetCodeAborted) {
+            return false;
+        }
+        if (retCode != EffectInstance::eRenderRoIRetCodeOk || planes.empty()) {
+            ///Let the refinement pass handle the failure
+            return true;
+        }
+        coarseImage = planes.front();
+    }
+    
+    if (!_imp->checkAgeNoUpdate(inArgs.params->textureIndex,inArgs.params->renderAge)) {
+        return false;
+    }
+    
+    if (!coarseRoi.intersect(coarseImage->getBounds(), &coarseRoi)) {
+        return true;
+    }
+    
+    ///Upscale the coarse image to the level of the texture, the image returned by renderRoI may be larger than the roi
+    Natron::Image coarseTile(coarseImage->getComponents(), coarseImage->getRoD(), coarseRoi, coarseLevel,
+                             coarseImage->getPixelAspectRatio(), coarseImage->getBitDepth());
+    coarseTile.pasteFrom(*coarseImage, coarseRoi, false);
+    
+    boost::shared_ptr<Natron::Image> upscaledImage(new Natron::Image(coarseImage->getComponents(), coarseImage->getRoD(),
+                                                                     coarseRoi.upscalePowerOfTwo(levels), inArgs.params->mipMapLevel,
+                                                                     coarseImage->getPixelAspectRatio(), coarseImage->getBitDepth()));
+    coarseTile.upscaleMipMap(coarseRoi, coarseLevel, inArgs.params->mipMapLevel, upscaledImage.get());
+    
+    RectI viewerRenderRoI;
+    if (!roi.intersect(upscaledImage->getBounds(), &viewerRenderRoI)) {
+        return true;
+    }
+    
+    if (inArgs.autoContrast) {
+        std::pair<double,double> vMinMax = findAutoContrastVminVmax(upscaledImage, inArgs.channels, viewerRenderRoI);
+        double vmin = vMinMax.first;
+        double vmax = vMinMax.second;
+        
+        if (vmax == vmin) {
+            vmin = vmax - 1.;
+        }
+        inArgs.params->gain = 1 / (vmax - vmin);
+        inArgs.params->offset =  -vmin / (vmax - vmin);
+    }
+    
+    const bool useDisplayLut = canUseDisplayLut(inArgs);
+    const double gamma = inArgs.params->gamma == 0. ? 0. : 1. / inArgs.params->gamma;
+    const Natron::Color::Lut* colorSpace = lutFromColorspace(inArgs.params->lut);
+    DisplayLutPtr displayLut;
+    if (useDisplayLut) {
+        displayLut = _imp->getDisplayLut(inArgs.params->gain, gamma, inArgs.params->offset, colorSpace);
+    }
+    const RenderViewerArgs args(upscaledImage,
+                                inArgs.params->textureRect,
+                                inArgs.channels,
+                                inArgs.params->srcPremult,
+                                inArgs.key->getBitDepth(),
+                                inArgs.params->gain,
+                                gamma,
+                                inArgs.params->offset,
+                                lutFromColorspace(getApp()->getDefaultColorSpaceForBitDepth( upscaledImage->getBitDepth() )),
+                                colorSpace,
+                                _imp->getGammaLut(),
+                                displayLut,
+                                alphaChannelIndex);
+    if (singleThreaded) {
+        renderFunctor(viewerRenderRoI, args, inArgs.params->ramBuffer);
+    } else {
+        std::vector<RectI> splitRects = viewerRenderRoI.splitIntoSmallerRects(appPTR->getHardwareIdealThreadCount());
+        forEachInRenderScheduler(splitRects.begin(),
+                                 splitRects.end(),
+                                 boost::bind(&renderFunctor,
+                                             _1,
+                                             args,
+                                             inArgs.params->ramBuffer));
+    }
+    
+    if (!_imp->checkAgeNoUpdate(inArgs.params->textureIndex,inArgs.params->renderAge)) {
+        return false;
+    }
+    
+    std::list<RectI> rectangles;
+    rectangles.push_back(viewerRenderRoI);
+    _imp->reportProgress(inArgs.params, rectangles, stats, request);
+    
+    return true;
+} // renderViewerCoarsePass
+
 void
 ViewerInstance::ViewerInstancePrivate::reportProgress(const boost::shared_ptr<UpdateViewerParams>& originalParams,
                                                       const std::list<RectI>& rectangles,
@@ -1691,7 +1955,6 @@ ViewerInstance::updateViewer(boost::shared_ptr<UpdateViewerParams> & frame)
 void
 renderFunctor(const RectI& roi,
               const RenderViewerArgs & args,
-              ViewerInstance* viewer,
               void *buffer)
 {
     assert(args.texRect.y1 <= roi.y1 && roi.y1 <= roi.y2 && roi.y2 <= args.texRect.y2);
@@ -1701,144 +1964,173 @@ renderFunctor(const RectI& roi,
         scaleToTexture32bits(roi, args, (float*)buffer);
     } else {
         // texture is stored as sRGB/Rec709 compressed 8-bit RGBA
-        scaleToTexture8bits(roi, args,viewer, (U32*)buffer);
+        scaleToTexture8bits(roi, args, (U32*)buffer);
     }
 }
 
-inline
 std::pair<double, double>
-findAutoContrastVminVmax_generic(boost::shared_ptr<const Natron::Image> inputImage,
-                                 int nComps,
-                                 Natron::DisplayChannelsEnum channels,
-                                 const RectI & rect)
+findAutoContrastVminVmax(boost::shared_ptr<const Natron::Image> inputImage,
+                         Natron::DisplayChannelsEnum channels,
+                         const RectI & rect)
 {
-    double localVmin = std::numeric_limits<double>::infinity();
-    double localVmax = -std::numeric_limits<double>::infinity();
-    
-    Natron::Image::ReadAccess acc = inputImage->getReadRights();
+    ///The statistics are cached with the image, so that they are computed once for all the renders of the same image
+    boost::shared_ptr<const ImageStatistics> statistics = inputImage->getStatistics(channels, rect);
     
-    for (int y = rect.bottom(); y < rect.top(); ++y) {
-        const float* src_pixels = (const float*)acc.pixelAt(rect.left(),y);
-        ///we fill the scan-line with all the pixels of the input image
-        for (int x = rect.left(); x < rect.right(); ++x) {
-            
-            double r = 0.;
-            double g = 0.;
-            double b = 0.;
-            double a = 0.;
-            switch (nComps) {
-                case 4:
-                    r = src_pixels[0];
-                    g = src_pixels[1];
-                    b = src_pixels[2];
-                    a = src_pixels[3];
-                    break;
-                case 3:
-                    r = src_pixels[0];
-                    g = src_pixels[1];
-                    b = src_pixels[2];
-                    a = 1.;
-                    break;
-                case 2:
-                    r = src_pixels[0];
-                    g = src_pixels[1];
-                    b = 0.;
-                    a = 1.;
-                    break;
-                case 1:
-                    a = src_pixels[0];
-                    r = g = b = 0.;
-                    break;
-                default:
-                    r = g = b = a = 0.;
-            }
-            
-            double mini, maxi;
-            switch (channels) {
-                case Natron::eDisplayChannelsRGB:
-                    mini = std::min(std::min(r,g),b);
-                    maxi = std::max(std::max(r,g),b);
-                    break;
-                case Natron::eDisplayChannelsY:
-                    mini = r = 0.299 * r + 0.587 * g + 0.114 * b;
-                    maxi = mini;
-                    break;
-                case Natron::eDisplayChannelsR:
-                    mini = r;
-                    maxi = mini;
-                    break;
-                case Natron::eDisplayChannelsG:
-                    mini = g;
-                    maxi = mini;
-                    break;
-                case Natron::eDisplayChannelsB:
-                    mini = b;
-                    maxi = mini;
-                    break;
-                case Natron::eDisplayChannelsA:
-                    mini = a;
-                    maxi = mini;
-                    break;
-                default:
-                    mini = 0.;
-                    maxi = 0.;
-                    break;
-            }
-            if (mini < localVmin) {
-                localVmin = mini;
-            }
-            if (maxi > localVmax) {
-                localVmax = maxi;
-            }
-            
-            src_pixels += nComps;
+    return std::make_pair( statistics->getPercentile(NATRON_VIEWER_AUTOCONTRAST_LOW_PERCENTILE),
+                           statistics->getPercentile(NATRON_VIEWER_AUTOCONTRAST_HIGH_PERCENTILE) );
+} // findAutoContrastVminVmax
+
+///Reads a color component of a source pixel as a linear float
+template <typename PIX>
+inline float
+toLinearFloat(PIX pix,
+              const Natron::Color::Lut* srcColorSpace)
+{
+    ///half and float pixels
+    float v = pix;
+
+    return srcColorSpace ? srcColorSpace->fromColorSpaceFloatToLinearFloat(v) : v;
+}
+
+template <>
+inline float
+toLinearFloat(unsigned char pix,
+              const Natron::Color::Lut* srcColorSpace)
+{
+    return srcColorSpace ? srcColorSpace->fromColorSpaceUint8ToLinearFloatFast(pix) : convertPixelDepth<unsigned char, float>(pix);
+}
+
+template <>
+inline float
+toLinearFloat(unsigned short pix,
+              const Natron::Color::Lut* srcColorSpace)
+{
+    return srcColorSpace ? srcColorSpace->fromColorSpaceUint16ToLinearFloatFast(pix) : convertPixelDepth<unsigned short, float>(pix);
+}
+
+/**
+ * @brief Converts width pixels of the source image to linear RGBA float pixels made of the channels to display.
+ * If src_pixels is NULL the pixels are black and transparent.
+ **/
+template <typename PIX,bool opaque,int rOffset,int gOffset,int bOffset>
+void
+unpackViewerRow(const PIX* src_pixels,
+                int nComps,
+                int width,
+                const Natron::Color::Lut* srcColorSpace,
+                float* dst)
+{
+    if (!src_pixels) {
+        std::fill(dst, dst + width * 4, 0.f);
+
+        return;
+    }
+    for (int x = 0; x < width; ++x, src_pixels += nComps, dst += 4) {
+        // coverity[dead_error_line]
+        dst[0] = rOffset < nComps ? toLinearFloat(src_pixels[rOffset], srcColorSpace) : 0.f;
+        if (nComps == 1) {
+            dst[1] = dst[2] = dst[0];
+        } else {
+            // coverity[dead_error_line]
+            dst[1] = gOffset < nComps ? toLinearFloat(src_pixels[gOffset], srcColorSpace) : 0.f;
+            // coverity[dead_error_line]
+            dst[2] = (nComps >= 3 && bOffset < nComps) ? toLinearFloat(src_pixels[bOffset], srcColorSpace) : 0.f;
         }
+        dst[3] = (nComps >= 4 && !opaque) ? convertPixelDepth<PIX, float>(src_pixels[3]) : 1.f;
     }
-    
-    return std::make_pair(localVmin, localVmax);
 }
 
-template <int nComps>
-std::pair<double, double>
-findAutoContrastVminVmax_internal(boost::shared_ptr<const Natron::Image> inputImage,
-                                  Natron::DisplayChannelsEnum channels,
-                                  const RectI & rect)
+static void
+gainOffsetPixels(float* pixels,
+                 int count,
+                 float gain,
+                 float offset)
 {
-    return findAutoContrastVminVmax_generic(inputImage, nComps, channels, rect);
+    if ( Natron::kernelsEnabled() ) {
+        Natron::gainOffsetPixelsKernel(pixels, count, gain, offset);
+
+        return;
+    }
+    for (int x = 0; x < count; ++x, pixels += 4) {
+        pixels[0] = pixels[0] * gain + offset;
+        pixels[1] = pixels[1] * gain + offset;
+        pixels[2] = pixels[2] * gain + offset;
+    }
 }
 
-std::pair<double, double>
-findAutoContrastVminVmax(boost::shared_ptr<const Natron::Image> inputImage,
-                         Natron::DisplayChannelsEnum channels,
-                         const RectI & rect)
+static void
+luminancePixels(float* pixels,
+                int count)
 {
-    int nComps = inputImage->getComponents().getNumComponents();
-    if (nComps == 4) {
-        return findAutoContrastVminVmax_internal<4>(inputImage, channels, rect);
-    } else if (nComps == 3) {
-        return findAutoContrastVminVmax_internal<3>(inputImage, channels, rect);
-    } else if (nComps == 1) {
-        return findAutoContrastVminVmax_internal<1>(inputImage, channels, rect);
-    } else {
-        return findAutoContrastVminVmax_generic(inputImage, nComps, channels, rect);
+    if ( Natron::kernelsEnabled() ) {
+        Natron::luminancePixelsKernel(pixels, count);
+
+        return;
     }
-    
-} // findAutoContrastVminVmax
+    for (int x = 0; x < count; ++x, pixels += 4) {
+        pixels[0] = pixels[1] = pixels[2] = 0.299f * pixels[0] + 0.587f * pixels[1] + 0.114f * pixels[2];
+    }
+}
+
+static void
+clampPixels(float* pixels,
+            int count)
+{
+    if ( Natron::kernelsEnabled() ) {
+        Natron::clampPixelsKernel(pixels, count);
+
+        return;
+    }
+    for (int i = 0; i < count * 4; ++i) {
+        pixels[i] = Natron::clamp(pixels[i], 0.f, 1.f);
+    }
+}
+
+static void
+pixelsToBGRA8(const float* pixels,
+              U32* dst,
+              int count)
+{
+    if ( Natron::kernelsEnabled() ) {
+        Natron::pixelsToBGRA8Kernel(pixels, dst, count);
+
+        return;
+    }
+    for (int x = 0; x < count; ++x, pixels += 4) {
+        dst[x] = toBGRA(Color::floatToInt<256>(pixels[0]),
+                        Color::floatToInt<256>(pixels[1]),
+                        Color::floatToInt<256>(pixels[2]),
+                        Color::floatToInt<256>(pixels[3]));
+    }
+}
+
+/**
+ * @brief Returns the column where the error diffusion of the row y starts. It only depends on the row, so that
+ * the texture does not depend on the threads rendering it, and unlike rand() it does not take any lock.
+ **/
+static int
+ditherRowStart(int y,
+               int width)
+{
+    U32 h = (U32)y * 2654435761U;
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+
+    return (int)(h % (U32)width);
+}
 
 template <typename PIX,int maxValue,bool opaque,int rOffset,int gOffset,int bOffset>
 void
 scaleToTexture8bits_generic(const RectI& roi,
                             const RenderViewerArgs & args,
                             int nComps,
-                            ViewerInstance* viewer,
                             U32* output)
 {
-    size_t pixelSize = sizeof(PIX);
-    
     const bool luminance = (args.channels == Natron::eDisplayChannelsY);
     
     Natron::Image::ReadAccess acc = Natron::Image::ReadAccess(args.inputImage.get());
-    const RectI srcImgBounds = args.inputImage->getBounds();
     
     ///offset the output buffer at the starting point
     U32* dst_pixels = output + (roi.y1 - args.texRect.y1) * args.texRect.w + (roi.x1 - args.texRect.x1);
@@ -1848,152 +2140,91 @@ scaleToTexture8bits_generic(const RectI& roi,
     
     const PIX* src_pixels = (const PIX*)acc.pixelAt(roi.x1, roi.y1);
     const int srcRowElements = (int)args.inputImage->getRowElements();
+    const int width = roi.x2 - roi.x1;
+    
+    ///gain, offset, gamma and colorspace in a single lookup per channel
+    const DisplayLut* displayLut = args.displayLut.get();
+    assert( !displayLut || !luminance );
+    
+    //args.gamma is in fact 1. / gamma at this point
+    const std::vector<float>* gammaLookup = (displayLut || args.gamma == 0. || args.gamma == 1.) ? 0 : args.gammaLookup.get();
+    assert( displayLut || args.gamma == 0. || args.gamma == 1. || (gammaLookup && gammaLookup->size() == GAMMA_LUT_NB_VALUES + 1) );
+
+    ///The current row, in linear RGBA float
+    std::vector<float> row(width * 4);
     
     for (int y = roi.y1; y < roi.y2;
          ++y,
          dst_pixels += args.texRect.w) {
         
-        // coverity[dont_call]
-        int start = (int)(rand() % (roi.x2 - roi.x1));
+        float* pixels = &row[0];
+        unpackViewerRow<PIX, opaque, rOffset, gOffset, bOffset>(src_pixels, nComps, width, args.srcColorSpace, pixels);
         
-
-        for (int backward = 0; backward < 2; ++backward) {
-            
-            int index = backward ? start - 1 : start;
-            
-            assert( backward == 1 || ( index >= 0 && index < (args.texRect.x2 - args.texRect.x1) ) );
-
-            unsigned error_r = 0x80;
-            unsigned error_g = 0x80;
-            unsigned error_b = 0x80;
-            
-            while (index < (roi.x2 - roi.x1) && index >= 0) {
-                
-                double r = 0.;
-                double g = 0.;
-                double b = 0.;
-                int a = 0;
-
-                if (nComps >= 4) {
-                    r = (src_pixels ? src_pixels[index * nComps + rOffset] : 0.);
-                    g = (src_pixels ? src_pixels[index * nComps + gOffset] : 0.);
-                    b = (src_pixels ? src_pixels[index * nComps + bOffset] : 0.);
-                    if (opaque) {
-                        a = 255;
-                    } else {
-                        a = (src_pixels ? Color::floatToInt<256>(src_pixels[index * nComps + 3]) : 0);
-                    }
-                } else if (nComps == 3) {
-                    // coverity[dead_error_line]
-                    r = (src_pixels && rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
-                    // coverity[dead_error_line]
-                    g = (src_pixels && gOffset < nComps) ? src_pixels[index * nComps + gOffset] : 0.;
-                    // coverity[dead_error_line]
-                    b = (src_pixels && bOffset < nComps) ? src_pixels[index * nComps + bOffset] : 0.;
-                    a = (src_pixels ? 255 : 0);
-                } else if (nComps == 2) {
-                    // coverity[dead_error_line]
-                    r = (src_pixels && rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
-                    // coverity[dead_error_line]
-                    g = (src_pixels && gOffset < nComps) ? src_pixels[index * nComps + gOffset] : 0.;
-                    b = 0;
-                    a = (src_pixels ? 255 : 0);
-                } else if (nComps == 1) {
-                    // coverity[dead_error_line]
-                    r = (src_pixels && rOffset < nComps) ? src_pixels[index * nComps + rOffset] : 0.;
-                    g = b = r;
-                    a = src_pixels ? 255 : 0;
-                } else {
-                    assert(false);
+        if (!displayLut) {
+            if (args.gamma == 0) {
+                for (int x = 0; x < width; ++x) {
+                    pixels[x * 4] = pixels[x * 4 + 1] = pixels[x * 4 + 2] = 0.f;
                 }
-
-
-                
-                switch ( pixelSize ) {
-                    case sizeof(unsigned char): //byte
-                        if (args.srcColorSpace) {
-                            r = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)r );
-                            g = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)g );
-                            b = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)b );
-                        } else {
-                            r = (double)convertPixelDepth<unsigned char, float>( (unsigned char)r );
-                            g = (double)convertPixelDepth<unsigned char, float>( (unsigned char)g );
-                            b = (double)convertPixelDepth<unsigned char, float>( (unsigned char)b );
-                        }
-                        break;
-                    case sizeof(unsigned short): //short
-                        if (args.srcColorSpace) {
-                            r = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)r );
-                            g = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)g );
-                            b = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)b );
-                        } else {
-                            r = (double)convertPixelDepth<unsigned short, float>( (unsigned char)r );
-                            g = (double)convertPixelDepth<unsigned short, float>( (unsigned char)g );
-                            b = (double)convertPixelDepth<unsigned short, float>( (unsigned char)b );
-                        }
-                        break;
-                    case sizeof(float): //float
-                        if (args.srcColorSpace) {
-                            r = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(r);
-                            g = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(g);
-                            b = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(b);
+            } else {
+                gainOffsetPixels(pixels, width, args.gain, args.offset);
+                if (gammaLookup) {
+                    for (int x = 0; x < width; ++x) {
+                        for (int k = 0; k < 3; ++k) {
+                            pixels[x * 4 + k] = lookupGammaLut(*gammaLookup, pixels[x * 4 + k]);
                         }
-                        break;
-                    default:
-                        break;
-                }
-                
-                //args.gamma is in fact 1. / gamma at this point
-                if  (args.gamma == 0) {
-                    r = 0;
-                    g = 0.;
-                    b = 0.;
-                } else if (args.gamma == 1.) {
-                    r = r * args.gain + args.offset;
-                    g = g * args.gain + args.offset;
-                    b = b * args.gain + args.offset;
-                } else {
-                    r = viewer->interpolateGammaLut(r * args.gain + args.offset);
-                    g = viewer->interpolateGammaLut(g * args.gain + args.offset);
-                    b = viewer->interpolateGammaLut(b * args.gain + args.offset);
+                    }
                 }
+            }
+            
+            if (luminance) {
+                luminancePixels(pixels, width);
+            }
+        }
         
+        if (!displayLut && !args.colorSpace) {
+            pixelsToBGRA8(pixels, dst_pixels, width);
+        } else {
+            int start = ditherRowStart(y, width);
+            
+            for (int backward = 0; backward < 2; ++backward) {
                 
-                if (luminance) {
-                    r = 0.299 * r + 0.587 * g + 0.114 * b;
-                    g = r;
-                    b = r;
-                }
+                int index = backward ? start - 1 : start;
                 
-                if (!args.colorSpace) {
-                    dst_pixels[index] = toBGRA(Color::floatToInt<256>(r),
-                                               Color::floatToInt<256>(g),
-                                               Color::floatToInt<256>(b),
-                                               a);
-                } else {
-                    error_r = (error_r & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(r);
-                    error_g = (error_g & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(g);
-                    error_b = (error_b & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(b);
+                unsigned error_r = 0x80;
+                unsigned error_g = 0x80;
+                unsigned error_b = 0x80;
+                
+                while (index < width && index >= 0) {
+                    const float* pixel = pixels + index * 4;
+                    
+                    if (displayLut) {
+                        error_r = (error_r & 0xff) + displayLut->lookup(pixel[0]);
+                        error_g = (error_g & 0xff) + displayLut->lookup(pixel[1]);
+                        error_b = (error_b & 0xff) + displayLut->lookup(pixel[2]);
+                    } else {
+                        error_r = (error_r & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(pixel[0]);
+                        error_g = (error_g & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(pixel[1]);
+                        error_b = (error_b & 0xff) + args.colorSpace->toColorSpaceUint8xxFromLinearFloatFast(pixel[2]);
+                    }
                     assert(error_r < 0x10000 && error_g < 0x10000 && error_b < 0x10000);
                     dst_pixels[index] = toBGRA((U8)(error_r >> 8),
                                                (U8)(error_g >> 8),
                                                (U8)(error_b >> 8),
-                                               a);
-                }
-                
-                if (backward) {
-                    --index;
-                } else {
-                    ++index;
-                }
+                                               Color::floatToInt<256>(pixel[3]));
+                    
+                    if (backward) {
+                        --index;
+                    } else {
+                        ++index;
+                    }
+                } // while (index < width && index >= 0) {
                 
-            } // while (index < args.texRect.w && index >= 0) {
-            
-        } // for (int backward = 0; backward < 2; ++backward) {
+            } // for (int backward = 0; backward < 2; ++backward) {
+        }
         if (src_pixels) {
             src_pixels += srcRowElements;
         }
-    } // for (int y = yRange.first; y < yRange.second;
+    } // for (int y = roi.y1; y < roi.y2;
 } // scaleToTexture8bits_generic
 
 
@@ -2001,35 +2232,33 @@ template <typename PIX,int maxValue,int nComps,bool opaque,int rOffset,int gOffs
 void
 scaleToTexture8bits_internal(const RectI& roi,
                              const RenderViewerArgs & args,
-                             ViewerInstance* viewer,
                              U32* output)
 {
-    scaleToTexture8bits_generic<PIX, maxValue, opaque, rOffset, gOffset, bOffset>(roi, args, nComps, viewer, output);
+    scaleToTexture8bits_generic<PIX, maxValue, opaque, rOffset, gOffset, bOffset>(roi, args, nComps, output);
 }
 
 template <typename PIX,int maxValue, bool opaque, int rOffset, int gOffset, int bOffset>
 void
 scaleToTexture8bitsForDepthForComponents(const RectI& roi,
                                          const RenderViewerArgs & args,
-                                         ViewerInstance* viewer,
                                          U32* output)
 {
     int nComps = args.inputImage->getComponents().getNumComponents();
     switch (nComps) {
         case 4:
-            scaleToTexture8bits_internal<PIX,maxValue,4 , opaque, rOffset,gOffset,bOffset>(roi,args,viewer,output);
+            scaleToTexture8bits_internal<PIX,maxValue,4 , opaque, rOffset,gOffset,bOffset>(roi,args,output);
             break;
         case 3:
-            scaleToTexture8bits_internal<PIX,maxValue,3, opaque, rOffset,gOffset,bOffset>(roi,args,viewer,output);
+            scaleToTexture8bits_internal<PIX,maxValue,3, opaque, rOffset,gOffset,bOffset>(roi,args,output);
             break;
         case 2:
-            scaleToTexture8bits_internal<PIX,maxValue,2, opaque, rOffset,gOffset,bOffset>(roi,args,viewer,output);
+            scaleToTexture8bits_internal<PIX,maxValue,2, opaque, rOffset,gOffset,bOffset>(roi,args,output);
             break;
         case 1:
-            scaleToTexture8bits_internal<PIX,maxValue,1, opaque, rOffset,gOffset,bOffset>(roi,args,viewer,output);
+            scaleToTexture8bits_internal<PIX,maxValue,1, opaque, rOffset,gOffset,bOffset>(roi,args,output);
             break;
         default:
-            scaleToTexture8bits_generic<PIX, maxValue, opaque, rOffset, gOffset, bOffset>(roi, args, nComps, viewer, output);
+            scaleToTexture8bits_generic<PIX, maxValue, opaque, rOffset, gOffset, bOffset>(roi, args, nComps, output);
             break;
     }
 }
@@ -2038,7 +2267,6 @@ template <typename PIX,int maxValue,bool opaque>
 void
 scaleToTexture8bitsForPremult(const RectI& roi,
                              const RenderViewerArgs & args,
-                             ViewerInstance* viewer,
                              U32* output)
 {
     
@@ -2046,39 +2274,39 @@ scaleToTexture8bitsForPremult(const RectI& roi,
         case Natron::eDisplayChannelsRGB:
         case Natron::eDisplayChannelsY:
             
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 1, 2>(roi, args,viewer, output);
+            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 1, 2>(roi, args, output);
             break;
         case Natron::eDisplayChannelsG:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 1, 1, 1>(roi, args,viewer, output);
+            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 1, 1, 1>(roi, args, output);
             break;
         case Natron::eDisplayChannelsB:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 2, 2, 2>(roi, args,viewer, output);
+            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 2, 2, 2>(roi, args, output);
             break;
         case Natron::eDisplayChannelsA:
             switch (args.alphaChannelIndex) {
                 case -1:
-                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args,viewer, output);
+                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args, output);
                     break;
                 case 0:
-                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 0, 0>(roi, args,viewer, output);
+                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 0, 0>(roi, args, output);
                     break;
                 case 1:
-                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 1, 1, 1>(roi, args,viewer, output);
+                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 1, 1, 1>(roi, args, output);
                     break;
                 case 2:
-                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 2, 2, 2>(roi, args,viewer, output);
+                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 2, 2, 2>(roi, args, output);
                     break;
                 case 3:
-                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args,viewer, output);
+                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args, output);
                     break;
                 default:
-                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args,viewer, output);
+                    scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 3, 3, 3>(roi, args, output);
             }
             
             break;
         case Natron::eDisplayChannelsR:
         default:
-            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 0, 0>(roi, args,viewer, output);
+            scaleToTexture8bitsForDepthForComponents<PIX, maxValue, opaque, 0, 0, 0>(roi, args, output);
             
             break;
     }
@@ -2091,17 +2319,16 @@ template <typename PIX,int maxValue>
 void
 scaleToTexture8bitsForDepth(const RectI& roi,
                             const RenderViewerArgs & args,
-                            ViewerInstance* viewer,
                             U32* output)
 {
     switch (args.srcPremult) {
         case Natron::eImagePremultiplicationOpaque:
-            scaleToTexture8bitsForPremult<PIX, maxValue, true>(roi, args,viewer, output);
+            scaleToTexture8bitsForPremult<PIX, maxValue, true>(roi, args, output);
             break;
         case Natron::eImagePremultiplicationPremultiplied:
         case Natron::eImagePremultiplicationUnPremultiplied:
         default:
-            scaleToTexture8bitsForPremult<PIX, maxValue, false>(roi, args,viewer, output);
+            scaleToTexture8bitsForPremult<PIX, maxValue, false>(roi, args, output);
             break;
             
     }
@@ -2110,34 +2337,27 @@ scaleToTexture8bitsForDepth(const RectI& roi,
 void
 scaleToTexture8bits(const RectI& roi,
                     const RenderViewerArgs & args,
-                    ViewerInstance* viewer,
                     U32* output)
 {
     assert(output);
     switch ( args.inputImage->getBitDepth() ) {
         case Natron::eImageBitDepthFloat:
-            scaleToTexture8bitsForDepth<float, 1>(roi, args,viewer, output);
+            scaleToTexture8bitsForDepth<float, 1>(roi, args, output);
             break;
         case Natron::eImageBitDepthByte:
-            scaleToTexture8bitsForDepth<unsigned char, 255>(roi, args,viewer, output);
+            scaleToTexture8bitsForDepth<unsigned char, 255>(roi, args, output);
             break;
         case Natron::eImageBitDepthShort:
-            scaleToTexture8bitsForDepth<unsigned short, 65535>(roi, args,viewer,output);
+            scaleToTexture8bitsForDepth<unsigned short, 65535>(roi, args, output);
             break;
         case Natron::eImageBitDepthHalf:
-            assert(false);
+            scaleToTexture8bitsForDepth<Half, 1>(roi, args, output);
             break;
         case Natron::eImageBitDepthNone:
             break;
     }
 } // scaleToTexture8bits
 
-float
-ViewerInstance::interpolateGammaLut(float value)
-{
-    return _imp->lookupGammaLut(value);
-}
-
 void
 ViewerInstance::markAllOnRendersAsAborted()
 {
@@ -2156,7 +2376,6 @@ scaleToTexture32bitsGeneric(const RectI& roi,
                             int nComps,
                             float *output)
 {
-    size_t pixelSize = sizeof(PIX);
     const bool luminance = (args.channels == Natron::eDisplayChannelsY);
 
     ///the width of the output buffer multiplied by the channels count
@@ -2166,104 +2385,24 @@ scaleToTexture32bitsGeneric(const RectI& roi,
     Natron::Image::ReadAccess acc = Natron::Image::ReadAccess(args.inputImage.get());
 
     float* dst_pixels =  output + (roi.y1 - args.texRect.y1) * dstRowElements + (roi.x1 - args.texRect.x1) * 4;
-    const float* src_pixels = (const float*)acc.pixelAt(roi.x1, roi.y1);
+    const PIX* src_pixels = (const PIX*)acc.pixelAt(roi.x1, roi.y1);
 
     assert(args.texRect.w == args.texRect.x2 - args.texRect.x1);
     
     const int srcRowElements = (const int)args.inputImage->getRowElements();
+    const int width = roi.width();
     
     for (int y = roi.y1; y < roi.y2;
          ++y,
          dst_pixels += dstRowElements) {
 
-        for (int x = 0; x < roi.width();
-             ++x) {
-            
-            double r = 0.;
-            double g = 0.;
-            double b = 0.;
-            double a = 0.;
-            
-            if (nComps >= 4) {
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
-                g = (src_pixels && gOffset < nComps) ? src_pixels[x * nComps + gOffset] : 0.;
-                b = (src_pixels && bOffset < nComps) ? src_pixels[x * nComps + bOffset] : 0.;
-                if (opaque) {
-                    a = 1.;
-                } else {
-                    a = src_pixels ? src_pixels[x * nComps + 3] : 0.;
-                }
-            } else if (nComps == 3) {
-                // coverity[dead_error_line]
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
-                // coverity[dead_error_line]
-                g = (src_pixels && gOffset < nComps) ? src_pixels[x * nComps + gOffset] : 0.;
-                // coverity[dead_error_line]
-                b = (src_pixels && bOffset < nComps) ? src_pixels[x * nComps + bOffset] : 0.;
-                a = 1.;
-            } else if (nComps == 2) {
-                // coverity[dead_error_line]
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
-                // coverity[dead_error_line]
-                g = (src_pixels && gOffset < nComps) ? src_pixels[x * nComps + gOffset] : 0.;
-                b = 0.;
-                a = 1.;
-            } else if (nComps == 1) {
-                // coverity[dead_error_line]
-                r = (src_pixels && rOffset < nComps) ? src_pixels[x * nComps + rOffset] : 0.;
-                g = b = r;
-                a = 1.;
-            } else {
-                assert(false);
-            }
-            
-            
-            switch ( pixelSize ) {
-            case sizeof(unsigned char):
-                if (args.srcColorSpace) {
-                    r = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)r );
-                    g = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)g );
-                    b = args.srcColorSpace->fromColorSpaceUint8ToLinearFloatFast( (unsigned char)b );
-                } else {
-                    r = (double)convertPixelDepth<unsigned char, float>( (unsigned char)r );
-                    g = (double)convertPixelDepth<unsigned char, float>( (unsigned char)g );
-                    b = (double)convertPixelDepth<unsigned char, float>( (unsigned char)b );
-                }
-                break;
-            case sizeof(unsigned short):
-                if (args.srcColorSpace) {
-                    r = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)r );
-                    g = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)g );
-                    b = args.srcColorSpace->fromColorSpaceUint16ToLinearFloatFast( (unsigned short)b );
-                } else {
-                    r = (double)convertPixelDepth<unsigned short, float>( (unsigned char)r );
-                    g = (double)convertPixelDepth<unsigned short, float>( (unsigned char)g );
-                    b = (double)convertPixelDepth<unsigned short, float>( (unsigned char)b );
-                }
-                break;
-            case sizeof(float):
-                if (args.srcColorSpace) {
-                    r = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(r);
-                    g = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(g);
-                    b = args.srcColorSpace->fromColorSpaceFloatToLinearFloat(b);
-                }
-                break;
-            default:
-                break;
-            }
-
-
-            if (luminance) {
-                r = 0.299 * r + 0.587 * g + 0.114 * b;
-                g = r;
-                b = r;
-            }
-            dst_pixels[x * 4] = Natron::clamp(r, 0., 1.);
-            dst_pixels[x * 4 + 1] = Natron::clamp(g, 0., 1.);
-            dst_pixels[x * 4 + 2] = Natron::clamp(b, 0., 1.);
-            dst_pixels[x * 4 + 3] = Natron::clamp(a, 0., 1.);
-
+        ///The texture is RGBA float: convert the row in place
+        unpackViewerRow<PIX, opaque, rOffset, gOffset, bOffset>(src_pixels, nComps, width, args.srcColorSpace, dst_pixels);
+        if (luminance) {
+            luminancePixels(dst_pixels, width);
         }
+        clampPixels(dst_pixels, width);
+
         if (src_pixels) {
             src_pixels += srcRowElements;
         }
@@ -2394,7 +2533,7 @@ scaleToTexture32bits(const RectI& roi,
             scaleToTexture32bitsForPremult<unsigned short, 65535>(roi, args, output);
             break;
         case Natron::eImageBitDepthHalf:
-            assert(false);
+            scaleToTexture32bitsForPremult<Half, 1>(roi, args, output);
             break;
         case Natron::eImageBitDepthNone:
             break;
@@ -244,8 +244,6 @@ public:
     
     struct ViewerInstancePrivate;
     
-    float interpolateGammaLut(float value);
-    
     void markAllOnRendersAsAborted();
     
     virtual void reportStats(int time, int view, double wallTime, const RenderStatsMap& stats) OVERRIDE FINAL;
@@ -370,6 +368,21 @@ private:
     bool isCurrentlyUpdatingOpenGLViewer() const;
 private:
     
+    /**
+     * @brief Renders the roi of the texture a few mipmap levels above the level of the texture, upscales it to the
+     * texture and displays it. Used by the progressive render before the tiles are refined.
+     * Returns false if the render was aborted or if a newer render was requested meanwhile.
+     **/
+    bool renderViewerCoarsePass(int view,
+                                bool singleThreaded,
+                                const RectI& roi,
+                                const std::list<Natron::ImageComponents>& requestedComponents,
+                                Natron::ImageBitDepthEnum imageDepth,
+                                int alphaChannelIndex,
+                                const boost::shared_ptr<RequestedFrame>& request,
+                                const boost::shared_ptr<RenderStats>& stats,
+                                ViewerArgs& inArgs);
+    
     boost::scoped_ptr<ViewerInstancePrivate> _imp;
 };
 
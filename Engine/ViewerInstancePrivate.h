@@ -27,12 +27,14 @@
 
 #include "ViewerInstance.h"
 
+#include <list>
 #include <map>
 #include <set>
 #include <vector>
 #include <cmath>
 #include <cassert>
 #include <algorithm> // min, max
+#include <cstring> // memcpy
 
 #include <QtCore/QMutex>
 #include <QtCore/QWaitCondition>
@@ -48,6 +50,74 @@
 
 #define GAMMA_LUT_NB_VALUES 1023
 
+///The gamma lookup table is never modified once built: a new one replaces it when the gamma changes, so that
+///the threads converting textures can use it without holding any lock.
+typedef boost::shared_ptr<const std::vector<float> > GammaLookupPtr;
+
+inline float
+lookupGammaLut(const std::vector<float>& gammaLookup,
+               float value)
+{
+    if (value < 0.) {
+        return 0.;
+    } else if (value > 1.) {
+        return 1.;
+    } else {
+        int i = (int)(value * GAMMA_LUT_NB_VALUES);
+        assert(0 <= i && i <= GAMMA_LUT_NB_VALUES);
+        float alpha = std::max(0.f,std::min(value * GAMMA_LUT_NB_VALUES - i, 1.f));
+        float a = gammaLookup[i];
+        float b = (i  < GAMMA_LUT_NB_VALUES) ? gammaLookup[i + 1] : 0.f;
+        return a * (1.f - alpha) + b * alpha;
+    }
+}
+
+/**
+ * @brief The display transform of the 8-bit textures (gain, offset, gamma and output colorspace) composed once
+ * into a 1D table. Like the tables of Natron::Color::Lut, it is indexed by the 16 high bits of the linear float
+ * value, and the 16 low bits are used to interpolate between two entries. The values are in [0 - 0xff00] like
+ * Lut::toColorSpaceUint8xxFromLinearFloatFast() so that they can be used for error diffusion.
+ * A table is never modified once built: it is shared by all the threads converting textures.
+ **/
+class DisplayLut
+{
+public:
+
+    ///gamma is in fact 1. / gamma, as in RenderViewerArgs. colorSpace may not be NULL: a linear output is not dithered
+    DisplayLut(double gain,
+               double gamma,
+               double offset,
+               const Natron::Color::Lut* colorSpace);
+
+    bool matches(double gain,
+                 double gamma,
+                 double offset,
+                 const Natron::Color::Lut* colorSpace) const
+    {
+        return _gain == gain && _gamma == gamma && _offset == offset && _colorSpace == colorSpace;
+    }
+
+    unsigned short lookup(float value) const
+    {
+        U32 bits;
+        memcpy(&bits, &value, sizeof(float));
+        float a = _table[bits >> 16];
+        float b = _table[(bits >> 16) + 1];
+
+        return (unsigned short)(a + (b - a) * ( (bits & 0xffff) * (1.f / 0x10000) ) + 0.5f);
+    }
+
+private:
+
+    double _gain;
+    double _gamma;
+    double _offset;
+    const Natron::Color::Lut* _colorSpace;
+    std::vector<unsigned short> _table; //< 0x10001 entries, the last one repeats the previous one
+};
+
+typedef boost::shared_ptr<const DisplayLut> DisplayLutPtr;
+
 namespace Natron {
 class FrameEntry;
 class FrameParams;
@@ -77,6 +147,8 @@ struct RenderViewerArgs
                      double offset_,
                      const Natron::Color::Lut* srcColorSpace_,
                      const Natron::Color::Lut* colorSpace_,
+                     const GammaLookupPtr& gammaLookup_,
+                     const DisplayLutPtr& displayLut_,
                      int alphaChannelIndex_)
     : inputImage(inputImage_)
     , texRect(texRect_)
@@ -88,6 +160,8 @@ struct RenderViewerArgs
     , offset(offset_)
     , srcColorSpace(srcColorSpace_)
     , colorSpace(colorSpace_)
+    , gammaLookup(gammaLookup_)
+    , displayLut(displayLut_)
     , alphaChannelIndex(alphaChannelIndex_)
     {
     }
@@ -102,6 +176,8 @@ struct RenderViewerArgs
     double offset;
     const Natron::Color::Lut* srcColorSpace;
     const Natron::Color::Lut* colorSpace;
+    GammaLookupPtr gammaLookup; //< snapshot of the gamma lookup table taken when the render started
+    DisplayLutPtr displayLut; //< if set, the 8-bit display transform of the render, and gain/gamma/offset/colorSpace are ignored
     int alphaChannelIndex;
 };
 
@@ -208,6 +284,8 @@ public:
     , activateInputChangedFromViewer(false)
     , gammaLookupMutex()
     , gammaLookup()
+    , displayLutsMutex()
+    , displayLuts()
     , lastRotoPaintTickParamsMutex()
     , lastRotoPaintTickParams()
     , currentlyUpdatingOpenGLViewerMutex()
@@ -374,33 +452,32 @@ public:
 
     
     void fillGammaLut(double gamma) {
-        gammaLookup.resize(GAMMA_LUT_NB_VALUES + 1);
+        boost::shared_ptr<std::vector<float> > lut( new std::vector<float>(GAMMA_LUT_NB_VALUES + 1) );
         for (int position = 0; position <= GAMMA_LUT_NB_VALUES; ++position) {
             
             double parametricPos = double(position) / GAMMA_LUT_NB_VALUES;
             double value = std::pow(parametricPos, gamma);
             // set that in the lut
-            gammaLookup[position] = (float)std::max(0.,std::min(1.,value));
+            (*lut)[position] = (float)std::max(0.,std::min(1.,value));
         }
+        ///Only the pointer swap is protected, renders holding the previous table keep using it
+        QMutexLocker k(&gammaLookupMutex);
+        gammaLookup = lut;
     }
     
-    float lookupGammaLut(float value) const
+    GammaLookupPtr getGammaLut() const
     {
-        if (value < 0.) {
-            return 0.;
-        } else if (value > 1.) {
-            return 1.;
-        } else {
-            int i = (int)(value * GAMMA_LUT_NB_VALUES);
-            assert(0 <= i && i <= GAMMA_LUT_NB_VALUES);
-            float alpha = std::max(0.f,std::min(value * GAMMA_LUT_NB_VALUES - i, 1.f));
-            float a = gammaLookup[i];
-            float b = (i  < GAMMA_LUT_NB_VALUES) ? gammaLookup[i + 1] : 0.f;
-            return a * (1.f - alpha) + b * alpha;
-        }
-
+        QMutexLocker k(&gammaLookupMutex);
+        return gammaLookup;
     }
     
+    /**
+     * @brief Returns the display transform for the given parameters (gamma is 1. / gamma), built the first time
+     * they are used. The most recently used tables are kept so that the A/B inputs do not rebuild them on each frame.
+     * Auto-contrast does not use the tables since its gain and offset change with each frame.
+     **/
+    DisplayLutPtr getDisplayLut(double gain, double gamma, double offset, const Natron::Color::Lut* colorSpace);
+    
     void reportProgress(const boost::shared_ptr<UpdateViewerParams>& originalParams,
                         const std::list<RectI>& rectangles,
                         const boost::shared_ptr<RenderStats>& stats,
@@ -455,8 +532,11 @@ public:
     QWaitCondition textureBeingRenderedCond;
     std::list<boost::shared_ptr<Natron::FrameEntry> > textureBeingRendered; ///< a list of all the texture being rendered simultaneously
     
-    mutable QMutex gammaLookupMutex;
-    std::vector<float> gammaLookup; // protected by gammaLookupMutex
+    mutable QMutex gammaLookupMutex; // protects the gammaLookup pointer only, the table itself is immutable
+    GammaLookupPtr gammaLookup;
+    
+    mutable QMutex displayLutsMutex; // protects displayLuts
+    std::list<DisplayLutPtr> displayLuts; //< most recently used first
     
     //When painting, this is the last texture we've drawn onto so that we can update only the specific portion needed
     mutable QMutex lastRotoPaintTickParamsMutex;
@@ -422,6 +422,12 @@ enum StorageModeEnum
     eStorageModeDisk //< will be allocated on virtual memory using mmap(). Fall-back on disk is assured by the operating system
 };
 
+enum CacheEvictionPolicyEnum
+{
+    eCacheEvictionPolicyLRU = 0, //< the least recently used entry is evicted first
+    eCacheEvictionPolicyGreedyDualSize //< entries that were cheap to render relatively to their size are evicted first (GreedyDual-Size)
+};
+
 enum OrientationEnum
 {
     eOrientationHorizontal = 0x1,
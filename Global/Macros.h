@@ -74,6 +74,26 @@
 
 #define NATRON_PROJECT_ENV_VAR_MAX_RECURSION 100
 #define NATRON_MAX_CACHE_FILES_OPENED 20000
+///Size in bytes of the files the disk caches are packed into
+#define NATRON_CACHE_PACK_FILE_SIZE 268435456
+///Granularity in bytes of the allocations inside a cache pack file
+#define NATRON_CACHE_PACK_ALIGNMENT 4096
+///Fraction of the in-memory portion of a cache that can be used to keep evicted entries compressed in RAM
+#define NATRON_CACHE_COMPRESSED_PORTION 0.5
+///Evicted entries are only kept compressed if their size is at most this fraction of their original size
+#define NATRON_CACHE_COMPRESSION_MAX_RATIO 0.8
+///The caches are filled in the background when idle until they reach this fraction of their maximum size
+#define NATRON_CACHE_WARMING_MAX_OCCUPANCY 0.9
+///Buffers smaller than this many bytes are not recycled by the image buffer pool
+#define NATRON_IMAGE_BUFFER_POOL_MIN_SIZE 65536
+///Alignment in bytes of the buffers of the image buffer pool
+#define NATRON_IMAGE_BUFFER_POOL_ALIGNMENT 4096
+///Maximum number of bytes held by the free-list of each thread in the image buffer pool, they also count against the maximum size of the pool
+#define NATRON_IMAGE_BUFFER_POOL_THREAD_CACHE_SIZE 67108864
+///Fraction of the RAM dedicated to the caches that the image buffer pool may keep to recycle buffers
+#define NATRON_IMAGE_BUFFER_POOL_PORTION 0.1
+///The render bitmap of images tracks the state of the pixels by tiles of 2^NATRON_BITMAP_TILE_SIZE_POT pixels on each side
+#define NATRON_BITMAP_TILE_SIZE_POT 6
 #define NATRON_CUSTOM_HTML_TAG_START "<" NATRON_APPLICATION_NAME ">"
 #define NATRON_CUSTOM_HTML_TAG_END "</" NATRON_APPLICATION_NAME ">"
 
@@ -207,6 +207,17 @@ CurveGui::getInternalCurve() const
     return _internalCurve;
 }
 
+void
+CurveGui::evaluateValues(bool useExpr,
+                         const double* x,
+                         double* y,
+                         int n) const
+{
+    for (int i = 0; i < n; ++i) {
+        y[i] = evaluate(useExpr, x[i]);
+    }
+}
+
 void
 CurveGui::drawCurve(int curveIndex,
                     int curvesCount)
@@ -259,27 +270,32 @@ CurveGui::drawCurve(int curveIndex,
     if (!keyframes.empty()) {
         
         try {
+            ///collect the abscissae first so that the curve is evaluated at all of them at once
+            std::vector<double> xs;
+            std::vector<std::pair<std::size_t,double> > keyPoints; //< the points lying on a keyframe: index in xs and value
             std::pair<KeyFrame,bool> isX1AKey;
             while ( x1 < (w - 1) ) {
-                double x,y;
                 if (!isX1AKey.second) {
-                    x = _curveWidget->toZoomCoordinates(x1,0).x();
-                    y = evaluate(false,x);
+                    xs.push_back( _curveWidget->toZoomCoordinates(x1,0).x() );
                 } else {
-                    x = isX1AKey.first.getTime();
-                    y = isX1AKey.first.getValue();
+                    keyPoints.push_back( std::make_pair( xs.size(), isX1AKey.first.getValue() ) );
+                    xs.push_back( isX1AKey.first.getTime() );
                 }
-                vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
                 isX1AKey = nextPointForSegment(x1,&x2,keyframes);
                 x1 = x2;
             }
             //also add the last point
-            {
-                double x = _curveWidget->toZoomCoordinates(x1,0).x();
-                double y = evaluate(false,x);
-                vertices.push_back( (float)x );
-                vertices.push_back( (float)y );
+            xs.push_back( _curveWidget->toZoomCoordinates(x1,0).x() );
+
+            std::vector<double> ys( xs.size() );
+            evaluateValues(false, &xs[0], &ys[0], (int)xs.size());
+            for (std::size_t i = 0; i < keyPoints.size(); ++i) {
+                ys[keyPoints[i].first] = keyPoints[i].second;
+            }
+            vertices.reserve(xs.size() * 2);
+            for (std::size_t i = 0; i < xs.size(); ++i) {
+                vertices.push_back( (float)xs[i] );
+                vertices.push_back( (float)ys[i] );
             }
         } catch (...) {
             
@@ -573,6 +589,27 @@ KnobCurveGui::evaluate(bool useExpr,double x) const
     }
 }
 
+void
+KnobCurveGui::evaluateValues(bool useExpr,
+                             const double* x,
+                             double* y,
+                             int n) const
+{
+    if (useExpr) {
+        CurveGui::evaluateValues(useExpr, x, y, n);
+
+        return;
+    }
+    boost::shared_ptr<KnobI> knob = getInternalKnob();
+    KnobParametric* isParametric = dynamic_cast<KnobParametric*>(knob.get());
+    if (isParametric) {
+        isParametric->getParametricCurve(_dimension)->getValuesAt(x, y, n);
+    } else {
+        assert(_internalCurve);
+        _internalCurve->getValuesAt(x, y, n, false);
+    }
+}
+
 boost::shared_ptr<Curve>
 KnobCurveGui::getInternalCurve() const
 {
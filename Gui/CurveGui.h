@@ -119,6 +119,11 @@ public:
      * The coordinates are those of the curve, not of the widget.
      **/
     virtual double evaluate(bool useExpr, double x) const = 0;
+
+    /**
+     * @brief Same as evaluate() for n abscissae at once. The default implementation calls evaluate() for each of them.
+     **/
+    virtual void evaluateValues(bool useExpr, const double* x, double* y, int n) const;
     
     virtual boost::shared_ptr<Curve>  getInternalCurve() const;
 
@@ -195,6 +200,8 @@ public:
     }
     
     virtual double evaluate(bool useExpr,double x) const OVERRIDE FINAL WARN_UNUSED_RETURN;
+
+    virtual void evaluateValues(bool useExpr, const double* x, double* y, int n) const OVERRIDE FINAL;
     
     boost::shared_ptr<RotoContext> getRotoContext() const { return _roto; }
     
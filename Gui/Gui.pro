@@ -113,6 +113,7 @@ SOURCES += \
     GuiAppWrapper.cpp \
     GuiPrivate.cpp \
     Histogram.cpp \
+    IdleCacheWarmer.cpp \
     InfoViewerWidget.cpp \
     KnobGui.cpp \
     KnobGui10.cpp \
@@ -260,6 +261,7 @@ HEADERS += \
     GuiPrivate.h \
     GlobalGuiWrapper.h \
     Histogram.h \
+    IdleCacheWarmer.h \
     InfoViewerWidget.h \
     KnobGui.h \
     KnobGuiFactory.h \
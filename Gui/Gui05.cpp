@@ -49,6 +49,7 @@
 #include "Gui/GuiAppInstance.h"
 #include "Gui/GuiPrivate.h"
 #include "Gui/Histogram.h"
+#include "Gui/IdleCacheWarmer.h"
 #include "Gui/NodeGraph.h"
 #include "Gui/ProjectGui.h"
 #include "Gui/ShortCutEditor.h"
@@ -132,6 +133,8 @@ Gui::setupUi()
 
     _imp->shortcutEditor = new ShortCutEditor(this);
     _imp->shortcutEditor->hide();
+    
+    _imp->idleCacheWarmer = new IdleCacheWarmer(this);
 
 
     //the same action also clears the ofx plugins caches, they are not the same cache but are used to the same end
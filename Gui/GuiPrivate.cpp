@@ -248,6 +248,7 @@ GuiPrivate::GuiPrivate(GuiAppInstance* app,
 , _lastEnteredTabWidget(0)
 , pythonCommands()
 , statsDialog(0)
+, idleCacheWarmer(0)
 , currentPanelFocus(0)
 , currentPanelFocusEventRecursion(0)
 , keyPressEventHasVisitedFocusWidget(false)
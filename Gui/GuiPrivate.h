@@ -80,6 +80,7 @@ class KnobHolder;
 class DockablePanel;
 class ScriptEditor;
 class RenderStatsDialog;
+class IdleCacheWarmer;
 
 #define kPropertiesBinName "properties"
 
@@ -266,6 +267,9 @@ struct GuiPrivate
     
     RenderStatsDialog* statsDialog;
     
+    ///Fills the caches when the user is idle, owned by the Gui
+    IdleCacheWarmer* idleCacheWarmer;
+    
     PanelWidget* currentPanelFocus;
     
     //To prevent recursion when we forward an uncaught event to the click focus widget
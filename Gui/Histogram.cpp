@@ -25,6 +25,7 @@
 #include "Histogram.h"
 
 #include <algorithm> // min, max
+#include <cmath>
 
 #include <QHBoxLayout>
 #include <QVBoxLayout>
@@ -158,6 +159,9 @@ struct HistogramPrivate
     
 #else
     void drawHistogramCPU();
+
+    ///Draws the waveform or the vectorscope over the whole widget
+    void drawScopeCPU();
 #endif
     
     //////////////////////////////////
@@ -365,6 +369,18 @@ Histogram::Histogram(Gui* gui,
     bAction->setText( QString("B") );
     bAction->setData(5);
     _imp->modeActions->addAction(bAction);
+
+#ifndef NATRON_HISTOGRAM_USING_OPENGL
+    QAction* waveformAction = new QAction(_imp->modeMenu);
+    waveformAction->setText( tr("Waveform") );
+    waveformAction->setData(6);
+    _imp->modeActions->addAction(waveformAction);
+
+    QAction* vectorscopeAction = new QAction(_imp->modeMenu);
+    vectorscopeAction->setText( tr("Vectorscope") );
+    vectorscopeAction->setData(7);
+    _imp->modeActions->addAction(vectorscopeAction);
+#endif
     QList<QAction*> actions = _imp->modeActions->actions();
     for (int i = 0; i < actions.size(); ++i) {
         _imp->modeMenu->addAction( actions.at(i) );
@@ -627,7 +643,10 @@ Histogram::onViewerImageChanged(ViewerGL* viewer,
                  || ( ( actionIndex > 1) && ( selectedHistAction->text() == viewerName) ) ) {
                 QAction* currentInput = _imp->viewerCurrentInputGroup->checkedAction();
                 if ( currentInput && (currentInput->data().toInt() == texIndex) ) {
-                    computeHistogramAndRefresh();
+                    ///When the viewer only updated a portion of the image, only that portion is accounted again
+                    RectD updatedRoI;
+                    viewer->getLastUpdatedTextureRoI(&updatedRoI);
+                    computeHistogramAndRefreshInternal(false, updatedRoI);
                     return;
                 }
             }
@@ -1183,13 +1202,20 @@ Histogram::paintGL()
         glClear(GL_COLOR_BUFFER_BIT);
         glCheckErrorIgnoreOSXBug();
         
-        _imp->drawScale();
+        bool isScope = (_imp->mode == eDisplayModeWaveform) || (_imp->mode == eDisplayModeVectorscope);
+        if (!isScope) {
+            _imp->drawScale();
+        }
         
         if (_imp->hasImage) {
 #ifndef NATRON_HISTOGRAM_USING_OPENGL
-            _imp->drawHistogramCPU();
+            if (isScope) {
+                _imp->drawScopeCPU();
+            } else {
+                _imp->drawHistogramCPU();
+            }
 #endif
-            if (_imp->drawCoordinates) {
+            if (_imp->drawCoordinates && !isScope) {
                 _imp->drawPicker();
             }
             
@@ -1317,6 +1343,10 @@ HistogramPrivate::updatePicker(double x)
     rValueStr.clear();
     gValueStr.clear();
     bValueStr.clear();
+    if ( (mode == Histogram::eDisplayModeWaveform) || (mode == Histogram::eDisplayModeVectorscope) ) {
+        ///the scopes have no picker
+        return;
+    }
     if (mode == Histogram::eDisplayModeRGB) {
         float r = histogram1.empty() ? 0 :  histogram1[index];
         float g = histogram2.empty() ? 0 :  histogram2[index];
@@ -1477,6 +1507,13 @@ Histogram::showEvent(QShowEvent* e)
 
 void
 Histogram::computeHistogramAndRefresh(bool forceEvenIfNotVisible)
+{
+    computeHistogramAndRefreshInternal( forceEvenIfNotVisible, RectD() );
+}
+
+void
+Histogram::computeHistogramAndRefreshInternal(bool forceEvenIfNotVisible,
+                                              const RectD & updatedRoI)
 {
     // always running in the main thread
     assert( qApp && qApp->thread() == QThread::currentThread() );
@@ -1495,7 +1532,11 @@ Histogram::computeHistogramAndRefresh(bool forceEvenIfNotVisible)
     RectI rect;
     boost::shared_ptr<Natron::Image> image = _imp->getHistogramImage(&rect);
     if (image) {
-        _imp->histogramThread.computeHistogram(_imp->mode, image, rect, width(),vmin,vmax,_imp->filterSize);
+        RectI updatedRect;
+        if ( !updatedRoI.isNull() ) {
+            updatedRoI.toPixelEnclosing(image->getMipMapLevel(), 1., &updatedRect);
+        }
+        _imp->histogramThread.computeHistogram(_imp->mode, image, rect, width(),vmin,vmax,_imp->filterSize, updatedRect);
     } else {
         _imp->hasImage = false;
     }
@@ -1903,6 +1944,88 @@ HistogramPrivate::drawHistogramCPU()
     glCheckError();
 } // drawHistogramCPU
 
+void
+HistogramPrivate::drawScopeCPU()
+{
+    // always running in the main thread
+    assert( qApp && qApp->thread() == QThread::currentThread() );
+    assert( QGLContext::currentContext() == widget->context() );
+
+    const std::vector<float>* scopes[3] = { &histogram1, &histogram2, &histogram3 };
+    int scopesCount = 1;
+    unsigned int columns = NATRON_SCOPE_RESOLUTION;
+    if (mode == Histogram::eDisplayModeWaveform) {
+        scopesCount = 3;
+        columns = binsCount;
+    }
+    for (int i = 0; i < scopesCount; ++i) {
+        if (scopes[i]->size() != columns * NATRON_SCOPE_RESOLUTION) {
+            ///the histogram was computed for another mode
+            return;
+        }
+    }
+
+    ///the scopes do not depend on the zoom, they fill the widget
+    QPointF btmLeft = zoomCtx.toZoomCoordinates(0, widget->height() - 1);
+    QPointF topRight = zoomCtx.toZoomCoordinates(widget->width() - 1, 0);
+    double cellWidth = ( topRight.x() - btmLeft.x() ) / columns;
+    double cellHeight = ( topRight.y() - btmLeft.y() ) / NATRON_SCOPE_RESOLUTION;
+
+    // same colors as the RGB histogram, their sum is white
+    const float colors[3][3] = {
+        { 0.711519527404004, 0.164533420851110, 0.164533420851110 },
+        { 0., 0.546986106552894, 0. },
+        { 0.288480472595996, 0.288480472595996, 0.835466579148890 }
+    };
+    const float white[3] = { 1., 1., 1. };
+
+    glCheckError();
+    {
+        GLProtectAttrib a(GL_COLOR_BUFFER_BIT | GL_LINE_BIT | GL_CURRENT_BIT | GL_ENABLE_BIT);
+
+        glEnable(GL_BLEND);
+        glBlendEquationSeparate(GL_FUNC_ADD, GL_FUNC_ADD);
+        glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ONE, GL_ONE);
+
+        if (mode == Histogram::eDisplayModeVectorscope) {
+            ///the neutral axes
+            glColor3f(0.25, 0.25, 0.25);
+            glBegin(GL_LINES);
+            glVertex2d( btmLeft.x(), ( btmLeft.y() + topRight.y() ) / 2. );
+            glVertex2d( topRight.x(), ( btmLeft.y() + topRight.y() ) / 2. );
+            glVertex2d( ( btmLeft.x() + topRight.x() ) / 2., btmLeft.y() );
+            glVertex2d( ( btmLeft.x() + topRight.x() ) / 2., topRight.y() );
+            glEnd(); // GL_LINES
+        }
+
+        glBegin(GL_QUADS);
+        for (int s = 0; s < scopesCount; ++s) {
+            const float* color = scopesCount == 1 ? white : colors[s];
+            const std::vector<float> & scope = *scopes[s];
+            for (int j = 0; j < NATRON_SCOPE_RESOLUTION; ++j) {
+                double y = btmLeft.y() + j * cellHeight;
+                for (unsigned int i = 0; i < columns; ++i) {
+                    float v = scope[j * columns + i];
+                    if (v <= 0.f) {
+                        continue;
+                    }
+                    ///the square root makes the sparse values visible
+                    float intensity = std::sqrt(v);
+                    double x = btmLeft.x() + i * cellWidth;
+                    glColor3f(color[0] * intensity, color[1] * intensity, color[2] * intensity);
+                    glVertex2d(x, y);
+                    glVertex2d(x + cellWidth, y);
+                    glVertex2d(x + cellWidth, y + cellHeight);
+                    glVertex2d(x, y + cellHeight);
+                }
+            }
+        }
+        glEnd(); // GL_QUADS
+        glCheckErrorIgnoreOSXBug();
+    } // GLProtectAttrib a(GL_COLOR_BUFFER_BIT | GL_LINE_BIT | GL_CURRENT_BIT | GL_ENABLE_BIT);
+    glCheckError();
+} // drawScopeCPU
+
 #endif // ifndef NATRON_HISTOGRAM_USING_OPENGL
 
 void
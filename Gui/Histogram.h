@@ -45,6 +45,7 @@ class QFont;
 
 class Gui;
 class ViewerGL;
+class RectD;
 /**
  * @class An histogram view in the histograms gui.
  **/
@@ -66,7 +67,9 @@ public:
         eDisplayModeY,
         eDisplayModeR,
         eDisplayModeG,
-        eDisplayModeB
+        eDisplayModeB,
+        eDisplayModeWaveform,
+        eDisplayModeVectorscope
     };
 
     Histogram(Gui* gui,
@@ -98,6 +101,12 @@ public Q_SLOTS:
 
 private:
 
+    /**
+     * @brief Same as computeHistogramAndRefresh. If updatedRoI is not null, only this portion of the viewer image
+     * (in canonical coordinates) changed since the last computation.
+     **/
+    void computeHistogramAndRefreshInternal(bool forceEvenIfNotVisible, const RectD & updatedRoI);
+
     virtual void initializeGL() OVERRIDE FINAL;
     virtual void paintGL() OVERRIDE FINAL;
     virtual void resizeGL(int w,int h) OVERRIDE FINAL;
@@ -0,0 +1,315 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include "IdleCacheWarmer.h"
+
+#include <list>
+
+#include <QCoreApplication>
+#include <QTimer>
+#include <QThread>
+GCC_DIAG_UNUSED_PRIVATE_FIELD_OFF
+// /opt/local/include/QtGui/qmime.h:119:10: warning: private field 'type' is not used [-Wunused-private-field]
+#include <QtGui/QMouseEvent>
+GCC_DIAG_UNUSED_PRIVATE_FIELD_ON
+
+#include "Engine/AppManager.h"
+#include "Engine/DiskCacheNode.h"
+#include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/OutputEffectInstance.h"
+#include "Engine/OutputSchedulerThread.h"
+#include "Engine/Project.h"
+#include "Engine/Settings.h"
+#include "Engine/ViewerInstance.h"
+
+#include "Gui/Gui.h"
+#include "Gui/GuiAppInstance.h"
+#include "Gui/ViewerTab.h"
+
+///While warming, the caches occupancy is checked at this interval, in milliseconds
+#define NATRON_CACHE_WARMING_CHECK_INTERVAL_MS 500
+
+using namespace Natron;
+
+namespace {
+    
+struct WarmedDiskCache
+{
+    boost::weak_ptr<Natron::Node> node;
+    U64 hash; //< the hash of the node when its frame range was rendered
+};
+
+///Returns true for the events by which the user interacts with the application
+bool
+isUserInputEvent(QEvent* e)
+{
+    switch ( e->type() ) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::KeyPress:
+        case QEvent::KeyRelease:
+        case QEvent::Wheel:
+        case QEvent::TabletPress:
+        case QEvent::TabletRelease:
+        case QEvent::TabletMove:
+            return true;
+        case QEvent::MouseMove: {
+            ///Hovering does not count, dragging does
+            QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(e);
+            return mouseEvent->buttons() != Qt::NoButton;
+        }
+        default:
+            return false;
+    }
+}
+    
+} // anon namespace
+
+struct IdleCacheWarmerPrivate
+{
+    Gui* gui;
+    QTimer idleTimer;
+    QTimer checkTimer;
+    bool warming;
+    
+    ///The DiskCache nodes whose frame range was rendered since they last changed, they are not rendered again
+    std::list<WarmedDiskCache> warmedDiskCaches;
+    
+    IdleCacheWarmerPrivate(Gui* gui)
+    : gui(gui)
+    , idleTimer()
+    , checkTimer()
+    , warming(false)
+    , warmedDiskCaches()
+    {
+        
+    }
+    
+    void restartIdleTimer()
+    {
+        int delay = appPTR->getCurrentSettings()->getIdleCacheWarmingDelay();
+        if (delay <= 0) {
+            idleTimer.stop();
+        } else {
+            idleTimer.start(delay * 1000);
+        }
+    }
+    
+    bool isDiskCacheWarmed(const NodePtr& node, U64 hash) const
+    {
+        for (std::list<WarmedDiskCache>::const_iterator it = warmedDiskCaches.begin(); it != warmedDiskCaches.end(); ++it) {
+            if (it->node.lock() == node) {
+                return it->hash == hash;
+            }
+        }
+        return false;
+    }
+    
+    void setDiskCacheWarmed(const NodePtr& node, U64 hash)
+    {
+        for (std::list<WarmedDiskCache>::iterator it = warmedDiskCaches.begin(); it != warmedDiskCaches.end();) {
+            NodePtr n = it->node.lock();
+            if (!n || n == node) {
+                it = warmedDiskCaches.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        WarmedDiskCache w;
+        w.node = node;
+        w.hash = hash;
+        warmedDiskCaches.push_back(w);
+    }
+    
+    void forgetDiskCacheWarmed(const NodePtr& node)
+    {
+        for (std::list<WarmedDiskCache>::iterator it = warmedDiskCaches.begin(); it != warmedDiskCaches.end(); ++it) {
+            if (it->node.lock() == node) {
+                warmedDiskCaches.erase(it);
+                return;
+            }
+        }
+    }
+    
+    ViewerInstance* getActiveViewer() const
+    {
+        ViewerInstance* viewer = gui->getApp()->getLastViewerUsingTimeline();
+        if (!viewer) {
+            const std::list<ViewerTab*>& viewers = gui->getViewersList();
+            if (!viewers.empty()) {
+                viewer = viewers.front()->getInternalNode();
+            }
+        }
+        return viewer;
+    }
+    
+    ///Aborts the renders started by the warmer. If onlyFullCaches is true, only the renders filling a cache that is almost full
+    ///are aborted. Returns true if some renders are still running.
+    bool abortWarming(bool onlyFullCaches);
+};
+
+bool
+IdleCacheWarmerPrivate::abortWarming(bool onlyFullCaches)
+{
+    bool stillWarming = false;
+    
+    ///The viewer cache warming stops by itself when the viewer cache is full
+    const std::list<ViewerTab*>& viewers = gui->getViewersList();
+    for (std::list<ViewerTab*>::const_iterator it = viewers.begin(); it != viewers.end(); ++it) {
+        RenderEngine* engine = (*it)->getInternalNode()->getRenderEngine();
+        if ( !engine->isWarmingViewerCache() ) {
+            continue;
+        }
+        if (onlyFullCaches) {
+            stillWarming = true;
+        } else {
+            ignore_result( engine->abortRendering(false,false) );
+        }
+    }
+    
+    bool diskCacheFull = appPTR->getDiskCacheOccupancy() >= NATRON_CACHE_WARMING_MAX_OCCUPANCY;
+    NodeList nodes;
+    gui->getApp()->getProject()->getNodes_recursive(nodes);
+    for (NodeList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        DiskCacheNode* isDiskCache = dynamic_cast<DiskCacheNode*>( (*it)->getLiveInstance() );
+        if ( !isDiskCache || !isDiskCache->getRenderEngine()->hasThreadsWorking() ) {
+            continue;
+        }
+        if ( !isDiskCacheWarmed( *it, (*it)->getHashValue() ) ) {
+            ///Not started by the warmer
+            continue;
+        }
+        if (onlyFullCaches && !diskCacheFull) {
+            stillWarming = true;
+        } else {
+            ///Its frame range was not entirely rendered, render it again next time
+            forgetDiskCacheWarmed(*it);
+            ignore_result( isDiskCache->getRenderEngine()->abortRendering(false,false) );
+        }
+    }
+    return stillWarming;
+}
+
+IdleCacheWarmer::IdleCacheWarmer(Gui* gui)
+: QObject(gui)
+, _imp(new IdleCacheWarmerPrivate(gui))
+{
+    _imp->idleTimer.setSingleShot(true);
+    QObject::connect( &_imp->idleTimer, SIGNAL( timeout() ), this, SLOT( onIdleTimerTimeout() ) );
+    _imp->checkTimer.setInterval(NATRON_CACHE_WARMING_CHECK_INTERVAL_MS);
+    QObject::connect( &_imp->checkTimer, SIGNAL( timeout() ), this, SLOT( onCheckTimerTimeout() ) );
+    
+    ///Watch the inputs sent to all the widgets of the application
+    qApp->installEventFilter(this);
+    _imp->restartIdleTimer();
+}
+
+IdleCacheWarmer::~IdleCacheWarmer()
+{
+    qApp->removeEventFilter(this);
+}
+
+void
+IdleCacheWarmer::notifyUserActivity()
+{
+    assert(QThread::currentThread() == qApp->thread());
+    if (_imp->warming) {
+        _imp->warming = false;
+        _imp->checkTimer.stop();
+        ignore_result( _imp->abortWarming(false) );
+    }
+    _imp->restartIdleTimer();
+}
+
+void
+IdleCacheWarmer::onIdleTimerTimeout()
+{
+    if (appPTR->getCurrentSettings()->getIdleCacheWarmingDelay() <= 0) {
+        return;
+    }
+    
+    ///Don't compete with the renders started by the user: wait for another idle delay
+    boost::shared_ptr<Project> project = _imp->gui->getApp()->getProject();
+    NodeList nodes;
+    project->getNodes_recursive(nodes);
+    for (NodeList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        OutputEffectInstance* isOutput = dynamic_cast<OutputEffectInstance*>( (*it)->getLiveInstance() );
+        if ( isOutput && isOutput->getRenderEngine() && isOutput->getRenderEngine()->hasThreadsWorking() ) {
+            _imp->restartIdleTimer();
+            return;
+        }
+    }
+    
+    if (appPTR->getViewerCacheOccupancy() < NATRON_CACHE_WARMING_MAX_OCCUPANCY) {
+        ViewerInstance* viewer = _imp->getActiveViewer();
+        if (viewer) {
+            int first,last;
+            viewer->getTimelineBounds(&first, &last);
+            viewer->getRenderEngine()->warmViewerCache(first, last);
+        }
+    }
+    
+    for (NodeList::iterator it = nodes.begin(); it != nodes.end(); ++it) {
+        DiskCacheNode* isDiskCache = dynamic_cast<DiskCacheNode*>( (*it)->getLiveInstance() );
+        if ( !isDiskCache || !(*it)->isActivated() || (*it)->isNodeDisabled() ) {
+            continue;
+        }
+        if (appPTR->getDiskCacheOccupancy() >= NATRON_CACHE_WARMING_MAX_OCCUPANCY) {
+            break;
+        }
+        U64 hash = (*it)->getHashValue();
+        if ( _imp->isDiskCacheWarmed(*it, hash) ) {
+            continue;
+        }
+        double first,last;
+        isDiskCache->getFrameRange_public(hash, &first, &last);
+        _imp->setDiskCacheWarmed(*it, hash);
+        isDiskCache->renderFullSequence(false, NULL, (int)first, (int)last);
+    }
+    
+    _imp->warming = true;
+    _imp->checkTimer.start();
+}
+
+void
+IdleCacheWarmer::onCheckTimerTimeout()
+{
+    if ( !_imp->abortWarming(true) ) {
+        ///Everything was rendered or the caches are full
+        _imp->warming = false;
+        _imp->checkTimer.stop();
+    }
+}
+
+bool
+IdleCacheWarmer::eventFilter(QObject* watched,
+                             QEvent* e)
+{
+    if ( isUserInputEvent(e) ) {
+        notifyUserActivity();
+    }
+    return QObject::eventFilter(watched, e);
+}
@@ -0,0 +1,76 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+#ifndef IDLECACHEWARMER_H
+#define IDLECACHEWARMER_H
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#if !defined(Q_MOC_RUN) && !defined(SBK_RUN)
+#include <boost/scoped_ptr.hpp>
+#endif
+
+#include <QObject>
+
+#include "Global/Macros.h"
+
+class Gui;
+class QEvent;
+
+/**
+ * @brief Fills the caches in the background when the user did not interact with the application for the delay set in
+ * the settings: the frame range of the active viewer is rendered into the viewer cache and the DiskCache nodes render
+ * their frame range into the disk cache. Any mouse or keyboard input aborts it via RenderEngine::abortRendering and
+ * restarts the delay. Each engine stops when its cache is almost full, @see NATRON_CACHE_WARMING_MAX_OCCUPANCY
+ **/
+struct IdleCacheWarmerPrivate;
+class IdleCacheWarmer : public QObject
+{
+GCC_DIAG_SUGGEST_OVERRIDE_OFF
+    Q_OBJECT
+GCC_DIAG_SUGGEST_OVERRIDE_ON
+
+public:
+    
+    IdleCacheWarmer(Gui* gui);
+    
+    virtual ~IdleCacheWarmer();
+    
+    /**
+     * @brief Aborts the renders started by the warmer and restarts the idle delay.
+     **/
+    void notifyUserActivity();
+    
+public Q_SLOTS:
+    
+    void onIdleTimerTimeout();
+    
+    void onCheckTimerTimeout();
+    
+private:
+    
+    virtual bool eventFilter(QObject* watched, QEvent* e) OVERRIDE FINAL;
+    
+    boost::scoped_ptr<IdleCacheWarmerPrivate> _imp;
+};
+
+#endif // IDLECACHEWARMER_H
@@ -162,6 +162,7 @@ KnobGuiFile::onReloadClicked()
             effect->purgeCaches();
             effect->clearPersistentMessage(false);
         }
+        knob->reloadFile();
         knob->evaluateValueChange(0, knob->getCurrentTime(), Natron::eValueChangedReasonNatronInternalEdited);
     }
 }
@@ -303,6 +304,7 @@ KnobGuiFile::watchedFileChanged()
                 }
                 
             } else {
+                 knob->reloadFile();
                  knob->evaluateValueChange(0, knob->getCurrentTime() , Natron::eValueChangedReasonNatronInternalEdited);
             }
         }
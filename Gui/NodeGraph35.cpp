@@ -254,6 +254,10 @@ NodeGraph::updateCacheSizeText()
     quint64 cacheSize = appPTR->getCachesTotalMemorySize();
     QString cacheSizeStr = QDirModelPrivate_size(cacheSize);
     QString newText = tr("Memory cache size: ") + cacheSizeStr;
+    quint64 pooledSize = appPTR->getImageBuffersPooledMemorySize();
+    if (pooledSize > 0) {
+        newText += tr(" (recycled buffers: ") + QDirModelPrivate_size(pooledSize) + ')';
+    }
     if (newText != oldText) {
         _imp->_cacheSizeText->setPlainText(newText);
     }
@@ -24,6 +24,7 @@
 
 #include "TimeLineGui.h"
 
+#include <algorithm>
 #include <cmath>
 #include <set>
 #include <QtGui/QFont>
@@ -208,12 +209,15 @@ TimeLineGui::setTimeline(const boost::shared_ptr<TimeLine>& timeline)
 
         //connect the gui to the internal timeline
         QObject::disconnect( _imp->timeline.get(), SIGNAL( keyframeIndicatorsChanged() ), this, SLOT( onKeyframesIndicatorsChanged() ) );
+        QObject::disconnect( _imp->timeline.get(), SIGNAL( readAheadRangeChanged() ), this, SLOT( onReadAheadRangeChanged() ) );
     }
 
     //connect the internal timeline to the gui
     QObject::connect( timeline.get(), SIGNAL( frameChanged(SequenceTime,int) ), this, SLOT( onFrameChanged(SequenceTime,int) ) );
     
     QObject::connect( timeline.get(), SIGNAL( keyframeIndicatorsChanged() ), this, SLOT( onKeyframesIndicatorsChanged() ) );
+    
+    QObject::connect( timeline.get(), SIGNAL( readAheadRangeChanged() ), this, SLOT( onReadAheadRangeChanged() ) );
 
     _imp->timeline = timeline;
 
@@ -605,6 +609,13 @@ TimeLineGui::paintGL()
         glLineWidth(2);
         glCheckError();
         glBegin(GL_LINES);
+        ///the frames being read ahead during playback are drawn dimmed underneath the cached frames
+        SequenceTime readAheadFirst,readAheadLast;
+        if ( _imp->timeline->getReadAheadRange(&readAheadFirst, &readAheadLast) ) {
+            glColor4f(cachedR,cachedG,cachedB,0.35);
+            glVertex2f(std::min(readAheadFirst,readAheadLast) - 0.5,cachedLineYPos);
+            glVertex2f(std::max(readAheadFirst,readAheadLast) + 0.5,cachedLineYPos);
+        }
         for (CachedFrames::const_iterator i = _imp->cachedFrames.begin(); i != _imp->cachedFrames.end(); ++i) {
             if (i->mode == eStorageModeRAM) {
                 glColor4f(cachedR,cachedG,cachedB,1.);
@@ -1047,6 +1058,12 @@ TimeLineGui::onKeyframesIndicatorsChanged()
     update();
 }
 
+void
+TimeLineGui::onReadAheadRangeChanged()
+{
+    update();
+}
+
 void
 TimeLineGui::connectSlotsToViewerCache()
 {
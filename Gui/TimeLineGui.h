@@ -142,6 +142,8 @@ public Q_SLOTS:
 
     void onKeyframesIndicatorsChanged();
     
+    void onReadAheadRangeChanged();
+    
     void onProjectFrameRangeChanged(int,int);
 
 private:
@@ -3818,6 +3818,20 @@ ViewerGL::getLastRenderedImageByMipMapLevel(int textureIndex,unsigned int mipMap
     }
 }
 
+bool
+ViewerGL::getLastUpdatedTextureRoI(RectD* roi) const
+{
+    // always running in the main thread
+    assert( qApp && qApp->thread() == QThread::currentThread() );
+
+    if (!_imp->isUpdatingTexture) {
+        return false;
+    }
+    *roi = _imp->lastTextureRoi;
+
+    return true;
+}
+
 #ifndef M_LN2
 #define M_LN2       0.693147180559945309417232121458176568  /* loge(2)        */
 #endif
@@ -4178,6 +4192,12 @@ ViewerGL::getColorAtRect(const RectD &rect, // rectangle in canonical coordinate
                                                                        &rPix, &gPix, &bPix, &aPix);
                     break;
                 case eImageBitDepthHalf:
+                    gotval = getColorAtInternal<Half, 1>(tiles,
+                                                         xPixel, yPixel,
+                                                         forceLinear,
+                                                         srcColorSpace,
+                                                         dstColorSpace,
+                                                         &rPix, &gPix, &bPix, &aPix);
                     break;
                 case eImageBitDepthFloat:
                     gotval = getColorAtInternal<float, 1>(tiles,
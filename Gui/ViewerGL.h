@@ -362,6 +362,12 @@ public:
     
     void getLastRenderedImageByMipMapLevel(int textureIndex,unsigned int mipMapLevel, std::list<boost::shared_ptr<Natron::Image> >* ret) const;
 
+    /**
+     * @brief Returns true if the last transfer to the textures only updated a portion of the texture, e.g. while
+     * the viewer reports the progress of a render. In that case roi is set to that portion in CANONICAL COORDINATES.
+     **/
+    bool getLastUpdatedTextureRoI(RectD* roi) const;
+
     /**
      * @brief Get the color of the currently displayed image at position x,y.
      * @param forceLinear If true, then it will not use the viewer current colorspace
@@ -26,7 +26,11 @@
 #include "BaseTest.h"
 
 #include <QFile>
+#include <QtConcurrentRun>
+#include <boost/bind.hpp>
 #include "Engine/Node.h"
+#include "Engine/NodeGroup.h"
+#include "Engine/TimeLine.h"
 #include "Engine/Project.h"
 #include "Engine/AppManager.h"
 #include "Engine/AppInstance.h"
@@ -277,6 +281,46 @@ TEST_F(BaseTest,SetValues)
     
 }
 
+///Reads the radius of the generator as its render does, on a render thread. The analysis sets it first, as the
+///tracker does from its instance changed action.
+static double
+readRadiusInRender(AppInstance* app,
+                   boost::shared_ptr<Node> generator,
+                   KnobDouble* radius,
+                   bool isAnalysis,
+                   double analysisValue)
+{
+    ParallelRenderArgsSetter frameRenderArgs( app->getProject().get(), 0, 0, false, false, false, 0, generator, 0, 0,
+                                              app->getTimeLine().get(), boost::shared_ptr<Node>(), isAnalysis, false, false,
+                                              boost::shared_ptr<RenderStats>() );
+    if (isAnalysis) {
+        radius->setValue(analysisValue, 0);
+    }
+
+    return radius->getValue();
+}
+
+TEST_F(BaseTest,KnobsSnapshotOnRenderThread)
+{
+    boost::shared_ptr<Node> generator = createNode(_dotGeneratorPluginID);
+    ASSERT_TRUE(generator);
+    boost::shared_ptr<KnobI> knob = generator->getKnobByName("radius");
+    KnobDouble* radius = dynamic_cast<KnobDouble*>(knob.get());
+    ASSERT_TRUE(radius);
+
+    radius->setValue(100, 0);
+    EXPECT_EQ( 100., QtConcurrent::run( boost::bind(&readRadiusInRender, _app, generator, radius, false, 0.) ).result() );
+
+    ///The copy of the knobs taken by the previous render must not be read once a knob changed
+    radius->setValue(50, 0);
+    EXPECT_EQ( 50., QtConcurrent::run( boost::bind(&readRadiusInRender, _app, generator, radius, false, 0.) ).result() );
+
+    ///The analysis reads back the values it sets
+    EXPECT_EQ( 25., QtConcurrent::run( boost::bind(&readRadiusInRender, _app, generator, radius, true, 25.) ).result() );
+    EXPECT_EQ( 25., radius->getValue() );
+    EXPECT_EQ( 25., QtConcurrent::run( boost::bind(&readRadiusInRender, _app, generator, radius, false, 0.) ).result() );
+}
+
 ///High level test: simple node connections test
 TEST_F(BaseTest,SimpleNodeConnections) {
     ///create the generator
@@ -291,3 +335,45 @@ TEST_F(BaseTest,SimpleNodeConnections) {
     disconnectNodes(generator, writer, false);
     connectNodes(generator, writer, 0, true);
 }
+
+///A change of the generator hash must reach every node downstream, and only them
+TEST_F(BaseTest,HashPropagation)
+{
+    boost::shared_ptr<Node> generator = createNode(_dotGeneratorPluginID);
+    ASSERT_TRUE(generator);
+
+    ///A chain of Dot nodes
+    std::vector<boost::shared_ptr<Node> > graph;
+    boost::shared_ptr<Node> previous = generator;
+    for (int i = 0; i < 8; ++i) {
+        boost::shared_ptr<Node> dot = createNode(PLUGINID_NATRON_DOT);
+        ASSERT_TRUE(dot);
+        connectNodes(previous, dot, 0, true);
+        graph.push_back(dot);
+        previous = dot;
+    }
+
+    ///A binary tree of Dot nodes fanning out from the generator
+    std::vector<boost::shared_ptr<Node> > tree;
+    for (int i = 0; i < 15; ++i) {
+        boost::shared_ptr<Node> dot = createNode(PLUGINID_NATRON_DOT);
+        ASSERT_TRUE(dot);
+        connectNodes(i == 0 ? generator : tree[(i - 1) / 2], dot, 0, true);
+        tree.push_back(dot);
+    }
+    graph.insert(graph.end(), tree.begin(), tree.end());
+
+    boost::shared_ptr<Node> disconnected = createNode(PLUGINID_NATRON_DOT);
+    ASSERT_TRUE(disconnected);
+
+    std::vector<U64> hashes(graph.size());
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        hashes[i] = graph[i]->getHashValue();
+    }
+    U64 disconnectedHash = disconnected->getHashValue();
+    generator->incrementKnobsAge();
+    for (std::size_t i = 0; i < graph.size(); ++i) {
+        EXPECT_NE(hashes[i], graph[i]->getHashValue());
+    }
+    EXPECT_EQ(disconnectedHash, disconnected->getHashValue());
+}
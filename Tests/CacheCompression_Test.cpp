@@ -0,0 +1,224 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <algorithm>
+#include <cstdlib>
+#include <list>
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "BaseTest.h"
+#include "Engine/Cache.h"
+#include "Engine/CacheCompression.h"
+#include "Engine/Image.h"
+
+using namespace Natron;
+
+namespace {
+///Smooth content made of runs of equal pixels, with values exactly representable in each bit depth
+template <typename PIX>
+void
+fillGradient(Image* img,
+             double scale)
+{
+    const RectI & bounds = img->getBounds();
+    Image::WriteAccess acc(img);
+
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+        PIX* pix = (PIX*)acc.pixelAt(bounds.x1, y);
+        for (int x = bounds.x1; x < bounds.x2; ++x) {
+            for (int c = 0; c < 4; ++c, ++pix) {
+                *pix = (PIX)( ( (x / 4 + (y / 4) * 3 + c * 16) % 256 ) * scale );
+            }
+        }
+    }
+}
+
+void
+fillNoise(Image* img)
+{
+    const RectI & bounds = img->getBounds();
+    Image::WriteAccess acc(img);
+    std::size_t rowBytes = bounds.width() * img->getComponentsCount() * getSizeOfForBitDepth( img->getBitDepth() );
+
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+        unsigned char* pix = acc.pixelAt(bounds.x1, y);
+        for (std::size_t i = 0; i < rowBytes; ++i) {
+            pix[i] = (unsigned char)(std::rand() & 0xff);
+        }
+    }
+}
+
+std::vector<char>
+copyPixels(const Image* img)
+{
+    const RectI & bounds = img->getBounds();
+    Image::ReadAccess acc(img);
+    std::size_t bytes = bounds.area() * img->getComponentsCount() * getSizeOfForBitDepth( img->getBitDepth() );
+    const char* pix = (const char*)acc.pixelAt(bounds.x1, bounds.y1);
+
+    return std::vector<char>(pix, pix + bytes);
+}
+
+void
+waitMilliseconds(unsigned long ms)
+{
+    QMutex mutex;
+    QWaitCondition never;
+    QMutexLocker k(&mutex);
+
+    never.wait(&mutex, ms);
+}
+
+boost::shared_ptr<Image>
+createImage(ImageBitDepthEnum depth)
+{
+    ///Not a multiple of 4 on purpose
+    RectI bounds(0, 0, 203, 97);
+    RectD rod(0, 0, 203, 97);
+
+    return boost::shared_ptr<Image>( new Image(ImageComponents::getRGBAComponents(), rod, bounds, 0, 1., depth) );
+}
+
+///Compresses the image in place, decompresses it and checks that the pixels are restored bit-exact
+void
+checkRoundTrip(const boost::shared_ptr<Image> & img)
+{
+    std::vector<char> original = copyPixels( img.get() );
+
+    ///The codec alone, on the pixels seen as elements of one pixel
+    std::vector<char> compressed(original.size() * NATRON_CACHE_COMPRESSION_MAX_RATIO);
+    std::size_t compressedSize = compressCacheBuffer(&original[0], original.size(), img->getCompressionElementSize(),
+                                                     &compressed[0], compressed.size());
+    ASSERT_NE( (std::size_t)0, compressedSize );
+    std::vector<char> decompressed( original.size() );
+    EXPECT_TRUE( decompressCacheBuffer(&compressed[0], compressedSize, &decompressed[0], decompressed.size()) );
+    EXPECT_TRUE(decompressed == original);
+    EXPECT_FALSE( decompressCacheBuffer(&compressed[0], compressedSize / 2, &decompressed[0], decompressed.size()) );
+
+    ///The image buffer, as the cache does it
+    ASSERT_TRUE( img->compress() );
+    EXPECT_TRUE( img->isCompressed() );
+    EXPECT_EQ( compressedSize, img->dataSize() );
+    img->decompress();
+    EXPECT_FALSE( img->isCompressed() );
+    EXPECT_TRUE(copyPixels( img.get() ) == original);
+}
+} // anon namespace
+
+TEST(CacheCompression,RoundTripFloat) {
+    boost::shared_ptr<Image> img = createImage(eImageBitDepthFloat);
+
+    fillGradient<float>(img.get(), 1. / 256.);
+    checkRoundTrip(img);
+}
+
+TEST(CacheCompression,RoundTripShort) {
+    boost::shared_ptr<Image> img = createImage(eImageBitDepthShort);
+
+    fillGradient<unsigned short>(img.get(), 256.);
+    checkRoundTrip(img);
+}
+
+TEST(CacheCompression,RoundTripByte) {
+    boost::shared_ptr<Image> img = createImage(eImageBitDepthByte);
+
+    fillGradient<unsigned char>(img.get(), 1.);
+    checkRoundTrip(img);
+}
+
+TEST(CacheCompression,Incompressible) {
+    std::srand(2015);
+    boost::shared_ptr<Image> img = createImage(eImageBitDepthFloat);
+    fillNoise( img.get() );
+    std::vector<char> original = copyPixels( img.get() );
+
+    ///Noise does not fit in the space the cache grants to a compressed entry
+    std::vector<char> compressed( original.size() + original.size() / 255 + 64 );
+    EXPECT_EQ( (std::size_t)0, compressCacheBuffer(&original[0], original.size(), 16, &compressed[0],
+                                                   (std::size_t)(original.size() * NATRON_CACHE_COMPRESSION_MAX_RATIO)) );
+
+    ///but it still round-trips when given enough room, including the trailing bytes which do not form a whole element
+    std::size_t size = original.size() - 7;
+    std::size_t compressedSize = compressCacheBuffer(&original[0], size, 16, &compressed[0], compressed.size());
+    ASSERT_NE( (std::size_t)0, compressedSize );
+    std::vector<char> decompressed(size);
+    EXPECT_TRUE( decompressCacheBuffer(&compressed[0], compressedSize, &decompressed[0], size) );
+    EXPECT_TRUE( std::equal( decompressed.begin(), decompressed.end(), original.begin() ) );
+
+    ///The image is left untouched
+    EXPECT_FALSE( img->compress() );
+    EXPECT_FALSE( img->isCompressed() );
+    EXPECT_TRUE(copyPixels( img.get() ) == original);
+}
+
+///Runs on top of BaseTest because the cache needs the AppManager
+TEST_F(BaseTest,CompressedCacheTier) {
+    Cache<Image> cache("CompressedCacheTierTest", 1, 256 * 1024 * 1024, 1., 1);
+    cache.setEvictionPolicy(eCacheEvictionPolicyLRU);
+    cache.setCompressionEnabled(true);
+
+    RectI bounds(0, 0, 256, 256);
+    RectD rod(0, 0, 256, 256);
+    ImageKey key = Image::makeKey(0, 1, false, 0, 0, false, false);
+    boost::shared_ptr<ImageParams> params = Image::makeParams( 0, rod, bounds, 1., 0, false, ImageComponents::getRGBAComponents(),
+                                                               eImageBitDepthFloat, std::map<int, std::map<int, std::vector<RangeD> > >() );
+    boost::shared_ptr<Image> img;
+    EXPECT_FALSE( cache.getOrCreate(key, params, &img) );
+    ASSERT_TRUE(img);
+    img->allocateMemory();
+    fillGradient<float>(img.get(), 1. / 256.);
+    std::vector<char> original = copyPixels( img.get() );
+    img.reset();
+
+    ///The evicted entry goes to the compressor thread then to the compressed portion
+    EXPECT_TRUE( cache.evictLRUInMemoryEntry() );
+    ///Don't look it up while waiting, this would take it back from the compressor thread
+    for (int i = 0; i < 500 && cache.getCompressedCacheSize() == 0; ++i) {
+        waitMilliseconds(10);
+    }
+    ASSERT_NE( (std::size_t)0, cache.getCompressedCacheSize() );
+    EXPECT_LT( (double)cache.getCompressedCacheSize(), original.size() * NATRON_CACHE_COMPRESSION_MAX_RATIO );
+    EXPECT_EQ( cache.getCompressedCacheSize(), cache.getMemoryCacheSize() );
+
+    ///Looking it up brings it back to the hot tier, decompressed
+    std::list<boost::shared_ptr<Image> > found;
+    EXPECT_TRUE( cache.get(key, &found) );
+    ASSERT_EQ( (std::size_t)1, found.size() );
+    EXPECT_FALSE( found.front()->isCompressed() );
+    EXPECT_TRUE(copyPixels( found.front().get() ) == original);
+    EXPECT_EQ( (std::size_t)0, cache.getCompressedCacheSize() );
+    EXPECT_GE( cache.getMemoryCacheSize(), original.size() );
+
+    found.clear();
+    cache.clear();
+    cache.waitForDeleterThread();
+}
@@ -0,0 +1,309 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <QDir>
+#include <QString>
+#include <QStringList>
+
+#include "BaseTest.h"
+#include "Engine/CacheEntry.h"
+#include "Engine/CachePackAllocator.h"
+#include "Engine/Image.h"
+
+#define PACK_ALIGN NATRON_CACHE_PACK_ALIGNMENT
+#define PACK_SIZE (16 * NATRON_CACHE_PACK_ALIGNMENT)
+
+using namespace Natron;
+
+namespace {
+///The cache as seen by the entries, reduced to its pack files
+class PackCacheAPI
+    : public CacheAPI
+{
+    boost::shared_ptr<CachePackAllocator> _packs;
+
+public:
+
+    PackCacheAPI(const boost::shared_ptr<CachePackAllocator> & packs)
+        : _packs(packs)
+    {
+    }
+
+    virtual void notifyEntrySizeChanged(U64 /*hash*/, size_t /*oldSize*/, size_t /*newSize*/) const OVERRIDE FINAL {}
+
+    virtual void notifyEntryAllocated(U64 /*hash*/, int /*time*/, size_t /*size*/, Natron::StorageModeEnum /*storage*/) const OVERRIDE FINAL {}
+
+    virtual void notifyEntryDestroyed(U64 /*hash*/, int /*time*/, size_t /*size*/, Natron::StorageModeEnum /*storage*/) const OVERRIDE FINAL {}
+
+    virtual void notifyMemoryDeallocated() const OVERRIDE FINAL {}
+
+    virtual boost::shared_ptr<CachePackAllocator> getPackAllocator() const OVERRIDE FINAL
+    {
+        return _packs;
+    }
+
+    virtual void notifyEntryStorageChanged(U64 /*hash*/, Natron::StorageModeEnum /*oldStorage*/, Natron::StorageModeEnum /*newStorage*/,
+                                           int /*time*/, size_t /*size*/) const OVERRIDE FINAL {}
+
+    virtual void removeAllEntriesWithDifferentNodeHashForHolderPrivate(const std::string & /*holderID*/, U64 /*nodeHash*/,
+                                                                       bool /*removeAll*/) OVERRIDE FINAL {}
+};
+
+///Creates an image of 64x64 RGBA bytes (4 pages) stored in the pack files
+boost::shared_ptr<Image>
+createDiskImage(const CacheAPI* cache,
+                U64 nodeHash)
+{
+    RectI bounds(0, 0, 64, 64);
+    RectD rod(0, 0, 64, 64);
+    boost::shared_ptr<ImageParams> params = Image::makeParams( 1, rod, bounds, 1., 0, false, ImageComponents::getRGBAComponents(),
+                                                               eImageBitDepthByte, std::map<int, std::map<int, std::vector<RangeD> > >() );
+    boost::shared_ptr<Image> ret( new Image(Image::makeKey(0, nodeHash, false, 0, 0, false, false), params, cache, eStorageModeDisk) );
+    ret->allocateMemory();
+
+    return ret;
+}
+} // anon namespace
+
+///Runs on top of BaseTest because the pack files are counted by the AppManager
+class CachePackAllocatorTest
+    : public BaseTest
+{
+protected:
+
+    virtual void SetUp()
+    {
+        BaseTest::SetUp();
+        _directory = QDir::tempPath() + "/NatronCachePackAllocatorTest";
+        QDir().mkpath(_directory);
+        removePackFiles();
+    }
+
+    virtual void TearDown()
+    {
+        removePackFiles();
+        QDir().rmdir(_directory);
+        BaseTest::TearDown();
+    }
+
+    void removePackFiles()
+    {
+        QDir dir(_directory);
+        QStringList files = dir.entryList(QDir::Files);
+
+        for (int i = 0; i < files.size(); ++i) {
+            dir.remove(files[i]);
+        }
+    }
+
+    QString _directory;
+};
+
+TEST_F(CachePackAllocatorTest,FirstFit) {
+    CachePackAllocator packs(_directory.toStdString(), PACK_SIZE);
+
+    EXPECT_EQ( (std::size_t)0, packs.getPacksCount() );
+
+    CachePackLocation a, b, c;
+    ASSERT_TRUE( packs.allocate(PACK_ALIGN, &a) );
+    ASSERT_TRUE( packs.allocate(2 * PACK_ALIGN, &b) );
+    ASSERT_TRUE( packs.allocate(PACK_ALIGN, &c) );
+    EXPECT_EQ( (std::size_t)1, packs.getPacksCount() );
+    EXPECT_EQ( (std::size_t)PACK_SIZE, packs.getPacksSize() );
+    EXPECT_EQ(0, a.pack);
+    EXPECT_EQ( (U64)0, a.offset );
+    EXPECT_EQ( (U64)PACK_ALIGN, b.offset );
+    EXPECT_EQ( (U64)(3 * PACK_ALIGN), c.offset );
+    EXPECT_EQ( (std::size_t)(4 * PACK_ALIGN), packs.getAllocatedSize() );
+
+    ///The location keeps the requested length, the space reserved is rounded up to the alignment
+    CachePackLocation small;
+    ASSERT_TRUE( packs.allocate(10, &small) );
+    EXPECT_EQ( (U64)10, small.length );
+    EXPECT_EQ( (U64)(4 * PACK_ALIGN), small.offset );
+    EXPECT_EQ( (std::size_t)(5 * PACK_ALIGN), packs.getAllocatedSize() );
+
+    ///The hole left by a is too small for 2 pages: they go after the last allocation
+    packs.deallocate(a);
+    CachePackLocation d;
+    ASSERT_TRUE( packs.allocate(2 * PACK_ALIGN, &d) );
+    EXPECT_EQ( (U64)(5 * PACK_ALIGN), d.offset );
+
+    ///but a single page takes the first hole that fits
+    CachePackLocation e;
+    ASSERT_TRUE( packs.allocate(PACK_ALIGN / 2, &e) );
+    EXPECT_EQ(0, e.pack);
+    EXPECT_EQ( (U64)0, e.offset );
+
+    ///A request which does not fit in the free space of the pack opens a new one
+    CachePackLocation f;
+    ASSERT_TRUE( packs.allocate(PACK_SIZE - PACK_ALIGN, &f) );
+    EXPECT_EQ(1, f.pack);
+    EXPECT_EQ( (U64)0, f.offset );
+    EXPECT_EQ( (std::size_t)2, packs.getPacksCount() );
+
+    ///Entries larger than a pack get a pack of their own which is removed when they are deallocated
+    CachePackLocation large;
+    ASSERT_TRUE( packs.allocate(2 * PACK_SIZE, &large) );
+    EXPECT_EQ(2, large.pack);
+    EXPECT_EQ( (std::size_t)3, packs.getPacksCount() );
+    packs.deallocate(large);
+    EXPECT_EQ( (std::size_t)2, packs.getPacksCount() );
+
+    ///The data of each location is distinct
+    std::memset(packs.data(b), 1, b.length);
+    std::memset(packs.data(c), 2, c.length);
+    EXPECT_EQ( 1, packs.data(b)[b.length - 1] );
+    EXPECT_EQ( 2, packs.data(c)[0] );
+}
+
+TEST_F(CachePackAllocatorTest,Coalescing) {
+    CachePackAllocator packs(_directory.toStdString(), PACK_SIZE);
+    std::vector<CachePackLocation> locations(PACK_SIZE / PACK_ALIGN);
+
+    ///Fill the pack page by page
+    for (std::size_t i = 0; i < locations.size(); ++i) {
+        ASSERT_TRUE( packs.allocate(PACK_ALIGN, &locations[i]) );
+        EXPECT_EQ(0, locations[i].pack);
+        EXPECT_EQ( (U64)(i * PACK_ALIGN), locations[i].offset );
+    }
+
+    ///Two free pages which are not adjacent cannot hold 2 pages
+    packs.deallocate(locations[0]);
+    packs.deallocate(locations[2]);
+    CachePackLocation twoPages;
+    ASSERT_TRUE( packs.allocate(2 * PACK_ALIGN, &twoPages) );
+    EXPECT_EQ(1, twoPages.pack);
+    packs.deallocate(twoPages);
+
+    ///Freeing the page in between merges the 3 free pages, with the previous and the next one
+    packs.deallocate(locations[1]);
+    CachePackLocation threePages;
+    ASSERT_TRUE( packs.allocate(3 * PACK_ALIGN, &threePages) );
+    EXPECT_EQ(0, threePages.pack);
+    EXPECT_EQ( (U64)0, threePages.offset );
+    packs.deallocate(threePages);
+
+    ///Free everything in an order which merges extents on both sides: the whole pack is one extent again
+    for (std::size_t i = 4; i < locations.size(); i += 2) {
+        packs.deallocate(locations[i]);
+    }
+    for (std::size_t i = 3; i < locations.size(); i += 2) {
+        packs.deallocate(locations[i]);
+    }
+    EXPECT_EQ( (std::size_t)0, packs.getAllocatedSize() );
+
+    CachePackLocation whole;
+    ASSERT_TRUE( packs.allocate(PACK_SIZE, &whole) );
+    EXPECT_EQ(0, whole.pack);
+    EXPECT_EQ( (U64)0, whole.offset );
+}
+
+TEST_F(CachePackAllocatorTest,ReserveOnRestore) {
+    CachePackLocation a, b, c;
+    {
+        CachePackAllocator packs(_directory.toStdString(), PACK_SIZE);
+        ASSERT_TRUE( packs.allocate(PACK_ALIGN, &a) );
+        ASSERT_TRUE( packs.allocate(2 * PACK_ALIGN, &b) );
+        ASSERT_TRUE( packs.allocate(PACK_ALIGN, &c) );
+        std::memset(packs.data(b), 42, b.length);
+        ASSERT_TRUE( packs.flush(b) );
+        ///a was not saved in the table of contents
+        packs.deallocate(a);
+    }
+
+    ///The pack files of the previous session are opened but their space is free until the entries are restored
+    CachePackAllocator packs(_directory.toStdString(), PACK_SIZE);
+    EXPECT_EQ( (std::size_t)1, packs.getPacksCount() );
+    EXPECT_EQ( (std::size_t)0, packs.getAllocatedSize() );
+
+    EXPECT_TRUE( packs.reserve(c) );
+    EXPECT_TRUE( packs.reserve(b) );
+    EXPECT_EQ( (std::size_t)(3 * PACK_ALIGN), packs.getAllocatedSize() );
+    ASSERT_TRUE( packs.data(b) != NULL );
+    EXPECT_EQ( 42, packs.data(b)[0] );
+    EXPECT_EQ( 42, packs.data(b)[b.length - 1] );
+
+    ///Overlapping locations and locations out of the pack files are refused
+    EXPECT_FALSE( packs.reserve(b) );
+    CachePackLocation overlap = c;
+    overlap.offset -= PACK_ALIGN;
+    EXPECT_FALSE( packs.reserve(overlap) );
+    CachePackLocation missingPack = a;
+    missingPack.pack = 5;
+    EXPECT_FALSE( packs.reserve(missingPack) );
+    EXPECT_FALSE( packs.reserve( CachePackLocation() ) );
+    EXPECT_EQ( (std::size_t)(3 * PACK_ALIGN), packs.getAllocatedSize() );
+
+    ///New allocations never overwrite the restored entries
+    CachePackLocation d, e;
+    ASSERT_TRUE( packs.allocate(PACK_ALIGN, &d) );
+    EXPECT_EQ( (U64)0, d.offset );
+    ASSERT_TRUE( packs.allocate(PACK_ALIGN, &e) );
+    EXPECT_EQ( (U64)(4 * PACK_ALIGN), e.offset );
+}
+
+TEST_F(CachePackAllocatorTest,ReuseAfterScheduleForDestruction) {
+    boost::shared_ptr<CachePackAllocator> packs( new CachePackAllocator(_directory.toStdString(), PACK_SIZE) );
+    PackCacheAPI cache(packs);
+
+    boost::shared_ptr<Image> kept = createDiskImage(&cache, 1);
+    CachePackLocation keptLocation = kept->getPackLocation();
+    ASSERT_TRUE( keptLocation.isValid() );
+    std::size_t allocatedSize = packs->getAllocatedSize();
+    EXPECT_EQ( (std::size_t)(4 * PACK_ALIGN), allocatedSize );
+
+    ///An entry destroyed without being scheduled for destruction stays in the pack files, e.g: to be restored later on
+    kept.reset();
+    EXPECT_EQ( allocatedSize, packs->getAllocatedSize() );
+
+    boost::shared_ptr<Image> removed = createDiskImage(&cache, 2);
+    CachePackLocation removedLocation = removed->getPackLocation();
+    ASSERT_TRUE( removedLocation.isValid() );
+    EXPECT_NE(keptLocation.offset, removedLocation.offset);
+    EXPECT_EQ( 2 * allocatedSize, packs->getAllocatedSize() );
+
+    removed->scheduleForDestruction();
+    removed.reset();
+    EXPECT_EQ( allocatedSize, packs->getAllocatedSize() );
+
+    ///The next entry of the same size takes the space released by the removed entry
+    boost::shared_ptr<Image> reused = createDiskImage(&cache, 3);
+    EXPECT_EQ(removedLocation.pack, reused->getPackLocation().pack);
+    EXPECT_EQ(removedLocation.offset, reused->getPackLocation().offset);
+    EXPECT_EQ( (std::size_t)1, packs->getPacksCount() );
+
+    reused->scheduleForDestruction();
+    reused.reset();
+    packs->deallocate(keptLocation);
+    EXPECT_EQ( (std::size_t)0, packs->getAllocatedSize() );
+}
@@ -0,0 +1,281 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFuture>
+#include <QtCore/QThread>
+#include <QtConcurrentRun>
+
+#include "BaseTest.h"
+#include "Engine/Cache.h"
+#include "Engine/Image.h"
+
+using namespace Natron;
+
+///A 256KB entry
+#define ENTRY_SIZE 256
+
+namespace {
+ImageKey
+makeKey(U64 nodeHash)
+{
+    return Image::makeKey(0, nodeHash, false, 0, 0, false, false);
+}
+
+boost::shared_ptr<ImageParams>
+makeParams(int size)
+{
+    RectI bounds(0, 0, size, size);
+    RectD rod(0, 0, size, size);
+
+    return Image::makeParams( 0, rod, bounds, 1., 0, false, ImageComponents::getRGBAComponents(), eImageBitDepthByte,
+                              std::map<int, std::map<int, std::vector<RangeD> > >() );
+}
+
+///Returns the nodeHash of the keys of all the entries of the cache, without touching them
+std::set<U64>
+getCachedNodeHashes(const Cache<Image> & cache)
+{
+    std::list<boost::shared_ptr<Image> > entries;
+    std::set<U64> ret;
+
+    cache.getCopy(&entries);
+    for (std::list<boost::shared_ptr<Image> >::iterator it = entries.begin(); it != entries.end(); ++it) {
+        ret.insert( (*it)->getKey().getTreeVersion() );
+    }
+
+    return ret;
+}
+
+///Creates an entry of ENTRY_SIZE x ENTRY_SIZE pixels (a quarter of MiB) which took costPerMiB / 4 seconds to render
+void
+insertEntryWithCost(const Cache<Image> & cache,
+                    U64 nodeHash,
+                    double costPerMiB)
+{
+    boost::shared_ptr<Image> img;
+
+    EXPECT_FALSE( cache.getOrCreate(makeKey(nodeHash), makeParams(ENTRY_SIZE), &img) );
+    ASSERT_TRUE(img);
+    img->allocateMemory();
+    img->addRenderCost(costPerMiB / 4.);
+}
+
+struct ConcurrentAccessArgs
+{
+    Cache<Image>* cache;
+    int keysCount;
+    int iterations;
+    QAtomicInt errors;
+};
+
+///Looks-up and inserts entries of random keys. Each entry holds a signature of its key in its first pixel
+void
+concurrentAccess(ConcurrentAccessArgs* args,
+                 unsigned int seed)
+{
+    boost::shared_ptr<ImageParams> params = makeParams(64);
+
+    for (int i = 0; i < args->iterations; ++i) {
+        seed = seed * 1103515245 + 12345;
+        int k = (int)( (seed >> 16) % args->keysCount );
+        ImageKey key = makeKey(k + 1);
+        boost::shared_ptr<Image> img;
+        if ( (i % 3) == 0 ) {
+            std::list<boost::shared_ptr<Image> > entries;
+            if ( !args->cache->get(key, &entries) ) {
+                continue;
+            }
+            if (entries.size() != 1) {
+                args->errors.fetchAndAddRelaxed(1);
+                continue;
+            }
+            img = entries.front();
+        } else {
+            args->cache->getOrCreate(key, params, &img);
+            if (!img) {
+                args->errors.fetchAndAddRelaxed(1);
+                continue;
+            }
+            ///Allocation is idempotent: another thread may find the entry before its creator allocated it
+            img->allocateMemory();
+        }
+        if ( !(img->getKey() == key) ) {
+            args->errors.fetchAndAddRelaxed(1);
+            continue;
+        }
+
+        ///All threads write the same signature for a given key
+        Image::WriteAccess acc( img.get() );
+        unsigned char* pix = acc.pixelAt(0, 0);
+        pix[0] = (unsigned char)k;
+        pix[1] = (unsigned char)~k;
+        if ( (pix[0] != (unsigned char)k) || (pix[1] != (unsigned char)~k) ) {
+            args->errors.fetchAndAddRelaxed(1);
+        }
+    }
+}
+} // anon namespace
+
+///Runs on top of BaseTest because the cache needs the AppManager
+TEST_F(BaseTest,CacheShardsMemoryBudget) {
+    ///16 entries fit in the in-memory portion, spread over 8 shards
+    const std::size_t maxSize = 16 * ENTRY_SIZE * ENTRY_SIZE * 4;
+    Cache<Image> cache("CacheShardsMemoryBudgetTest", 1, maxSize, 1., 8);
+
+    cache.setEvictionPolicy(eCacheEvictionPolicyLRU);
+    cache.setCompressionEnabled(false);
+    EXPECT_EQ( (std::size_t)8, cache.getShardsCount() );
+    EXPECT_EQ( maxSize, cache.getMaximumMemorySize() );
+
+    boost::shared_ptr<ImageParams> params = makeParams(ENTRY_SIZE);
+    const int entriesCount = 64;
+    for (int i = 0; i < entriesCount; ++i) {
+        boost::shared_ptr<Image> img;
+        EXPECT_FALSE( cache.getOrCreate(makeKey(i + 1), params, &img) );
+        ASSERT_TRUE(img);
+        img->allocateMemory();
+    }
+
+    ///The entries evicted are destroyed by the deleter thread
+    cache.clearExceedingEntries();
+    cache.waitForDeleterThread();
+
+    ///The budget is global: the shards together never hold more than the maximum
+    EXPECT_LE( cache.getMemoryCacheSize(), maxSize );
+    std::set<U64> cached = getCachedNodeHashes(cache);
+    EXPECT_FALSE( cached.empty() );
+    EXPECT_LE(cached.size(), (std::size_t)16);
+    EXPECT_EQ( cached.size() * ENTRY_SIZE * ENTRY_SIZE * 4, cache.getMemoryCacheSize() );
+
+    ///The most recent entry must have survived, whatever its shard
+    EXPECT_EQ( (std::size_t)1, cached.count(entriesCount) );
+    std::list<boost::shared_ptr<Image> > found;
+    EXPECT_TRUE( cache.get(makeKey(entriesCount), &found) );
+
+    found.clear();
+    cache.clear();
+    cache.waitForDeleterThread();
+    EXPECT_EQ( (std::size_t)0, cache.getMemoryCacheSize() );
+}
+
+TEST_F(BaseTest,CacheShardsConcurrentAccess) {
+    Cache<Image> cache("CacheShardsConcurrentAccessTest", 1, 256 * 1024 * 1024, 1., 4);
+
+    cache.setCompressionEnabled(false);
+
+    ConcurrentAccessArgs args;
+    args.cache = &cache;
+    args.keysCount = 32;
+    args.iterations = 2000;
+
+    const int threadsCount = std::max(4, QThread::idealThreadCount() * 2);
+    std::vector<QFuture<void> > futures;
+    for (int i = 0; i < threadsCount; ++i) {
+        futures.push_back( QtConcurrent::run(concurrentAccess, &args, (unsigned int)i + 1) );
+    }
+    for (std::size_t i = 0; i < futures.size(); ++i) {
+        futures[i].waitForFinished();
+    }
+    EXPECT_EQ( 0, (int)args.errors );
+
+    ///Nothing was evicted and each key was created exactly once
+    std::list<boost::shared_ptr<Image> > entries;
+    cache.getCopy(&entries);
+    std::set<U64> cached;
+    for (std::list<boost::shared_ptr<Image> >::iterator it = entries.begin(); it != entries.end(); ++it) {
+        EXPECT_TRUE( cached.insert( (*it)->getKey().getTreeVersion() ).second );
+    }
+    EXPECT_EQ( (std::size_t)args.keysCount, entries.size() );
+    entries.clear();
+
+    for (int k = 0; k < args.keysCount; ++k) {
+        std::list<boost::shared_ptr<Image> > found;
+        ASSERT_TRUE( cache.get(makeKey(k + 1), &found) );
+        ASSERT_EQ( (std::size_t)1, found.size() );
+        Image::ReadAccess acc( found.front().get() );
+        const unsigned char* pix = acc.pixelAt(0, 0);
+        EXPECT_EQ( (unsigned char)k, pix[0] );
+        EXPECT_EQ( (unsigned char)~k, pix[1] );
+    }
+
+    cache.clear();
+    cache.waitForDeleterThread();
+}
+
+TEST_F(BaseTest,CacheGreedyDualSizeEviction) {
+    Cache<Image> cache("CacheGreedyDualSizeEvictionTest", 1, 256 * 1024 * 1024, 1., 1);
+
+    cache.setEvictionPolicy(eCacheEvictionPolicyGreedyDualSize);
+    cache.setCompressionEnabled(false);
+
+    ///H = L + cost / size, with L = 0 when the entries are inserted
+    insertEntryWithCost(cache, 1, 2.); // H(A) = 2
+    insertEntryWithCost(cache, 2, 1.); // H(B) = 1
+    insertEntryWithCost(cache, 3, 2.5); // H(C) = 2.5
+
+    ///B is not the least recently used entry but it is the cheapest to recompute
+    EXPECT_TRUE( cache.evictLRUInMemoryEntry() );
+    std::set<U64> cached = getCachedNodeHashes(cache);
+    EXPECT_EQ( (std::size_t)2, cached.size() );
+    EXPECT_EQ( (std::size_t)0, cached.count(2) );
+
+    ///L is now H(B) = 1: accessing A raises it to H(A) = L + 2 = 3, above H(C) = 2.5
+    std::list<boost::shared_ptr<Image> > found;
+    EXPECT_TRUE( cache.get(makeKey(1), &found) );
+    found.clear();
+
+    ///Without the aging, A would be evicted before C
+    EXPECT_TRUE( cache.evictLRUInMemoryEntry() );
+    cached = getCachedNodeHashes(cache);
+    EXPECT_EQ( (std::size_t)1, cached.size() );
+    EXPECT_EQ( (std::size_t)1, cached.count(1) );
+
+    ///L is now H(C) = 2.5: a new entry starts from it, H(D) = 2.5 + 0.25 < H(A)
+    insertEntryWithCost(cache, 4, 0.25);
+    EXPECT_TRUE( cache.evictLRUInMemoryEntry() );
+    cached = getCachedNodeHashes(cache);
+    EXPECT_EQ( (std::size_t)1, cached.size() );
+    EXPECT_EQ( (std::size_t)1, cached.count(1) );
+
+    ///but an entry that costs more than A does not get evicted first
+    insertEntryWithCost(cache, 5, 1.);
+    EXPECT_TRUE( cache.evictLRUInMemoryEntry() );
+    cached = getCachedNodeHashes(cache);
+    EXPECT_EQ( (std::size_t)1, cached.size() );
+    EXPECT_EQ( (std::size_t)1, cached.count(5) );
+
+    cache.clear();
+    cache.waitForDeleterThread();
+}
@@ -24,10 +24,17 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdlib>
+#include <list>
+#include <vector>
+
 #include <QString>
 #include <QDir>
 
 #include "Engine/Curve.h"
+#include "Engine/Hash64.h"
+#include "Engine/Interpolation.h"
 
 TEST(KeyFrame,Basic)
 {
@@ -118,4 +125,181 @@ TEST(Curve,Basic)
     KeyFrame k2(1., 20.);
 }
 
+TEST(Curve,Hash)
+{
+    Curve c1, c2;
+
+    EXPECT_TRUE( c1.addKeyFrame( KeyFrame(0.,10.) ) );
+    EXPECT_TRUE( c1.addKeyFrame( KeyFrame(1.,20.) ) );
+    // same keyframes added in a different order
+    EXPECT_TRUE( c2.addKeyFrame( KeyFrame(1.,20.) ) );
+    EXPECT_TRUE( c2.addKeyFrame( KeyFrame(0.,10.) ) );
+
+    Hash64 h1, h2;
+    c1.appendToHash(&h1);
+    h1.computeHash();
+    c2.appendToHash(&h2);
+    h2.computeHash();
+    EXPECT_EQ( h1.value(), h2.value() ) << "Curves with the same keyframes should have the same hash.";
+
+    // changing a keyframe changes the hash, setting it back restores it
+    EXPECT_FALSE( c2.addKeyFrame( KeyFrame(1.,30.) ) );
+    h2.reset();
+    c2.appendToHash(&h2);
+    h2.computeHash();
+    EXPECT_NE( h1.value(), h2.value() );
+
+    EXPECT_FALSE( c2.addKeyFrame( KeyFrame(1.,20.) ) );
+    h2.reset();
+    c2.appendToHash(&h2);
+    h2.computeHash();
+    EXPECT_EQ( h1.value(), h2.value() );
+}
+
+TEST(Curve,Snapshot)
+{
+    Curve c;
+    CurveSnapshot empty;
+
+    c.getSnapshot(&empty);
+    EXPECT_FALSE( empty.isAnimated() );
+
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(0.,10.) ) );
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(1.,20.,0.,0.,Natron::eKeyframeTypeLinear) ) );
+    EXPECT_TRUE( c.addKeyFrame( KeyFrame(3.,-5.,0.,0.,Natron::eKeyframeTypeConstant) ) );
+    c.setYRange(0., 15.);
+
+    CurveSnapshot s;
+    c.getSnapshot(&s);
+    ASSERT_TRUE( s.isAnimated() );
+    for (double t = -2.; t <= 5.; t += 0.25) {
+        EXPECT_EQ( c.getValueAt(t), s.getValueAt(t) );
+        EXPECT_EQ( c.getValueAt(t, false), s.getValueAt(t, false) );
+    }
+
+    // the snapshot is not affected by later changes of the curve
+    EXPECT_FALSE( c.addKeyFrame( KeyFrame(0.,12.) ) );
+    EXPECT_EQ( 10., s.getValueAt(0.) );
+}
+
+///The value of the curve at t computed from its keyframes, the way the curves did before they cached the coefficients
+///of their segments: find the segment with upper_bound, then interpolate between its keyframes
+static double
+referenceValueAt(const KeyFrameSet & keys,
+                 double t)
+{
+    KeyFrameSet::const_iterator itup = keys.upper_bound( KeyFrame(t, 0.) );
+    double tcur, vcur, vcurDerivRight, tnext, vnext, vnextDerivLeft;
+    Natron::KeyframeTypeEnum interp, interpNext;
+
+    if ( itup == keys.begin() ) {
+        tnext = itup->getTime();
+        vnext = itup->getValue();
+        vnextDerivLeft = itup->getLeftDerivative();
+        interpNext = itup->getInterpolation();
+        tcur = tnext - 1.;
+        vcur = vnext;
+        vcurDerivRight = 0.;
+        interp = Natron::eKeyframeTypeNone;
+    } else if ( itup == keys.end() ) {
+        KeyFrameSet::const_reverse_iterator itlast = keys.rbegin();
+        tcur = itlast->getTime();
+        vcur = itlast->getValue();
+        vcurDerivRight = itlast->getRightDerivative();
+        interp = itlast->getInterpolation();
+        tnext = tcur + 1.;
+        vnext = vcur;
+        vnextDerivLeft = 0.;
+        interpNext = Natron::eKeyframeTypeNone;
+    } else {
+        KeyFrameSet::const_iterator itcur = itup;
+        --itcur;
+        tcur = itcur->getTime();
+        vcur = itcur->getValue();
+        vcurDerivRight = itcur->getRightDerivative();
+        interp = itcur->getInterpolation();
+        tnext = itup->getTime();
+        vnext = itup->getValue();
+        vnextDerivLeft = itup->getLeftDerivative();
+        interpNext = itup->getInterpolation();
+    }
+
+    return Natron::interpolate(tcur, vcur, vcurDerivRight, vnextDerivLeft, tnext, vnext, t, interp, interpNext);
+}
+
+TEST(Curve,BatchEvaluation)
+{
+    Curve c;
+
+    for (int i = 0; i < 200; ++i) {
+        Natron::KeyframeTypeEnum interp = (i % 3 == 0) ? Natron::eKeyframeTypeSmooth : ( (i % 3 == 1) ? Natron::eKeyframeTypeLinear : Natron::eKeyframeTypeConstant );
+        EXPECT_TRUE( c.addKeyFrame( KeyFrame(i * 1.5, (i * 7) % 13, 0., 0., interp) ) );
+    }
+    const KeyFrameSet keys = c.getKeyFrames_mt_safe();
+
+    ///Random times over the keyframes and on both sides of them, where the curve is extrapolated, and the times of the keyframes
+    srand(2000);
+    const int n = 10000;
+    std::vector<double> times(n), batchValues(n), referenceValues(n);
+    for (int i = 0; i < n; ++i) {
+        // coverity[dont_call]
+        times[i] = -50. + 400. * ( (double)rand() / RAND_MAX );
+    }
+    for (int i = 0; i < 200; ++i) {
+        times[i] = i * 1.5;
+    }
+
+    // the segments computed from the cached coefficients give the values interpolated from the keyframes
+    for (int i = 0; i < n; ++i) {
+        referenceValues[i] = referenceValueAt(keys, times[i]);
+        ASSERT_EQ( referenceValues[i], c.getValueAt(times[i]) ) << "at t = " << times[i];
+    }
+    c.getValuesAt(&times[0], &batchValues[0], n);
+    for (int i = 0; i < n; ++i) {
+        ASSERT_EQ( referenceValues[i], batchValues[i] ) << "at t = " << times[i];
+    }
 
+    // the batch evaluation is clamped like getValueAt
+    c.setYRange(0., 6.);
+    c.getValuesAt(&times[0], &batchValues[0], n);
+    for (int i = 0; i < n; ++i) {
+        ASSERT_EQ( std::max( 0., std::min(6., referenceValues[i]) ), batchValues[i] ) << "at t = " << times[i];
+        ASSERT_EQ( c.getValueAt(times[i]), batchValues[i] );
+    }
+}
+
+TEST(Curve,AddKeyFrames)
+{
+    Curve c, bulk;
+    std::list<KeyFrame> keys;
+
+    for (int i = 0; i < 100; ++i) {
+        KeyFrame k(i * 2., (i * 7) % 13, 0., 0., Natron::eKeyframeTypeLinear);
+        EXPECT_TRUE( c.addKeyFrame(k) );
+        keys.push_back(k);
+    }
+    EXPECT_EQ( 100, bulk.addKeyFrames(keys) );
+    EXPECT_EQ( c.getKeyFramesCount(), bulk.getKeyFramesCount() );
+
+    // the derivatives are the same as when adding the keyframes one by one
+    KeyFrameSet ks = c.getKeyFrames_mt_safe();
+    KeyFrameSet bulkKs = bulk.getKeyFrames_mt_safe();
+    for (KeyFrameSet::iterator it = ks.begin(), it2 = bulkKs.begin(); it != ks.end(); ++it, ++it2) {
+        EXPECT_EQ( it->getTime(), it2->getTime() );
+        EXPECT_EQ( it->getValue(), it2->getValue() );
+        EXPECT_EQ( it->getLeftDerivative(), it2->getLeftDerivative() );
+        EXPECT_EQ( it->getRightDerivative(), it2->getRightDerivative() );
+    }
+    for (double t = -5.; t < 205.; t += 0.5) {
+        EXPECT_EQ( c.getValueAt(t), bulk.getValueAt(t) );
+    }
+
+    // existing keyframes are replaced
+    std::list<KeyFrame> replaced;
+    replaced.push_back( KeyFrame(0., 100., 0., 0., Natron::eKeyframeTypeLinear) );
+    replaced.push_back( KeyFrame(1., 50., 0., 0., Natron::eKeyframeTypeLinear) );
+    EXPECT_EQ( 1, bulk.addKeyFrames(replaced) );
+    EXPECT_EQ( 101, bulk.getKeyFramesCount() );
+    EXPECT_EQ( 100., bulk.getValueAt(0.) );
+    EXPECT_EQ( 50., bulk.getValueAt(1.) );
+}
@@ -24,6 +24,7 @@
 
 #include <cstdlib>
 #include <gtest/gtest.h>
+#include <QtCore/QString>
 #include "Engine/Hash64.h"
 
 TEST(Hash64,GeneralTest) {
@@ -82,3 +83,32 @@ TEST(Hash64,GeneralTest) {
     EXPECT_NE( hash1.value(), hash2.value() );
     EXPECT_NE(hash1, hash2);
 }
+
+TEST(Hash64,QString) {
+    const char* strings[] = { "", "a", "abc", "abcd", "abcde", "abcdefgh", "abcdefghi", "bacd", 0 };
+    std::vector<U64> values;
+
+    for (int i = 0; strings[i]; ++i) {
+        Hash64 hash1,hash2;
+        Hash64_appendQString( &hash1, QString(strings[i]) );
+        hash1.computeHash();
+        Hash64_appendQString( &hash2, QString(strings[i]) );
+        hash2.computeHash();
+        EXPECT_EQ(hash1, hash2) << "Hashs of the same string should be equal.";
+        values.push_back( hash1.value() );
+    }
+
+    ///Strings sharing their first characters or differing by their length should not collide
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        for (std::size_t j = i + 1; j < values.size(); ++j) {
+            EXPECT_NE(values[i], values[j]);
+        }
+    }
+
+    Hash64 nullChar,empty;
+    Hash64_appendQString( &nullChar, QString( QChar(0) ) );
+    nullChar.computeHash();
+    Hash64_appendQString( &empty, QString() );
+    empty.computeHash();
+    EXPECT_NE(nullChar, empty);
+}
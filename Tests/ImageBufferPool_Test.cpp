@@ -0,0 +1,170 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <cstddef>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "Global/Macros.h"
+#include "Engine/ImageBufferPool.h"
+
+using namespace Natron;
+
+#define MIN_SIZE NATRON_IMAGE_BUFFER_POOL_MIN_SIZE
+
+namespace {
+///The maximum size the pool has before the AppManager sets it
+const std::size_t defaultPoolMaximumSize = 268435456;
+
+///Checks that size is one of the 4 classes between 2 consecutive powers of 2, starting at the minimum size
+bool
+isSizeClass(std::size_t size)
+{
+    std::size_t power = MIN_SIZE;
+
+    if (size < power) {
+        return false;
+    }
+    while (power * 2 <= size) {
+        power *= 2;
+    }
+
+    return (size - power) % (power / 4) == 0;
+}
+
+ImageBufferPoolStats
+getStats()
+{
+    ImageBufferPoolStats stats;
+
+    getImageBufferPoolStats(&stats);
+
+    return stats;
+}
+} // anon namespace
+
+TEST(ImageBufferPool,SizeClasses) {
+    ///Small buffers go to malloc and are not rounded
+    EXPECT_EQ( (std::size_t)1, getImageBufferAllocationSize(1) );
+    EXPECT_EQ( (std::size_t)MIN_SIZE - 1, getImageBufferAllocationSize(MIN_SIZE - 1) );
+
+    for (std::size_t power = MIN_SIZE; power <= (std::size_t)1 << 30; power *= 2) {
+        EXPECT_EQ( power, getImageBufferAllocationSize(power) );
+        EXPECT_EQ( power + power / 4, getImageBufferAllocationSize(power + 1) );
+        EXPECT_EQ( power * 2, getImageBufferAllocationSize(power * 2 - 1) );
+    }
+
+    std::size_t previous = 0;
+    for (std::size_t size = MIN_SIZE; size < 16 * 1024 * 1024; size += 4093) {
+        std::size_t sizeClass = getImageBufferAllocationSize(size);
+        EXPECT_GE(sizeClass, size);
+        ///At most 25% of a buffer is wasted
+        EXPECT_LT( (double)sizeClass, size * 1.25 );
+        EXPECT_EQ( (std::size_t)0, sizeClass % NATRON_IMAGE_BUFFER_POOL_ALIGNMENT );
+        EXPECT_TRUE( isSizeClass(sizeClass) ) << "size " << size << " rounded to " << sizeClass;
+        EXPECT_GE(sizeClass, previous);
+        previous = sizeClass;
+    }
+}
+
+TEST(ImageBufferPool,ReuseAfterRelease) {
+    trimImageBufferPool(0);
+    EXPECT_EQ( (U64)0, getStats().pooledSize );
+
+    const std::size_t size = 3 * MIN_SIZE + 17;
+    const std::size_t sizeClass = getImageBufferAllocationSize(size);
+    void* buffer = allocateImageBuffer(size);
+    ASSERT_TRUE(buffer != 0);
+    EXPECT_EQ( (std::size_t)0, (std::size_t)buffer % NATRON_IMAGE_BUFFER_POOL_ALIGNMENT );
+
+    ImageBufferPoolStats stats = getStats();
+    EXPECT_EQ( (U64)0, stats.pooledSize );
+    EXPECT_GE( stats.usedSize, (U64)sizeClass );
+
+    freeImageBuffer(buffer, size);
+    stats = getStats();
+    EXPECT_EQ( (U64)sizeClass, stats.pooledSize );
+    EXPECT_EQ( (U64)1, stats.pooledBuffersCount );
+
+    ///Another size of the same class gets the buffer back
+    void* reused = allocateImageBuffer(sizeClass);
+    ImageBufferPoolStats after = getStats();
+    EXPECT_EQ(buffer, reused);
+    EXPECT_EQ(stats.hits + 1, after.hits);
+    EXPECT_EQ(stats.misses, after.misses);
+    EXPECT_EQ( (U64)0, after.pooledSize );
+
+    ///but another class does not
+    void* other = allocateImageBuffer(sizeClass + 1);
+    EXPECT_NE(buffer, other);
+    EXPECT_EQ(after.misses + 1, getStats().misses);
+
+    freeImageBuffer(other, sizeClass + 1);
+    freeImageBuffer(reused, sizeClass);
+    trimImageBufferPool(0);
+    EXPECT_EQ( (U64)0, getStats().pooledSize );
+    EXPECT_EQ( (U64)0, getStats().pooledBuffersCount );
+}
+
+TEST(ImageBufferPool,TrimOverBudget) {
+    trimImageBufferPool(0);
+
+    const std::size_t size = MIN_SIZE * 4;
+    std::vector<void*> buffers;
+    for (int i = 0; i < 4; ++i) {
+        buffers.push_back( allocateImageBuffer(size) );
+    }
+
+    ///Buffers freed once the pool is full go back to the system
+    setImageBufferPoolMaximumSize(2 * size);
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        freeImageBuffer(buffers[i], size);
+    }
+    ImageBufferPoolStats stats = getStats();
+    EXPECT_EQ( (U64)2 * size, stats.pooledSize );
+    EXPECT_EQ( (U64)2, stats.pooledBuffersCount );
+
+    ///Lowering the maximum size trims what the pool already holds
+    setImageBufferPoolMaximumSize(size);
+    EXPECT_LE( getStats().pooledSize, (U64)size );
+
+    trimImageBufferPool(0);
+    EXPECT_EQ( (U64)0, getStats().pooledSize );
+
+    ///The freed buffers are reused up to the budget
+    setImageBufferPoolMaximumSize(defaultPoolMaximumSize);
+    buffers.clear();
+    for (int i = 0; i < 4; ++i) {
+        buffers.push_back( allocateImageBuffer(size) );
+    }
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        freeImageBuffer(buffers[i], size);
+    }
+    EXPECT_EQ( (U64)4 * size, getStats().pooledSize );
+    trimImageBufferPool(2 * size);
+    EXPECT_LE( getStats().pooledSize, (U64)2 * size );
+
+    trimImageBufferPool(0);
+}
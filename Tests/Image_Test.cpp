@@ -23,8 +23,14 @@
 // ***** END PYTHON BLOCK *****
 
 #include <cstring>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include "Engine/Image.h"
+#include "Engine/ImageKernels.h"
+#include "Engine/ImageStatistics.h"
 
 
 TEST(BitmapTest,SimpleRect) {
@@ -43,8 +49,7 @@ TEST(BitmapTest,SimpleRect) {
     ASSERT_TRUE(rod == nonRenderedRectsUnion);
 
     ///assert that the "underlying" bitmap is clean
-    const char* map = bm.getBitmap();
-    ASSERT_TRUE( !memchr( map,1,rod.area() ) );
+    ASSERT_TRUE( bm.getStatesInRect(rod) == (1 << 0) );
 
     RectI halfRoD(0,0,100,50);
     bm.markForRendered(halfRoD);
@@ -58,14 +63,12 @@ TEST(BitmapTest,SimpleRect) {
 
 
     ///assert that the underlying bitmap is marked as expected
-    const char* start = map;
 
     ///check that there are only ones in the rendered half
-    ASSERT_TRUE( !memchr( start,0,halfRoD.area() ) );
+    ASSERT_TRUE( bm.getStatesInRect(halfRoD) == (1 << 1) );
 
     ///check that there are only 0s in the non rendered half
-    start = map + halfRoD.area();
-    ASSERT_TRUE( !memchr( start,1,halfRoD.area() ) );
+    ASSERT_TRUE( bm.getStatesInRect(nonRenderedHalf) == (1 << 0) );
 
     ///mark for renderer the other half of the rod
     bm.markForRendered(nonRenderedHalf);
@@ -74,7 +77,7 @@ TEST(BitmapTest,SimpleRect) {
     nonRenderedRects.clear();
     bm.minimalNonMarkedRects(rod, nonRenderedRects);
     ASSERT_TRUE( nonRenderedRects.empty() );
-    ASSERT_TRUE( !memchr( map,0,rod.area() ) );
+    ASSERT_TRUE( bm.getStatesInRect(rod) == (1 << 1) );
     
     ///More complex example where A,B,C,D are not rendered check that both trimap & bitmap yield the same result
     // BBBBBBBBBBBBBB
@@ -106,6 +109,114 @@ TEST(BitmapTest,SimpleRect) {
     EXPECT_TRUE(nonRenderedRects.size() == 3);
 }
 
+///The bounding box of the pixels that are not rendered, computed on a plain one-byte-per-pixel bitmap
+static RectI
+naiveNonMarkedBbox(const std::vector<char>& map,
+                   const RectI& bounds)
+{
+    RectI bbox;
+    bool found = false;
+
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+        const char* row = &map[(y - bounds.y1) * bounds.width()];
+        for (int x = bounds.x1; x < bounds.x2; ++x) {
+            if (row[x - bounds.x1] == 0) {
+                if (!found) {
+                    bbox.set(x, y, x + 1, y + 1);
+                    found = true;
+                } else {
+                    bbox.merge( RectI(x, y, x + 1, y + 1) );
+                }
+            }
+        }
+    }
+
+    return bbox;
+}
+
+TEST(BitmapTest,TilesMatchPixels) {
+    ///Rectangles not aligned on the tiles, with negative coordinates
+    RectI rod(-37,-101,301,199);
+    Natron::Bitmap bm(rod);
+    std::vector<char> map(rod.area(), 0);
+
+    RectI marked[3] = { RectI(-37,-101,200,150), RectI(-10,-50,7,3), RectI(150,100,301,199) };
+    char states[3] = { 1, 0, 1 };
+    for (int i = 0; i < 3; ++i) {
+        if (states[i] == 1) {
+            bm.markForRendered(marked[i]);
+        } else {
+            bm.clear(marked[i]);
+        }
+        for (int y = marked[i].y1; y < marked[i].y2; ++y) {
+            for (int x = marked[i].x1; x < marked[i].x2; ++x) {
+                map[(y - rod.y1) * rod.width() + x - rod.x1] = states[i];
+            }
+        }
+    }
+
+    for (int y = rod.y1; y < rod.y2; ++y) {
+        for (int x = rod.x1; x < rod.x2; ++x) {
+            ASSERT_EQ( map[(y - rod.y1) * rod.width() + x - rod.x1], bm.getStateAt(x, y) );
+        }
+    }
+
+    RectI bbox = bm.minimalNonMarkedBbox(rod);
+    EXPECT_TRUE( bbox == naiveNonMarkedBbox(map, rod) );
+
+    ///The union of the rects must cover all the pixels that are not rendered
+    std::list<RectI> rects;
+    bm.minimalNonMarkedRects(rod, rects);
+    for (int y = rod.y1; y < rod.y2; ++y) {
+        for (int x = rod.x1; x < rod.x2; ++x) {
+            if (map[(y - rod.y1) * rod.width() + x - rod.x1] == 0) {
+                bool covered = false;
+                for (std::list<RectI>::iterator it = rects.begin(); it != rects.end() && !covered; ++it) {
+                    covered = it->contains(x, y);
+                }
+                ASSERT_TRUE(covered);
+            }
+        }
+    }
+
+    ///Copying the bitmap gives the same states
+    Natron::Bitmap copy(rod);
+    copy.copyBitmapPortion(rod, bm);
+    for (int y = rod.y1; y < rod.y2; ++y) {
+        for (int x = rod.x1; x < rod.x2; ++x) {
+            ASSERT_EQ( bm.getStateAt(x, y), copy.getStateAt(x, y) );
+        }
+    }
+
+    ///Once everything is rendered, the tiles are uniform again and do not hold any pixel
+    bm.markForRendered(rod);
+    Natron::Bitmap empty(rod);
+    EXPECT_EQ( empty.getMemorySize(), bm.getMemorySize() );
+}
+
+///Finds what is left to render in a 8K image which is almost entirely rendered. The bitmap only holds
+///the tiles that are not uniform and takes a fraction of the memory of a byte per pixel.
+TEST(BitmapTest,AlmostRenderedImage) {
+    RectI rod(0,0,8192,4320);
+    RectI hole(4000,2000,4100,2100);
+    Natron::Bitmap bm(rod);
+    bm.markForRendered(rod);
+    bm.clear(hole);
+
+    EXPECT_TRUE(bm.minimalNonMarkedBbox(rod) == hole);
+
+    ///The rects to render cover the hole
+    std::list<RectI> rects;
+    bm.minimalNonMarkedRects(rod, rects);
+    ASSERT_FALSE( rects.empty() );
+    RectI rectsBbox = rects.front();
+    for (std::list<RectI>::iterator it = rects.begin(); it != rects.end(); ++it) {
+        rectsBbox.merge(*it);
+    }
+    EXPECT_TRUE( rectsBbox.contains(hole) );
+    EXPECT_TRUE( bm.getMemorySize() < (std::size_t)rod.area() / 100 );
+}
+
 TEST(ImageKeyTest,Equality) {
     srand(2000);
     // coverity[dont_call]
@@ -149,3 +260,468 @@ TEST(ImageKeyTest,Difference) {
     ASSERT_TRUE(keyHash1 != keyHash2);
 }
 
+
+TEST(HalfTest,RoundTrip) {
+    ///Every half except NaNs must be converted exactly to float and back
+    for (unsigned int i = 0; i < 65536; ++i) {
+        U16 bits = (U16)i;
+        float f = Natron::Half::toFloat(bits);
+        if (f != f) {
+            EXPECT_EQ( 0x7c00, bits & 0x7c00 );
+            EXPECT_TRUE( (bits & 0x3ff) != 0 );
+            continue;
+        }
+        ASSERT_EQ( bits, Natron::Half::fromFloat(f) );
+    }
+}
+
+TEST(HalfTest,SpecialValues) {
+    EXPECT_EQ( 0.f, (float)Natron::Half(0.f) );
+    EXPECT_EQ( 1.f, (float)Natron::Half(1.f) );
+    EXPECT_EQ( -2.5f, (float)Natron::Half(-2.5f) );
+    EXPECT_EQ( 65504.f, (float)Natron::Half(65504.f) );
+    EXPECT_EQ( 0x7c00, Natron::Half(1e6f).bits() );
+    EXPECT_EQ( 0xfc00, Natron::Half(-1e6f).bits() );
+    EXPECT_EQ( 0x7c00, Natron::Half( std::numeric_limits<float>::infinity() ).bits() );
+    float nan = (float)Natron::Half( std::numeric_limits<float>::quiet_NaN() );
+    EXPECT_TRUE(nan != nan);
+    ///smallest denormal
+    EXPECT_EQ( 0x0001, Natron::Half(5.9604645e-8f).bits() );
+    EXPECT_EQ( 5.9604645e-8f, Natron::Half::toFloat(0x0001) );
+    EXPECT_EQ( 0, Natron::Half(1e-9f).bits() );
+    ///relative error of a normal half is below 2^-11
+    for (float f = 1e-4f; f < 60000.f; f *= 1.01f) {
+        EXPECT_TRUE( std::fabs( (float)Natron::Half(f) - f ) <= f / 2048.f );
+    }
+}
+
+TEST(HalfTest,BulkConversions) {
+    ///The bulk conversions must give the same results as the scalar ones, including for the last values
+    ///that are not a multiple of the SIMD width
+    std::vector<Natron::Half> halfs(65536 + 5);
+    for (std::size_t i = 0; i < halfs.size(); ++i) {
+        halfs[i] = Natron::Half::fromBits( (U16)(i * 7919) );
+    }
+    std::vector<float> floats( halfs.size() );
+    Natron::convertHalfToFloat(&halfs[0], &floats[0], halfs.size());
+    for (std::size_t i = 0; i < halfs.size(); ++i) {
+        float expected = Natron::Half::toFloat( halfs[i].bits() );
+        if (expected != expected) {
+            EXPECT_TRUE(floats[i] != floats[i]);
+        } else {
+            ASSERT_EQ( expected, floats[i] );
+        }
+    }
+
+    srand(2000);
+    for (std::size_t i = 0; i < floats.size(); ++i) {
+        // coverity[dont_call]
+        floats[i] = ( (float)rand() / RAND_MAX - 0.5f ) * ( i % 3 == 0 ? 1e5f : (i % 3 == 1 ? 1.f : 1e-5f) );
+    }
+    floats[0] = std::numeric_limits<float>::infinity();
+    floats[1] = -std::numeric_limits<float>::infinity();
+    floats[2] = std::numeric_limits<float>::quiet_NaN();
+    Natron::convertFloatToHalf(&floats[0], &halfs[0], floats.size());
+    for (std::size_t i = 0; i < floats.size(); ++i) {
+        ASSERT_EQ( Natron::Half::fromFloat(floats[i]), halfs[i].bits() );
+    }
+}
+
+TEST(HalfTest,RoundsToNearestEven) {
+    ///Ties go to the even mantissa, for normals, denormals and at the top of the range
+    EXPECT_EQ( 0x3c00, Natron::Half(1.f + 1.f / 2048.f).bits() );
+    EXPECT_EQ( 0x3c02, Natron::Half(1.f + 3.f / 2048.f).bits() );
+    EXPECT_EQ( 0xbc02, Natron::Half(-1.f - 3.f / 2048.f).bits() );
+    EXPECT_EQ( 0x0000, Natron::Half(2.9802322e-8f).bits() ); // half of the smallest denormal
+    EXPECT_EQ( 0x0002, Natron::Half(8.9406967e-8f).bits() ); // 3 halves of the smallest denormal
+    EXPECT_EQ( 0x7bff, Natron::Half(65519.f).bits() );
+    EXPECT_EQ( 0x7c00, Natron::Half(65520.f).bits() );
+
+    ///The midpoints between 2 consecutive halfs and their neighbours must be converted with the same bits by all the
+    ///instruction sets
+    std::vector<float> floats;
+    for (unsigned int i = 0; i < 0x7bff; ++i) {
+        for (int s = 0; s < 2; ++s) {
+            U16 sign = s ? 0x8000 : 0;
+            float midpoint = ( Natron::Half::toFloat( (U16)(i | sign) ) + Natron::Half::toFloat( (U16)( (i + 1) | sign ) ) ) / 2.f;
+            U32 bits;
+            memcpy( &bits, &midpoint, sizeof(float) );
+            for (U32 b = bits - 1; b <= bits + 1; ++b) {
+                float f;
+                memcpy( &f, &b, sizeof(float) );
+                floats.push_back(f);
+            }
+        }
+    }
+    floats.push_back( std::numeric_limits<float>::quiet_NaN() );
+    floats.push_back( std::numeric_limits<float>::denorm_min() );
+    std::vector<Natron::Half> halfs( floats.size() );
+    Natron::KernelInstructionSetEnum supported = Natron::getSupportedKernelInstructionSet();
+    for (int k = (int)Natron::eKernelInstructionSetNone; k <= (int)supported; ++k) {
+        Natron::setKernelInstructionSet( (Natron::KernelInstructionSetEnum)k );
+        Natron::convertFloatToHalf(&floats[0], &halfs[0], floats.size());
+        for (std::size_t i = 0; i < floats.size(); ++i) {
+            ASSERT_EQ( Natron::Half(floats[i]).bits(), halfs[i].bits() ) << "instruction set " << k << ", f = " << floats[i];
+        }
+    }
+    Natron::setKernelInstructionSet(supported);
+}
+
+TEST(HalfTest,ImageConversion) {
+    RectI bounds(0,0,67,13);
+    RectD rod(0,0,67,13);
+    Natron::Image src(Natron::ImageComponents::getRGBAComponents(), rod, bounds, 0, 1., Natron::eImageBitDepthFloat);
+    Natron::Image half(Natron::ImageComponents::getRGBAComponents(), rod, bounds, 0, 1., Natron::eImageBitDepthHalf);
+    Natron::Image dst(Natron::ImageComponents::getRGBAComponents(), rod, bounds, 0, 1., Natron::eImageBitDepthFloat);
+
+    {
+        Natron::Image::WriteAccess acc(&src);
+        float* pixels = (float*)acc.pixelAt(0, 0);
+        for (int i = 0; i < bounds.area() * 4; ++i) {
+            pixels[i] = i * 0.01f;
+        }
+    }
+    src.convertToFormat(bounds, Natron::eViewerColorSpaceLinear, Natron::eViewerColorSpaceLinear, -1, false, false, &half);
+    half.convertToFormat(bounds, Natron::eViewerColorSpaceLinear, Natron::eViewerColorSpaceLinear, -1, false, false, &dst);
+
+    Natron::Image::ReadAccess srcAcc(&src);
+    Natron::Image::ReadAccess dstAcc(&dst);
+    const float* pixels = (const float*)srcAcc.pixelAt(0, 0);
+    const float* converted = (const float*)dstAcc.pixelAt(0, 0);
+    for (int i = 0; i < bounds.area() * 4; ++i) {
+        EXPECT_EQ( (float)Natron::Half(pixels[i]), converted[i] );
+    }
+}
+
+///Fills the image with reproducible values, including negative values, values above 1 and zeros in every channel
+static void
+fillWithRandomValues(Natron::Image* img,
+                     unsigned int seed)
+{
+    srand(seed);
+    const RectI & bounds = img->getBounds();
+    int nComps = (int)img->getComponentsCount();
+    Natron::Image::WriteAccess acc(img);
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+        float* pixels = (float*)acc.pixelAt(bounds.x1, y);
+        for (int i = 0; i < bounds.width() * nComps; ++i) {
+            // coverity[dont_call]
+            int r = rand();
+            pixels[i] = (r % 8 == 0) ? 0.f : ( (float)r / RAND_MAX ) * 2.f - 0.5f;
+        }
+    }
+}
+
+static bool
+haveSamePixels(const Natron::Image & a,
+               const Natron::Image & b)
+{
+    const RectI & bounds = a.getBounds();
+    std::size_t rowSize = bounds.width() * a.getComponentsCount() * sizeof(float);
+    Natron::Image::ReadAccess aAcc(&a);
+    Natron::Image::ReadAccess bAcc(&b);
+    for (int y = bounds.y1; y < bounds.y2; ++y) {
+        if (memcmp(aAcc.pixelAt(bounds.x1, y), bAcc.pixelAt(bounds.x1, y), rowSize) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct ImageOperation
+{
+    virtual ~ImageOperation()
+    {
+    }
+
+    virtual void apply(Natron::Image* img) const = 0;
+};
+
+///Applies op to 2 identical float images, once with the templated loops of Image and once with the kernels
+///of each vector instruction set supported by the CPU, and checks that the results are identical bit for bit
+static void
+checkKernelsMatchLoops(const ImageOperation & op,
+                       const Natron::ImageComponents & components)
+{
+    ///An odd width so that the kernels have to handle the pixels that do not fill a vector
+    RectI bounds(-3,2,58,21);
+    RectD rod(-3,2,58,21);
+    Natron::KernelInstructionSetEnum supported = Natron::getSupportedKernelInstructionSet();
+
+    for (int i = (int)Natron::eKernelInstructionSetSSE2; i <= (int)supported; ++i) {
+        Natron::Image loops(components, rod, bounds, 0, 1., Natron::eImageBitDepthFloat);
+        Natron::Image kernels(components, rod, bounds, 0, 1., Natron::eImageBitDepthFloat);
+        fillWithRandomValues(&loops, 1000);
+        fillWithRandomValues(&kernels, 1000);
+
+        Natron::setKernelInstructionSet(Natron::eKernelInstructionSetNone);
+        op.apply(&loops);
+        Natron::setKernelInstructionSet( (Natron::KernelInstructionSetEnum)i );
+        op.apply(&kernels);
+        Natron::setKernelInstructionSet(supported);
+
+        EXPECT_TRUE( haveSamePixels(loops, kernels) ) << "instruction set " << i;
+    }
+}
+
+struct FillOperation
+    : public ImageOperation
+{
+    virtual void apply(Natron::Image* img) const
+    {
+        img->fill(RectI(0,3,41,15), 0.25f, -0.5f, 3.f, 0.75f);
+    }
+};
+
+struct PremultOperation
+    : public ImageOperation
+{
+    bool premult;
+
+    virtual void apply(Natron::Image* img) const
+    {
+        if (premult) {
+            img->premultImage( RectI(-1,2,50,20) );
+        } else {
+            img->unpremultImage( RectI(-1,2,50,20) );
+        }
+    }
+};
+
+struct MaskMixOperation
+    : public ImageOperation
+{
+    Natron::ImagePtr original;
+    Natron::ImagePtr mask;
+    bool masked;
+    bool maskInvert;
+    float mix;
+
+    virtual void apply(Natron::Image* img) const
+    {
+        img->applyMaskMix(img->getBounds(), mask.get(), original.get(), masked, maskInvert, mix);
+    }
+};
+
+struct CopyChannelsOperation
+    : public ImageOperation
+{
+    Natron::ImagePtr original;
+    bool processChannels[4];
+    Natron::ImagePremultiplicationEnum premult;
+    Natron::ImagePremultiplicationEnum originalPremult;
+
+    virtual void apply(Natron::Image* img) const
+    {
+        img->copyUnProcessedChannels(img->getBounds(), premult, originalPremult, processChannels, original);
+    }
+};
+
+///Returns an image which covers entirely some rows of the images of checkKernelsMatchLoops, only a part of others and
+///does not intersect the remaining ones
+static Natron::ImagePtr
+makeOverlappingImage(const Natron::ImageComponents & components,
+                     unsigned int seed)
+{
+    RectI bounds(-3,5,40,30);
+    RectD rod(-3,5,40,30);
+    Natron::ImagePtr img( new Natron::Image(components, rod, bounds, 0, 1., Natron::eImageBitDepthFloat) );
+    fillWithRandomValues(img.get(), seed);
+
+    return img;
+}
+
+TEST(ImageKernelsTest,Fill) {
+    FillOperation op;
+    checkKernelsMatchLoops( op, Natron::ImageComponents::getRGBAComponents() );
+    checkKernelsMatchLoops( op, Natron::ImageComponents::getRGBComponents() );
+    checkKernelsMatchLoops( op, Natron::ImageComponents::getXYComponents() );
+    checkKernelsMatchLoops( op, Natron::ImageComponents::getAlphaComponents() );
+}
+
+TEST(ImageKernelsTest,Premult) {
+    PremultOperation op;
+    op.premult = true;
+    checkKernelsMatchLoops( op, Natron::ImageComponents::getRGBAComponents() );
+    op.premult = false;
+    checkKernelsMatchLoops( op, Natron::ImageComponents::getRGBAComponents() );
+}
+
+TEST(ImageKernelsTest,MaskMix) {
+    const Natron::ImageComponents* components[3] = {
+        &Natron::ImageComponents::getRGBAComponents(), &Natron::ImageComponents::getRGBComponents(), &Natron::ImageComponents::getAlphaComponents()
+    };
+    for (int c = 0; c < 3; ++c) {
+        MaskMixOperation op;
+        op.original = makeOverlappingImage(*components[c], 2000);
+        op.mix = 0.7f;
+        for (int masked = 0; masked < 2; ++masked) {
+            for (int maskInvert = 0; maskInvert < 2; ++maskInvert) {
+                op.masked = masked;
+                op.maskInvert = maskInvert;
+                op.mask.reset();
+                checkKernelsMatchLoops(op, *components[c]);
+                if (masked) {
+                    op.mask = makeOverlappingImage(Natron::ImageComponents::getAlphaComponents(), 3000);
+                    checkKernelsMatchLoops(op, *components[c]);
+                }
+            }
+        }
+    }
+
+    ///The kernels are not used when the original image has other components, the results must not change either
+    MaskMixOperation op;
+    op.original = makeOverlappingImage(Natron::ImageComponents::getRGBComponents(), 2000);
+    op.masked = false;
+    op.maskInvert = false;
+    op.mix = 0.3f;
+    checkKernelsMatchLoops( op, Natron::ImageComponents::getRGBAComponents() );
+}
+
+TEST(ImageKernelsTest,CopyUnProcessedChannels) {
+    CopyChannelsOperation op;
+    op.original = makeOverlappingImage(Natron::ImageComponents::getRGBAComponents(), 2000);
+    for (int channels = 0; channels < 16; ++channels) {
+        for (int i = 0; i < 4; ++i) {
+            op.processChannels[i] = (channels & (1 << i)) != 0;
+        }
+        for (int premult = 0; premult < 2; ++premult) {
+            for (int originalPremult = 0; originalPremult < 2; ++originalPremult) {
+                op.premult = premult ? Natron::eImagePremultiplicationPremultiplied : Natron::eImagePremultiplicationUnPremultiplied;
+                op.originalPremult = originalPremult ? Natron::eImagePremultiplicationPremultiplied : Natron::eImagePremultiplicationUnPremultiplied;
+                checkKernelsMatchLoops( op, Natron::ImageComponents::getRGBAComponents() );
+            }
+        }
+    }
+}
+
+TEST(ImageMipMapTest,PyramidAverages) {
+    ///With a linear ramp, each pixel of a level is the value of the ramp at the center of the pixels it covers
+    RectI bounds(0,0,64,32);
+    RectD rod(0,0,64,32);
+    Natron::Image src(Natron::ImageComponents::getAlphaComponents(), rod, bounds, 0, 1., Natron::eImageBitDepthFloat);
+    {
+        Natron::Image::WriteAccess acc(&src);
+        for (int y = bounds.y1; y < bounds.y2; ++y) {
+            float* pixels = (float*)acc.pixelAt(bounds.x1, y);
+            for (int x = bounds.x1; x < bounds.x2; ++x) {
+                pixels[x - bounds.x1] = x + 100.f * y;
+            }
+        }
+    }
+
+    const unsigned int levelsCount = 3;
+    std::vector<Natron::ImagePtr> images;
+    std::vector<Natron::Image*> levels;
+    for (unsigned int i = 1; i <= levelsCount; ++i) {
+        images.push_back( Natron::ImagePtr( new Natron::Image(Natron::ImageComponents::getAlphaComponents(), rod, bounds.downscalePowerOfTwoSmallestEnclosing(i),
+                                                              i, 1., Natron::eImageBitDepthFloat) ) );
+        levels.push_back( images.back().get() );
+    }
+    src.buildMipMapPyramid(rod, bounds, levels, false);
+
+    for (unsigned int i = 1; i <= levelsCount; ++i) {
+        RectI levelBounds = bounds.downscalePowerOfTwoSmallestEnclosing(i);
+        float scale = 1 << i;
+        float offset = (scale - 1.f) / 2.f;
+        Natron::Image::ReadAccess acc( levels[i - 1] );
+        for (int y = levelBounds.y1; y < levelBounds.y2; ++y) {
+            const float* pixels = (const float*)acc.pixelAt(levelBounds.x1, y);
+            for (int x = levelBounds.x1; x < levelBounds.x2; ++x) {
+                ASSERT_EQ( (x * scale + offset) + 100.f * (y * scale + offset), pixels[x - levelBounds.x1] );
+            }
+        }
+    }
+}
+
+TEST(ImageMipMapTest,PyramidKernels) {
+    ///A roi with odd bounds so that the pixels on the edges average less than 4 pixels
+    RectI bounds(-3,2,58,41);
+    RectD rod(-3,2,58,41);
+    RectI roi(-2,3,57,41);
+    const unsigned int levelsCount = 4;
+    const Natron::ImageComponents* components[2] = {
+        &Natron::ImageComponents::getRGBAComponents(), &Natron::ImageComponents::getAlphaComponents()
+    };
+    Natron::KernelInstructionSetEnum supported = Natron::getSupportedKernelInstructionSet();
+
+    for (int c = 0; c < 2; ++c) {
+        Natron::Image src(*components[c], rod, bounds, 0, 1., Natron::eImageBitDepthFloat);
+        fillWithRandomValues(&src, 1000);
+
+        std::vector<Natron::ImagePtr> images[2];
+        std::vector<Natron::Image*> levels[2];
+        for (int k = 0; k < 2; ++k) {
+            for (unsigned int i = 1; i <= levelsCount; ++i) {
+                images[k].push_back( Natron::ImagePtr( new Natron::Image(*components[c], rod, roi.downscalePowerOfTwoSmallestEnclosing(i),
+                                                                         i, 1., Natron::eImageBitDepthFloat) ) );
+                levels[k].push_back( images[k].back().get() );
+            }
+        }
+        Natron::setKernelInstructionSet(Natron::eKernelInstructionSetNone);
+        src.buildMipMapPyramid(rod, roi, levels[0], false);
+        Natron::setKernelInstructionSet(supported);
+        src.buildMipMapPyramid(rod, roi, levels[1], false);
+
+        for (unsigned int i = 0; i < levelsCount; ++i) {
+            EXPECT_TRUE( haveSamePixels(*levels[0][i], *levels[1][i]) ) << "level " << i + 1;
+        }
+    }
+}
+
+TEST(ImageStatisticsTest,MatchesSortedValues) {
+    RectI bounds(-3,2,258,141);
+    RectD rod(-3,2,258,141);
+    RectI roi(-1,5,250,140);
+    Natron::Image img(Natron::ImageComponents::getRGBAComponents(), rod, bounds, 0, 1., Natron::eImageBitDepthFloat);
+    fillWithRandomValues(&img, 1000);
+
+    ///The R values of the roi, sorted
+    std::vector<float> values;
+    {
+        Natron::Image::ReadAccess acc(&img);
+        for (int y = roi.y1; y < roi.y2; ++y) {
+            const float* pixels = (const float*)acc.pixelAt(roi.x1, y);
+            for (int x = roi.x1; x < roi.x2; ++x, pixels += 4) {
+                values.push_back(pixels[0]);
+            }
+        }
+    }
+    std::sort( values.begin(), values.end() );
+    double sum = 0.;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        sum += values[i];
+    }
+
+    Natron::KernelInstructionSetEnum supported = Natron::getSupportedKernelInstructionSet();
+    boost::shared_ptr<const Natron::ImageStatistics> statistics[2];
+    for (int k = 0; k < 2; ++k) {
+        Natron::setKernelInstructionSet(k == 0 ? Natron::eKernelInstructionSetNone : supported);
+        img.invalidateStatistics();
+        statistics[k] = img.getStatistics(Natron::eDisplayChannelsR, roi);
+
+        EXPECT_EQ( values.size(), statistics[k]->getCount() );
+        EXPECT_EQ( 0u, statistics[k]->getNaNCount() );
+        EXPECT_EQ( values.front(), statistics[k]->getMin() );
+        EXPECT_EQ( values.back(), statistics[k]->getMax() );
+        EXPECT_NEAR( sum / values.size(), statistics[k]->getMean(), 1e-9 );
+        const double percentiles[3] = { 0.01, 0.5, 0.99 };
+        for (int i = 0; i < 3; ++i) {
+            double exact = values[(std::size_t)(percentiles[i] * values.size())];
+            ///The histogram bins are 1/128 of the values wide
+            EXPECT_NEAR( exact, statistics[k]->getPercentile(percentiles[i]), std::fabs(exact) / 64. ) << "percentile " << percentiles[i];
+        }
+    }
+    Natron::setKernelInstructionSet(supported);
+    EXPECT_EQ( statistics[0]->getMean(), statistics[1]->getMean() );
+    EXPECT_EQ( statistics[0]->getPercentile(0.3), statistics[1]->getPercentile(0.3) );
+
+    ///The statistics are cached until the image is written to
+    EXPECT_EQ( statistics[1], img.getStatistics(Natron::eDisplayChannelsR, roi) );
+    img.fill(bounds, 0.5f, 0.5f, 0.5f, 1.f);
+    boost::shared_ptr<const Natron::ImageStatistics> filled = img.getStatistics(Natron::eDisplayChannelsR, roi);
+    EXPECT_NE( statistics[1], filled );
+    EXPECT_EQ( 0.5, filled->getMin() );
+    EXPECT_EQ( 0.5, filled->getPercentile(0.5) );
+}
@@ -0,0 +1,253 @@
+/* ***** BEGIN LICENSE BLOCK *****
+ * This file is part of Natron <http://www.natron.fr/>,
+ * Copyright (C) 2015 INRIA and Alexandre Gauthier-Foichat
+ *
+ * Natron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Natron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Natron.  If not, see <http://www.gnu.org/licenses/gpl-2.0.html>
+ * ***** END LICENSE BLOCK ***** */
+
+// ***** BEGIN PYTHON BLOCK *****
+// from <https://docs.python.org/3/c-api/intro.html#include-files>:
+// "Since Python may define some pre-processor definitions which affect the standard headers on some systems, you must include Python.h before any standard headers are included."
+#include <Python.h>
+// ***** END PYTHON BLOCK *****
+
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QMutex>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
+
+#include "Engine/RenderScheduler.h"
+
+using namespace Natron;
+
+namespace {
+void
+countTask(QAtomicInt* count)
+{
+    count->fetchAndAddOrdered(1);
+}
+
+void
+countInThreadTask(const QThread* thread,
+                  QAtomicInt* count)
+{
+    if (QThread::currentThread() == thread) {
+        count->fetchAndAddOrdered(1);
+    }
+}
+
+///Keeps the worker running it busy until released
+void
+blockingTask(QSemaphore* started,
+             QSemaphore* release)
+{
+    started->release();
+    release->acquire();
+}
+
+///Waits for a group of its own, as a render nested in a tile does
+void
+nestedTask(int nestedTasksCount,
+           QAtomicInt* count)
+{
+    RenderTaskGroup group;
+
+    for (int i = 0; i < nestedTasksCount; ++i) {
+        group.run( boost::bind(&countTask, count) );
+    }
+    group.wait();
+}
+
+///Records the order in which the tasks ran
+void
+orderedTask(int id,
+            QMutex* mutex,
+            std::vector<int>* order,
+            QSemaphore* done)
+{
+    {
+        QMutexLocker k(mutex);
+        order->push_back(id);
+    }
+    done->release();
+}
+
+void
+throwingTask(int kind)
+{
+    if (kind == 0) {
+        throw std::runtime_error("render task failure");
+    } else {
+        throw std::bad_alloc();
+    }
+}
+
+int
+throwOnOdd(int i)
+{
+    if (i % 2) {
+        throw std::runtime_error("odd element");
+    }
+
+    return i;
+}
+} // anon namespace
+
+TEST(RenderScheduler,HelpWhileWaiting) {
+    ///Without worker threads, the waiting thread runs all the tasks
+    setRenderSchedulerThreadsCount(0);
+
+    QAtomicInt count(0);
+    RenderTaskGroup group;
+    for (int i = 0; i < 64; ++i) {
+        group.run( boost::bind(&countInThreadTask, QThread::currentThread(), &count) );
+    }
+    group.wait();
+    EXPECT_EQ(64, (int)count);
+    RenderTaskTimings timings = group.getTimings();
+    EXPECT_EQ(64, timings.tasksCount);
+    EXPECT_EQ(64, timings.waitingThreadTasksCount);
+
+    ///With its only worker busy, the waiting thread runs the tasks queued behind the busy one instead of waiting
+    setRenderSchedulerThreadsCount(1);
+
+    QSemaphore started, release;
+    RenderTaskGroup blockingGroup;
+    blockingGroup.run( boost::bind(&blockingTask, &started, &release) );
+    started.acquire();
+
+    QAtomicInt helpedCount(0);
+    RenderTaskGroup helpedGroup;
+    for (int i = 0; i < 16; ++i) {
+        helpedGroup.run( boost::bind(&countInThreadTask, QThread::currentThread(), &helpedCount) );
+    }
+    helpedGroup.wait();
+    EXPECT_EQ(16, (int)helpedCount);
+    EXPECT_EQ(16, helpedGroup.getTimings().waitingThreadTasksCount);
+
+    release.release();
+    blockingGroup.wait();
+    EXPECT_EQ(0, blockingGroup.getTimings().waitingThreadTasksCount);
+
+    setRenderSchedulerThreadsCount( QThread::idealThreadCount() );
+}
+
+TEST(RenderScheduler,NestedWaits) {
+    ///More nested waits than workers: each must run its own tasks rather than wait for a free worker
+    const int threadsCounts[] = { 1, 2, QThread::idealThreadCount() };
+
+    for (int t = 0; t < 3; ++t) {
+        setRenderSchedulerThreadsCount(threadsCounts[t]);
+
+        QAtomicInt count(0);
+        RenderTaskGroup group;
+        for (int i = 0; i < 32; ++i) {
+            group.run( boost::bind(&nestedTask, 16, &count) );
+        }
+        group.wait();
+        EXPECT_EQ(32 * 16, (int)count);
+        EXPECT_EQ(32, group.getTimings().tasksCount);
+    }
+
+    setRenderSchedulerThreadsCount( QThread::idealThreadCount() );
+}
+
+TEST(RenderScheduler,ExceptionPropagation) {
+    QAtomicInt count(0);
+    RenderTaskGroup group;
+
+    for (int i = 0; i < 32; ++i) {
+        group.run( boost::bind(&countTask, &count) );
+    }
+    group.run( boost::bind(&throwingTask, 0) );
+    for (int i = 0; i < 32; ++i) {
+        group.run( boost::bind(&countTask, &count) );
+    }
+    try {
+        group.wait();
+        ADD_FAILURE() << "The exception of the task was not rethrown";
+    } catch (const std::runtime_error & e) {
+        EXPECT_EQ( std::string("render task failure"), std::string( e.what() ) );
+    }
+    ///The other tasks are all done when the exception is rethrown
+    EXPECT_EQ(64, (int)count);
+
+    ///The exception is rethrown once
+    EXPECT_NO_THROW( group.wait() );
+
+    group.run( boost::bind(&throwingTask, 1) );
+    EXPECT_THROW(group.wait(), std::bad_alloc);
+
+    std::vector<int> elements;
+    for (int i = 0; i < 16; ++i) {
+        elements.push_back(i);
+    }
+    std::vector<int> results;
+    EXPECT_THROW(mapInRenderScheduler(elements.begin(), elements.end(), &throwOnOdd, &results), std::runtime_error);
+
+    ///Without worker threads, the exceptions of the tasks run by the waiting thread are rethrown as well
+    setRenderSchedulerThreadsCount(0);
+    group.run( boost::bind(&throwingTask, 0) );
+    EXPECT_THROW(group.wait(), std::runtime_error);
+    setRenderSchedulerThreadsCount( QThread::idealThreadCount() );
+}
+
+TEST(RenderScheduler,LowPriorityLane) {
+    setRenderSchedulerThreadsCount(1);
+
+    QSemaphore started, release;
+    RenderTaskGroup blockingGroup;
+    blockingGroup.run( boost::bind(&blockingTask, &started, &release) );
+    started.acquire();
+
+    ///Queued while the worker is busy: the low-priority tasks are submitted first but must run last
+    QMutex mutex;
+    std::vector<int> order;
+    QSemaphore done;
+    RenderTaskGroup lowPriorityGroup;
+    {
+        RenderSchedulerLowPriorityScope lowPriority;
+        for (int i = 0; i < 8; ++i) {
+            lowPriorityGroup.run( boost::bind(&orderedTask, 100 + i, &mutex, &order, &done) );
+        }
+    }
+    RenderTaskGroup normalGroup;
+    for (int i = 0; i < 8; ++i) {
+        normalGroup.run( boost::bind(&orderedTask, i, &mutex, &order, &done) );
+    }
+
+    ///Let the worker run them all before waiting, so that this thread does not run any
+    release.release();
+    done.acquire(16);
+    blockingGroup.wait();
+    normalGroup.wait();
+    lowPriorityGroup.wait();
+
+    ASSERT_EQ( 16, (int)order.size() );
+    for (int i = 0; i < 16; ++i) {
+        EXPECT_EQ(i >= 8, order[i] >= 100);
+    }
+    EXPECT_EQ(0, normalGroup.getTimings().waitingThreadTasksCount);
+    EXPECT_EQ(0, lowPriorityGroup.getTimings().waitingThreadTasksCount);
+
+    setRenderSchedulerThreadsCount( QThread::idealThreadCount() );
+}
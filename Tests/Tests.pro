@@ -218,7 +218,12 @@ SOURCES += \
     Image_Test.cpp \
     Lut_Test.cpp \
     KnobFile_Test.cpp \
-    Curve_Test.cpp
+    Curve_Test.cpp \
+    RenderScheduler_Test.cpp \
+    CachePackAllocator_Test.cpp \
+    CacheCompression_Test.cpp \
+    ImageBufferPool_Test.cpp \
+    Cache_Test.cpp
 
 HEADERS += \
     BaseTest.h